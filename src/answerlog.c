@@ -0,0 +1,600 @@
+/*
+ * answerlog.c - Answer History Log
+ *
+ * Both files start with the same 16-byte header as the progress file:
+ * magic, version, byte-order mark and item size. A log written with the
+ * other byte order is readable as is; the first session to append to it
+ * converts both files to native order.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "answerlog.h"
+#include "persist.h"
+
+#define LOG_MAGIC "MTHL"
+#define INDEX_MAGIC "MTHI"
+#define LOG_VERSION 2             // Version 1 records lack the value and answer
+#define LOG_V1_RECORD_SIZE 16
+#define INDEX_VERSION 1
+#define HEADER_SIZE 16
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t byte_order;
+    uint32_t item_size;
+    uint32_t reserved;
+} file_header_t;
+
+/* How the records of a log on disk are laid out */
+typedef struct {
+    bool swap;                  // Written with the other byte order
+    uint32_t record_size;       // sizeof(answer_record_t), or LOG_V1_RECORD_SIZE
+} log_format_t;
+
+typedef char answer_record_size_check[(sizeof(answer_record_t) == 24) ? 1 : -1];
+typedef char answerlog_block_size_check[(sizeof(answerlog_block_t) == 36) ? 1 : -1];
+
+/* ========== Encoding ========== */
+
+static uint32_t swap32(uint32_t v) {
+    return (v >> 24) | ((v >> 8) & 0xff00u) | ((v << 8) & 0xff0000u) | (v << 24);
+}
+
+static void swap_words(void *item, size_t size) {
+    uint32_t words[16];
+    memcpy(words, item, size);
+    for (size_t i = 0; i < size / 4; i++) {
+        words[i] = swap32(words[i]);
+    }
+    memcpy(item, words, size);
+}
+
+/* Decodes one record as stored in any supported format */
+static void decode_record(const unsigned char *raw, const log_format_t *format, answer_record_t *record) {
+    uint32_t words[sizeof(answer_record_t) / 4] = {0};
+    memcpy(words, raw, format->record_size);
+    if (format->swap) {
+        // Word 1 holds the single-byte conversion id and flags, which stay put
+        swap_words(words, format->record_size);
+        words[1] = swap32(words[1]);
+    }
+    memcpy(record, words, sizeof(*record));
+    record->reserved = 0;
+    if (format->record_size < sizeof(answer_record_t)) {
+        record->flags &= (uint8_t)~ANSWERLOG_ANSWERED;
+    }
+}
+
+static uint32_t block_crc(const answerlog_block_t *block) {
+    return persist_crc32(block, offsetof(answerlog_block_t, crc));
+}
+
+static void block_add(answerlog_block_t *block, const answer_record_t *record) {
+    if (block->count == 0) {
+        block->min_time = block->max_time = record->time;
+        block->min_error = block->max_error = record->percent_error;
+    }
+    if (record->time < block->min_time) block->min_time = record->time;
+    if (record->time > block->max_time) block->max_time = record->time;
+    if (record->percent_error < block->min_error) block->min_error = record->percent_error;
+    if (record->percent_error > block->max_error) block->max_error = record->percent_error;
+
+    block->count++;
+    if (record->flags & ANSWERLOG_CORRECT) {
+        block->correct++;
+    }
+    block->conversions[record->conversion_id / 32] |= 1u << (record->conversion_id % 32);
+    block->crc = block_crc(block);
+}
+
+static void write_header(file_header_t *header, const char *magic, uint16_t version, uint32_t item_size) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, magic, 4);
+    header->version = version;
+    header->byte_order = PERSIST_BYTE_ORDER;
+    header->item_size = item_size;
+}
+
+/* Returns 0 and sets *swap if the header is ours, -1 otherwise */
+static int read_header(int fd, const char *magic, uint32_t item_size, bool *swap) {
+    file_header_t header;
+    if (persist_read_at(fd, &header, sizeof(header), 0) != 0 || memcmp(header.magic, magic, 4) != 0) {
+        return -1;
+    }
+    *swap = header.byte_order == PERSIST_BYTE_ORDER_SWAPPED;
+    if (!*swap && header.byte_order != PERSIST_BYTE_ORDER) {
+        return -1;
+    }
+    return (*swap ? swap32(header.item_size) : header.item_size) == item_size ? 0 : -1;
+}
+
+/* Returns 0 and fills *format if the file is a log we can read, -1 otherwise */
+static int read_log_header(int fd, log_format_t *format) {
+    file_header_t header;
+    if (read_header(fd, LOG_MAGIC, sizeof(answer_record_t), &format->swap) == 0) {
+        format->record_size = sizeof(answer_record_t);
+        return 0;
+    }
+    if (read_header(fd, LOG_MAGIC, LOG_V1_RECORD_SIZE, &format->swap) == 0 &&
+        persist_read_at(fd, &header, sizeof(header), 0) == 0 &&
+        header.version == (format->swap ? 0x0100 : 1)) {
+        format->record_size = LOG_V1_RECORD_SIZE;
+        return 0;
+    }
+    return -1;
+}
+
+static uint64_t record_count(int fd, uint32_t record_size) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < HEADER_SIZE) {
+        return 0;
+    }
+    return (uint64_t)(st.st_size - HEADER_SIZE) / record_size;
+}
+
+static off_t record_offset(uint64_t record, uint32_t record_size) {
+    return HEADER_SIZE + (off_t)(record * record_size);
+}
+
+static off_t block_offset(size_t block) {
+    return HEADER_SIZE + (off_t)(block * sizeof(answerlog_block_t));
+}
+
+/* ========== Block Summaries ========== */
+
+static int read_block_records(int fd, const log_format_t *format, size_t block, uint32_t count,
+                              answer_record_t *records) {
+    if (persist_read_at(fd, records, count * format->record_size,
+                        record_offset((uint64_t)block * ANSWERLOG_BLOCK_RECORDS, format->record_size)) != 0) {
+        return -1;
+    }
+    if (format->swap || format->record_size != sizeof(answer_record_t)) {
+        // Decoded in place from the last record down: a stored record never
+        // lies past the slot it decodes into
+        const unsigned char *raw = (const unsigned char *)records;
+        for (uint32_t i = count; i-- > 0;) {
+            unsigned char copy[sizeof(answer_record_t)];
+            memcpy(copy, raw + (size_t)i * format->record_size, format->record_size);
+            decode_record(copy, format, &records[i]);
+        }
+    }
+    return 0;
+}
+
+static uint32_t expected_count(uint64_t records, size_t block) {
+    uint64_t start = (uint64_t)block * ANSWERLOG_BLOCK_RECORDS;
+    uint64_t left = records - start;
+    return left < ANSWERLOG_BLOCK_RECORDS ? (uint32_t)left : ANSWERLOG_BLOCK_RECORDS;
+}
+
+/*
+ * Summaries for every block of the log: taken from the index where they
+ * are intact and agree with the log, recomputed from the log from the
+ * first one that does not. *valid receives how many came from the index.
+ */
+static int load_blocks(int data_fd, const log_format_t *format, int index_fd, uint64_t records,
+                       answerlog_block_t **blocks_out, size_t *count_out, size_t *capacity_out,
+                       size_t *valid) {
+    size_t count = (size_t)((records + ANSWERLOG_BLOCK_RECORDS - 1) / ANSWERLOG_BLOCK_RECORDS);
+    size_t capacity = count + 16;
+    answerlog_block_t *blocks = calloc(capacity, sizeof(*blocks));
+    answer_record_t *buffer = malloc(ANSWERLOG_BLOCK_RECORDS * sizeof(*buffer));
+    bool index_swap;
+    *valid = 0;
+
+    if (blocks == NULL || buffer == NULL) {
+        free(blocks);
+        free(buffer);
+        return -1;
+    }
+
+    if (index_fd >= 0 && count > 0 &&
+        read_header(index_fd, INDEX_MAGIC, sizeof(answerlog_block_t), &index_swap) == 0) {
+        struct stat st;
+        size_t stored = 0;
+        if (fstat(index_fd, &st) == 0 && st.st_size > HEADER_SIZE) {
+            stored = (size_t)(st.st_size - HEADER_SIZE) / sizeof(answerlog_block_t);
+        }
+        if (stored > count) {
+            stored = count;
+        }
+        if (stored > 0 && persist_read_at(index_fd, blocks, stored * sizeof(*blocks), HEADER_SIZE) == 0) {
+            for (size_t i = 0; i < stored; i++) {
+                uint32_t crc = index_swap ? swap32(blocks[i].crc) : blocks[i].crc;
+                if (block_crc(&blocks[i]) != crc) {
+                    break;
+                }
+                if (index_swap) {
+                    swap_words(&blocks[i], sizeof(blocks[i]));
+                    blocks[i].crc = block_crc(&blocks[i]);
+                }
+                if (blocks[i].count != expected_count(records, i)) {
+                    break;
+                }
+                *valid = i + 1;
+            }
+        }
+    }
+
+    for (size_t i = *valid; i < count; i++) {
+        uint32_t n = expected_count(records, i);
+        memset(&blocks[i], 0, sizeof(blocks[i]));
+        if (read_block_records(data_fd, format, i, n, buffer) != 0) {
+            free(blocks);
+            free(buffer);
+            return -1;
+        }
+        for (uint32_t r = 0; r < n; r++) {
+            block_add(&blocks[i], &buffer[r]);
+        }
+    }
+
+    free(buffer);
+    *blocks_out = blocks;
+    *count_out = count;
+    if (capacity_out != NULL) {
+        *capacity_out = capacity;
+    }
+    return 0;
+}
+
+/* ========== Appending ========== */
+
+/* Rewrites a log of another byte order or version in the current format */
+static int convert_log(const char *path, int fd, const log_format_t *format, uint64_t records) {
+    size_t tmp_len = strlen(path) + 5;
+    char *tmp_path = malloc(tmp_len);
+    answer_record_t *buffer = malloc(ANSWERLOG_BLOCK_RECORDS * sizeof(*buffer));
+    int out = -1;
+    int result = -1;
+
+    if (tmp_path == NULL || buffer == NULL) {
+        goto done;
+    }
+    snprintf(tmp_path, tmp_len, "%s.tmp", path);
+    out = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        goto done;
+    }
+
+    file_header_t header;
+    write_header(&header, LOG_MAGIC, LOG_VERSION, sizeof(answer_record_t));
+    if (persist_write_at(out, &header, sizeof(header), 0) != 0) {
+        goto done;
+    }
+    for (size_t block = 0; (uint64_t)block * ANSWERLOG_BLOCK_RECORDS < records; block++) {
+        uint32_t n = expected_count(records, block);
+        if (read_block_records(fd, format, block, n, buffer) != 0 ||
+            persist_write_at(out, buffer, n * sizeof(*buffer),
+                             record_offset((uint64_t)block * ANSWERLOG_BLOCK_RECORDS, sizeof(*buffer))) != 0) {
+            goto done;
+        }
+    }
+    if (fsync(out) == 0 && rename(tmp_path, path) == 0) {
+        result = 0;
+    }
+
+done:
+    if (out >= 0) {
+        close(out);
+        if (result != 0) {
+            unlink(tmp_path);
+        }
+    }
+    free(tmp_path);
+    free(buffer);
+    return result;
+}
+
+int answerlog_open(const char *path, answerlog_t *log) {
+    char index_path[PATH_MAX];
+    snprintf(index_path, sizeof(index_path), "%s%s", path, ANSWERLOG_INDEX_SUFFIX);
+
+    memset(log, 0, sizeof(*log));
+    log->data_fd = log->index_fd = -1;
+
+    log->data_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (log->data_fd < 0) {
+        return -1;
+    }
+
+    file_header_t header;
+    log_format_t format = { false, sizeof(answer_record_t) };
+    struct stat st;
+    if (fstat(log->data_fd, &st) != 0) {
+        goto fail;
+    }
+    if (st.st_size == 0) {
+        write_header(&header, LOG_MAGIC, LOG_VERSION, sizeof(answer_record_t));
+        if (persist_write_at(log->data_fd, &header, sizeof(header), 0) != 0) {
+            goto fail;
+        }
+    } else if (read_log_header(log->data_fd, &format) != 0) {
+        goto fail;  // Not a log we understand; leave it alone
+    }
+
+    log->records = record_count(log->data_fd, format.record_size);
+    if (format.swap || format.record_size != sizeof(answer_record_t)) {
+        if (convert_log(path, log->data_fd, &format, log->records) != 0) {
+            goto fail;
+        }
+        close(log->data_fd);
+        log->data_fd = open(path, O_RDWR);
+        if (log->data_fd < 0) {
+            goto fail;
+        }
+        unlink(index_path);  // Rebuilt below, in native order
+        format.swap = false;
+        format.record_size = sizeof(answer_record_t);
+    }
+    // Drop a record torn by a crash, so appends stay aligned
+    if (ftruncate(log->data_fd, record_offset(log->records, sizeof(answer_record_t))) != 0) {
+        goto fail;
+    }
+
+    log->index_fd = open(index_path, O_RDWR | O_CREAT, 0644);
+    if (log->index_fd < 0) {
+        goto fail;
+    }
+
+    bool index_swap;
+    bool index_ok = read_header(log->index_fd, INDEX_MAGIC, sizeof(answerlog_block_t), &index_swap) == 0 &&
+                    !index_swap;
+    size_t valid;
+    if (load_blocks(log->data_fd, &format, index_ok ? log->index_fd : -1, log->records,
+                    &log->blocks, &log->block_count, &log->block_capacity, &valid) != 0) {
+        goto fail;
+    }
+
+    // Bring the index up to date with the log before appending to either
+    if (!index_ok) {
+        write_header(&header, INDEX_MAGIC, INDEX_VERSION, sizeof(answerlog_block_t));
+        if (ftruncate(log->index_fd, 0) != 0 ||
+            persist_write_at(log->index_fd, &header, sizeof(header), 0) != 0) {
+            goto fail;
+        }
+        valid = 0;
+    }
+    log->first_dirty_block = valid;
+    if (valid < log->block_count &&
+        (persist_write_at(log->index_fd, &log->blocks[valid],
+                          (log->block_count - valid) * sizeof(answerlog_block_t), block_offset(valid)) != 0 ||
+         ftruncate(log->index_fd, block_offset(log->block_count)) != 0)) {
+        goto fail;
+    }
+    log->first_dirty_block = log->block_count;
+    return 0;
+
+fail:
+    answerlog_close(log);
+    return -1;
+}
+
+void answerlog_append(answerlog_t *log, const stats_delta_t *delta) {
+    if (log->data_fd < 0) {
+        return;
+    }
+
+    if (log->pending_count == log->pending_capacity) {
+        size_t capacity = log->pending_capacity > 0 ? log->pending_capacity * 2 : 64;
+        answer_record_t *pending = realloc(log->pending, capacity * sizeof(*pending));
+        if (pending == NULL) {
+            return;
+        }
+        log->pending = pending;
+        log->pending_capacity = capacity;
+    }
+
+    size_t block = (size_t)((log->records + log->pending_count) / ANSWERLOG_BLOCK_RECORDS);
+    if (block >= log->block_count) {
+        if (block >= log->block_capacity) {
+            size_t capacity = log->block_capacity * 2 + 16;
+            answerlog_block_t *blocks = realloc(log->blocks, capacity * sizeof(*blocks));
+            if (blocks == NULL) {
+                return;
+            }
+            log->blocks = blocks;
+            log->block_capacity = capacity;
+        }
+        memset(&log->blocks[block], 0, sizeof(log->blocks[block]));
+        log->block_count = block + 1;
+    }
+
+    answer_record_t *record = &log->pending[log->pending_count++];
+    memset(record, 0, sizeof(*record));
+    record->time = (uint32_t)delta->answered_at;
+    record->conversion_id = (uint8_t)delta->conversion_id;
+    record->flags = (delta->correct ? ANSWERLOG_CORRECT : 0) |
+                    (delta->response_seconds > 0.0f ? ANSWERLOG_TIMED : 0) | ANSWERLOG_ANSWERED;
+    record->percent_error = delta->percent_error;
+    record->response_seconds = delta->response_seconds > 0.0f ? delta->response_seconds : 0.0f;
+    record->value = delta->value;
+    record->answer = delta->answer;
+
+    block_add(&log->blocks[block], record);
+    if (block < log->first_dirty_block) {
+        log->first_dirty_block = block;
+    }
+}
+
+int answerlog_flush(answerlog_t *log) {
+    if (log->data_fd < 0 || log->pending_count == 0) {
+        return 0;
+    }
+
+    // Records first: an index that is behind the log is repaired on open,
+    // so the order of the two syncs is what keeps the pair consistent
+    if (persist_write_at(log->data_fd, log->pending, log->pending_count * sizeof(answer_record_t),
+                         record_offset(log->records, sizeof(answer_record_t))) != 0 ||
+        fdatasync(log->data_fd) != 0) {
+        return -1;
+    }
+    log->records += log->pending_count;
+    log->pending_count = 0;
+
+    size_t first = log->first_dirty_block;
+    if (persist_write_at(log->index_fd, &log->blocks[first],
+                         (log->block_count - first) * sizeof(answerlog_block_t), block_offset(first)) != 0 ||
+        fdatasync(log->index_fd) != 0) {
+        return -1;
+    }
+    log->first_dirty_block = log->block_count;
+    return 0;
+}
+
+void answerlog_close(answerlog_t *log) {
+    answerlog_flush(log);
+    if (log->data_fd >= 0) {
+        close(log->data_fd);
+    }
+    if (log->index_fd >= 0) {
+        close(log->index_fd);
+    }
+    free(log->blocks);
+    free(log->pending);
+    memset(log, 0, sizeof(*log));
+    log->data_fd = log->index_fd = -1;
+}
+
+/* ========== Queries ========== */
+
+static bool block_may_match(const answerlog_block_t *block, const answerlog_filter_t *filter) {
+    if (block->max_time < filter->since || (filter->until != 0 && block->min_time > filter->until)) {
+        return false;
+    }
+    if ((filter->conversions[0] | filter->conversions[1]) != 0 &&
+        (block->conversions[0] & filter->conversions[0]) == 0 &&
+        (block->conversions[1] & filter->conversions[1]) == 0) {
+        return false;
+    }
+    return !(filter->incorrect_only && block->correct == block->count);
+}
+
+static bool record_matches(const answer_record_t *record, const answerlog_filter_t *filter) {
+    if (record->time < filter->since || (filter->until != 0 && record->time > filter->until)) {
+        return false;
+    }
+    if ((filter->conversions[0] | filter->conversions[1]) != 0 &&
+        !(filter->conversions[record->conversion_id / 32] & (1u << (record->conversion_id % 32)))) {
+        return false;
+    }
+    return !(filter->incorrect_only && (record->flags & ANSWERLOG_CORRECT));
+}
+
+int answerlog_query(const char *path, const answerlog_filter_t *filter,
+                    answerlog_visit_fn visit, void *context, answerlog_scan_t *scan) {
+    char index_path[PATH_MAX];
+    snprintf(index_path, sizeof(index_path), "%s%s", path, ANSWERLOG_INDEX_SUFFIX);
+
+    answerlog_scan_t local;
+    if (scan == NULL) {
+        scan = &local;
+    }
+    memset(scan, 0, sizeof(*scan));
+
+    int data_fd = open(path, O_RDONLY);
+    if (data_fd < 0) {
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    log_format_t format;
+    int result = -1;
+    int index_fd = -1;
+    answerlog_block_t *blocks = NULL;
+    answer_record_t *buffer = NULL;
+    size_t block_count, valid;
+
+    if (read_log_header(data_fd, &format) != 0) {
+        goto done;
+    }
+    uint64_t records = record_count(data_fd, format.record_size);
+    index_fd = open(index_path, O_RDONLY);
+    buffer = malloc(ANSWERLOG_BLOCK_RECORDS * sizeof(*buffer));
+    if (buffer == NULL ||
+        load_blocks(data_fd, &format, index_fd, records, &blocks, &block_count, NULL, &valid) != 0) {
+        goto done;
+    }
+
+    scan->blocks_total = block_count;
+    for (size_t i = 0; i < block_count; i++) {
+        if (!block_may_match(&blocks[i], filter)) {
+            continue;
+        }
+        uint32_t n = blocks[i].count;
+        if (read_block_records(data_fd, &format, i, n, buffer) != 0) {
+            goto done;
+        }
+        scan->blocks_read++;
+        scan->records_read += n;
+        for (uint32_t r = 0; r < n; r++) {
+            if (record_matches(&buffer[r], filter)) {
+                visit(context, &buffer[r]);
+            }
+        }
+    }
+    result = 0;
+
+done:
+    if (index_fd >= 0) {
+        close(index_fd);
+    }
+    close(data_fd);
+    free(blocks);
+    free(buffer);
+    return result;
+}
+
+int answerlog_summary(const char *path, answerlog_block_t *summary) {
+    char index_path[PATH_MAX];
+    snprintf(index_path, sizeof(index_path), "%s%s", path, ANSWERLOG_INDEX_SUFFIX);
+    memset(summary, 0, sizeof(*summary));
+
+    int data_fd = open(path, O_RDONLY);
+    if (data_fd < 0) {
+        return -1;
+    }
+
+    log_format_t format;
+    int result = -1;
+    int index_fd = open(index_path, O_RDONLY);
+    answerlog_block_t *blocks = NULL;
+    size_t block_count, valid;
+
+    if (read_log_header(data_fd, &format) == 0 &&
+        load_blocks(data_fd, &format, index_fd, record_count(data_fd, format.record_size), &blocks, &block_count, NULL, &valid) == 0) {
+        for (size_t i = 0; i < block_count; i++) {
+            const answerlog_block_t *block = &blocks[i];
+            if (summary->count == 0) {
+                summary->min_time = block->min_time;
+                summary->max_time = block->max_time;
+                summary->min_error = block->min_error;
+                summary->max_error = block->max_error;
+            }
+            if (block->min_time < summary->min_time) summary->min_time = block->min_time;
+            if (block->max_time > summary->max_time) summary->max_time = block->max_time;
+            if (block->min_error < summary->min_error) summary->min_error = block->min_error;
+            if (block->max_error > summary->max_error) summary->max_error = block->max_error;
+            summary->count += block->count;
+            summary->correct += block->correct;
+            summary->conversions[0] |= block->conversions[0];
+            summary->conversions[1] |= block->conversions[1];
+        }
+        summary->crc = block_crc(summary);
+        result = 0;
+    }
+
+    if (index_fd >= 0) {
+        close(index_fd);
+    }
+    close(data_fd);
+    free(blocks);
+    return result;
+}
@@ -0,0 +1,142 @@
+/*
+ * answerlog.h - Answer History Log
+ *
+ * Every answer given in practice, appended to a compact log so it can be
+ * queried later by date, category, conversion and correctness.
+ *
+ * Two files, both suffixed with ".<user>" under --user:
+ *
+ *   .metric_trainer_history      16-byte header, then 24-byte answer records
+ *                                 in the order given; record k belongs to
+ *                                 block k / ANSWERLOG_BLOCK_RECORDS
+ *   .metric_trainer_history.idx  16-byte header, then one 36-byte summary
+ *                                 per block: time range, answers, correct
+ *                                 answers, conversions present (bitmap),
+ *                                 error range, CRC
+ *
+ * A query reads the whole index - a few bytes per 256 answers - and then
+ * only the blocks whose summaries can match, so selective queries over
+ * years of history touch a handful of 6 KB blocks. The index is derived
+ * data: summaries that are missing, damaged or behind the log after a
+ * crash are recomputed from the log when it is next opened. Version 1
+ * logs, whose 16-byte records lack the value and answer, are read as
+ * they are and converted the next time a session appends to them.
+ */
+
+#ifndef ANSWERLOG_H
+#define ANSWERLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "questions.h"
+
+#define ANSWERLOG_FILE ".metric_trainer_history"
+#define ANSWERLOG_INDEX_SUFFIX ".idx"
+#define ANSWERLOG_BLOCK_RECORDS 256
+
+#define ANSWERLOG_CORRECT 0x01
+#define ANSWERLOG_TIMED 0x02
+#define ANSWERLOG_ANSWERED 0x04     // value and answer recorded (not in version 1 logs)
+
+/* One answer, 24 bytes */
+typedef struct {
+    uint32_t time;              // Unix time of the answer
+    uint8_t conversion_id;
+    uint8_t flags;              // ANSWERLOG_CORRECT, ANSWERLOG_TIMED, ANSWERLOG_ANSWERED
+    uint16_t reserved;
+    float percent_error;
+    float response_seconds;     // Valid if ANSWERLOG_TIMED
+    float value;                // Value asked about; valid if ANSWERLOG_ANSWERED
+    float answer;               // Answer given; valid if ANSWERLOG_ANSWERED
+} answer_record_t;
+
+/* Summary of one block of records */
+typedef struct {
+    uint32_t min_time;
+    uint32_t max_time;
+    uint32_t count;
+    uint32_t correct;
+    uint32_t conversions[2];    // Bit i set if conversion i appears
+    float min_error;
+    float max_error;
+    uint32_t crc;               // CRC-32 of the fields above
+} answerlog_block_t;
+
+/* An open log being appended to (by the stats writer) */
+typedef struct {
+    int data_fd;
+    int index_fd;
+    uint64_t records;           // Records on disk
+    answerlog_block_t *blocks;  // Summaries of all blocks, including pending records
+    size_t block_count;
+    size_t block_capacity;
+    size_t first_dirty_block;   // Summaries from here on are unsaved
+    answer_record_t *pending;   // Appended but not yet written
+    size_t pending_count;
+    size_t pending_capacity;
+} answerlog_t;
+
+/* Query filter; zero fields match everything */
+typedef struct {
+    uint32_t since;             // Earliest time, inclusive
+    uint32_t until;             // Latest time, inclusive (0 = no limit)
+    uint32_t conversions[2];    // Bitmap of conversions to include
+    bool incorrect_only;
+} answerlog_filter_t;
+
+/* Work done by a query, for reporting */
+typedef struct {
+    size_t blocks_total;
+    size_t blocks_read;
+    uint64_t records_read;
+} answerlog_scan_t;
+
+typedef void (*answerlog_visit_fn)(void *context, const answer_record_t *record);
+
+/**
+ * Open (creating if needed) a log for appending
+ * @param path Log file name; the index is path + ANSWERLOG_INDEX_SUFFIX
+ * @param log Log state to initialize
+ * @return 0 on success, -1 on error
+ */
+int answerlog_open(const char *path, answerlog_t *log);
+
+/**
+ * Add an answer to the log; written at the next answerlog_flush
+ */
+void answerlog_append(answerlog_t *log, const stats_delta_t *delta);
+
+/**
+ * Write appended answers and their block summaries, then sync
+ * @return 0 on success, -1 on error
+ */
+int answerlog_flush(answerlog_t *log);
+
+/**
+ * Flush and close a log
+ */
+void answerlog_close(answerlog_t *log);
+
+/**
+ * Visit every logged answer that matches a filter, in log order
+ * @param path Log file name
+ * @param filter Which answers to visit
+ * @param visit Called once per matching answer
+ * @param context Passed to visit
+ * @param scan Receives how much of the log was read (may be NULL)
+ * @return 0 on success (including a missing log), -1 on error
+ */
+int answerlog_query(const char *path, const answerlog_filter_t *filter,
+                    answerlog_visit_fn visit, void *context, answerlog_scan_t *scan);
+
+/**
+ * Summarize a whole log from its index, reading log blocks only where the
+ * index is missing or stale
+ * @param path Log file name
+ * @param summary Receives the combined summary of all blocks
+ * @return 0 on success, -1 if the log cannot be read
+ */
+int answerlog_summary(const char *path, answerlog_block_t *summary);
+
+#endif
@@ -0,0 +1,579 @@
+/*
+ * api.c - Practice Sessions over HTTP
+ *
+ * Requests are routed by method and path with plain comparisons; the
+ * session routes carry the id as 16 hex digits, looked up in an
+ * open-addressing table (linear probing, backward-shift deletion, so no
+ * tombstones build up as sessions come and go). Sessions come from a
+ * slab, so once the server has seen its peak number of sessions,
+ * starting and ending them makes no heap calls. Responses are written
+ * straight into the connection's output buffer with the outbuf
+ * formatters, never through stdio.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "api.h"
+#include "leaderboard.h"
+#include "metrics.h"
+#include "questions.h"
+#include "rng.h"
+#include "sketch.h"
+#include "slab.h"
+#include "tables.h"
+#include "userstore.h"
+
+#define SESSION_ID_DIGITS 16
+#define SESSION_TABLE_INITIAL 1024
+#define SESSIONS_PER_CHUNK 256
+#define MAX_LEADERBOARD_TOP 100
+#define MAX_PARAM 64
+
+typedef struct {
+    uint64_t id;
+    char user[USER_NAME_MAX + 1];     // Empty if anonymous
+    category_selection_t selection;
+    rng_t rng;
+    question_t question;
+    bool pending;                     // question is waiting for an answer
+    uint32_t questions_asked;
+    double asked_at;                  // Monotonic seconds when the question was fetched
+    double active_at;                 // Monotonic seconds of the last request
+    session_stats_t stats;
+} session_t;
+
+struct api {
+    session_t **table;                // Open addressing by id; NULL = empty
+    size_t capacity;                  // Power of two
+    size_t count;
+    size_t table_allocations;         // Heap allocations of the table so far
+    slab_t slab;                      // Where sessions live
+    size_t max_sessions;
+    int idle_seconds;
+    leaderboard_t *leaderboard;
+    rng_t rng;                        // Session ids and seeds
+};
+
+/* ========== Helpers ========== */
+
+static double monotonic_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/* Copy a parameter into a NUL-terminated buffer; false if absent or too long */
+static bool param(const http_request_t *request, const char *name, char *buf, size_t size) {
+    const char *value;
+    size_t len;
+    if (!http_query(request, name, &value, &len) || len >= size) {
+        return false;
+    }
+    memcpy(buf, value, len);
+    buf[len] = '\0';
+    return true;
+}
+
+/* JSON has no infinities or NaN: those are sent as null */
+static void put_number(outbuf_t *out, double value) {
+    if (isfinite(value)) {
+        outbuf_fixed(out, value, 2);
+    } else {
+        outbuf_puts(out, "null");
+    }
+}
+
+static void put_hex_id(outbuf_t *out, uint64_t id) {
+    static const char hex[] = "0123456789abcdef";
+    char digits[SESSION_ID_DIGITS + 2];
+    digits[0] = '"';
+    for (int i = 0; i < SESSION_ID_DIGITS; i++) {
+        digits[SESSION_ID_DIGITS - i] = hex[(id >> (4 * i)) & 15];
+    }
+    digits[SESSION_ID_DIGITS + 1] = '"';
+    outbuf_write(out, digits, sizeof(digits));
+}
+
+static bool parse_hex_id(const char *text, size_t len, uint64_t *id) {
+    if (len != SESSION_ID_DIGITS) {
+        return false;
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < len; i++) {
+        char c = text[i];
+        int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (digit < 0) {
+            return false;
+        }
+        value = value << 4 | (uint64_t)digit;
+    }
+    *id = value;
+    return value != 0;
+}
+
+static void put_lower_name(outbuf_t *out, const char *name) {
+    char lower[32];
+    size_t n = 0;
+    for (; name[n] != '\0' && n < sizeof(lower); n++) {
+        lower[n] = (name[n] >= 'A' && name[n] <= 'Z') ? (char)(name[n] + ('a' - 'A')) : name[n];
+    }
+    http_json_string(out, lower, n);
+}
+
+void api_error(outbuf_t *out, int status, const char *message, bool keep_alive) {
+    size_t body = http_begin(out, status, "application/json", keep_alive);
+    outbuf_puts(out, "{\"error\":");
+    http_json_string(out, message, strlen(message));
+    outbuf_puts(out, "}\n");
+    http_end(out, body);
+}
+
+/* ========== Session Table ========== */
+
+static size_t slot_of(const api_t *api, uint64_t id) {
+    // Ids are random, so their low bits are already well mixed
+    return (size_t)id & (api->capacity - 1);
+}
+
+static session_t *find_session(const api_t *api, uint64_t id) {
+    for (size_t i = slot_of(api, id);; i = (i + 1) & (api->capacity - 1)) {
+        session_t *session = api->table[i];
+        if (session == NULL || session->id == id) {
+            return session;
+        }
+    }
+}
+
+static void place_session(session_t **table, size_t capacity, session_t *session) {
+    size_t i = (size_t)session->id & (capacity - 1);
+    while (table[i] != NULL) {
+        i = (i + 1) & (capacity - 1);
+    }
+    table[i] = session;
+}
+
+static int grow_table(api_t *api) {
+    size_t capacity = api->capacity * 2;
+    session_t **table = calloc(capacity, sizeof(session_t *));
+    if (table == NULL) {
+        return -1;
+    }
+    for (size_t i = 0; i < api->capacity; i++) {
+        if (api->table[i] != NULL) {
+            place_session(table, capacity, api->table[i]);
+        }
+    }
+    free(api->table);
+    api->table = table;
+    api->capacity = capacity;
+    api->table_allocations++;
+    return 0;
+}
+
+/* Removes the session at slot i, shifting later entries of its run back */
+static void remove_slot(api_t *api, size_t i) {
+    size_t mask = api->capacity - 1;
+    slab_free(&api->slab, api->table[i]);
+    api->table[i] = NULL;
+    api->count--;
+    metrics_session_ended();
+
+    for (size_t j = (i + 1) & mask; api->table[j] != NULL; j = (j + 1) & mask) {
+        size_t home = slot_of(api, api->table[j]->id);
+        // Move j back into the hole unless its home lies cyclically in (i, j]
+        bool stays = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+        if (!stays) {
+            api->table[i] = api->table[j];
+            api->table[j] = NULL;
+            i = j;
+        }
+    }
+}
+
+static void remove_session(api_t *api, uint64_t id) {
+    for (size_t i = slot_of(api, id); api->table[i] != NULL; i = (i + 1) & (api->capacity - 1)) {
+        if (api->table[i]->id == id) {
+            remove_slot(api, i);
+            return;
+        }
+    }
+}
+
+/* ========== Handlers ========== */
+
+static void create_session(api_t *api, const http_request_t *request, outbuf_t *out) {
+    char categories[MAX_PARAM] = "all";
+    char user[MAX_PARAM] = "";
+    const char *value;
+    size_t len;
+
+    if (http_query(request, "categories", &value, &len) && !param(request, "categories", categories, sizeof(categories))) {
+        api_error(out, 400, "categories is too long", request->keep_alive);
+        return;
+    }
+    if (http_query(request, "user", &value, &len) &&
+        (!param(request, "user", user, sizeof(user)) || !userstore_valid_name(user))) {
+        api_error(out, 400, "user must be 1-31 letters, digits, '.', '_' or '-'", request->keep_alive);
+        return;
+    }
+
+    category_selection_t selection;
+    if (!parse_category_input(categories, &selection)) {
+        api_error(out, 400, "categories must be letters a-d or \"all\"", request->keep_alive);
+        return;
+    }
+    if (api->count >= api->max_sessions) {
+        api_error(out, 503, "too many sessions", request->keep_alive);
+        return;
+    }
+    if ((api->count + 1) * 2 > api->capacity && grow_table(api) != 0) {
+        api_error(out, 503, "out of memory", request->keep_alive);
+        return;
+    }
+    session_t *session = slab_alloc(&api->slab);
+    if (session == NULL) {
+        api_error(out, 503, "out of memory", request->keep_alive);
+        return;
+    }
+    memset(session, 0, sizeof(*session));
+
+    do {
+        session->id = rng_next(&api->rng);
+    } while (session->id == 0 || find_session(api, session->id) != NULL);
+    memcpy(session->user, user, sizeof(session->user) - 1);
+    session->selection = selection;
+    rng_seed(&session->rng, rng_next(&api->rng));
+    session->active_at = monotonic_seconds();
+    place_session(api->table, api->capacity, session);
+    api->count++;
+    metrics_session_started();
+
+    size_t body = http_begin(out, 201, "application/json", request->keep_alive);
+    outbuf_puts(out, "{\"session\":");
+    put_hex_id(out, session->id);
+    outbuf_puts(out, "}\n");
+    http_end(out, body);
+}
+
+static void get_question(session_t *session, const http_request_t *request, outbuf_t *out) {
+    if (!session->pending) {
+        session->question = generate_question_r(&session->selection, &session->rng);
+        session->pending = true;
+        session->questions_asked++;
+        session->asked_at = monotonic_seconds();
+        metrics_question(session->question.category);
+    }
+    const question_t *q = &session->question;
+
+    size_t body = http_begin(out, 200, "application/json", request->keep_alive);
+    outbuf_puts(out, "{\"number\":");
+    outbuf_long(out, (long)session->questions_asked);
+    outbuf_puts(out, ",\"category\":");
+    put_lower_name(out, category_names[q->category]);
+    outbuf_puts(out, ",\"conversion\":");
+    outbuf_long(out, q->conversion_id);
+    outbuf_puts(out, ",\"from\":");
+    http_json_string(out, q->from_unit, strlen(q->from_unit));
+    outbuf_puts(out, ",\"to\":");
+    http_json_string(out, q->to_unit, strlen(q->to_unit));
+    outbuf_puts(out, ",\"value\":");
+    put_number(out, q->value);
+    outbuf_puts(out, ",\"text\":");
+    http_json_string(out, q->question_text, strlen(q->question_text));
+    outbuf_puts(out, "}\n");
+    http_end(out, body);
+}
+
+static void post_answer(api_t *api, session_t *session, const http_request_t *request, outbuf_t *out) {
+    char text[MAX_PARAM];
+    if (!param(request, "value", text, sizeof(text))) {
+        if (request->body_len == 0 || request->body_len >= sizeof(text)) {
+            api_error(out, 400, "send the answer as ?value=X or as the body", request->keep_alive);
+            return;
+        }
+        memcpy(text, request->body, request->body_len);
+        text[request->body_len] = '\0';
+    }
+    char *end;
+    double value = strtod(text, &end);
+    while (*end == ' ' || *end == '\n' || *end == '\r') {
+        end++;
+    }
+    if (end == text || *end != '\0' || !isfinite(value)) {
+        api_error(out, 400, "the answer is not a number", request->keep_alive);
+        return;
+    }
+    if (fabs(value) > FLT_MAX) {
+        api_error(out, 400, "the answer is out of range", request->keep_alive);
+        return;
+    }
+    if (!session->pending) {
+        api_error(out, 409, "no question is waiting for an answer", request->keep_alive);
+        return;
+    }
+
+    double started = monotonic_seconds();
+    const question_t *q = &session->question;
+    float answer = (float)value;
+    answer_result_t result = grade_answer(q, answer);
+    float seconds = (float)(started - session->asked_at);
+    stats_delta_t delta = make_stats_delta(q, answer, result.percent_error, result.is_correct, seconds);
+    update_stats(&session->stats, &delta);
+    if (session->user[0] != '\0' && api->leaderboard != NULL) {
+        leaderboard_record(api->leaderboard, session->user, &delta);
+    }
+    session->pending = false;
+
+    size_t body = http_begin(out, 200, "application/json", request->keep_alive);
+    outbuf_puts(out, result.is_correct ? "{\"correct\":true" : "{\"correct\":false");
+    outbuf_puts(out, ",\"answer\":");
+    put_number(out, q->correct_answer);
+    outbuf_puts(out, ",\"tolerance\":");
+    put_number(out, q->tolerance);
+    outbuf_puts(out, ",\"error\":");
+    put_number(out, result.percent_error);
+    outbuf_puts(out, ",\"seconds\":");
+    put_number(out, seconds);
+    outbuf_puts(out, "}\n");
+    http_end(out, body);
+    metrics_answer(q->category, result.is_correct, monotonic_seconds() - started);
+}
+
+static void get_stats(const session_t *session, const http_request_t *request, outbuf_t *out) {
+    const session_stats_t *stats = &session->stats;
+
+    size_t body = http_begin(out, 200, "application/json", request->keep_alive);
+    outbuf_puts(out, "{\"answered\":");
+    outbuf_long(out, stats->total_questions);
+    outbuf_puts(out, ",\"correct\":");
+    outbuf_long(out, stats->correct_answers);
+    if (stats->total_questions > 0) {
+        outbuf_puts(out, ",\"error_median\":");
+        put_number(out, sketch_quantile(&stats->error_sketch, &sketch_percent_scale, 0.5f));
+        outbuf_puts(out, ",\"error_p90\":");
+        put_number(out, sketch_quantile(&stats->error_sketch, &sketch_percent_scale, 0.9f));
+    }
+    if (sketch_count(&stats->seconds_sketch) > 0) {
+        outbuf_puts(out, ",\"seconds_median\":");
+        put_number(out, sketch_quantile(&stats->seconds_sketch, &sketch_seconds_scale, 0.5f));
+    }
+    outbuf_puts(out, ",\"categories\":{");
+    for (int c = 0; c < CATEGORY_COUNT; c++) {
+        if (c > 0) {
+            outbuf_putc(out, ',');
+        }
+        put_lower_name(out, category_names[c]);
+        outbuf_puts(out, ":{\"answered\":");
+        outbuf_long(out, stats->category_totals[c]);
+        outbuf_puts(out, ",\"correct\":");
+        outbuf_long(out, stats->category_correct[c]);
+        outbuf_putc(out, '}');
+    }
+    outbuf_puts(out, "}}\n");
+    http_end(out, body);
+}
+
+static void put_entry(outbuf_t *out, const leaderboard_entry_t *entry) {
+    const leaderboard_score_t *score = &entry->score;
+    outbuf_puts(out, "{\"rank\":");
+    outbuf_long(out, (long)entry->rank);
+    outbuf_puts(out, ",\"user\":");
+    http_json_string(out, entry->user, strlen(entry->user));
+    outbuf_puts(out, ",\"answered\":");
+    outbuf_long(out, (long)score->answered);
+    outbuf_puts(out, ",\"correct\":");
+    outbuf_long(out, (long)score->correct);
+    if (score->timed > 0) {
+        outbuf_puts(out, ",\"seconds\":");
+        put_number(out, score->seconds / score->timed);
+    }
+    outbuf_puts(out, ",\"best_streak\":");
+    outbuf_long(out, (long)score->best_streak);
+    outbuf_putc(out, '}');
+}
+
+static void get_leaderboard(api_t *api, const http_request_t *request, outbuf_t *out) {
+    char text[MAX_PARAM];
+    char user[MAX_PARAM];
+    int scope = LEADERBOARD_ALL;
+    int metric = LEADERBOARD_ACCURACY;
+    long top = 10;
+
+    if (param(request, "by", text, sizeof(text)) && (metric = leaderboard_parse_metric(text)) < 0) {
+        api_error(out, 400, "by must be accuracy, speed or streak", request->keep_alive);
+        return;
+    }
+    if (param(request, "category", text, sizeof(text)) && (scope = leaderboard_parse_scope(text)) < 0) {
+        api_error(out, 400, "unknown category", request->keep_alive);
+        return;
+    }
+    if (param(request, "top", text, sizeof(text)) && !parse_whole_number(text, 1, MAX_LEADERBOARD_TOP, &top)) {
+        api_error(out, 400, "top must be 1-100", request->keep_alive);
+        return;
+    }
+    bool want_user = param(request, "user", user, sizeof(user));
+
+    leaderboard_entry_t entries[MAX_LEADERBOARD_TOP];
+    size_t shown = leaderboard_top(api->leaderboard, scope, (leaderboard_metric_t)metric, 1, (size_t)top, entries);
+
+    size_t body = http_begin(out, 200, "application/json", request->keep_alive);
+    outbuf_puts(out, "{\"by\":\"");
+    outbuf_puts(out, leaderboard_metric_names[metric]);
+    outbuf_puts(out, "\",\"category\":");
+    put_lower_name(out, scope == LEADERBOARD_ALL ? "all" : category_names[scope]);
+    outbuf_puts(out, ",\"ranked\":");
+    outbuf_long(out, (long)leaderboard_ranked(api->leaderboard, scope, (leaderboard_metric_t)metric));
+    outbuf_puts(out, ",\"entries\":[");
+    for (size_t i = 0; i < shown; i++) {
+        if (i > 0) {
+            outbuf_putc(out, ',');
+        }
+        put_entry(out, &entries[i]);
+    }
+    outbuf_putc(out, ']');
+    leaderboard_entry_t mine;
+    if (want_user && leaderboard_find(api->leaderboard, user, scope, (leaderboard_metric_t)metric, &mine)) {
+        outbuf_puts(out, ",\"you\":");
+        put_entry(out, &mine);
+    }
+    outbuf_puts(out, "}\n");
+    http_end(out, body);
+}
+
+static void get_metrics(const http_request_t *request, outbuf_t *out) {
+    size_t body = http_begin(out, 200, "text/plain; version=0.0.4", request->keep_alive);
+    metrics_render(out);
+    http_end(out, body);
+}
+
+/* ========== Public Interface ========== */
+
+api_t *api_create(const api_options_t *options) {
+    api_t *api = calloc(1, sizeof(api_t));
+    if (api == NULL) {
+        return NULL;
+    }
+    api->capacity = SESSION_TABLE_INITIAL;
+    api->table = calloc(api->capacity, sizeof(session_t *));
+    api->table_allocations = 1;
+    slab_init(&api->slab, sizeof(session_t), SESSIONS_PER_CHUNK);
+    api->max_sessions = options->max_sessions;
+    api->idle_seconds = options->idle_seconds;
+    api->leaderboard = leaderboard_create(LEADERBOARD_MIN_ANSWERS);
+    if (api->table == NULL || api->leaderboard == NULL ||
+        (options->store != NULL && access(options->store, F_OK) == 0 &&
+         leaderboard_load(api->leaderboard, options->store, NULL) != 0)) {
+        api_free(api);
+        return NULL;
+    }
+
+    // Session ids must not be guessable from one another or across restarts
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    rng_seed(&api->rng, (uint64_t)now.tv_sec * 1000000007u ^ (uint64_t)now.tv_nsec ^ (uint64_t)getpid() << 32);
+    FILE *urandom = fopen("/dev/urandom", "rb");
+    if (urandom != NULL) {
+        uint64_t seed;
+        if (fread(&seed, sizeof(seed), 1, urandom) == 1) {
+            rng_seed(&api->rng, seed);
+        }
+        fclose(urandom);
+    }
+    return api;
+}
+
+void api_free(api_t *api) {
+    if (api == NULL) {
+        return;
+    }
+    free(api->table);
+    slab_destroy(&api->slab);
+    leaderboard_free(api->leaderboard);
+    free(api);
+}
+
+void api_handle(api_t *api, const http_request_t *request, outbuf_t *out) {
+    static const char prefix[] = "/session/";
+    const size_t prefix_len = sizeof(prefix) - 1;
+
+    if (http_is(request, "POST", "/session")) {
+        create_session(api, request, out);
+        return;
+    } else if (http_is(request, "GET", "/leaderboard")) {
+        get_leaderboard(api, request, out);
+        return;
+    } else if (http_is(request, "GET", "/metrics")) {
+        get_metrics(request, out);
+        return;
+    }
+
+    // /session/ID[/question|/answer|/stats]
+    uint64_t id;
+    if (request->path_len < prefix_len + SESSION_ID_DIGITS || memcmp(request->path, prefix, prefix_len) != 0 ||
+        !parse_hex_id(request->path + prefix_len, SESSION_ID_DIGITS, &id)) {
+        api_error(out, 404, "no such endpoint", request->keep_alive);
+        return;
+    }
+    session_t *session = find_session(api, id);
+    if (session == NULL) {
+        api_error(out, 404, "no such session", request->keep_alive);
+        return;
+    }
+    session->active_at = monotonic_seconds();
+
+    const char *action = request->path + prefix_len + SESSION_ID_DIGITS;
+    size_t action_len = request->path_len - prefix_len - SESSION_ID_DIGITS;
+    const char *method = request->method;
+    size_t method_len = request->method_len;
+#define ROUTE(m, a) (method_len == sizeof(m) - 1 && memcmp(method, m, method_len) == 0 && \
+                     action_len == sizeof(a) - 1 && memcmp(action, a, action_len) == 0)
+    if (ROUTE("GET", "/question")) {
+        get_question(session, request, out);
+    } else if (ROUTE("POST", "/answer")) {
+        post_answer(api, session, request, out);
+    } else if (ROUTE("GET", "/stats")) {
+        get_stats(session, request, out);
+    } else if (ROUTE("DELETE", "")) {
+        remove_session(api, id);
+        size_t body = http_begin(out, 200, "application/json", request->keep_alive);
+        outbuf_puts(out, "{\"ended\":true}\n");
+        http_end(out, body);
+    } else {
+        api_error(out, 404, "no such endpoint", request->keep_alive);
+    }
+#undef ROUTE
+}
+
+size_t api_expire(api_t *api) {
+    double cutoff = monotonic_seconds() - api->idle_seconds;
+    size_t ended = 0;
+    size_t i = 0;
+
+    // Removal shifts later entries back into slot i, so only advance past
+    // a slot that keeps its session
+    while (i < api->capacity) {
+        session_t *session = api->table[i];
+        if (session != NULL && session->active_at < cutoff) {
+            remove_slot(api, i);
+            ended++;
+        } else {
+            i++;
+        }
+    }
+    return ended;
+}
+
+size_t api_sessions(const api_t *api) {
+    return api->count;
+}
+
+void api_memory(const api_t *api, api_memory_t *memory) {
+    memory->sessions = api->count;
+    memory->bytes = slab_bytes(&api->slab) + api->capacity * sizeof(session_t *);
+    memory->allocations = api->slab.chunk_count + api->table_allocations;
+}
@@ -0,0 +1,96 @@
+/*
+ * api.h - Practice Sessions over HTTP
+ *
+ * The JSON API behind `metric-trainer serve`. Sessions live in memory,
+ * keyed by a random 64-bit id, and use the same generate_question_r /
+ * grade_answer core as the terminal. Graded answers feed the session's
+ * statistics, the live leaderboard (for sessions with a user) and the
+ * metrics.
+ *
+ *   POST   /session?categories=ab&user=NAME   start a session -> {"session": id}
+ *   GET    /session/ID/question                the pending question (a new one
+ *                                              once the last was answered)
+ *   POST   /session/ID/answer?value=X          grade X (or a body of just X)
+ *   GET    /session/ID/stats                   the session's statistics
+ *   DELETE /session/ID                         end the session
+ *   GET    /leaderboard?by=M&category=C&top=N&user=NAME
+ *   GET    /metrics                            Prometheus text format
+ *
+ * Errors come back as {"error": "..."} with a 4xx or 5xx status.
+ */
+
+#ifndef API_H
+#define API_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "http.h"
+#include "outbuf.h"
+
+#define API_DEFAULT_MAX_SESSIONS 100000
+#define API_DEFAULT_IDLE_SECONDS 1800
+
+typedef struct api api_t;
+
+/* Memory held for sessions */
+typedef struct {
+    size_t sessions;            // Open sessions
+    size_t bytes;               // Held from the heap for them (slab and table)
+    size_t allocations;         // Heap allocations made for them so far
+} api_memory_t;
+
+typedef struct {
+    const char *store;          // User store to seed the leaderboard from, or NULL
+    size_t max_sessions;
+    int idle_seconds;           // Sessions idle this long are ended
+} api_options_t;
+
+/**
+ * Create the API state (and load the leaderboard)
+ * @param options Settings
+ * @return The API, or NULL if the store cannot be read or memory ran out
+ */
+api_t *api_create(const api_options_t *options);
+
+/**
+ * End every session and free the API
+ */
+void api_free(api_t *api);
+
+/**
+ * Answer one request, appending a complete response to out
+ * @param api The API
+ * @param request Parsed request
+ * @param out Connection output (memory mode)
+ */
+void api_handle(api_t *api, const http_request_t *request, outbuf_t *out);
+
+/**
+ * Append a JSON error response
+ * @param out Connection output (memory mode)
+ * @param status HTTP status
+ * @param message Error text
+ * @param keep_alive Whether the connection stays open
+ */
+void api_error(outbuf_t *out, int status, const char *message, bool keep_alive);
+
+/**
+ * End sessions that have been idle too long
+ * @param api The API
+ * @return Number of sessions ended
+ */
+size_t api_expire(api_t *api);
+
+/**
+ * Number of open sessions
+ */
+size_t api_sessions(const api_t *api);
+
+/**
+ * Report the memory held for sessions
+ * @param api The API
+ * @param memory Receives the figures
+ */
+void api_memory(const api_t *api, api_memory_t *memory);
+
+#endif
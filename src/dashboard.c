@@ -0,0 +1,670 @@
+/*
+ * dashboard.c - Full-Screen Practice Dashboard
+ *
+ * Every frame is drawn from scratch into the screen's frame buffer and
+ * presented; screen_present() works out what actually changed, so the
+ * drawing code never has to. Keys are read one at a time with poll(2),
+ * which also wakes the loop for the question timer and, through
+ * SIGWINCH, for resizes.
+ *
+ * SIGINT, SIGTERM and SIGHUP give the terminal back before they take
+ * effect. During a session the stats writer catches them first, saves,
+ * puts these handlers back and raises the signal again (statswriter.h).
+ *
+ * Layout, top to bottom (at least DASH_MIN_COLS x DASH_MIN_ROWS):
+ *
+ *   title bar                         session totals
+ *   question box: question, answer line, feedback
+ *   accuracy heading                  error median and p90
+ *   sparkline of accuracy over the last DASH_WINDOW answers
+ *   heatmap heading, then two rows per category
+ *   answer time heading               median and p90
+ *   histogram of the seconds sketch, then its axis
+ *   status bar
+ */
+
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "dashboard.h"
+#include "format.h"
+#include "metrics.h"
+#include "questions.h"
+#include "screen.h"
+#include "statswriter.h"
+#include "tables.h"
+
+#define DASH_MIN_ROWS 24
+#define DASH_MIN_COLS 72
+#define DASH_LINE_SIZE 40               // Longest answer or command that can be typed
+#define DASH_WINDOW 10                  // Answers the running accuracy covers
+#define DASH_HISTORY 512                // Running accuracy points kept for the sparkline
+#define DASH_TICK_MS 100                // Timer refresh while a question waits
+#define DASH_IDLE_MS 1000
+#define DASH_TIME_BUCKETS 22            // Sketch buckets shown; the last takes everything above
+#define DASH_BUCKET_WIDTH 3
+#define DASH_LABEL_WIDTH 12             // Category names in the heatmap
+
+#define CH_HLINE 0x2500
+#define CH_VLINE 0x2502
+#define CH_TOP_LEFT 0x250C
+#define CH_TOP_RIGHT 0x2510
+#define CH_BOTTOM_LEFT 0x2514
+#define CH_BOTTOM_RIGHT 0x2518
+#define CH_BLOCK_1 0x2581               // Lower one eighth; 0x2588 is the full block
+#define CH_FULL_BLOCK 0x2588
+
+static const screen_style_t plain = { SCREEN_DEFAULT, SCREEN_DEFAULT, 0 };
+static const screen_style_t bold = { SCREEN_DEFAULT, SCREEN_DEFAULT, SCREEN_BOLD };
+static const screen_style_t dim = { SCREEN_DEFAULT, SCREEN_DEFAULT, SCREEN_DIM };
+static const screen_style_t bar = { SCREEN_DEFAULT, SCREEN_DEFAULT, SCREEN_REVERSE };
+static const screen_style_t bar_title = { SCREEN_DEFAULT, SCREEN_DEFAULT, SCREEN_REVERSE | SCREEN_BOLD };
+static const screen_style_t histogram = { SCREEN_CYAN, SCREEN_DEFAULT, 0 };
+static const screen_style_t good = { SCREEN_GREEN, SCREEN_DEFAULT, SCREEN_BOLD };
+static const screen_style_t bad = { SCREEN_RED, SCREEN_DEFAULT, SCREEN_BOLD };
+static const screen_style_t caret = { SCREEN_DEFAULT, SCREEN_DEFAULT, SCREEN_REVERSE };
+
+typedef struct {
+    screen_t screen;
+    bool quit;
+    int escape;                         // Position inside an escape sequence being skipped
+
+    // The line being typed
+    char line[DASH_LINE_SIZE];
+    size_t line_len;
+    char feedback[MAX_QUESTION_TEXT];
+    screen_style_t feedback_style;
+
+    // The session, as run_practice_session keeps it
+    bool in_session;
+    bool any_session;
+    category_selection_t selection;
+    question_t question;
+    int questions_asked;
+    double asked_at;
+    session_stats_t stats;
+    persistent_stats_t lifetime;        // Loaded at the start, then updated per answer
+
+    // Running accuracy
+    bool recent[DASH_WINDOW];
+    int answered;
+    float history[DASH_HISTORY];
+    int history_count;
+} dashboard_t;
+
+static const int fatal_signals[] = { SIGINT, SIGTERM, SIGHUP };
+#define FATAL_SIGNAL_COUNT (int)(sizeof(fatal_signals) / sizeof(fatal_signals[0]))
+
+static volatile sig_atomic_t resized = 0;
+static const screen_t *open_screen;     // For the fatal signal handler
+
+static void on_resize(int sig) {
+    (void)sig;
+    resized = 1;
+}
+
+static void on_fatal_signal(int sig) {
+    screen_restore(open_screen);
+
+    // Die of the signal as if it had never been caught
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = SIG_DFL;
+    sigemptyset(&action.sa_mask);
+    sigaction(sig, &action, NULL);
+    raise(sig);
+}
+
+static double monotonic_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/* Copy a string without its terminator, returning the end of the copy */
+static char *append_text(char *dst, const char *src) {
+    size_t len = strlen(src);
+    memcpy(dst, src, len);
+    return dst + len;
+}
+
+/* "8/12 correct (66.7%)" */
+static char *append_score(char *p, int correct, int total) {
+    p = fmt_long(p, correct);
+    *p++ = '/';
+    p = fmt_long(p, total);
+    p = append_text(p, " correct");
+    if (total > 0) {
+        p = append_text(p, " (");
+        p = fmt_fixed(p, (float)correct / total * 100.0f, 1);
+        p = append_text(p, "%)");
+    }
+    return p;
+}
+
+/* ========== Sessions ========== */
+
+static void ask_question(dashboard_t *d) {
+    d->question = generate_question(&d->selection);
+    d->questions_asked++;
+    d->asked_at = monotonic_seconds();
+    metrics_question(d->question.category);
+}
+
+static void start_session(dashboard_t *d, const category_selection_t *selection) {
+    d->selection = *selection;
+    d->in_session = true;
+    d->any_session = true;
+    d->questions_asked = 0;
+    memset(&d->stats, 0, sizeof(d->stats));
+    load_persistent_stats(&d->lifetime);
+    statswriter_start(&d->lifetime, STATSWRITER_DEFAULT_INTERVAL_MS);
+    metrics_session_started();
+    d->feedback[0] = '\0';
+    ask_question(d);
+}
+
+static void end_session(dashboard_t *d) {
+    statswriter_stop(NULL);
+    metrics_session_ended();
+    d->in_session = false;
+
+    char *p = append_text(d->feedback, "Session ended: ");
+    p = append_score(p, d->stats.correct_answers, d->stats.total_questions);
+    *p = '\0';
+    d->feedback_style = bold;
+}
+
+static void answer_question(dashboard_t *d, float answer) {
+    const question_t *q = &d->question;
+    double answered = monotonic_seconds();
+    float seconds = (float)(answered - d->asked_at);
+
+    answer_result_t result = grade_answer(q, answer);
+    stats_delta_t delta = make_stats_delta(q, answer, result.percent_error, result.is_correct, seconds);
+    update_stats(&d->stats, &delta);
+    apply_stats_delta(&d->lifetime, &delta);
+    statswriter_record(&delta);
+    metrics_answer(q->category, result.is_correct, monotonic_seconds() - answered);
+
+    // Feedback in check_answer's words
+    char *p = append_text(d->feedback, "Correct answer: ");
+    p = fmt_fixed(p, q->correct_answer, 2);
+    p = append_text(p, " (±");
+    p = fmt_fixed(p, q->tolerance, 2);
+    *p++ = ' ';
+    p = append_text(p, q->to_unit);
+    if (result.is_correct) {
+        p = append_text(p, ")  Correct!");
+    } else {
+        p = append_text(p, ")  Error: ");
+        p = fmt_fixed(p, result.percent_error, 1);
+        p = append_text(p, "% off target");
+    }
+    *p = '\0';
+    d->feedback_style = result.is_correct ? good : bad;
+
+    // Running accuracy over the last DASH_WINDOW answers
+    d->recent[d->answered % DASH_WINDOW] = result.is_correct;
+    d->answered++;
+    int window = d->answered < DASH_WINDOW ? d->answered : DASH_WINDOW;
+    int correct = 0;
+    for (int i = 0; i < window; i++) {
+        correct += d->recent[i];
+    }
+    d->history[d->history_count % DASH_HISTORY] = (float)correct / (float)window;
+    d->history_count++;
+}
+
+/* ========== Input ========== */
+
+/* Trim and lowercase the typed line in place */
+static char *normalize(char *line) {
+    while (*line == ' ') {
+        line++;
+    }
+    size_t len = strlen(line);
+    while (len > 0 && line[len - 1] == ' ') {
+        line[--len] = '\0';
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (line[i] >= 'A' && line[i] <= 'Z') {
+            line[i] = (char)(line[i] + ('a' - 'A'));
+        }
+    }
+    return line;
+}
+
+static void set_feedback(dashboard_t *d, const char *text, screen_style_t style) {
+    snprintf(d->feedback, sizeof(d->feedback), "%s", text);
+    d->feedback_style = style;
+}
+
+static void submit_line(dashboard_t *d) {
+    d->line[d->line_len] = '\0';
+    char *line = normalize(d->line);
+    d->line_len = 0;
+
+    if (strcmp(line, "quit") == 0 || strcmp(line, "exit") == 0) {
+        if (d->in_session) {
+            end_session(d);
+        } else {
+            d->quit = true;
+        }
+        return;
+    }
+
+    if (!d->in_session) {
+        category_selection_t selection;
+        if (parse_category_input(line, &selection)) {
+            start_session(d, &selection);
+        } else {
+            set_feedback(d, "Enter categories like 'a', 'bd' or 'all', or 'quit'", bad);
+        }
+        return;
+    }
+
+    if (strcmp(line, "skip") == 0) {
+        set_feedback(d, "Skipped", dim);
+        ask_question(d);
+    } else if (is_valid_number(line) && isfinite(strtof(line, NULL))) {
+        answer_question(d, strtof(line, NULL));
+        ask_question(d);
+    } else if (*line != '\0') {
+        set_feedback(d, "Enter a number, 'skip' or 'quit'", bad);
+    }
+}
+
+static void handle_key(dashboard_t *d, unsigned char c) {
+    // Arrow and function keys: ESC [ ... final byte, or ESC O x
+    if (d->escape == 1) {
+        d->escape = (c == '[' || c == 'O') ? 2 : 0;
+        return;
+    }
+    if (d->escape == 2) {
+        if (c >= 0x40 && c <= 0x7e) {
+            d->escape = 0;
+        }
+        return;
+    }
+
+    switch (c) {
+    case 0x1b:
+        d->escape = 1;
+        break;
+    case 0x03:                          // Ctrl-C
+    case 0x04:                          // Ctrl-D
+        d->quit = true;
+        break;
+    case 0x0c:                          // Ctrl-L
+        screen_invalidate(&d->screen);
+        break;
+    case 0x15:                          // Ctrl-U
+        d->line_len = 0;
+        break;
+    case 0x08:
+    case 0x7f:
+        if (d->line_len > 0) {
+            d->line_len--;
+        }
+        break;
+    case '\r':
+    case '\n':
+        submit_line(d);
+        break;
+    default:
+        if (c >= 0x20 && c < 0x7f && d->line_len < DASH_LINE_SIZE - 1) {
+            d->line[d->line_len++] = (char)c;
+        }
+        break;
+    }
+}
+
+/* ========== Drawing ========== */
+
+static void draw_title(dashboard_t *d, int row) {
+    screen_t *s = &d->screen;
+    char right[96];
+    char *p = right;
+
+    screen_fill(s, row, 0, s->cols, ' ', bar);
+    int col = screen_text(s, row, 1, "Metric Trainer Dashboard", bar_title);
+    if (g_easy_mode) {
+        col = screen_text(s, row, col, "  Easy Mode", bar);
+    } else if (g_whole_numbers_mode) {
+        col = screen_text(s, row, col, "  Whole Numbers", bar);
+    }
+    if (g_user_name != NULL) {
+        col = screen_text(s, row, col, "  user: ", bar);
+        screen_text(s, row, col, g_user_name, bar);
+    }
+
+    if (d->any_session) {
+        p = append_text(p, "Session: ");
+        p = append_score(p, d->stats.correct_answers, d->stats.total_questions);
+        *p++ = ' ';
+    }
+    *p = '\0';
+    screen_text(s, row, s->cols - (int)strlen(right) - 1, right, bar);
+}
+
+static void draw_box(screen_t *s, int top, int height, const char *title, const char *right) {
+    screen_put(s, top, 0, CH_TOP_LEFT, plain);
+    screen_fill(s, top, 1, s->cols - 2, CH_HLINE, plain);
+    screen_put(s, top, s->cols - 1, CH_TOP_RIGHT, plain);
+    screen_text(s, top, 2, title, bold);
+    screen_text(s, top, s->cols - 2 - (int)strlen(right), right, plain);
+    for (int row = top + 1; row < top + height - 1; row++) {
+        screen_put(s, row, 0, CH_VLINE, plain);
+        screen_put(s, row, s->cols - 1, CH_VLINE, plain);
+    }
+    screen_put(s, top + height - 1, 0, CH_BOTTOM_LEFT, plain);
+    screen_fill(s, top + height - 1, 1, s->cols - 2, CH_HLINE, plain);
+    screen_put(s, top + height - 1, s->cols - 1, CH_BOTTOM_RIGHT, plain);
+}
+
+/* Five rows */
+static void draw_question(dashboard_t *d, int top) {
+    screen_t *s = &d->screen;
+    char title[48], elapsed[FMT_MAX_CHARS + 4];
+    char *p;
+
+    if (d->in_session) {
+        p = append_text(title, " Question ");
+        p = fmt_long(p, d->questions_asked);
+        p = append_text(p, " ");
+        *p = '\0';
+        p = append_text(elapsed, " ");
+        p = fmt_fixed(p, monotonic_seconds() - d->asked_at, 1);
+        p = append_text(p, "s ");
+        *p = '\0';
+        draw_box(s, top, 5, title, elapsed);
+        screen_text(s, top + 1, 2, d->question.question_text, bold);
+    } else {
+        draw_box(s, top, 5, " Categories ", "");
+        screen_text(s, top + 1, 2, "a Distance, b Weight, c Temperature, d Volume, or all; quit to exit", plain);
+    }
+
+    d->line[d->line_len] = '\0';
+    int col = screen_text(s, top + 2, 2, "> ", bold);
+    col = screen_text(s, top + 2, col, d->line, plain);
+    screen_put(s, top + 2, col, ' ', caret);
+    screen_text(s, top + 3, 2, d->feedback, d->feedback_style);
+}
+
+/* Two rows */
+static void draw_accuracy(dashboard_t *d, int top) {
+    screen_t *s = &d->screen;
+    const session_stats_t *stats = &d->stats;
+    char right[96];
+    char *p = right;
+
+    screen_text(s, top, 0, "Accuracy", bold);
+    screen_text(s, top, 9, "(last 10 answers)", dim);
+    if (stats->total_questions > 0) {
+        p = append_text(p, "error median ");
+        p = fmt_fixed(p, sketch_quantile(&stats->error_sketch, &sketch_percent_scale, 0.5f), 1);
+        p = append_text(p, "%  p90 ");
+        p = fmt_fixed(p, sketch_quantile(&stats->error_sketch, &sketch_percent_scale, 0.9f), 1);
+        *p++ = '%';
+    }
+    *p = '\0';
+    screen_text(s, top, s->cols - (int)strlen(right), right, plain);
+
+    if (d->history_count == 0) {
+        screen_text(s, top + 1, 0, "No answers yet", dim);
+        return;
+    }
+    int width = s->cols;
+    int shown = d->history_count < width ? d->history_count : width;
+    if (shown > DASH_HISTORY) shown = DASH_HISTORY;
+    for (int i = 0; i < shown; i++) {
+        float accuracy = d->history[(d->history_count - shown + i) % DASH_HISTORY];
+        int level = (int)lrintf(accuracy * 7.0f);
+        screen_style_t style = { accuracy >= 0.8f ? SCREEN_GREEN : accuracy >= 0.5f ? SCREEN_YELLOW : SCREEN_RED,
+                                 SCREEN_DEFAULT, 0 };
+        screen_put(s, top + 1, i, (uint32_t)(CH_BLOCK_1 + level), style);
+    }
+}
+
+/* One heading row, then two rows per category */
+static void draw_heatmap(dashboard_t *d, int top) {
+    screen_t *s = &d->screen;
+    const persistent_stats_t *lifetime = &d->lifetime;
+    int cell = (s->cols - DASH_LABEL_WIDTH) / MAX_CONVERSIONS_PER_CATEGORY;
+    if (cell > 10) cell = 10;
+
+    screen_text(s, top, 0, "Lifetime accuracy", bold);
+    screen_text(s, top, 18, "by conversion", dim);
+
+    for (int c = 0; c < CATEGORY_COUNT; c++) {
+        int label_row = top + 1 + 2 * c;
+        int heat_row = label_row + 1;
+        bool active = d->in_session && d->selection.active[c];
+        char text[32];
+        char *p;
+
+        screen_text(s, label_row, 0, category_names[c], active ? bold : plain);
+        if (d->stats.category_totals[c] > 0) {
+            p = fmt_long(text, d->stats.category_correct[c]);
+            *p++ = '/';
+            p = fmt_long(p, d->stats.category_totals[c]);
+            p = append_text(p, " now");
+            *p = '\0';
+            screen_text(s, heat_row, 0, text, dim);
+        }
+
+        int count;
+        const unsigned char *ids = get_conversions_for_category((category_t)c, &count);
+        for (int i = 0; i < count; i++) {
+            int id = ids[i];
+            int col = DASH_LABEL_WIDTH + i * cell;
+            bool current = d->in_session && d->question.conversion_id == id;
+
+            p = append_text(text, unit_string(conversion_names[id].from_abbrev));
+            p = append_text(p, "→");
+            p = append_text(p, unit_string(conversion_names[id].to_abbrev));
+            *p = '\0';
+            screen_style_t label = current ? caret : dim;
+            int end = screen_text(s, label_row, col, text, label);
+            for (int k = col + cell - 1; k < end; k++) {
+                screen_put(s, label_row, k, ' ', plain);      // Clip to the cell, keep a gap
+            }
+
+            const conversion_stats_t *stats = &lifetime->conversions[id];
+            screen_style_t heat = { SCREEN_DEFAULT, SCREEN_BRIGHT_BLACK, 0 };
+            if (stats->total > 0) {
+                int percent = (int)lrintf((float)stats->correct / (float)stats->total * 100.0f);
+                heat.fg = SCREEN_BLACK;
+                heat.bg = percent >= 75 ? SCREEN_GREEN : percent >= 50 ? SCREEN_YELLOW : SCREEN_RED;
+                p = fmt_long(text, percent);
+                *p++ = '%';
+            } else {
+                p = append_text(text, "-");
+            }
+            *p = '\0';
+            screen_fill(s, heat_row, col, cell - 1, ' ', heat);
+            screen_text(s, heat_row, col + (cell - 1 - (int)strlen(text)) / 2, text, heat);
+        }
+    }
+}
+
+/* Heading, height rows of bars, and the axis */
+static void draw_times(dashboard_t *d, int top, int height) {
+    screen_t *s = &d->screen;
+    const sketch_scale_t *scale = &sketch_seconds_scale;
+    sketch_t lifetime = {{0}};
+    const sketch_t *sketch = &d->stats.seconds_sketch;
+    bool session = sketch_count(sketch) > 0;
+    char right[96];
+    char *p = right;
+
+    // Before the session's first answer, show the lifetime distribution
+    if (!session) {
+        for (int id = 0; id < CONVERSION_COUNT; id++) {
+            sketch_merge(&lifetime, &d->lifetime.conversions[id].seconds_sketch);
+        }
+        sketch = &lifetime;
+    }
+    screen_text(s, top, 0, "Answer time", bold);
+    screen_text(s, top, 12, session ? "this session" : "lifetime", dim);
+    if (sketch_count(sketch) == 0) {
+        screen_text(s, top + 1, 0, "No answers yet", dim);
+        return;
+    }
+    p = append_text(p, "median ");
+    p = fmt_fixed(p, sketch_quantile(sketch, scale, 0.5f), 1);
+    p = append_text(p, "s  p90 ");
+    p = fmt_fixed(p, sketch_quantile(sketch, scale, 0.9f), 1);
+    *p++ = 's';
+    *p = '\0';
+    screen_text(s, top, s->cols - (int)strlen(right), right, plain);
+
+    uint32_t counts[DASH_TIME_BUCKETS] = {0};
+    uint32_t most = 0;
+    for (int b = 0; b < SKETCH_BUCKETS; b++) {
+        int shown = b < DASH_TIME_BUCKETS ? b : DASH_TIME_BUCKETS - 1;
+        counts[shown] += sketch->counts[b];
+    }
+    for (int b = 0; b < DASH_TIME_BUCKETS; b++) {
+        if (counts[b] > most) most = counts[b];
+    }
+
+    // Bars in eighths of a row
+    for (int b = 0; b < DASH_TIME_BUCKETS; b++) {
+        int eighths = (int)(((uint64_t)counts[b] * (uint64_t)(height * 8) + most - 1) / most);
+        int col = b * DASH_BUCKET_WIDTH;
+        for (int r = 0; r < height && eighths > 0; r++, eighths -= 8) {
+            uint32_t ch = eighths >= 8 ? CH_FULL_BLOCK : (uint32_t)(CH_BLOCK_1 + eighths - 1);
+            screen_fill(s, top + height - r, col, DASH_BUCKET_WIDTH - 1, ch, histogram);
+        }
+    }
+
+    // Axis: lower edges of every fifth bucket (bucket b starts at min * gamma^(b-1))
+    int axis = top + height + 1;
+    for (int b = 1; b < DASH_TIME_BUCKETS; b += 5) {
+        double edge = scale->min * exp(scale->log_gamma * (b - 1));
+        p = fmt_fixed(right, edge, edge < 1.0 ? 2 : edge < 10.0 ? 1 : 0);
+        *p++ = 's';
+        if (b + 5 >= DASH_TIME_BUCKETS) {
+            *p++ = '+';
+        }
+        *p = '\0';
+        screen_text(s, axis, b * DASH_BUCKET_WIDTH, right, dim);
+    }
+}
+
+static void draw_status(dashboard_t *d, int row) {
+    screen_t *s = &d->screen;
+    char right[96];
+    char *p = right;
+
+    screen_fill(s, row, 0, s->cols, ' ', bar);
+    screen_text(s, row, 1, d->in_session ? "number: answer  skip  quit: end session  Ctrl-L: redraw"
+                                         : "categories: start  quit: exit  Ctrl-L: redraw", bar);
+    p = append_text(p, "last frame ");
+    p = fmt_long(p, (long)d->screen.last_bytes);
+    p = append_text(p, " B ");
+    *p = '\0';
+    screen_text(s, row, s->cols - (int)strlen(right), right, bar);
+}
+
+static void draw(dashboard_t *d) {
+    screen_t *s = &d->screen;
+
+    screen_clear(s);
+    if (s->rows < DASH_MIN_ROWS || s->cols < DASH_MIN_COLS) {
+        char text[64];
+        char *p = append_text(text, "Make the terminal at least ");
+        p = fmt_long(p, DASH_MIN_COLS);
+        *p++ = 'x';
+        p = fmt_long(p, DASH_MIN_ROWS);
+        *p = '\0';
+        screen_text(s, 0, 0, text, bold);
+        return;
+    }
+
+    int times_height = s->rows - 20;
+    if (times_height > 10) times_height = 10;
+
+    draw_title(d, 0);
+    draw_question(d, 1);
+    draw_accuracy(d, 6);
+    draw_heatmap(d, 8);
+    draw_times(d, 17, times_height);
+    draw_status(d, s->rows - 1);
+}
+
+/* ========== Public API ========== */
+
+int dashboard_main(void) {
+    static dashboard_t d;               // persistent_stats_t is too big for the stack
+
+    if (!isatty(STDIN_FILENO) || screen_open(&d.screen, STDOUT_FILENO) != 0) {
+        fprintf(stderr, "dashboard: needs a terminal on standard input and output\n");
+        return 1;
+    }
+    load_persistent_stats(&d.lifetime);
+
+    struct sigaction action, saved, saved_fatal[FATAL_SIGNAL_COUNT];
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_resize;      // No SA_RESTART, so poll() wakes up
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGWINCH, &action, &saved);
+
+    open_screen = &d.screen;
+    action.sa_handler = on_fatal_signal;
+    for (int i = 0; i < FATAL_SIGNAL_COUNT; i++) {
+        sigaction(fatal_signals[i], &action, &saved_fatal[i]);
+        if (saved_fatal[i].sa_handler == SIG_IGN) {
+            sigaction(fatal_signals[i], &saved_fatal[i], NULL);  // e.g. under nohup
+        }
+    }
+
+    while (!d.quit) {
+        if (resized) {
+            resized = 0;
+            screen_resize(&d.screen);
+        }
+        draw(&d);
+        if (screen_present(&d.screen) != 0) {
+            break;
+        }
+
+        struct pollfd key = { STDIN_FILENO, POLLIN, 0 };
+        int ready = poll(&key, 1, d.in_session ? DASH_TICK_MS : DASH_IDLE_MS);
+        if (ready > 0) {
+            unsigned char keys[64];
+            ssize_t n = read(STDIN_FILENO, keys, sizeof(keys));
+            if (n <= 0) {
+                break;                  // The terminal went away
+            }
+            for (ssize_t i = 0; i < n && !d.quit; i++) {
+                handle_key(&d, keys[i]);
+            }
+        }
+    }
+
+    if (d.in_session) {
+        end_session(&d);
+    }
+    unsigned long long frames = d.screen.frames;
+    unsigned long long bytes = d.screen.total_bytes;
+    for (int i = 0; i < FATAL_SIGNAL_COUNT; i++) {
+        sigaction(fatal_signals[i], &saved_fatal[i], NULL);
+    }
+    screen_close(&d.screen);
+    sigaction(SIGWINCH, &saved, NULL);
+
+    if (d.any_session) {
+        print_session_summary(&d.stats);
+    }
+    printf("\n%llu frames, %llu bytes to the terminal (%llu per frame)\n", frames, bytes,
+           frames > 0 ? bytes / frames : 0);
+    return 0;
+}
@@ -0,0 +1,23 @@
+/*
+ * dashboard.h - Full-Screen Practice Dashboard
+ *
+ * Practice sessions on one live screen (see screen.h): the current
+ * question with the answer being typed and feedback on the last one, a
+ * sparkline of running accuracy, a heatmap of lifetime accuracy for
+ * every conversion, and the distribution of answer times. The session
+ * and lifetime figures are the same ones the session summary and the
+ * 'stats' report print, updated as each answer is graded; the screen
+ * ticks ten times a second while a question is waiting.
+ */
+
+#ifndef DASHBOARD_H
+#define DASHBOARD_H
+
+/**
+ * Run the dashboard on the terminal until the user quits, then print the
+ * last session's summary
+ * @return Process exit status
+ */
+int dashboard_main(void);
+
+#endif
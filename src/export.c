@@ -0,0 +1,663 @@
+/*
+ * export.c - Answer History Export
+ *
+ * Rows stream from the answer log (or a columnar export, with --input)
+ * straight into the output: text formats are rendered with the fmt_*
+ * formatters into one outbuf, while the columnar writer keeps seven
+ * in-memory column buffers and writes them out every EXPORT_GROUP_ROWS
+ * rows. Memory use is bounded by one group, whatever the history size.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "answerlog.h"
+#include "export.h"
+#include "format.h"
+#include "history.h"
+#include "outbuf.h"
+#include "questions.h"
+#include "tables.h"
+#include "userstore.h"
+
+#define EXPORT_MAGIC "MTCX"
+#define EXPORT_VERSION 1
+#define EXPORT_GROUP_ROWS 65536
+#define EXPORT_COLUMNS 7
+#define EXPORT_OUTBUF_SIZE (1 << 20)
+#define MAX_DICTIONARY 256
+#define DECIMAL_RAW 3             // Decimal column tag: a raw float follows
+
+typedef enum {
+    EXPORT_COLUMNAR,
+    EXPORT_CSV,
+    EXPORT_NDJSON
+} export_format_t;
+
+static const char *const format_names[] = { "columnar", "csv", "ndjson" };
+
+enum {
+    COLUMN_TIME,
+    COLUMN_CONVERSION,
+    COLUMN_FLAGS,
+    COLUMN_VALUE,
+    COLUMN_ANSWER,
+    COLUMN_ERROR,
+    COLUMN_LATENCY
+};
+
+typedef struct {
+    export_format_t format;
+    const char *output_path;
+    const char *input_path;     // Columnar export to convert, instead of the log
+    uint32_t since;
+    uint32_t until;
+    const char *user;           // Whose log: --user, else the practicing user
+} export_options_t;
+
+/* Conversion names by dictionary code ("?" for unused codes) */
+typedef struct {
+    const char *from[MAX_DICTIONARY];
+    const char *to[MAX_DICTIONARY];
+} export_dictionary_t;
+
+typedef struct {
+    export_format_t format;
+    outbuf_t out;
+    const export_dictionary_t *dictionary;
+    uint64_t rows;
+
+    /* Columnar writer */
+    outbuf_t columns[EXPORT_COLUMNS];
+    uint32_t group_rows;
+    uint32_t previous_time;
+} export_writer_t;
+
+static void show_export_help(void) {
+    printf("USAGE:\n");
+    printf("  metric-trainer export [OPTIONS]\n\n");
+    printf("OPTIONS:\n");
+    printf("  -f, --format FORMAT    columnar (default), csv or ndjson\n");
+    printf("  -o, --output FILE      Write to FILE (default: standard output)\n");
+    printf("  --since DATE           Answers on or after DATE (YYYY-MM-DD)\n");
+    printf("  --until DATE           Answers on or before DATE (YYYY-MM-DD)\n");
+    printf("  -i, --input FILE       Convert a columnar export to csv or ndjson\n");
+    printf("                         instead of reading the answer log\n");
+    printf("  -u, --user NAME        Export NAME's history (see --user in practice)\n\n");
+    printf("The columnar layout is described under \"Exporting History\" in README.md.\n");
+}
+
+static int parse_export_options(int argc, char *argv[], export_options_t *opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->format = EXPORT_COLUMNAR;
+    opts->user = g_user_name;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            show_export_help();
+            return 0;
+        }
+        if (value == NULL) {
+            fprintf(stderr, "export: unknown option or missing value: %s\n", arg);
+            return -1;
+        }
+        i++;
+
+        if (strcmp(arg, "-f") == 0 || strcmp(arg, "--format") == 0) {
+            size_t f;
+            for (f = 0; f < sizeof(format_names) / sizeof(format_names[0]); f++) {
+                if (strcmp(value, format_names[f]) == 0) {
+                    break;
+                }
+            }
+            if (f == sizeof(format_names) / sizeof(format_names[0])) {
+                fprintf(stderr, "export: unknown format '%s'\n", value);
+                return -1;
+            }
+            opts->format = (export_format_t)f;
+        } else if (strcmp(arg, "-o") == 0 || strcmp(arg, "--output") == 0) {
+            opts->output_path = value;
+        } else if (strcmp(arg, "-i") == 0 || strcmp(arg, "--input") == 0) {
+            opts->input_path = value;
+        } else if (strcmp(arg, "--since") == 0 || strcmp(arg, "--until") == 0) {
+            bool until = arg[2] == 'u';
+            if (history_parse_date(value, until, until ? &opts->until : &opts->since) != 0) {
+                fprintf(stderr, "export: invalid date '%s' (expected YYYY-MM-DD)\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "-u") == 0 || strcmp(arg, "--user") == 0) {
+            if (!userstore_valid_name(value)) {
+                fprintf(stderr, "export: invalid user name '%s'\n", value);
+                return -1;
+            }
+            opts->user = value;
+        } else {
+            fprintf(stderr, "export: unknown option: %s\n", arg);
+            return -1;
+        }
+    }
+
+    if (opts->input_path != NULL && opts->format == EXPORT_COLUMNAR) {
+        fprintf(stderr, "export: --input converts to csv or ndjson; choose one with --format\n");
+        return -1;
+    }
+    if (opts->format == EXPORT_COLUMNAR && opts->output_path == NULL && isatty(STDOUT_FILENO)) {
+        fprintf(stderr, "export: not writing binary to a terminal; use -o FILE or --format csv\n");
+        return -1;
+    }
+    return 1;
+}
+
+/* ========== Encoding ========== */
+
+/* Signed to unsigned as 0, -1, 1, -2, ... -> 0, 1, 2, 3, ..., in unsigned arithmetic */
+static uint64_t zigzag_encode(int64_t v) {
+    return v < 0 ? ((uint64_t)-(v + 1) << 1) | 1 : (uint64_t)v << 1;
+}
+
+static int64_t zigzag_decode(uint64_t v) {
+    return (v & 1) ? -(int64_t)(v >> 1) - 1 : (int64_t)(v >> 1);
+}
+
+static char *put_varint(char *p, uint64_t v) {
+    while (v >= 0x80) {
+        *p++ = (char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (char)v;
+    return p;
+}
+
+static void outbuf_varint(outbuf_t *ob, uint64_t v) {
+    char *p = outbuf_reserve(ob, 10);
+    if (p != NULL) {
+        outbuf_commit(ob, put_varint(p, v));
+    }
+}
+
+static void outbuf_float(outbuf_t *ob, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    char *p = outbuf_reserve(ob, 4);
+    if (p != NULL) {
+        p[0] = (char)bits;
+        p[1] = (char)(bits >> 8);
+        p[2] = (char)(bits >> 16);
+        p[3] = (char)(bits >> 24);
+        outbuf_commit(ob, p + 4);
+    }
+}
+
+static const double decimal_scales[] = { 1.0, 10.0, 100.0 };
+
+/*
+ * Values and answers are mostly short decimals (12.5, 30), which fit in
+ * a varint or two as zigzag(k) << 2 | s, meaning k / 10^s. Anything that
+ * would not come back as the identical float is stored raw instead.
+ */
+static void outbuf_decimal(outbuf_t *ob, float value) {
+    if (isfinite(value) && fabsf(value) < 1e9f && !(value == 0.0f && signbit(value))) {
+        for (uint64_t s = 0; s < DECIMAL_RAW; s++) {
+            double scaled = rint((double)value * decimal_scales[s]);
+            if ((float)(scaled / decimal_scales[s]) == value) {
+                int64_t k = (int64_t)scaled;
+                outbuf_varint(ob, zigzag_encode(k) << 2 | s);
+                return;
+            }
+        }
+    }
+    outbuf_varint(ob, DECIMAL_RAW);
+    outbuf_float(ob, value);
+}
+
+static void outbuf_string(outbuf_t *ob, const char *s) {
+    size_t len = strlen(s);
+    outbuf_varint(ob, len);
+    outbuf_write(ob, s, len);
+}
+
+/* Shortest of up to three decimals: 12.5 rather than 12.500; nothing if not finite */
+static void outbuf_number(outbuf_t *ob, float value) {
+    if (!isfinite(value)) {
+        return;
+    }
+    char *p = outbuf_reserve(ob, FMT_MAX_CHARS);
+    if (p == NULL) {
+        return;
+    }
+    char *end = fmt_fixed(p, value, 3);
+    if (memchr(p, '.', (size_t)(end - p)) != NULL) {
+        while (end[-1] == '0') {
+            end--;
+        }
+        if (end[-1] == '.') {
+            end--;
+        }
+    }
+    outbuf_commit(ob, end);
+}
+
+/* A JSON number, or null if unknown or not finite */
+static void outbuf_json_number(outbuf_t *ob, float value, bool known) {
+    if (known && isfinite(value)) {
+        outbuf_number(ob, value);
+    } else {
+        outbuf_puts(ob, "null");
+    }
+}
+
+static void write_dictionary(outbuf_t *ob) {
+    outbuf_write(ob, EXPORT_MAGIC, 4);
+    outbuf_putc(ob, EXPORT_VERSION);
+    outbuf_varint(ob, CONVERSION_COUNT);
+    for (int id = 0; id < CONVERSION_COUNT; id++) {
+        outbuf_varint(ob, (uint64_t)id);
+        outbuf_string(ob, unit_string(conversion_names[id].from_abbrev));
+        outbuf_string(ob, unit_string(conversion_names[id].to_abbrev));
+        outbuf_string(ob, category_names[conversion_table[id].category]);
+    }
+}
+
+static void write_group(export_writer_t *writer) {
+    if (writer->group_rows == 0) {
+        return;
+    }
+    outbuf_varint(&writer->out, writer->group_rows);
+    for (int c = 0; c < EXPORT_COLUMNS; c++) {
+        outbuf_varint(&writer->out, writer->columns[c].len);
+        outbuf_write(&writer->out, writer->columns[c].data, writer->columns[c].len);
+        writer->columns[c].len = 0;
+    }
+    writer->group_rows = 0;
+    writer->previous_time = 0;
+}
+
+static void write_columnar_row(export_writer_t *writer, const answer_record_t *record) {
+    int64_t delta = (int64_t)record->time - (int64_t)writer->previous_time;
+    writer->previous_time = record->time;
+
+    outbuf_varint(&writer->columns[COLUMN_TIME], zigzag_encode(delta));
+    outbuf_varint(&writer->columns[COLUMN_CONVERSION], record->conversion_id);
+    outbuf_putc(&writer->columns[COLUMN_FLAGS], (char)record->flags);
+    outbuf_decimal(&writer->columns[COLUMN_VALUE], record->value);
+    outbuf_decimal(&writer->columns[COLUMN_ANSWER], record->answer);
+    outbuf_float(&writer->columns[COLUMN_ERROR], record->percent_error);
+    outbuf_varint(&writer->columns[COLUMN_LATENCY],
+                  (record->flags & ANSWERLOG_TIMED) ? (uint64_t)(record->response_seconds * 1000.0f + 0.5f) : 0);
+
+    if (++writer->group_rows == EXPORT_GROUP_ROWS) {
+        write_group(writer);
+    }
+}
+
+static void write_text_row(export_writer_t *writer, const answer_record_t *record) {
+    outbuf_t *ob = &writer->out;
+    const char *from = writer->dictionary->from[record->conversion_id];
+    const char *to = writer->dictionary->to[record->conversion_id];
+    bool answered = (record->flags & ANSWERLOG_ANSWERED) != 0;
+    bool timed = (record->flags & ANSWERLOG_TIMED) != 0;
+    bool correct = (record->flags & ANSWERLOG_CORRECT) != 0;
+
+    if (writer->format == EXPORT_CSV) {
+        // Unit abbreviations are letters and spaces, so no field needs quoting
+        outbuf_long(ob, (long)record->time);
+        outbuf_putc(ob, ',');
+        outbuf_puts(ob, from);
+        outbuf_putc(ob, ',');
+        outbuf_puts(ob, to);
+        outbuf_puts(ob, correct ? ",1," : ",0,");
+        if (answered) outbuf_number(ob, record->value);
+        outbuf_putc(ob, ',');
+        if (answered) outbuf_number(ob, record->answer);
+        outbuf_putc(ob, ',');
+        outbuf_number(ob, record->percent_error);
+        outbuf_putc(ob, ',');
+        if (timed) outbuf_number(ob, record->response_seconds);
+        outbuf_putc(ob, '\n');
+        return;
+    }
+
+    outbuf_puts(ob, "{\"time\":");
+    outbuf_long(ob, (long)record->time);
+    outbuf_puts(ob, ",\"from\":\"");
+    outbuf_puts(ob, from);
+    outbuf_puts(ob, "\",\"to\":\"");
+    outbuf_puts(ob, to);
+    outbuf_puts(ob, correct ? "\",\"correct\":true,\"value\":" : "\",\"correct\":false,\"value\":");
+    outbuf_json_number(ob, record->value, answered);
+    outbuf_puts(ob, ",\"answer\":");
+    outbuf_json_number(ob, record->answer, answered);
+    outbuf_puts(ob, ",\"error\":");
+    outbuf_json_number(ob, record->percent_error, true);
+    outbuf_puts(ob, ",\"latency\":");
+    outbuf_json_number(ob, record->response_seconds, timed);
+    outbuf_puts(ob, "}\n");
+}
+
+static void export_row(void *context, const answer_record_t *record) {
+    export_writer_t *writer = context;
+    if (writer->format == EXPORT_COLUMNAR) {
+        write_columnar_row(writer, record);
+    } else {
+        write_text_row(writer, record);
+    }
+    writer->rows++;
+}
+
+/* ========== Columnar Input ========== */
+
+typedef struct {
+    FILE *file;
+    char *names;                // Dictionary strings, NUL-separated
+    size_t names_len;
+    unsigned char *data;        // One group's columns
+    size_t data_capacity;
+} columnar_reader_t;
+
+static int read_varint(FILE *file, uint64_t *v) {
+    *v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = getc(file);
+        if (c == EOF) {
+            return -1;
+        }
+        *v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* Reads a varint from a column, failing rather than running past its end */
+static int column_varint(const unsigned char **p, const unsigned char *end, uint64_t *v) {
+    *v = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+        unsigned char c = *(*p)++;
+        *v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int column_float(const unsigned char **p, const unsigned char *end, float *value) {
+    const unsigned char *b = *p;
+    if (end - b < 4) {
+        return -1;
+    }
+    uint32_t bits = (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+    memcpy(value, &bits, sizeof(*value));
+    *p += 4;
+    return 0;
+}
+
+static int column_decimal(const unsigned char **p, const unsigned char *end, float *value) {
+    uint64_t v;
+    if (column_varint(p, end, &v) != 0) {
+        return -1;
+    }
+    if ((v & 3) == DECIMAL_RAW) {
+        return column_float(p, end, value);
+    }
+    int64_t k = zigzag_decode(v >> 2);
+    *value = (float)((double)k / decimal_scales[v & 3]);
+    return 0;
+}
+
+/* Appends a string to the name table; *offset receives where it starts */
+static int read_string(columnar_reader_t *reader, size_t *offset) {
+    uint64_t len;
+    if (read_varint(reader->file, &len) != 0 || len > 255) {
+        return -1;
+    }
+    char *grown = realloc(reader->names, reader->names_len + len + 1);
+    if (grown == NULL) {
+        return -1;
+    }
+    *offset = reader->names_len;
+    reader->names = grown;
+    if (fread(reader->names + reader->names_len, 1, len, reader->file) != len) {
+        return -1;
+    }
+    reader->names_len += len;
+    reader->names[reader->names_len++] = '\0';
+    return 0;
+}
+
+static void clear_dictionary(export_dictionary_t *dictionary) {
+    for (int code = 0; code < MAX_DICTIONARY; code++) {
+        dictionary->from[code] = dictionary->to[code] = "?";
+    }
+}
+
+static int read_dictionary(columnar_reader_t *reader, export_dictionary_t *dictionary) {
+    char magic[5];
+    uint64_t count, code;
+    size_t from[MAX_DICTIONARY], to[MAX_DICTIONARY], category;
+    bool present[MAX_DICTIONARY] = { false };
+
+    if (fread(magic, 1, 5, reader->file) != 5 || memcmp(magic, EXPORT_MAGIC, 4) != 0 ||
+        magic[4] != EXPORT_VERSION || read_varint(reader->file, &count) != 0 || count > MAX_DICTIONARY) {
+        return -1;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        if (read_varint(reader->file, &code) != 0 || code >= MAX_DICTIONARY ||
+            read_string(reader, &from[code]) != 0 || read_string(reader, &to[code]) != 0 ||
+            read_string(reader, &category) != 0) {
+            return -1;
+        }
+        present[code] = true;
+    }
+
+    // Pointers only now that the name table has stopped growing
+    clear_dictionary(dictionary);
+    for (int c = 0; c < MAX_DICTIONARY; c++) {
+        if (present[c]) {
+            dictionary->from[c] = reader->names + from[c];
+            dictionary->to[c] = reader->names + to[c];
+        }
+    }
+    return 0;
+}
+
+/* Decodes one group into rows; returns its row count, 0 at the end, -1 if damaged */
+static long read_group(columnar_reader_t *reader, const export_options_t *opts, export_writer_t *writer) {
+    uint64_t rows;
+    uint64_t lengths[EXPORT_COLUMNS];
+    size_t total = 0;
+
+    if (read_varint(reader->file, &rows) != 0 || rows > EXPORT_GROUP_ROWS) {
+        return -1;
+    }
+    if (rows == 0) {
+        return 0;
+    }
+
+    const unsigned char *p[EXPORT_COLUMNS];
+    const unsigned char *end[EXPORT_COLUMNS];
+    for (int c = 0; c < EXPORT_COLUMNS; c++) {
+        if (read_varint(reader->file, &lengths[c]) != 0 || lengths[c] > rows * 10) {
+            return -1;
+        }
+        if (total + lengths[c] > reader->data_capacity) {
+            size_t capacity = (total + lengths[c]) * 2;
+            unsigned char *grown = realloc(reader->data, capacity);
+            if (grown == NULL) {
+                return -1;
+            }
+            reader->data = grown;
+            reader->data_capacity = capacity;
+        }
+        if (fread(reader->data + total, 1, lengths[c], reader->file) != lengths[c]) {
+            return -1;
+        }
+        total += lengths[c];
+    }
+    size_t offset = 0;
+    for (int c = 0; c < EXPORT_COLUMNS; c++) {
+        p[c] = reader->data + offset;
+        offset += lengths[c];
+        end[c] = reader->data + offset;
+    }
+    if (lengths[COLUMN_FLAGS] != rows) {
+        return -1;
+    }
+
+    uint32_t time = 0;
+    for (uint64_t r = 0; r < rows; r++) {
+        answer_record_t record;
+        uint64_t zigzag, code, latency;
+        memset(&record, 0, sizeof(record));
+        if (column_varint(&p[COLUMN_TIME], end[COLUMN_TIME], &zigzag) != 0 ||
+            column_varint(&p[COLUMN_CONVERSION], end[COLUMN_CONVERSION], &code) != 0 ||
+            code >= MAX_DICTIONARY ||
+            column_decimal(&p[COLUMN_VALUE], end[COLUMN_VALUE], &record.value) != 0 ||
+            column_decimal(&p[COLUMN_ANSWER], end[COLUMN_ANSWER], &record.answer) != 0 ||
+            column_float(&p[COLUMN_ERROR], end[COLUMN_ERROR], &record.percent_error) != 0 ||
+            column_varint(&p[COLUMN_LATENCY], end[COLUMN_LATENCY], &latency) != 0) {
+            return -1;
+        }
+        time = (uint32_t)((int64_t)time + zigzag_decode(zigzag));
+
+        record.time = time;
+        record.conversion_id = (uint8_t)code;
+        record.flags = *p[COLUMN_FLAGS]++;
+        record.response_seconds = (float)latency / 1000.0f;
+
+        if (time >= opts->since && (opts->until == 0 || time <= opts->until)) {
+            export_row(writer, &record);
+        }
+    }
+    return (long)rows;
+}
+
+static int convert_columnar(const export_options_t *opts, export_writer_t *writer,
+                            export_dictionary_t *dictionary) {
+    columnar_reader_t reader;
+    memset(&reader, 0, sizeof(reader));
+    reader.file = fopen(opts->input_path, "rb");
+    if (reader.file == NULL) {
+        fprintf(stderr, "export: cannot open %s: %s\n", opts->input_path, strerror(errno));
+        return -1;
+    }
+
+    int result = -1;
+    if (read_dictionary(&reader, dictionary) != 0) {
+        fprintf(stderr, "export: %s is not a columnar export\n", opts->input_path);
+    } else {
+        writer->dictionary = dictionary;
+        long rows;
+        while ((rows = read_group(&reader, opts, writer)) > 0) {
+        }
+        if (rows < 0) {
+            fprintf(stderr, "export: %s is damaged after %llu rows\n", opts->input_path,
+                    (unsigned long long)writer->rows);
+        } else {
+            result = 0;
+        }
+    }
+
+    fclose(reader.file);
+    free(reader.names);
+    free(reader.data);
+    return result;
+}
+
+/* ========== Entry Point ========== */
+
+int export_main(int argc, char *argv[]) {
+    export_options_t opts;
+    int parsed = parse_export_options(argc, argv, &opts);
+    if (parsed <= 0) {
+        return parsed == 0 ? 0 : 1;
+    }
+
+    int fd = STDOUT_FILENO;
+    if (opts.output_path != NULL) {
+        fd = open(opts.output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            fprintf(stderr, "export: cannot open %s: %s\n", opts.output_path, strerror(errno));
+            return 1;
+        }
+    }
+
+    export_writer_t writer;
+    export_dictionary_t dictionary;
+    memset(&writer, 0, sizeof(writer));
+    writer.format = opts.format;
+    bool ok = outbuf_init(&writer.out, fd, EXPORT_OUTBUF_SIZE) == 0;
+    for (int c = 0; ok && c < EXPORT_COLUMNS; c++) {
+        ok = outbuf_init(&writer.columns[c], -1, EXPORT_GROUP_ROWS * 4) == 0;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int status = ok ? 0 : 1;
+
+    if (ok && opts.format == EXPORT_COLUMNAR) {
+        write_dictionary(&writer.out);
+    } else if (ok && opts.format == EXPORT_CSV) {
+        outbuf_puts(&writer.out, "time,from,to,correct,value,answer,error,latency\n");
+    }
+
+    if (!ok) {
+        fprintf(stderr, "export: out of memory\n");
+    } else if (opts.input_path != NULL) {
+        status = convert_columnar(&opts, &writer, &dictionary) == 0 ? 0 : 1;
+    } else {
+        char path[MAX_DATA_PATH];
+        answerlog_filter_t filter;
+        memset(&filter, 0, sizeof(filter));
+        filter.since = opts.since;
+        filter.until = opts.until;
+        clear_dictionary(&dictionary);
+        for (int id = 0; id < CONVERSION_COUNT; id++) {
+            dictionary.from[id] = unit_string(conversion_names[id].from_abbrev);
+            dictionary.to[id] = unit_string(conversion_names[id].to_abbrev);
+        }
+        writer.dictionary = &dictionary;
+
+        user_file_path(opts.user, ANSWERLOG_FILE, path, sizeof(path));
+        if (answerlog_query(path, &filter, export_row, &writer, NULL) != 0) {
+            fprintf(stderr, "export: cannot read %s\n", path);
+            status = 1;
+        }
+    }
+
+    if (ok && opts.format == EXPORT_COLUMNAR) {
+        write_group(&writer);
+        outbuf_varint(&writer.out, 0);
+    }
+    if (ok && outbuf_flush(&writer.out) != 0) {
+        fprintf(stderr, "export: write failed: %s\n", strerror(writer.out.error));
+        status = 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (status == 0 && opts.output_path != NULL) {
+        off_t bytes = lseek(fd, 0, SEEK_END);
+        double ms = (double)(end.tv_sec - start.tv_sec) * 1000.0 + (double)(end.tv_nsec - start.tv_nsec) / 1e6;
+        fprintf(stderr, "Exported %llu answers to %s as %s: %lld bytes (%.1f per answer) in %.0f ms\n",
+                (unsigned long long)writer.rows, opts.output_path, format_names[opts.format],
+                (long long)bytes, writer.rows > 0 ? (double)bytes / (double)writer.rows : 0.0, ms);
+    }
+
+    outbuf_free(&writer.out);
+    for (int c = 0; c < EXPORT_COLUMNS; c++) {
+        outbuf_free(&writer.columns[c]);
+    }
+    if (opts.output_path != NULL) {
+        close(fd);
+    }
+    return status;
+}
@@ -0,0 +1,49 @@
+/*
+ * export.h - Answer History Export
+ *
+ * Writes the answer log (see answerlog.h) for analysis elsewhere, as CSV,
+ * NDJSON, or a compact columnar binary format that the same command can
+ * turn back into CSV or NDJSON (--input).
+ *
+ * Columnar format, version 1. All integers are unsigned LEB128 varints;
+ * "zigzag" marks signed values mapped to unsigned as 0, -1, 1, -2, ...
+ * -> 0, 1, 2, 3, ...; floats are IEEE 754 binary32, little-endian.
+ * A "decimal" is a varint zigzag(k) << 2 | s standing for k / 10^s
+ * (s = 0, 1 or 2), or the tag 3 followed by a float, for values that are
+ * not short decimals.
+ *
+ *   file       = "MTCX" version:u8 dictionary group* end
+ *   dictionary = count { code from:str to:str category:str }
+ *                str = length bytes
+ *   group      = rows column[7]           rows > 0, at most 65536
+ *                column = length bytes
+ *   end        = 0 (a group of zero rows)
+ *
+ * The columns of a group, in order, one entry per row:
+ *
+ *   time       zigzag difference from the previous row's Unix time
+ *              (from 0 for the group's first row)
+ *   conversion dictionary code
+ *   flags      one byte: 1 correct, 2 timed, 4 value and answer known
+ *   value      decimal, the value asked about
+ *   answer     decimal, the answer given
+ *   error      float, percent error
+ *   latency    answer time in milliseconds (0 if not timed)
+ *
+ * Groups decode independently, so a reader can skip one by its column
+ * lengths without decoding it. README.md carries the same layout for
+ * readers of exported files; keep the two in step.
+ */
+
+#ifndef EXPORT_H
+#define EXPORT_H
+
+/**
+ * Entry point for `metric-trainer export ...`
+ * @param argc Argument count, argv[0] being "export"
+ * @param argv Argument vector
+ * @return Process exit status
+ */
+int export_main(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ * format.c - Fixed-Precision Number Formatting
+ *
+ * fmt_fixed scales by 10^decimals and rounds with rint(), which under the
+ * default rounding mode is round-half-to-even. For float inputs the
+ * scaled value is exact in double precision (24 + 10 mantissa bits), so
+ * the result is digit-for-digit what printf("%.1f"/"%.2f"/"%.3f") shows.
+ * For other doubles the scaling can round onto a tie the exact value is
+ * not on (0.15 * 10 gives 1.5); fma() recovers the scaling's rounding
+ * error, which says which way the exact value lies. It cannot cross a
+ * tie without landing on it, so other results stand as they are.
+ * Scaled magnitudes from 1e15 up, where doubles start to lose the units
+ * digit, and non-finite values fall back to snprintf.
+ */
+
+#include "format.h"
+#include <stdio.h>
+#include <math.h>
+
+static const double powers_of_ten[] = { 1.0, 10.0, 100.0, 1000.0 };
+static const double exact_limits[] = { 1e15, 1e14, 1e13, 1e12 };    // 1e15 once scaled
+
+// Write the digits of an unsigned value, most significant first
+static char *write_digits(char *dst, unsigned long value) {
+    char digits[24];
+    int n = 0;
+
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    while (n > 0) {
+        *dst++ = digits[--n];
+    }
+    return dst;
+}
+
+char *fmt_long(char *dst, long value) {
+    if (value < 0) {
+        *dst++ = '-';
+        return write_digits(dst, 0UL - (unsigned long)value);
+    }
+    return write_digits(dst, (unsigned long)value);
+}
+
+char *fmt_fixed(char *dst, double value, int decimals) {
+    if (decimals < 0) decimals = 0;
+    if (decimals > 3) decimals = 3;
+
+    if (!isfinite(value) || fabs(value) >= exact_limits[decimals]) {
+        int n = snprintf(dst, FMT_MAX_CHARS, "%.*f", decimals, value);
+        return dst + (n < FMT_MAX_CHARS ? n : FMT_MAX_CHARS - 1);
+    }
+
+    if (signbit(value)) {
+        *dst++ = '-';
+        value = -value;
+    }
+
+    double product = value * powers_of_ten[decimals];
+    double rounded = rint(product);
+    if (fabs(product - rounded) == 0.5) {
+        double error = fma(value, powers_of_ten[decimals], -product);
+        if (error > 0.0 && rounded < product) {
+            rounded += 1.0;
+        } else if (error < 0.0 && rounded > product) {
+            rounded -= 1.0;
+        }
+    }
+    unsigned long scaled = (unsigned long)rounded;
+    unsigned long divisor = (unsigned long)powers_of_ten[decimals];
+
+    dst = write_digits(dst, scaled / divisor);
+    if (decimals > 0) {
+        unsigned long fraction = scaled % divisor;
+        *dst++ = '.';
+        for (unsigned long place = divisor / 10; place > 0; place /= 10) {
+            *dst++ = (char)('0' + fraction / place % 10);
+        }
+    }
+    return dst;
+}
+
+char *fmt_centi(char *dst, long centi) {
+    unsigned long magnitude;
+
+    if (centi < 0) {
+        *dst++ = '-';
+        magnitude = 0UL - (unsigned long)centi;
+    } else {
+        magnitude = (unsigned long)centi;
+    }
+
+    dst = write_digits(dst, magnitude / 100);
+    *dst++ = '.';
+    *dst++ = (char)('0' + (magnitude % 100) / 10);
+    *dst++ = (char)('0' + magnitude % 10);
+    return dst;
+}
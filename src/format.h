@@ -0,0 +1,50 @@
+/*
+ * format.h - Fixed-Precision Number Formatting
+ *
+ * Locale-independent formatters that write straight into a caller's
+ * buffer, for output paths that emit numbers in bulk (worksheets, answer
+ * keys, exports) and for the questions, feedback and statistics of
+ * practice sessions. tools/bench_format checks that they show what
+ * printf shows and times them against snprintf (make bench), and
+ * tools/check_format tries their edge cases (make check-format). Each
+ * function writes no terminating NUL and returns a pointer just past the
+ * last character written, so calls can be chained:
+ *
+ *     p = fmt_fixed(p, value, 1);
+ *     *p++ = ' ';
+ *
+ * The caller must provide at least FMT_MAX_CHARS bytes per call. A value
+ * too large to show in FMT_MAX_CHARS - 1 characters is cut short there.
+ */
+
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#define FMT_MAX_CHARS 32
+
+/**
+ * Format a value with a fixed number of decimal places, as printf("%.*f")
+ * @param dst Destination buffer
+ * @param value Value to format
+ * @param decimals Digits after the decimal point (0-3)
+ * @return Pointer just past the formatted text
+ */
+char *fmt_fixed(char *dst, double value, int decimals);
+
+/**
+ * Format an exact amount in hundredths as a two-decimal number
+ * @param dst Destination buffer
+ * @param centi Amount in hundredths (e.g., 805 -> "8.05")
+ * @return Pointer just past the formatted text
+ */
+char *fmt_centi(char *dst, long centi);
+
+/**
+ * Format a signed integer in decimal
+ * @param dst Destination buffer
+ * @param value Value to format
+ * @return Pointer just past the formatted text
+ */
+char *fmt_long(char *dst, long value);
+
+#endif
@@ -0,0 +1,412 @@
+/*
+ * history.c - Answer History Queries
+ *
+ * Narrows the answer log with the filter the log itself can prune blocks
+ * by (time range, conversions, incorrect only), collects the matching
+ * answers, then sorts them by group so each group's percentiles are
+ * exact rather than estimated.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include "answerlog.h"
+#include "history.h"
+#include "questions.h"
+#include "rollup.h"
+#include "tables.h"
+#include "userstore.h"
+
+typedef enum {
+    GROUP_NONE,
+    GROUP_CATEGORY,
+    GROUP_CONVERSION,
+    GROUP_DAY,
+    GROUP_WEEK
+} history_group_t;
+
+static const char *const group_names[] = { "none", "category", "conversion", "day", "week" };
+static const char *const group_headings[] = { "", "Category", "Conversion", "Day", "Week of" };
+
+typedef struct {
+    answerlog_filter_t filter;
+    history_group_t group;
+    const char *user;               // Whose log: --user, else the practicing user
+} history_options_t;
+
+/* One matching answer, reduced to what the report needs */
+typedef struct {
+    uint32_t key;               // Group the answer belongs to
+    bool correct;
+    bool timed;
+    float percent_error;
+    float response_seconds;
+} history_entry_t;
+
+typedef struct {
+    history_group_t group;
+    history_entry_t *entries;
+    size_t count;
+    size_t capacity;
+    bool out_of_memory;
+} history_result_t;
+
+static void show_history_help(void) {
+    printf("USAGE:\n");
+    printf("  metric-trainer history [OPTIONS]\n\n");
+    printf("OPTIONS:\n");
+    printf("  --since DATE           Answers on or after DATE (YYYY-MM-DD)\n");
+    printf("  --until DATE           Answers on or before DATE (YYYY-MM-DD)\n");
+    printf("  -c, --category SET     Categories to include, e.g. \"ab\" (default: all)\n");
+    printf("  --conversion FROM[-TO] Only these conversions, by unit name or abbreviation,\n");
+    printf("                         e.g. \"mi-km\" or \"lb\" (may be repeated)\n");
+    printf("  --incorrect            Only answers that were marked wrong\n");
+    printf("  --by GROUP             category (default), conversion, day, week or none\n");
+    printf("  -u, --user NAME        Query NAME's history (see --user in practice)\n");
+}
+
+int history_parse_date(const char *text, bool end_of_day, uint32_t *when) {
+    int year, month, day;
+    char extra;
+    if (sscanf(text, "%d-%d-%d%c", &year, &month, &day, &extra) != 3 ||
+        month < 1 || month > 12 || day < 1 || day > 31) {
+        return -1;
+    }
+
+    // The next day's midnight, less a second, whatever the day's length
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = end_of_day ? day + 1 : day;
+    tm.tm_isdst = -1;
+    time_t start = mktime(&tm);
+    if (start < 0) {
+        return -1;
+    }
+    *when = (uint32_t)(end_of_day ? start - 1 : start);
+    return 0;
+}
+
+static bool unit_matches(const char *name, unsigned short unit, unsigned short abbrev) {
+    return strcasecmp(name, unit_string(unit)) == 0 || strcasecmp(name, unit_string(abbrev)) == 0;
+}
+
+/* Adds the conversions FROM[-TO] names to a bitmap; false if it names none */
+static bool select_conversions(const char *spec, uint32_t conversions[2]) {
+    char from[64];
+    const char *to = strchr(spec, '-');
+    size_t from_len = to != NULL ? (size_t)(to - spec) : strlen(spec);
+    if (from_len == 0 || from_len >= sizeof(from)) {
+        return false;
+    }
+    memcpy(from, spec, from_len);
+    from[from_len] = '\0';
+    if (to != NULL) {
+        to++;
+    }
+
+    bool found = false;
+    for (int id = 0; id < CONVERSION_COUNT; id++) {
+        const conversion_names_t *names = &conversion_names[id];
+        if (unit_matches(from, names->from_unit, names->from_abbrev) &&
+            (to == NULL || unit_matches(to, names->to_unit, names->to_abbrev))) {
+            conversions[id / 32] |= 1u << (id % 32);
+            found = true;
+        }
+    }
+    return found;
+}
+
+static int parse_history_options(int argc, char *argv[], history_options_t *opts) {
+    const char *categories = NULL;
+    uint32_t conversions[2] = {0, 0};
+
+    memset(opts, 0, sizeof(*opts));
+    opts->group = GROUP_CATEGORY;
+    opts->user = g_user_name;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            show_history_help();
+            return 0;
+        } else if (strcmp(arg, "--incorrect") == 0) {
+            opts->filter.incorrect_only = true;
+            continue;
+        }
+
+        if (value == NULL) {
+            fprintf(stderr, "history: unknown option or missing value: %s\n", arg);
+            return -1;
+        }
+        i++;
+
+        if (strcmp(arg, "--since") == 0 || strcmp(arg, "--until") == 0) {
+            bool until = arg[2] == 'u';
+            if (history_parse_date(value, until, until ? &opts->filter.until : &opts->filter.since) != 0) {
+                fprintf(stderr, "history: invalid date '%s' (expected YYYY-MM-DD)\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "-c") == 0 || strcmp(arg, "--category") == 0) {
+            categories = value;
+        } else if (strcmp(arg, "--conversion") == 0) {
+            if (!select_conversions(value, conversions)) {
+                fprintf(stderr, "history: no conversion matches '%s'\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "--by") == 0) {
+            size_t g;
+            for (g = 0; g < sizeof(group_names) / sizeof(group_names[0]); g++) {
+                if (strcmp(value, group_names[g]) == 0) {
+                    break;
+                }
+            }
+            if (g == sizeof(group_names) / sizeof(group_names[0])) {
+                fprintf(stderr, "history: unknown grouping '%s'\n", value);
+                return -1;
+            }
+            opts->group = (history_group_t)g;
+        } else if (strcmp(arg, "-u") == 0 || strcmp(arg, "--user") == 0) {
+            if (!userstore_valid_name(value)) {
+                fprintf(stderr, "history: invalid user name '%s'\n", value);
+                return -1;
+            }
+            opts->user = value;
+        } else {
+            fprintf(stderr, "history: unknown option: %s\n", arg);
+            return -1;
+        }
+    }
+
+    // Categories narrow the conversion bitmap, so the log prunes by both
+    if (categories != NULL) {
+        category_selection_t selection;
+        if (!parse_category_input(categories, &selection)) {
+            fprintf(stderr, "history: invalid categories '%s'\n", categories);
+            return -1;
+        }
+        uint32_t in_categories[2] = {0, 0};
+        for (int id = 0; id < CONVERSION_COUNT; id++) {
+            if (selection.active[conversion_table[id].category]) {
+                in_categories[id / 32] |= 1u << (id % 32);
+            }
+        }
+        bool any = (conversions[0] | conversions[1]) != 0;
+        for (int w = 0; w < 2; w++) {
+            conversions[w] = any ? conversions[w] & in_categories[w] : in_categories[w];
+        }
+        if ((conversions[0] | conversions[1]) == 0) {
+            fprintf(stderr, "history: no selected conversion is in categories '%s'\n", categories);
+            return -1;
+        }
+    }
+    opts->filter.conversions[0] = conversions[0];
+    opts->filter.conversions[1] = conversions[1];
+
+    if (opts->filter.until != 0 && opts->filter.until < opts->filter.since) {
+        fprintf(stderr, "history: --until is before --since\n");
+        return -1;
+    }
+    return 1;
+}
+
+/* ========== Aggregation ========== */
+
+static uint32_t group_key(history_group_t group, const answer_record_t *record) {
+    switch (group) {
+        case GROUP_CATEGORY:
+            return conversion_table[record->conversion_id].category;
+        case GROUP_CONVERSION:
+            return record->conversion_id;
+        case GROUP_DAY:
+            return rollup_day((time_t)record->time);
+        case GROUP_WEEK:
+            return rollup_week(rollup_day((time_t)record->time));
+        case GROUP_NONE:
+            break;
+    }
+    return 0;
+}
+
+static void collect_answer(void *context, const answer_record_t *record) {
+    history_result_t *result = context;
+
+    if (record->conversion_id >= CONVERSION_COUNT) {
+        return;  // Logged by a build with more conversions
+    }
+    if (result->count == result->capacity) {
+        size_t capacity = result->capacity > 0 ? result->capacity * 2 : 1024;
+        history_entry_t *entries = realloc(result->entries, capacity * sizeof(*entries));
+        if (entries == NULL) {
+            result->out_of_memory = true;
+            return;
+        }
+        result->entries = entries;
+        result->capacity = capacity;
+    }
+
+    history_entry_t *entry = &result->entries[result->count++];
+    entry->key = group_key(result->group, record);
+    entry->correct = (record->flags & ANSWERLOG_CORRECT) != 0;
+    entry->timed = (record->flags & ANSWERLOG_TIMED) != 0;
+    entry->percent_error = record->percent_error;
+    entry->response_seconds = record->response_seconds;
+}
+
+static int compare_keys(const void *a, const void *b) {
+    uint32_t ka = ((const history_entry_t *)a)->key;
+    uint32_t kb = ((const history_entry_t *)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+
+static int compare_floats(const void *a, const void *b) {
+    float fa = *(const float *)a;
+    float fb = *(const float *)b;
+    return (fa > fb) - (fa < fb);
+}
+
+/* Nearest-rank percentile of sorted values */
+static float percentile(const float *sorted, size_t count, float q) {
+    size_t rank = (size_t)(q * (float)count + 0.999999f);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void group_label(history_group_t group, uint32_t key, char *buf, size_t size) {
+    switch (group) {
+        case GROUP_CATEGORY:
+            snprintf(buf, size, "%s", category_names[key]);
+            break;
+        case GROUP_CONVERSION:
+            snprintf(buf, size, "%s → %s", unit_string(conversion_names[key].from_abbrev),
+                     unit_string(conversion_names[key].to_abbrev));
+            break;
+        case GROUP_DAY:
+        case GROUP_WEEK: {
+            char day[16];
+            rollup_format_day(group == GROUP_WEEK ? rollup_week_start(key) : key, day);
+            snprintf(buf, size, "%s", day);
+            break;
+        }
+        case GROUP_NONE:
+            snprintf(buf, size, "All");
+            break;
+    }
+}
+
+/* One report row; `scratch` holds at least `count` floats */
+static void print_group(const char *label, const history_entry_t *entries, size_t count, float *scratch) {
+    size_t correct = 0;
+    size_t timed = 0;
+    double error_sum = 0.0;
+    double seconds_sum = 0.0;
+
+    for (size_t i = 0; i < count; i++) {
+        correct += entries[i].correct;
+        error_sum += entries[i].percent_error;
+        scratch[i] = entries[i].percent_error;
+    }
+    qsort(scratch, count, sizeof(float), compare_floats);
+    float median_error = percentile(scratch, count, 0.5f);
+    float p90_error = percentile(scratch, count, 0.9f);
+
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].timed) {
+            seconds_sum += entries[i].response_seconds;
+            scratch[timed++] = entries[i].response_seconds;
+        }
+    }
+
+    // Labels may hold multi-byte arrows, so pad by display width by hand
+    int width = 0;
+    for (const char *p = label; *p != '\0'; p++) {
+        width += ((unsigned char)*p & 0xc0) != 0x80;
+    }
+    printf("  %s%*s  %7zu  %7.1f%%  %7.1f%%  %7.1f%%  %7.1f%%  ", label, width < 14 ? 14 - width : 0, "",
+           count, 100.0 * correct / count, error_sum / count, median_error, p90_error);
+    if (timed > 0) {
+        qsort(scratch, timed, sizeof(float), compare_floats);
+        printf("%7.1fs  %7.1fs\n", seconds_sum / timed, percentile(scratch, timed, 0.5f));
+    } else {
+        printf("%8s  %8s\n", "-", "-");
+    }
+}
+
+int history_main(int argc, char *argv[]) {
+    history_options_t opts;
+    int parsed = parse_history_options(argc, argv, &opts);
+    if (parsed <= 0) {
+        return parsed == 0 ? 0 : 1;
+    }
+
+    char path[MAX_DATA_PATH];
+    history_result_t result;
+    answerlog_scan_t scan;
+    struct timespec start, end;
+    memset(&result, 0, sizeof(result));
+    result.group = opts.group;
+    user_file_path(opts.user, ANSWERLOG_FILE, path, sizeof(path));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (answerlog_query(path, &opts.filter, collect_answer, &result, &scan) != 0) {
+        fprintf(stderr, "history: cannot read %s\n", path);
+        free(result.entries);
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (result.out_of_memory) {
+        fprintf(stderr, "history: out of memory; showing the first %zu answers\n", result.count);
+    }
+
+    if (opts.user != NULL) {
+        printf("\nAnswer History for %s\n", opts.user);
+    } else {
+        printf("\nAnswer History\n");
+    }
+    printf("══════════════════════════════════════════\n\n");
+
+    if (result.count == 0) {
+        printf("No answers match. Answers are logged from practice sessions;\n");
+        printf("see 'stats' for totals from before the log existed.\n\n");
+        free(result.entries);
+        return 0;
+    }
+
+    float *scratch = malloc(result.count * sizeof(float));
+    if (scratch == NULL) {
+        fprintf(stderr, "history: out of memory\n");
+        free(result.entries);
+        return 1;
+    }
+
+    printf("  %-14s  %7s  %8s  %8s  %8s  %8s  %8s  %8s\n", group_headings[opts.group],
+           "Answers", "Accuracy", "Avg Err", "Median", "p90", "Avg Time", "Med Time");
+    printf("  ────────────────────────────────────────────────────────────────────────────────\n");
+
+    if (opts.group != GROUP_NONE) {
+        qsort(result.entries, result.count, sizeof(history_entry_t), compare_keys);
+        size_t first = 0;
+        for (size_t i = 1; i <= result.count; i++) {
+            if (i == result.count || result.entries[i].key != result.entries[first].key) {
+                char label[64];
+                group_label(opts.group, result.entries[first].key, label, sizeof(label));
+                print_group(label, &result.entries[first], i - first, scratch);
+                first = i;
+            }
+        }
+        printf("  ────────────────────────────────────────────────────────────────────────────────\n");
+    }
+    print_group("All", result.entries, result.count, scratch);
+
+    double ms = (double)(end.tv_sec - start.tv_sec) * 1000.0 + (double)(end.tv_nsec - start.tv_nsec) / 1e6;
+    printf("\n  Read %zu of %zu blocks (%llu answers) in %.2f ms\n\n",
+           scan.blocks_read, scan.blocks_total, (unsigned long long)scan.records_read, ms);
+
+    free(scratch);
+    free(result.entries);
+    return 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * history.h - Answer History Queries
+ *
+ * Filters and aggregates the answer log (see answerlog.h): counts,
+ * accuracy, error percentiles and answer times, overall or grouped by
+ * category, conversion, day or week.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Entry point for `metric-trainer history ...`
+ * @param argc Argument count, argv[0] being "history"
+ * @param argv Argument vector
+ * @return Process exit status
+ */
+int history_main(int argc, char *argv[]);
+
+/**
+ * Parse a YYYY-MM-DD date, as --since and --until take it, in local time
+ * @param text Date to parse
+ * @param end_of_day Give the day's last second rather than its first
+ * @param when Receives the Unix time
+ * @return 0 on success, -1 if the date is invalid
+ */
+int history_parse_date(const char *text, bool end_of_day, uint32_t *when);
+
+#endif
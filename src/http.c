@@ -0,0 +1,209 @@
+/*
+ * http.c - Minimal HTTP/1.1 Parsing and Framing
+ *
+ * The parser looks for the blank line that ends a head before decoding
+ * anything, so a head arriving in pieces costs one scan per read until
+ * it is complete. Only the headers the server acts on are interpreted:
+ * Content-Length, Connection and Transfer-Encoding (chunked bodies are
+ * refused). The Content-Length field of a response is written as ten
+ * space-padded digits and patched when the body is done, so responses
+ * are built in place with no second copy.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "http.h"
+
+#define LENGTH_DIGITS 10
+
+/* ========== Requests ========== */
+
+/* End of the head (just past the blank line), or 0 if not buffered yet */
+static size_t find_head_end(const char *data, size_t len) {
+    for (size_t i = 3; i < len; i++) {
+        if (data[i] == '\n' && data[i - 1] == '\r' && data[i - 2] == '\n' && data[i - 3] == '\r') {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static bool header_is(const char *line, size_t len, const char *name, const char **value, size_t *value_len) {
+    size_t n = strlen(name);
+    if (len <= n || line[n] != ':' || strncasecmp(line, name, n) != 0) {
+        return false;
+    }
+    const char *v = line + n + 1;
+    const char *end = line + len;
+    while (v < end && (*v == ' ' || *v == '\t')) {
+        v++;
+    }
+    while (end > v && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+    *value = v;
+    *value_len = (size_t)(end - v);
+    return true;
+}
+
+static bool value_has(const char *value, size_t len, const char *token) {
+    size_t n = strlen(token);
+    for (size_t i = 0; i + n <= len; i++) {
+        if (strncasecmp(value + i, token, n) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+long http_parse(const char *data, size_t len, http_request_t *request) {
+    size_t head = find_head_end(data, len < HTTP_MAX_HEAD ? len : HTTP_MAX_HEAD);
+    if (head == 0) {
+        return len >= HTTP_MAX_HEAD ? -431 : 0;
+    }
+    memset(request, 0, sizeof(*request));
+
+    // Request line: METHOD SP target SP HTTP/1.x CRLF
+    const char *line_end = memchr(data, '\r', head);
+    const char *sp1 = memchr(data, ' ', (size_t)(line_end - data));
+    const char *sp2 = sp1 != NULL ? memchr(sp1 + 1, ' ', (size_t)(line_end - sp1 - 1)) : NULL;
+    if (sp1 == NULL || sp2 == NULL || sp1 == data || sp2 == sp1 + 1 ||
+        line_end - sp2 != 9 || strncmp(sp2 + 1, "HTTP/1.", 7) != 0) {
+        return -400;
+    }
+    request->method = data;
+    request->method_len = (size_t)(sp1 - data);
+    request->path = sp1 + 1;
+    const char *target_end = sp2;
+    const char *question = memchr(request->path, '?', (size_t)(target_end - request->path));
+    if (question != NULL) {
+        request->query = question + 1;
+        request->query_len = (size_t)(target_end - question - 1);
+        target_end = question;
+    }
+    request->path_len = (size_t)(target_end - request->path);
+    request->keep_alive = sp2[8] == '1';
+
+    // Headers, one per CRLF-terminated line, up to the blank line
+    size_t body_len = 0;
+    const char *line = line_end + 2;
+    while (line < data + head - 2) {
+        const char *end = memchr(line, '\r', (size_t)(data + head - line));
+        const char *value;
+        size_t value_len;
+        if (header_is(line, (size_t)(end - line), "Content-Length", &value, &value_len)) {
+            char *stop;
+            unsigned long n = strtoul(value, &stop, 10);
+            if (value_len == 0 || stop != value + value_len) {
+                return -400;
+            }
+            if (n > HTTP_MAX_BODY) {
+                return -413;
+            }
+            body_len = n;
+        } else if (header_is(line, (size_t)(end - line), "Connection", &value, &value_len)) {
+            if (value_has(value, value_len, "close")) {
+                request->keep_alive = false;
+            } else if (value_has(value, value_len, "keep-alive")) {
+                request->keep_alive = true;
+            }
+        } else if (header_is(line, (size_t)(end - line), "Transfer-Encoding", &value, &value_len)) {
+            return -501;
+        }
+        line = end + 2;
+    }
+
+    if (len - head < body_len) {
+        return 0;
+    }
+    request->body = data + head;
+    request->body_len = body_len;
+    return (long)(head + body_len);
+}
+
+bool http_is(const http_request_t *request, const char *method, const char *path) {
+    size_t m = strlen(method), p = strlen(path);
+    return request->method_len == m && memcmp(request->method, method, m) == 0 &&
+           request->path_len == p && memcmp(request->path, path, p) == 0;
+}
+
+bool http_query(const http_request_t *request, const char *name, const char **value, size_t *value_len) {
+    size_t n = strlen(name);
+    const char *p = request->query;
+    const char *end = p + request->query_len;
+
+    while (p != NULL && p < end) {
+        const char *amp = memchr(p, '&', (size_t)(end - p));
+        const char *field_end = amp != NULL ? amp : end;
+        if ((size_t)(field_end - p) >= n && memcmp(p, name, n) == 0 &&
+            (p + n == field_end || p[n] == '=')) {
+            *value = p + n < field_end ? p + n + 1 : field_end;
+            *value_len = (size_t)(field_end - *value);
+            return true;
+        }
+        p = amp != NULL ? amp + 1 : NULL;
+    }
+    return false;
+}
+
+/* ========== Responses ========== */
+
+static const char *status_text(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 201: return "Created";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 409: return "Conflict";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        default:  return "Internal Server Error";
+    }
+}
+
+size_t http_begin(outbuf_t *out, int status, const char *content_type, bool keep_alive) {
+    outbuf_puts(out, "HTTP/1.1 ");
+    outbuf_long(out, status);
+    outbuf_putc(out, ' ');
+    outbuf_puts(out, status_text(status));
+    outbuf_puts(out, "\r\nContent-Type: ");
+    outbuf_puts(out, content_type);
+    outbuf_puts(out, keep_alive ? "\r\nConnection: keep-alive" : "\r\nConnection: close");
+    outbuf_puts(out, "\r\nContent-Length: ");
+    outbuf_puts(out, "          \r\n\r\n");     // LENGTH_DIGITS spaces, patched by http_end
+    return out->len;
+}
+
+void http_end(outbuf_t *out, size_t body_start) {
+    if (out->len < body_start) {
+        return;                                  // A failed allocation lost the head
+    }
+    size_t length = out->len - body_start;
+    char *digit = out->data + body_start - 4 - 1;
+    do {
+        *digit-- = (char)('0' + length % 10);
+        length /= 10;
+    } while (length > 0 && digit > out->data + body_start - 4 - LENGTH_DIGITS);
+}
+
+void http_json_string(outbuf_t *out, const char *text, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    outbuf_putc(out, '"');
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '"' || c == '\\') {
+            outbuf_putc(out, '\\');
+            outbuf_putc(out, (char)c);
+        } else if (c < 0x20) {
+            char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+            outbuf_write(out, escape, sizeof(escape));
+        } else {
+            outbuf_putc(out, (char)c);
+        }
+    }
+    outbuf_putc(out, '"');
+}
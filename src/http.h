@@ -0,0 +1,81 @@
+/*
+ * http.h - Minimal HTTP/1.1 Parsing and Framing
+ *
+ * Just enough HTTP/1.1 for a loopback JSON API: request heads are parsed
+ * in place from a connection's input buffer (so pipelined requests are
+ * taken one after another from the same bytes), bodies must carry a
+ * Content-Length, and responses are framed straight into an in-memory
+ * outbuf_t with the length patched in once the body is written.
+ */
+
+#ifndef HTTP_H
+#define HTTP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "outbuf.h"
+
+#define HTTP_MAX_HEAD 8192
+#define HTTP_MAX_BODY 65536
+
+/* A parsed request; all pointers are into the caller's buffer */
+typedef struct {
+    const char *method;
+    size_t method_len;
+    const char *path;           // Target up to '?'
+    size_t path_len;
+    const char *query;          // After '?', or NULL
+    size_t query_len;
+    const char *body;
+    size_t body_len;
+    bool keep_alive;
+} http_request_t;
+
+/**
+ * Parse one request from the start of a buffer
+ * @param data Buffered input
+ * @param len Bytes buffered
+ * @param request Receives the request (when complete)
+ * @return Bytes the request takes up (> 0), 0 if it is not all here yet,
+ *         or minus the HTTP status to fail with (e.g. -400)
+ */
+long http_parse(const char *data, size_t len, http_request_t *request);
+
+/**
+ * Whether a request is for a method and exact path
+ */
+bool http_is(const http_request_t *request, const char *method, const char *path);
+
+/**
+ * Find a query parameter (values are not percent-decoded)
+ * @param request The request
+ * @param name Parameter name
+ * @param value Receives the value (not NUL-terminated)
+ * @param value_len Receives the value's length
+ * @return true if the parameter is present
+ */
+bool http_query(const http_request_t *request, const char *name, const char **value, size_t *value_len);
+
+/**
+ * Start a response: writes the status line and headers
+ * @param out Connection output (memory mode)
+ * @param status HTTP status code
+ * @param content_type Content-Type of the body
+ * @param keep_alive Whether the connection stays open
+ * @return Where the body starts, for http_end
+ */
+size_t http_begin(outbuf_t *out, int status, const char *content_type, bool keep_alive);
+
+/**
+ * Finish a response begun with http_begin by filling in Content-Length
+ * @param out Connection output
+ * @param body_start Value returned by http_begin
+ */
+void http_end(outbuf_t *out, size_t body_start);
+
+/**
+ * Append a JSON string literal, quoted and escaped
+ */
+void http_json_string(outbuf_t *out, const char *text, size_t len);
+
+#endif
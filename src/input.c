@@ -0,0 +1,139 @@
+/*
+ * input.c - Line Input
+ */
+
+#include "input.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+void input_init(input_t *in, int fd, char *block, size_t capacity) {
+    in->fd = fd;
+    in->data = block;
+    in->block = block;
+    in->cap = capacity;
+    in->start = 0;
+    in->len = 0;
+    in->eof = false;
+    in->skipping = false;
+    in->error = 0;
+    in->prompt = NULL;
+}
+
+void input_init_memory(input_t *in, const char *data, size_t len) {
+    in->fd = -1;
+    in->data = data;
+    in->block = NULL;
+    in->cap = len;
+    in->start = 0;
+    in->len = len;
+    in->eof = true;
+    in->skipping = false;
+    in->error = 0;
+    in->prompt = NULL;
+}
+
+/* Move unread bytes to the front of the block and read more; false at the end */
+static bool refill(input_t *in) {
+    if (in->fd < 0 || in->eof || in->error != 0) {
+        return false;
+    }
+    if (in->start > 0) {
+        memmove(in->block, in->block + in->start, in->len - in->start);
+        in->len -= in->start;
+        in->start = 0;
+    }
+    if (in->prompt != NULL) {
+        fflush(in->prompt);
+    }
+    for (;;) {
+        ssize_t n = read(in->fd, in->block + in->len, in->cap - in->len);
+        if (n > 0) {
+            in->len += (size_t)n;
+            return true;
+        } else if (n == 0) {
+            in->eof = true;
+            return false;
+        } else if (errno != EINTR) {
+            in->error = errno;
+            return false;
+        }
+    }
+}
+
+static void set_view(input_view_t *line, const char *text, size_t len, bool truncated) {
+    if (len > 0 && text[len - 1] == '\r') {
+        len--;
+    }
+    line->text = text;
+    line->len = len;
+    line->truncated = truncated;
+}
+
+bool input_next(input_t *in, input_view_t *line) {
+    size_t scanned = 0;                 // Bytes after start known to hold no newline
+
+    for (;;) {
+        const char *from = in->data + in->start + scanned;
+        const char *newline = memchr(from, '\n', in->len - in->start - scanned);
+        if (newline != NULL) {
+            size_t end = (size_t)(newline - in->data);
+            if (in->skipping) {
+                in->skipping = false;
+                in->start = end + 1;
+                scanned = 0;
+                continue;
+            }
+            set_view(line, in->data + in->start, end - in->start, false);
+            in->start = end + 1;
+            return true;
+        }
+
+        if (in->skipping) {
+            in->start = in->len;        // Drop what has arrived of the skipped line
+        } else if (in->fd >= 0 && in->start == 0 && in->len == in->cap) {
+            // Longer than the block: hand out what fits, skip the rest
+            set_view(line, in->data, in->len, true);
+            in->start = in->len;
+            in->skipping = true;
+            return true;
+        }
+        scanned = in->len - in->start;
+        if (!refill(in)) {
+            if (in->start < in->len) {
+                set_view(line, in->data + in->start, in->len - in->start, false);
+                in->start = in->len;    // The last line had no newline
+                return true;
+            }
+            in->skipping = false;
+            return false;
+        }
+    }
+}
+
+long input_line(input_t *in, char *line, size_t size) {
+    input_view_t view;
+    if (!input_next(in, &view)) {
+        return INPUT_END;
+    }
+    if (view.truncated || view.len >= size) {
+        return INPUT_TOO_LONG;
+    }
+    memcpy(line, view.text, view.len);
+    line[view.len] = '\0';
+    return (long)view.len;
+}
+
+bool input_at_end(const input_t *in) {
+    return in->start >= in->len && (in->fd < 0 || in->eof || in->error != 0);
+}
+
+bool input_pending(const input_t *in) {
+    if (in->start >= in->len || in->skipping) {
+        return false;
+    }
+    if (in->fd < 0 || in->eof || in->error != 0) {
+        return true;
+    }
+    return memchr(in->data + in->start, '\n', in->len - in->start) != NULL;
+}
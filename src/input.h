@@ -0,0 +1,103 @@
+/*
+ * input.h - Line Input
+ *
+ * The reading counterpart of outbuf: splits lines out of a block of
+ * bytes that is either refilled from a file descriptor with read(2) or
+ * is caller memory holding the whole input (fd = -1). The block always
+ * belongs to the caller, and so does every line buffer, so any number
+ * of inputs can be read at once from any threads, one thread per input.
+ *
+ * input_next() hands out each line as a view into the block, without
+ * copying it; input_line() copies the next line into the caller's
+ * buffer as a C string, for parsers that need one. Line endings (LF or
+ * CRLF) are not part of a line. All reading of standard input goes
+ * through one input_t, so nothing read ahead into its block is lost to
+ * another reader.
+ *
+ * An input can name a prompt stream to flush just before it blocks in
+ * read(2); an interactive program can then keep its output fully
+ * buffered and still show each prompt before waiting for the answer.
+ */
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define INPUT_BLOCK_SIZE 4096       // A good block size for terminals and pipes
+
+#define INPUT_END (-1)              // input_line: no more lines (see error)
+#define INPUT_TOO_LONG (-2)         // input_line: the line did not fit and was skipped
+
+typedef struct {
+    int fd;                         // Source descriptor, or -1 for memory only
+    const char *data;               // The block lines are split from
+    char *block;                    // Caller's block refilled from fd (NULL for memory)
+    size_t cap;                     // Size of block
+    size_t start;                   // First byte not yet handed out
+    size_t len;                     // End of the bytes in data
+    bool eof;                       // The descriptor has no more to read
+    bool skipping;                  // Discarding the rest of a truncated line
+    int error;                      // errno of a failed read, 0 if none
+    FILE *prompt;                   // Flushed before each read(2), or NULL
+} input_t;
+
+/* One line, pointing into the input's block */
+typedef struct {
+    const char *text;               // Not NUL-terminated
+    size_t len;
+    bool truncated;                 // Longer than the block; the rest was skipped
+} input_view_t;
+
+/**
+ * Initialize an input that reads from a descriptor into the caller's block
+ * (with no prompt stream until one is set in in->prompt)
+ * @param in Input to initialize
+ * @param fd Descriptor to read from
+ * @param block Caller's memory; lines longer than it are truncated
+ * @param capacity Its size
+ */
+void input_init(input_t *in, int fd, char *block, size_t capacity);
+
+/**
+ * Initialize an input over caller memory that holds the whole input
+ * @param in Input to initialize
+ * @param data The input; must outlive every line handed out
+ * @param len Its length
+ */
+void input_init_memory(input_t *in, const char *data, size_t len);
+
+/**
+ * Hand out the next line without copying it; the view stays valid until
+ * the next call on this input (for memory inputs, as long as the memory)
+ * @param in Input to read
+ * @param line Receives the line
+ * @return true if there was a line, false at the end of input or on a
+ *         read error (see in->error)
+ */
+bool input_next(input_t *in, input_view_t *line);
+
+/**
+ * Copy the next line into the caller's buffer as a C string
+ * @param in Input to read
+ * @param line Caller's buffer
+ * @param size Its size; lines of size bytes or more are skipped
+ * @return The line's length, INPUT_TOO_LONG if it was skipped, or
+ *         INPUT_END at the end of input or on a read error
+ */
+long input_line(input_t *in, char *line, size_t size);
+
+/**
+ * Whether the input has run out (after input_next or input_line failed)
+ */
+bool input_at_end(const input_t *in);
+
+/**
+ * Whether the next line can be handed out without reading: it is already
+ * complete in the block, or it is the last one
+ */
+bool input_pending(const input_t *in);
+
+#endif
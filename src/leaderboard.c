@@ -0,0 +1,745 @@
+/*
+ * leaderboard.c - Live Leaderboards
+ *
+ * One skip list per scope and metric. A node's key packs the ranking into
+ * a single 64-bit integer, smaller ranking first, so comparisons along a
+ * search are one integer compare plus the user index for exact ties. Each
+ * link holds the number of entries it passes (its span), and summing spans
+ * along a search gives a rank. Links also carry a copy of the key they lead
+ * to, so a search decides whether to follow a link without first loading
+ * the node at its far end - with 100k users most nodes are cache misses.
+ * A user owns one node per ranking it is in; re-ranking unlinks the node
+ * and links it back under its new key, reusing its memory, so steady-state
+ * updates do not allocate.
+ *
+ * The leaderboard command builds a leaderboard from the user store: each
+ * user's lifetime totals, plus answer times and streaks replayed from the
+ * user's answer log (see answerlog.h).
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include "answerlog.h"
+#include "leaderboard.h"
+#include "questions.h"
+#include "rng.h"
+#include "tables.h"
+#include "userstore.h"
+
+#define MAX_LEVEL 24                // Levels grow with probability 1/4: ample for 2^40 entries
+#define NAME_TABLE_INITIAL 1024
+#define NO_USER UINT32_MAX
+
+const char *const leaderboard_metric_names[LEADERBOARD_METRICS] = { "accuracy", "speed", "streak" };
+
+typedef struct board_node board_node_t;
+
+typedef struct {
+    board_node_t *next;
+    uint64_t next_key;              // next->key and next->user, if next is set
+    uint32_t next_user;
+    uint32_t span;                  // Entries passed by following this link
+} board_link_t;
+
+struct board_node {
+    uint64_t key;                   // Ranking, smaller first
+    uint32_t user;                  // Index into users; breaks exact ties
+    uint32_t level;
+    board_link_t links[];
+};
+
+typedef struct {
+    board_node_t *head;             // Sentinel, MAX_LEVEL links
+    uint32_t level;                 // Levels in use
+    uint32_t length;
+} board_list_t;
+
+typedef struct {
+    char name[USER_NAME_MAX + 1];
+    leaderboard_score_t scores[LEADERBOARD_SCOPES];
+    board_node_t *nodes[LEADERBOARD_SCOPES][LEADERBOARD_METRICS];   // NULL while unranked
+} board_user_t;
+
+struct leaderboard {
+    board_list_t lists[LEADERBOARD_SCOPES][LEADERBOARD_METRICS];
+    board_user_t *users;
+    uint32_t user_count;
+    uint32_t user_capacity;
+    uint32_t *names;                // Open-addressing table of user indices
+    uint32_t name_capacity;         // Power of two, at least twice user_count
+    uint32_t min_answers;
+    rng_t rng;                      // Node levels
+};
+
+/* ========== Skip Lists ========== */
+
+/* Whether a link leads to an entry ranked before (key, user) */
+static bool link_before(const board_link_t *link, uint64_t key, uint32_t user) {
+    return link->next != NULL && (link->next_key < key || (link->next_key == key && link->next_user < user));
+}
+
+static board_node_t *node_alloc(rng_t *rng) {
+    // Each further level with probability 1/4, from two random bits at a time
+    uint64_t bits = rng_next(rng);
+    uint32_t level = 1;
+    while (level < MAX_LEVEL && (bits & 3) == 0) {
+        level++;
+        bits >>= 2;
+    }
+    board_node_t *node = calloc(1, sizeof(board_node_t) + level * sizeof(board_link_t));
+    if (node != NULL) {
+        node->level = level;
+    }
+    return node;
+}
+
+static int list_init(board_list_t *list) {
+    list->head = calloc(1, sizeof(board_node_t) + MAX_LEVEL * sizeof(board_link_t));
+    list->level = 1;
+    list->length = 0;
+    return list->head != NULL ? 0 : -1;
+}
+
+static void list_free(board_list_t *list) {
+    if (list->head == NULL) {
+        return;
+    }
+    board_node_t *node = list->head->links[0].next;
+    while (node != NULL) {
+        board_node_t *next = node->links[0].next;
+        free(node);
+        node = next;
+    }
+    free(list->head);
+    list->head = NULL;
+}
+
+/* Link a node in by its key and user */
+static void list_link(board_list_t *list, board_node_t *node) {
+    board_node_t *update[MAX_LEVEL];
+    uint32_t rank[MAX_LEVEL];
+    board_node_t *x = list->head;
+
+    for (int i = (int)list->level - 1; i >= 0; i--) {
+        rank[i] = i == (int)list->level - 1 ? 0 : rank[i + 1];
+        while (link_before(&x->links[i], node->key, node->user)) {
+            rank[i] += x->links[i].span;
+            x = x->links[i].next;
+        }
+        update[i] = x;
+    }
+
+    // New levels start at the head, spanning the whole list
+    for (uint32_t i = list->level; i < node->level; i++) {
+        rank[i] = 0;
+        update[i] = list->head;
+        list->head->links[i].next = NULL;
+        list->head->links[i].span = list->length;
+    }
+    if (node->level > list->level) {
+        list->level = node->level;
+    }
+
+    for (uint32_t i = 0; i < node->level; i++) {
+        board_link_t *prev = &update[i]->links[i];
+        node->links[i] = *prev;
+        node->links[i].span = prev->span - (rank[0] - rank[i]);
+        prev->next = node;
+        prev->next_key = node->key;
+        prev->next_user = node->user;
+        prev->span = rank[0] - rank[i] + 1;
+    }
+    for (uint32_t i = node->level; i < list->level; i++) {
+        update[i]->links[i].span++;
+    }
+    list->length++;
+}
+
+/* Unlink a node, found by its current key and user */
+static void list_unlink(board_list_t *list, board_node_t *node) {
+    board_node_t *update[MAX_LEVEL];
+    board_node_t *x = list->head;
+
+    for (int i = (int)list->level - 1; i >= 0; i--) {
+        while (link_before(&x->links[i], node->key, node->user)) {
+            x = x->links[i].next;
+        }
+        update[i] = x;
+    }
+
+    for (uint32_t i = 0; i < list->level; i++) {
+        if (update[i]->links[i].next == node) {
+            uint32_t span = update[i]->links[i].span + node->links[i].span - 1;
+            update[i]->links[i] = node->links[i];
+            update[i]->links[i].span = span;
+        } else {
+            update[i]->links[i].span--;
+        }
+    }
+    while (list->level > 1 && list->head->links[list->level - 1].next == NULL) {
+        list->level--;
+    }
+    list->length--;
+}
+
+/* 1-based rank of a linked node */
+static uint32_t list_rank(const board_list_t *list, const board_node_t *node) {
+    uint32_t rank = 0;
+    const board_node_t *x = list->head;
+
+    for (int i = (int)list->level - 1; i >= 0; i--) {
+        while (x->links[i].next == node || link_before(&x->links[i], node->key, node->user)) {
+            rank += x->links[i].span;
+            x = x->links[i].next;
+        }
+        if (x == node) {
+            return rank;
+        }
+    }
+    return 0;
+}
+
+/* Node at a 1-based rank, or NULL past the end */
+static const board_node_t *list_at(const board_list_t *list, uint32_t rank) {
+    uint32_t passed = 0;
+    const board_node_t *x = list->head;
+
+    for (int i = (int)list->level - 1; i >= 0; i--) {
+        while (x->links[i].next != NULL && passed + x->links[i].span <= rank) {
+            passed += x->links[i].span;
+            x = x->links[i].next;
+        }
+        if (passed == rank) {
+            return x != list->head ? x : NULL;
+        }
+    }
+    return NULL;
+}
+
+/* ========== Rankings ========== */
+
+/* Whether a score ranks on a metric, and its key if so */
+static bool score_key(const leaderboard_score_t *score, leaderboard_metric_t metric,
+                      uint32_t min_answers, uint64_t *key) {
+    switch (metric) {
+        case LEADERBOARD_ACCURACY: {
+            if (score->answered == 0 || score->answered < min_answers) {
+                return false;
+            }
+            uint64_t ppm = (uint64_t)score->correct * 1000000 / score->answered;
+            *key = (1000000 - ppm) << 32 | (UINT32_MAX - score->answered);
+            return true;
+        }
+        case LEADERBOARD_SPEED: {
+            if (score->timed == 0 || score->timed < min_answers) {
+                return false;
+            }
+            double ms = score->seconds * 1000.0 / score->timed;
+            uint64_t mean = ms < (double)UINT32_MAX ? (uint64_t)ms : UINT32_MAX;
+            *key = mean << 32 | (UINT32_MAX - score->timed);
+            return true;
+        }
+        case LEADERBOARD_STREAK:
+            if (score->best_streak == 0) {
+                return false;
+            }
+            // Not tie-broken by the current run, which would move the entry on every answer
+            *key = UINT32_MAX - score->best_streak;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Move a user's entries in one scope to match its score there */
+static int rerank(leaderboard_t *board, uint32_t index, int scope) {
+    board_user_t *user = &board->users[index];
+
+    for (int m = 0; m < LEADERBOARD_METRICS; m++) {
+        board_list_t *list = &board->lists[scope][m];
+        board_node_t *node = user->nodes[scope][m];
+        uint64_t key;
+        bool ranked = score_key(&user->scores[scope], (leaderboard_metric_t)m, board->min_answers, &key);
+
+        if (node != NULL && (!ranked || node->key != key)) {
+            list_unlink(list, node);
+            if (!ranked) {
+                free(node);
+                user->nodes[scope][m] = NULL;
+                continue;
+            }
+        } else if (node != NULL || !ranked) {
+            continue;                   // Unchanged
+        } else if ((node = node_alloc(&board->rng)) == NULL) {
+            return -1;
+        } else {
+            node->user = index;
+            user->nodes[scope][m] = node;
+        }
+        node->key = key;
+        list_link(list, node);
+    }
+    return 0;
+}
+
+/* ========== Users ========== */
+
+static uint32_t hash_name(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t *name_slot(uint32_t *names, uint32_t capacity, const board_user_t *users, const char *name) {
+    uint32_t mask = capacity - 1;
+    uint32_t i = hash_name(name) & mask;
+    while (names[i] != NO_USER && strcmp(users[names[i]].name, name) != 0) {
+        i = (i + 1) & mask;
+    }
+    return &names[i];
+}
+
+static uint32_t find_user(const leaderboard_t *board, const char *name) {
+    return *name_slot(board->names, board->name_capacity, board->users, name);
+}
+
+static int grow_names(leaderboard_t *board) {
+    uint32_t capacity = board->name_capacity * 2;
+    uint32_t *names = malloc(capacity * sizeof(uint32_t));
+    if (names == NULL) {
+        return -1;
+    }
+    memset(names, 0xff, capacity * sizeof(uint32_t));
+    for (uint32_t i = 0; i < board->user_count; i++) {
+        *name_slot(names, capacity, board->users, board->users[i].name) = i;
+    }
+    free(board->names);
+    board->names = names;
+    board->name_capacity = capacity;
+    return 0;
+}
+
+/* Index of a user, added if new; NO_USER if out of memory */
+static uint32_t intern_user(leaderboard_t *board, const char *name) {
+    uint32_t index = find_user(board, name);
+    if (index != NO_USER) {
+        return index;
+    }
+
+    if ((board->user_count + 1) * 2 > board->name_capacity && grow_names(board) != 0) {
+        return NO_USER;
+    }
+    if (board->user_count == board->user_capacity) {
+        uint32_t capacity = board->user_capacity > 0 ? board->user_capacity * 2 : 256;
+        board_user_t *users = realloc(board->users, capacity * sizeof(board_user_t));
+        if (users == NULL) {
+            return NO_USER;
+        }
+        board->users = users;
+        board->user_capacity = capacity;
+    }
+
+    index = board->user_count++;
+    board_user_t *user = &board->users[index];
+    memset(user, 0, sizeof(*user));
+    strncpy(user->name, name, USER_NAME_MAX);
+    *name_slot(board->names, board->name_capacity, board->users, user->name) = index;
+    return index;
+}
+
+/* ========== Public Interface ========== */
+
+leaderboard_t *leaderboard_create(uint32_t min_answers) {
+    leaderboard_t *board = calloc(1, sizeof(leaderboard_t));
+    if (board == NULL) {
+        return NULL;
+    }
+    board->min_answers = min_answers;
+    board->name_capacity = NAME_TABLE_INITIAL;
+    board->names = malloc(board->name_capacity * sizeof(uint32_t));
+    rng_seed(&board->rng, 0x6c65616465726272ull);
+
+    bool ok = board->names != NULL;
+    for (int s = 0; s < LEADERBOARD_SCOPES; s++) {
+        for (int m = 0; m < LEADERBOARD_METRICS; m++) {
+            ok = ok && list_init(&board->lists[s][m]) == 0;
+        }
+    }
+    if (!ok) {
+        leaderboard_free(board);
+        return NULL;
+    }
+    memset(board->names, 0xff, board->name_capacity * sizeof(uint32_t));
+    return board;
+}
+
+void leaderboard_free(leaderboard_t *board) {
+    if (board == NULL) {
+        return;
+    }
+    // The lists own the nodes
+    for (int s = 0; s < LEADERBOARD_SCOPES; s++) {
+        for (int m = 0; m < LEADERBOARD_METRICS; m++) {
+            list_free(&board->lists[s][m]);
+        }
+    }
+    free(board->users);
+    free(board->names);
+    free(board);
+}
+
+void leaderboard_score_add(leaderboard_score_t scores[LEADERBOARD_SCOPES], category_t category,
+                           bool correct, float response_seconds) {
+    leaderboard_score_t *in_scope[2] = { &scores[category], &scores[LEADERBOARD_ALL] };
+
+    for (int i = 0; i < 2; i++) {
+        leaderboard_score_t *score = in_scope[i];
+        score->answered++;
+        if (correct) {
+            score->correct++;
+            if (++score->streak > score->best_streak) {
+                score->best_streak = score->streak;
+            }
+        } else {
+            score->streak = 0;
+        }
+        if (response_seconds > 0.0f) {
+            score->timed++;
+            score->seconds += response_seconds;
+        }
+    }
+}
+
+int leaderboard_record(leaderboard_t *board, const char *user, const stats_delta_t *delta) {
+    uint32_t index = intern_user(board, user);
+    if (index == NO_USER) {
+        return -1;
+    }
+    leaderboard_score_add(board->users[index].scores, delta->category, delta->correct, delta->response_seconds);
+
+    // Only the answer's category and the overall scope change
+    if (rerank(board, index, delta->category) != 0 || rerank(board, index, LEADERBOARD_ALL) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int leaderboard_set(leaderboard_t *board, const char *user,
+                    const leaderboard_score_t scores[LEADERBOARD_SCOPES]) {
+    uint32_t index = intern_user(board, user);
+    if (index == NO_USER) {
+        return -1;
+    }
+    memcpy(board->users[index].scores, scores, sizeof(board->users[index].scores));
+    for (int s = 0; s < LEADERBOARD_SCOPES; s++) {
+        if (rerank(board, index, s) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+size_t leaderboard_users(const leaderboard_t *board) {
+    return board->user_count;
+}
+
+size_t leaderboard_ranked(const leaderboard_t *board, int scope, leaderboard_metric_t metric) {
+    return board->lists[scope][metric].length;
+}
+
+size_t leaderboard_top(const leaderboard_t *board, int scope, leaderboard_metric_t metric,
+                       size_t first, size_t count, leaderboard_entry_t *entries) {
+    const board_list_t *list = &board->lists[scope][metric];
+    if (first == 0 || first > list->length) {
+        return 0;
+    }
+
+    const board_node_t *node = list_at(list, (uint32_t)first);
+    size_t n = 0;
+    for (; node != NULL && n < count; node = node->links[0].next, n++) {
+        const board_user_t *user = &board->users[node->user];
+        entries[n].rank = (uint32_t)(first + n);
+        entries[n].user = user->name;
+        entries[n].score = user->scores[scope];
+    }
+    return n;
+}
+
+bool leaderboard_find(const leaderboard_t *board, const char *user, int scope,
+                      leaderboard_metric_t metric, leaderboard_entry_t *entry) {
+    uint32_t index = find_user(board, user);
+    if (index == NO_USER) {
+        return false;
+    }
+    const board_user_t *found = &board->users[index];
+    const board_node_t *node = found->nodes[scope][metric];
+    entry->rank = node != NULL ? list_rank(&board->lists[scope][metric], node) : 0;
+    entry->user = found->name;
+    entry->score = found->scores[scope];
+    return true;
+}
+
+/* ========== Loading from the User Store ========== */
+
+typedef struct {
+    leaderboard_t *board;
+    uint64_t logged;                // Answers replayed from logs
+    bool failed;
+} load_context_t;
+
+static void replay_answer(void *context, const answer_record_t *record) {
+    leaderboard_score_t *scores = context;
+    leaderboard_score_add(scores, (category_t)conversion_table[record->conversion_id].category,
+                          (record->flags & ANSWERLOG_CORRECT) != 0,
+                          (record->flags & ANSWERLOG_TIMED) ? record->response_seconds : 0.0f);
+}
+
+static void add_store_user(void *context, const char *user, const persistent_stats_t *stats) {
+    load_context_t *load = context;
+    leaderboard_score_t scores[LEADERBOARD_SCOPES];
+    answerlog_filter_t everything;
+    char path[MAX_DATA_PATH];
+
+    // Times and streaks from the user's log, named as user_data_path names it
+    memset(scores, 0, sizeof(scores));
+    memset(&everything, 0, sizeof(everything));
+    snprintf(path, sizeof(path), "%s.%s", ANSWERLOG_FILE, user);
+    if (answerlog_query(path, &everything, replay_answer, scores, NULL) == 0) {
+        load->logged += scores[LEADERBOARD_ALL].answered;
+    }
+
+    // Totals from the store, which also counts answers from before the log
+    uint32_t total = 0, correct = 0;
+    for (int c = 0; c < CATEGORY_COUNT; c++) {
+        if ((uint32_t)stats->total_questions[c] > scores[c].answered) {
+            scores[c].answered = (uint32_t)stats->total_questions[c];
+            scores[c].correct = (uint32_t)stats->correct_answers[c];
+        }
+        total += scores[c].answered;
+        correct += scores[c].correct;
+    }
+    scores[LEADERBOARD_ALL].answered = total;
+    scores[LEADERBOARD_ALL].correct = correct;
+
+    if (leaderboard_set(load->board, user, scores) != 0) {
+        load->failed = true;
+    }
+}
+
+int leaderboard_load(leaderboard_t *board, const char *path, uint64_t *logged) {
+    load_context_t load = { board, 0, false };
+    if (userstore_foreach(path, add_store_user, &load) != 0 || load.failed) {
+        return -1;
+    }
+    if (logged != NULL) {
+        *logged = load.logged;
+    }
+    return 0;
+}
+
+int leaderboard_parse_scope(const char *text) {
+    if (strcmp(text, "all") == 0) {
+        return LEADERBOARD_ALL;
+    }
+    for (int c = 0; c < CATEGORY_COUNT; c++) {
+        if ((text[0] == category_letters[c] && text[1] == '\0') || strcasecmp(text, category_names[c]) == 0) {
+            return c;
+        }
+    }
+    return -1;
+}
+
+int leaderboard_parse_metric(const char *text) {
+    for (int m = 0; m < LEADERBOARD_METRICS; m++) {
+        if (strcmp(text, leaderboard_metric_names[m]) == 0) {
+            return m;
+        }
+    }
+    return -1;
+}
+
+/* ========== Leaderboard Command ========== */
+
+typedef struct {
+    int scope;
+    leaderboard_metric_t metric;
+    size_t count;
+    uint32_t min_answers;
+    const char *store;
+    const char *user;
+} leaderboard_options_t;
+
+static void show_leaderboard_help(void) {
+    printf("USAGE:\n");
+    printf("  metric-trainer leaderboard [OPTIONS]\n\n");
+    printf("Ranks the users of the user store (see --user in practice). Accuracy\n");
+    printf("uses lifetime statistics; speed and streaks come from answer logs.\n\n");
+    printf("OPTIONS:\n");
+    printf("  --by METRIC            accuracy (default), speed or streak\n");
+    printf("  -c, --category C       One category, by letter or name (default: all)\n");
+    printf("  -n, --top N            Number of places to list (default: 10)\n");
+    printf("  -u, --user NAME        Also show NAME's place\n");
+    printf("  --min-answers N        Answers needed to rank on accuracy or speed\n");
+    printf("                         (default: %d)\n", LEADERBOARD_MIN_ANSWERS);
+    printf("  --store FILE           User store to read (default: %s)\n", USER_STORE_FILE);
+}
+
+static int parse_leaderboard_options(int argc, char *argv[], leaderboard_options_t *opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->scope = LEADERBOARD_ALL;
+    opts->metric = LEADERBOARD_ACCURACY;
+    opts->count = 10;
+    opts->min_answers = LEADERBOARD_MIN_ANSWERS;
+    opts->store = USER_STORE_FILE;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            show_leaderboard_help();
+            return 0;
+        }
+        if (value == NULL) {
+            fprintf(stderr, "leaderboard: unknown option or missing value: %s\n", arg);
+            return -1;
+        }
+        i++;
+
+        if (strcmp(arg, "--by") == 0) {
+            int m = leaderboard_parse_metric(value);
+            if (m < 0) {
+                fprintf(stderr, "leaderboard: unknown ranking '%s'\n", value);
+                return -1;
+            }
+            opts->metric = (leaderboard_metric_t)m;
+        } else if (strcmp(arg, "-c") == 0 || strcmp(arg, "--category") == 0) {
+            if ((opts->scope = leaderboard_parse_scope(value)) < 0) {
+                fprintf(stderr, "leaderboard: unknown category '%s'\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "-n") == 0 || strcmp(arg, "--top") == 0) {
+            long count;
+            if (!parse_whole_number(value, 1, INT_MAX, &count)) {
+                fprintf(stderr, "leaderboard: invalid --top '%s' (use 1 or more)\n", value);
+                return -1;
+            }
+            opts->count = (size_t)count;
+        } else if (strcmp(arg, "-u") == 0 || strcmp(arg, "--user") == 0) {
+            if (!userstore_valid_name(value)) {
+                fprintf(stderr, "leaderboard: invalid user name '%s'\n", value);
+                return -1;
+            }
+            opts->user = value;
+        } else if (strcmp(arg, "--min-answers") == 0) {
+            long min_answers;
+            if (!parse_whole_number(value, 0, INT_MAX, &min_answers)) {
+                fprintf(stderr, "leaderboard: invalid --min-answers '%s' (use 0 or more)\n", value);
+                return -1;
+            }
+            opts->min_answers = (uint32_t)min_answers;
+        } else if (strcmp(arg, "--store") == 0) {
+            opts->store = value;
+        } else {
+            fprintf(stderr, "leaderboard: unknown option: %s\n", arg);
+            return -1;
+        }
+    }
+    return 1;
+}
+
+static void print_entry(const leaderboard_entry_t *entry, bool highlight) {
+    const leaderboard_score_t *score = &entry->score;
+    printf("  %6u%c %-16s  %7u", entry->rank, highlight ? '*' : ' ', entry->user, score->answered);
+    if (score->answered > 0) {
+        printf("  %7.1f%%", 100.0 * score->correct / score->answered);
+    } else {
+        printf("  %8s", "-");
+    }
+    if (score->timed > 0) {
+        printf("  %7.1fs", score->seconds / score->timed);
+    } else {
+        printf("  %8s", "-");
+    }
+    printf("  %11u\n", score->best_streak);
+}
+
+int leaderboard_main(int argc, char *argv[]) {
+    leaderboard_options_t opts;
+    int parsed = parse_leaderboard_options(argc, argv, &opts);
+    if (parsed <= 0) {
+        return parsed == 0 ? 0 : 1;
+    }
+
+    leaderboard_t *board;
+    uint64_t logged;
+    struct timespec start, built, queried;
+    if ((board = leaderboard_create(opts.min_answers)) == NULL) {
+        fprintf(stderr, "leaderboard: out of memory\n");
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (leaderboard_load(board, opts.store, &logged) != 0) {
+        fprintf(stderr, "leaderboard: cannot read %s\n", opts.store);
+        leaderboard_free(board);
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &built);
+
+    leaderboard_entry_t *entries = malloc(opts.count * sizeof(leaderboard_entry_t));
+    if (entries == NULL) {
+        fprintf(stderr, "leaderboard: out of memory\n");
+        leaderboard_free(board);
+        return 1;
+    }
+    size_t shown = leaderboard_top(board, opts.scope, opts.metric, 1, opts.count, entries);
+    leaderboard_entry_t mine;
+    bool found = opts.user != NULL && leaderboard_find(board, opts.user, opts.scope, opts.metric, &mine);
+    clock_gettime(CLOCK_MONOTONIC, &queried);
+
+    const char *scope_name = opts.scope == LEADERBOARD_ALL ? "All categories" : category_names[opts.scope];
+    size_t ranked = leaderboard_ranked(board, opts.scope, opts.metric);
+    printf("\nLeaderboard: %s by %s\n", scope_name, leaderboard_metric_names[opts.metric]);
+    printf("══════════════════════════════════════════\n\n");
+
+    if (shown == 0) {
+        printf("  No users rank here yet");
+        if (opts.metric != LEADERBOARD_STREAK) {
+            printf(" (%u answers needed)", opts.min_answers);
+        }
+        printf(".\n");
+    } else {
+        printf("  %6s  %-16s  %7s  %8s  %8s  %11s\n", "Rank", "User",
+               "Answers", "Accuracy", "Avg Time", "Best Streak");
+        printf("  ─────────────────────────────────────────────────────────────────────\n");
+        for (size_t i = 0; i < shown; i++) {
+            print_entry(&entries[i], found && entries[i].user == mine.user);
+        }
+    }
+
+    if (opts.user != NULL && !found) {
+        printf("\n  %s is not in the user store.\n", opts.user);
+    } else if (found && mine.rank == 0) {
+        printf("\n  %s is not ranked here yet.\n", opts.user);
+    } else if (found && mine.rank > shown) {
+        printf("  ...\n");
+        print_entry(&mine, true);
+    }
+
+    double build_ms = (double)(built.tv_sec - start.tv_sec) * 1000.0 + (double)(built.tv_nsec - start.tv_nsec) / 1e6;
+    double query_us = (double)(queried.tv_sec - built.tv_sec) * 1e6 + (double)(queried.tv_nsec - built.tv_nsec) / 1e3;
+    printf("\n  %zu of %zu users ranked; %llu answers replayed from answer logs\n",
+           ranked, leaderboard_users(board), (unsigned long long)logged);
+    printf("  Built in %.1f ms, queried in %.1f us\n\n", build_ms, query_us);
+
+    free(entries);
+    leaderboard_free(board);
+    return 0;
+}
@@ -0,0 +1,168 @@
+/*
+ * leaderboard.h - Live Leaderboards
+ *
+ * Ranks users by accuracy, speed and best streak, per category and over
+ * all categories. Each ranking is an order-statistics skip list: every
+ * link records how many entries it jumps over, so inserting, removing,
+ * finding the entry at rank r and finding the rank of an entry all take
+ * O(log n). A graded answer moves the answering user's entries in the
+ * rankings it changes and touches nothing else, so a long-lived server
+ * keeps its leaderboards current answer by answer.
+ *
+ * Rankings, best first:
+ *   accuracy   share of answers correct, then more answers
+ *   speed      mean answer time, then more timed answers
+ *   streak     longest run of correct answers
+ * Accuracy and speed only rank users with at least min_answers answers
+ * (timed answers, for speed) in the scope; ties that remain go to the
+ * user seen first.
+ */
+
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "questions.h"
+
+#define LEADERBOARD_ALL CATEGORY_COUNT          // Scope of all categories together
+#define LEADERBOARD_SCOPES (CATEGORY_COUNT + 1)
+#define LEADERBOARD_MIN_ANSWERS 20
+
+typedef enum {
+    LEADERBOARD_ACCURACY,
+    LEADERBOARD_SPEED,
+    LEADERBOARD_STREAK,
+    LEADERBOARD_METRICS
+} leaderboard_metric_t;
+
+extern const char *const leaderboard_metric_names[LEADERBOARD_METRICS];
+
+/* One user's results in one scope */
+typedef struct {
+    uint32_t answered;
+    uint32_t correct;
+    uint32_t timed;             // Answers with a response time
+    uint32_t streak;            // Correct answers since the last wrong one
+    uint32_t best_streak;
+    double seconds;             // Total response time of timed answers
+} leaderboard_score_t;
+
+/* A ranked user, as returned by queries */
+typedef struct {
+    uint32_t rank;              // 1 is best; 0 if not ranked
+    const char *user;           // Valid until a user is next added
+    leaderboard_score_t score;
+} leaderboard_entry_t;
+
+typedef struct leaderboard leaderboard_t;
+
+/**
+ * Create an empty leaderboard
+ * @param min_answers Answers a user needs in a scope to rank on accuracy
+ *                    or speed there
+ * @return The leaderboard, or NULL if out of memory
+ */
+leaderboard_t *leaderboard_create(uint32_t min_answers);
+
+/**
+ * Free a leaderboard and everything in it
+ */
+void leaderboard_free(leaderboard_t *board);
+
+/**
+ * Add one graded answer to a set of scores (one per scope)
+ * @param scores Scores indexed by category, LEADERBOARD_ALL last
+ * @param category Category of the answer
+ * @param correct Whether the answer was correct
+ * @param response_seconds Answer time; 0 or less if not timed
+ */
+void leaderboard_score_add(leaderboard_score_t scores[LEADERBOARD_SCOPES], category_t category,
+                           bool correct, float response_seconds);
+
+/**
+ * Record a graded answer and re-rank its user, in O(log n)
+ * @param board Leaderboard
+ * @param user User name (added if new)
+ * @param delta The answer
+ * @return 0 on success, -1 if out of memory
+ */
+int leaderboard_record(leaderboard_t *board, const char *user, const stats_delta_t *delta);
+
+/**
+ * Replace all of a user's scores and re-rank them
+ * @param board Leaderboard
+ * @param user User name (added if new)
+ * @param scores Scores indexed by category, LEADERBOARD_ALL last
+ * @return 0 on success, -1 if out of memory
+ */
+int leaderboard_set(leaderboard_t *board, const char *user,
+                    const leaderboard_score_t scores[LEADERBOARD_SCOPES]);
+
+/**
+ * Number of users known to the leaderboard, ranked or not
+ */
+size_t leaderboard_users(const leaderboard_t *board);
+
+/**
+ * Number of users ranked in a scope on a metric
+ */
+size_t leaderboard_ranked(const leaderboard_t *board, int scope, leaderboard_metric_t metric);
+
+/**
+ * Read a run of consecutive ranks, in O(log n + count)
+ * @param board Leaderboard
+ * @param scope Category, or LEADERBOARD_ALL
+ * @param metric Ranking to read
+ * @param first First rank wanted (1 for the top)
+ * @param count Maximum entries to return
+ * @param entries Receives up to count entries
+ * @return Number of entries returned
+ */
+size_t leaderboard_top(const leaderboard_t *board, int scope, leaderboard_metric_t metric,
+                       size_t first, size_t count, leaderboard_entry_t *entries);
+
+/**
+ * Look up one user's rank and scores, in O(log n)
+ * @param board Leaderboard
+ * @param user User name
+ * @param scope Category, or LEADERBOARD_ALL
+ * @param metric Ranking to look in
+ * @param entry Receives the user's entry (rank 0 if not ranked)
+ * @return true if the user is known
+ */
+bool leaderboard_find(const leaderboard_t *board, const char *user, int scope,
+                      leaderboard_metric_t metric, leaderboard_entry_t *entry);
+
+/**
+ * Add every user of a user store: lifetime totals from the store, answer
+ * times and streaks replayed from each user's answer log
+ * @param board Leaderboard
+ * @param path User store file
+ * @param logged Receives the number of answers replayed (may be NULL)
+ * @return 0 on success, -1 if the store cannot be read or memory ran out
+ */
+int leaderboard_load(leaderboard_t *board, const char *path, uint64_t *logged);
+
+/**
+ * Parse a scope: "all", a category letter or a category name
+ * @return Category, LEADERBOARD_ALL, or -1 if not recognized
+ */
+int leaderboard_parse_scope(const char *text);
+
+/**
+ * Parse a metric name ("accuracy", "speed" or "streak")
+ * @return The metric, or -1 if not recognized
+ */
+int leaderboard_parse_metric(const char *text);
+
+/**
+ * Entry point for `metric-trainer leaderboard ...`
+ * @param argc Argument count, argv[0] being "leaderboard"
+ * @param argv Argument vector
+ * @return Process exit status
+ */
+int leaderboard_main(int argc, char *argv[]);
+
+#endif
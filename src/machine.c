@@ -0,0 +1,276 @@
+/*
+ * machine.c - Machine Protocol
+ *
+ * Records are rendered with the fmt_* formatters into one outbuf bound
+ * to standard output, which is flushed only when no complete request is
+ * left in the input's block, just before reading would block.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "machine.h"
+#include "metrics.h"
+#include "outbuf.h"
+#include "questions.h"
+#include "statswriter.h"
+#include "tables.h"
+
+#define MACHINE_OUTBUF_SIZE (1 << 16)
+#define MACHINE_LINE_SIZE 64
+
+/* category_names, as they appear in records */
+static const char *const record_category_names[CATEGORY_COUNT] = {
+    "distance", "weight", "temperature", "volume"
+};
+
+typedef struct {
+    machine_format_t format;
+    outbuf_t out;
+    bool in_session;
+    category_selection_t selection;
+    question_t question;
+    int questions_asked;
+    double asked_at;
+    session_stats_t stats;
+    persistent_stats_t persistent;
+} machine_t;
+
+static double monotonic_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/* ========== Records ========== */
+
+/* Start a record: the type, then fields added with put_* */
+static void begin_record(machine_t *m, const char *type) {
+    if (m->format == MACHINE_JSON) {
+        outbuf_puts(&m->out, "{\"type\":\"");
+        outbuf_puts(&m->out, type);
+        outbuf_putc(&m->out, '"');
+    } else {
+        outbuf_puts(&m->out, type);
+    }
+}
+
+static void put_key(machine_t *m, const char *key) {
+    if (m->format == MACHINE_JSON) {
+        outbuf_puts(&m->out, ",\"");
+        outbuf_puts(&m->out, key);
+        outbuf_puts(&m->out, "\":");
+    } else {
+        outbuf_putc(&m->out, '\t');
+    }
+}
+
+/* Strings in records are names and unit abbreviations: no escaping needed */
+static void put_string(machine_t *m, const char *key, const char *value) {
+    put_key(m, key);
+    if (m->format == MACHINE_JSON) {
+        outbuf_putc(&m->out, '"');
+        outbuf_puts(&m->out, value);
+        outbuf_putc(&m->out, '"');
+    } else {
+        outbuf_puts(&m->out, value);
+    }
+}
+
+static void put_long(machine_t *m, const char *key, long value) {
+    put_key(m, key);
+    outbuf_long(&m->out, value);
+}
+
+/* Numbers that are not finite are null in JSON and empty in TSV */
+static void put_fixed(machine_t *m, const char *key, double value) {
+    put_key(m, key);
+    if (isfinite(value)) {
+        outbuf_fixed(&m->out, value, 2);
+    } else if (m->format == MACHINE_JSON) {
+        outbuf_puts(&m->out, "null");
+    }
+}
+
+static void put_bool(machine_t *m, const char *key, bool value) {
+    put_key(m, key);
+    if (m->format == MACHINE_JSON) {
+        outbuf_puts(&m->out, value ? "true" : "false");
+    } else {
+        outbuf_putc(&m->out, value ? '1' : '0');
+    }
+}
+
+static void end_record(machine_t *m) {
+    if (m->format == MACHINE_JSON) {
+        outbuf_putc(&m->out, '}');
+    }
+    outbuf_putc(&m->out, '\n');
+}
+
+static void error_record(machine_t *m, const char *message) {
+    begin_record(m, "error");
+    put_string(m, "message", message);
+    end_record(m);
+}
+
+/* ========== Sessions ========== */
+
+static void ask_question(machine_t *m) {
+    const question_t *q = &m->question;
+
+    m->question = generate_question(&m->selection);
+    m->questions_asked++;
+    m->asked_at = monotonic_seconds();
+    metrics_question(q->category);
+
+    begin_record(m, "question");
+    put_long(m, "number", m->questions_asked);
+    put_string(m, "category", record_category_names[q->category]);
+    put_long(m, "conversion", q->conversion_id);
+    put_string(m, "from", unit_string(conversion_names[q->conversion_id].from_abbrev));
+    put_string(m, "to", unit_string(conversion_names[q->conversion_id].to_abbrev));
+    put_fixed(m, "value", q->value);
+    end_record(m);
+}
+
+static void start_session(machine_t *m, const category_selection_t *selection) {
+    m->selection = *selection;
+    m->in_session = true;
+    m->questions_asked = 0;
+    memset(&m->stats, 0, sizeof(m->stats));
+    load_persistent_stats(&m->persistent);
+    statswriter_start(&m->persistent, STATSWRITER_DEFAULT_INTERVAL_MS);
+    metrics_session_started();
+    ask_question(m);
+}
+
+static void end_session(machine_t *m) {
+    const session_stats_t *stats = &m->stats;
+
+    statswriter_stop(NULL);
+    metrics_session_ended();
+    m->in_session = false;
+
+    begin_record(m, "summary");
+    put_long(m, "answered", stats->total_questions);
+    put_long(m, "correct", stats->correct_answers);
+    if (stats->total_questions > 0) {
+        put_fixed(m, "error_median", sketch_quantile(&stats->error_sketch, &sketch_percent_scale, 0.5f));
+        put_fixed(m, "error_p90", sketch_quantile(&stats->error_sketch, &sketch_percent_scale, 0.9f));
+    }
+    end_record(m);
+}
+
+static void answer_question(machine_t *m, float answer) {
+    const question_t *q = &m->question;
+    double answered = monotonic_seconds();
+    float seconds = (float)(answered - m->asked_at);
+
+    answer_result_t result = grade_answer(q, answer);
+    stats_delta_t delta = make_stats_delta(q, answer, result.percent_error, result.is_correct, seconds);
+    update_stats(&m->stats, &delta);
+    statswriter_record(&delta);
+    metrics_answer(q->category, result.is_correct, monotonic_seconds() - answered);
+
+    begin_record(m, "result");
+    put_long(m, "number", m->questions_asked);
+    put_bool(m, "correct", result.is_correct);
+    put_fixed(m, "answer", q->correct_answer);
+    put_fixed(m, "tolerance", q->tolerance);
+    put_fixed(m, "error", result.percent_error);
+    put_fixed(m, "seconds", seconds);
+    end_record(m);
+}
+
+/* ========== Requests ========== */
+
+/* Trim and lowercase a request in place */
+static char *normalize(char *line) {
+    while (*line == ' ' || *line == '\t') {
+        line++;
+    }
+    size_t len = strlen(line);
+    while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t')) {
+        line[--len] = '\0';
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (line[i] >= 'A' && line[i] <= 'Z') {
+            line[i] = (char)(line[i] + ('a' - 'A'));
+        }
+    }
+    return line;
+}
+
+/* Handle one request; false once the program should end */
+static bool handle_request(machine_t *m, char *line) {
+    if (strcmp(line, "quit") == 0 || strcmp(line, "exit") == 0) {
+        if (!m->in_session) {
+            return false;
+        }
+        end_session(m);
+        return true;
+    }
+
+    if (!m->in_session) {
+        category_selection_t selection;
+        if (parse_category_input(line, &selection)) {
+            start_session(m, &selection);
+        } else {
+            error_record(m, "expected categories (a-d, or all) or quit");
+        }
+        return true;
+    }
+
+    if (strcmp(line, "skip") == 0) {
+        begin_record(m, "skip");
+        put_long(m, "number", m->questions_asked);
+        end_record(m);
+        ask_question(m);
+    } else if (is_valid_number(line) && isfinite(strtof(line, NULL))) {
+        answer_question(m, strtof(line, NULL));
+        ask_question(m);
+    } else {
+        error_record(m, "expected a number, skip or quit");
+    }
+    return true;
+}
+
+/* ========== Public API ========== */
+
+int machine_main(input_t *in, machine_format_t format) {
+    static machine_t m;                 // persistent_stats_t is too big for the stack
+    char line[MACHINE_LINE_SIZE];
+
+    m.format = format;
+    if (outbuf_init(&m.out, STDOUT_FILENO, MACHINE_OUTBUF_SIZE) != 0) {
+        return 1;
+    }
+
+    for (;;) {
+        // Reply to everything read so far before waiting for more
+        if (!input_pending(in) && outbuf_flush(&m.out) != 0) {
+            break;
+        }
+        long len = input_line(in, line, sizeof(line));
+        if (len == INPUT_END) {
+            break;
+        }
+        if (len == INPUT_TOO_LONG) {
+            error_record(&m, "request too long");
+            continue;
+        }
+        if (!handle_request(&m, normalize(line))) {
+            break;
+        }
+    }
+
+    if (m.in_session) {
+        end_session(&m);
+    }
+    int status = outbuf_flush(&m.out) == 0 ? 0 : 1;
+    outbuf_free(&m.out);
+    return status;
+}
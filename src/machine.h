@@ -0,0 +1,58 @@
+/*
+ * machine.h - Machine Protocol
+ *
+ * A compact line protocol for driving practice sessions from scripts,
+ * used instead of the menus when neither standard input nor standard
+ * output is a terminal (or with --machine). Every request is one line
+ * and every reply is one record, either NDJSON or tab-separated; there
+ * are no banners, prompts or help text.
+ *
+ * Requests:
+ *
+ *   CATEGORIES   start a session, e.g. "a", "bd" or "all"
+ *   NUMBER       answer the question waiting in the session
+ *   skip         skip it
+ *   quit         end the session (or, outside one, the program)
+ *
+ * Records, shown as NDJSON; the TSV form has the same fields in the
+ * same order, led by the type and with booleans as 1/0:
+ *
+ *   {"type":"question","number":1,"category":"distance","conversion":2,
+ *    "from":"in","to":"cm","value":12.00}
+ *   {"type":"result","number":1,"correct":true,"answer":30.48,
+ *    "tolerance":0.61,"error":0.07,"seconds":0.01}
+ *   {"type":"skip","number":2}
+ *   {"type":"summary","answered":1,"correct":1,"error_median":0.07,
+ *    "error_p90":0.07}            (the errors only if any were answered)
+ *   {"type":"error","message":"..."}
+ *
+ * Starting a session, and answering or skipping a question, is replied
+ * to with the next question; a result or skip record comes before it.
+ * Ending a session, or the input, is replied to with a summary. Invalid
+ * requests get an error record and change nothing.
+ *
+ * Replies are written with one write(2) per batch of requests already
+ * read, so a driver that pipelines its requests costs one system call
+ * per batch on both sides.
+ */
+
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include "input.h"
+
+typedef enum {
+    MACHINE_JSON,
+    MACHINE_TSV
+} machine_format_t;
+
+/**
+ * Serve the machine protocol on standard output until the input ends or
+ * asks to quit
+ * @param in Input to read requests from
+ * @param format Record format
+ * @return Process exit status
+ */
+int machine_main(input_t *in, machine_format_t format);
+
+#endif
@@ -7,64 +7,148 @@
  *
  */
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "input.h"
 #include "questions.h"
-
-#define MAX_INPUT_LENGTH 32
+#include "tables.h"
+#include "worksheet.h"
+#include "simulate.h"
+#include "userstore.h"
+#include "statswriter.h"
+#include "progress.h"
+#include "history.h"
+#include "merge.h"
+#include "export.h"
+#include "dashboard.h"
+#include "leaderboard.h"
+#include "machine.h"
+#include "metrics.h"
+#include "server.h"
+
+#define MAX_INPUT_LENGTH 96
+#define TERMINAL_BUFFER_SIZE (1 << 16)
 
 /* ========== Global Variables ========== */
 bool g_whole_numbers_mode = false;  // Global flag for whole numbers only
 bool g_easy_mode = false;           // Global flag for easy mode (increments of 5)
+const char *g_user_name = NULL;     // Per-user stats in the user store when set
+
+/* ========== Terminal Output ========== */
+/* stdout is fully buffered here and flushed only before the program
+ * waits for input (see input_t.prompt), so each question, menu or
+ * report reaches the terminal in a single write */
+static char terminal_buffer[TERMINAL_BUFFER_SIZE];
+
+/* The menu's help page, written with one call */
+static const char help_text[] =
+    "\nMetric Trainer - Complete Help Guide\n"
+    "═══════════════════════════════════════════════════════════\n"
+    "\nCATEGORY SELECTION\n"
+    "──────────────────\n"
+    "Choose conversion categories for practice:\n"
+    "  a = Distance     (miles <-> km, feet <-> m, inches <-> cm)\n"
+    "  b = Weight       (pounds <-> kg, ounces <-> grams)\n"
+    "  c = Temperature  (Celsius <-> Fahrenheit)\n"
+    "  d = Volume       (gallons <-> liters, cups <-> ml, fl oz conversions)\n"
+    "\nINPUT OPTIONS\n"
+    "─────────────\n"
+    "  • Single category:     'a', 'b', 'c', or 'd'\n"
+    "  • Multiple categories: 'ac', 'bd', 'abc'\n"
+    "  • All categories:      'all' or 'abcd'\n"
+    "  • Get this help:       'help', 'h', or '?'\n"
+    "  • View statistics:     'stats'\n"
+    "  • Query past answers:  'history [options]', e.g.\n"
+    "                         'history --since 2024-01-01 --by day'\n"
+    "  • View formulas:       'reference'\n"
+    "  • Exit program:        'quit' or 'exit'\n"
+    "\nPRACTICE SESSION\n"
+    "────────────────\n"
+    "Practice sessions continue until you type 'quit' or 'exit'."
+    "\nDuring practice:\n"
+    "  • Enter numbers (decimals OK): 5.2, 100, 42\n"
+    "  • Skip difficult questions:    'skip'\n"
+    "  • End session early:           'quit' or 'exit'\n"
+    "\nEXAMPLES\n"
+    "────────\n"
+    "  'a'    → Practice distance conversions only\n"
+    "  'cd'   → Practice temperature and volume together\n"
+    "  'all'  → Practice all conversion types\n"
+    "\n═══════════════════════════════════════════════════════════\n"
+    "Ready to start? Enter your category choice above!\n\n";
+
+/* Shown after a menu choice that is not understood */
+static const char quick_reference_text[] =
+    "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n"
+    "Quick Reference:\n"
+    "  Single categories: 'a', 'b', 'c', 'd'\n"
+    "  Multiple categories: 'ac', 'bd', 'abc'\n"
+    "  All categories: 'all'\n"
+    "  Get help: 'help' or '?'\n"
+    "  Exit program: 'quit' or 'exit'\n"
+    "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n"
+    "Tip: Try 'help' for detailed explanations\n\n";
+
+/* Rules around each question and its feedback */
+static const char question_rule[] = "═══════════════════════════════════════\n";
+static const char feedback_rule[] = "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n\n";
+
+/* The practice session's instructions */
+static const char session_intro_text[] =
+    "Practice Session Started!\n"
+    "─────────────────────────\n"
+    "• Enter a number to answer questions\n"
+    "• Type 'skip' to skip a question\n"
+    "• Type 'quit' or 'exit' to return to main menu\n\n";
 
 /* ========== Function Prototypes ========== */
-void run_practice_session(const category_selection_t *selection);
+void run_practice_session(const category_selection_t *selection, input_t *in);
+void run_history_command(char *line);
+
+/* ========== Subcommands ========== */
+/* Non-interactive modes, selected by the first command line argument */
+typedef struct {
+    const char *name;
+    int (*run)(int argc, char *argv[]);
+} command_t;
+
+static const command_t commands[] = {
+    { "worksheet", worksheet_main },
+    { "simulate",  simulate_main },
+    { "progress",  progress_main },
+    { "history",   history_main },
+    { "merge",     merge_main },
+    { "export",    export_main },
+    { "leaderboard", leaderboard_main },
+    { "serve",     server_main },
+};
 
 /**
  * Display the main menu with category options and usage instructions
  */
 void show_menu(void) {
-    printf("\n");
-    printf("Metric Trainer - Metric Conversion Practice\n");
-    printf("==========================================\n\n");
-    printf("Select categories:\n");
-    printf("  a) Distance     (miles <-> km, feet <-> m, inches <-> cm)\n");
-    printf("  b) Weight       (pounds <-> kg, ounces <-> grams)\n");
-    printf("  c) Temperature  (Celsius <-> Fahrenheit)\n");
-    printf("  d) Volume       (gallons <-> liters, cups <-> ml, fl oz conversions)\n");
-    printf("  all) All categories\n\n");
-    printf("Enter choice (e.g., \"b\", \"all\", \"ac\", or \"help\"): ");
-    fflush(stdout);
+    fputs(menu_text, stdout);
 }
 
 /**
- * Get user input from stdin with length validation and error handling
- * @return Pointer to static input buffer, or NULL on error/EOF
+ * Read a line of user input with length validation and error handling
+ * @param in Input to read from
+ * @param input Caller's buffer for the line
+ * @param size Its size
+ * @return input, or NULL on error/EOF
  */
-char* get_user_input(void) {
-    static char input[MAX_INPUT_LENGTH];
-
-    if (fgets(input, sizeof(input), stdin) != NULL) {
-        // Remove newline if present
-        size_t len = strlen(input);
-        if (len > 0 && input[len - 1] == '\n') {
-            input[len - 1] = '\0';
-        }
-
-        // Handle input that was too long (no newline found and buffer full)
-        if (len == MAX_INPUT_LENGTH - 1 && input[len - 1] != '\0') {
-            // Clear the rest of the input line
-            int c;
-            while ((c = getchar()) != '\n' && c != EOF);
-            printf("Input too long (max %d characters).\n", MAX_INPUT_LENGTH - 1);
-            printf("Try shorter commands like 'a', 'help', or 'all'\n");
-            return NULL;
-        }
-
-        return input;
+char* get_user_input(input_t *in, char *input, size_t size) {
+    long len = input_line(in, input, size);
+    if (len == INPUT_TOO_LONG) {
+        printf("Input too long (max %d characters).\n", (int)size - 1);
+        printf("Try shorter commands like 'a', 'help', or 'all'\n");
+        return NULL;
     }
-    return NULL;
+    return len >= 0 ? input : NULL;
 }
 
 /**
@@ -94,20 +178,19 @@ void trim_whitespace(char *str) {
 /**
  * Run the main practice session with question generation and user interaction
  * @param selection Pointer to active category selection for question generation
+ * @param in Input to read answers from
  */
-void run_practice_session(const category_selection_t *selection) {
+void run_practice_session(const category_selection_t *selection, input_t *in) {
     session_stats_t stats = {0}; // Initialize statistics
     persistent_stats_t persistent_stats;
     load_persistent_stats(&persistent_stats);
+    statswriter_start(&persistent_stats, STATSWRITER_DEFAULT_INTERVAL_MS);
+    metrics_session_started();
     float user_answer;
     bool continue_session = true;
     int questions_asked = 0;
 
-    printf("Practice Session Started!\n");
-    printf("─────────────────────────\n");
-    printf("• Enter a number to answer questions\n");
-    printf("• Type 'skip' to skip a question\n");
-    printf("• Type 'quit' or 'exit' to return to main menu\n\n");
+    fputs(session_intro_text, stdout);
 
     while (continue_session) {
         // Generate a new question
@@ -121,44 +204,73 @@ void run_practice_session(const category_selection_t *selection) {
 
         // Display the question with improved formatting
         questions_asked++;
+        metrics_question(question.category);
         printf("\n[Question %d] %s\n", questions_asked, question.question_text);
-        printf("═══════════════════════════════════════\n");
+        fputs(question_rule, stdout);
+
+        // Get user's answer, timing how long it takes
+        struct timespec asked, answered;
+        clock_gettime(CLOCK_MONOTONIC, &asked);
+        int answer_result = get_numeric_answer(in, &user_answer);
+        clock_gettime(CLOCK_MONOTONIC, &answered);
+        float response_seconds = (float)(answered.tv_sec - asked.tv_sec) +
+                                 (float)(answered.tv_nsec - asked.tv_nsec) / 1e9f;
 
-        // Get user's answer
-        int answer_result = get_numeric_answer(&user_answer);
         if (answer_result == 1) {
             // Valid number entered - check the answer and provide feedback
+            struct timespec graded;
             answer_result_t answer_check = check_answer(&question, user_answer);
+            stats_delta_t delta = make_stats_delta(&question, user_answer, answer_check.percent_error,
+                                                   answer_check.is_correct, response_seconds);
 
             // Update session statistics
-            update_stats(&stats, &question, answer_check.is_correct);
+            update_stats(&stats, &delta);
 
-            // Update persistent statistics
-            update_persistent_stats(&persistent_stats, &question, answer_check.percent_error, answer_check.is_correct);
+            // Queue the answer for the background stats writer
+            statswriter_record(&delta);
+            clock_gettime(CLOCK_MONOTONIC, &graded);
+            metrics_answer(question.category, answer_check.is_correct,
+                           (double)(graded.tv_sec - answered.tv_sec) +
+                           (double)(graded.tv_nsec - answered.tv_nsec) / 1e9);
 
-            printf("━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n\n");
+            fputs(feedback_rule, stdout);
         } else if (answer_result == -1) {
             // User wants to quit/exit - end the session
             continue_session = false;
-            printf("━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n\n");
+            fputs(feedback_rule, stdout);
         } else {
             // Skip, empty input, or other cases - continue with next question
             // get_numeric_answer() already handled the appropriate messages
-            if (feof(stdin)) {
+            if (input_at_end(in)) {
                 printf("\nSession ended.\n");
                 continue_session = false;
             }
-            printf("━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n\n");
+            fputs(feedback_rule, stdout);
         }
     }
 
-    // Save persistent statistics
-    save_persistent_stats(&persistent_stats);
+    // Save whatever the writer has not saved yet
+    statswriter_stop(NULL);
+    metrics_session_ended();
 
     // Print session summary
     print_session_summary(&stats);
 }
 
+/**
+ * Run a 'history ...' line typed at the menu as the history subcommand
+ * @param line The input line, split in place on spaces
+ */
+void run_history_command(char *line) {
+    char *argv[16];
+    int argc = 0;
+
+    for (char *token = strtok(line, " "); token != NULL && argc < 16; token = strtok(NULL, " ")) {
+        argv[argc++] = token;
+    }
+    history_main(argc, argv);
+}
+
 /**
  * Display command line help information
  */
@@ -166,12 +278,41 @@ void show_command_help(void) {
     printf("Metric Trainer - Interactive Metric Conversion Practice\n");
     printf("======================================================\n\n");
     printf("USAGE:\n");
-    printf("  metric-trainer [OPTIONS]\n\n");
+    printf("  metric-trainer [OPTIONS]\n");
+    printf("  metric-trainer COMMAND [ARGS]\n\n");
+    printf("COMMANDS:\n");
+    printf("  worksheet      Write a worksheet and answer key (see 'worksheet --help')\n");
+    printf("  simulate       Compare question-selection strategies on virtual learners\n");
+    printf("  progress       Show weekly or daily trends (see 'progress --help')\n");
+    printf("  history        Query the answer log (see 'history --help')\n");
+    printf("  merge          Combine statistics from many machines (see 'merge --help')\n");
+    printf("  export         Export the answer log for analysis (see 'export --help')\n");
+    printf("  leaderboard    Rank the users of the user store (see 'leaderboard --help')\n");
+    printf("  serve          Serve practice sessions as a JSON API (see 'serve --help')\n\n");
     printf("OPTIONS:\n");
     printf("  -h, --help     Show this help message and exit\n");
     printf("  -v, --version  Show version information and exit\n");
     printf("  -w, --whole    Use whole numbers only (easier practice)\n");
-    printf("  -e, --easy     Use simple numbers only: 1, 5, 10, 15, 20... (easiest)\n\n");
+    printf("  -e, --easy     Use simple numbers only: 1, 5, 10, 15, 20... (easiest)\n");
+    printf("  -s, --seed N   Seed the question generator for a repeatable session\n");
+    printf("  -u, --user N   Keep lifetime statistics for user N in the shared\n");
+    printf("                 user store (%s)\n", USER_STORE_FILE);
+    printf("  --metrics-port P\n");
+    printf("                 Serve Prometheus metrics at http://127.0.0.1:P/metrics\n");
+    printf("  --machine      Drive sessions with a line protocol instead of menus (the\n");
+    printf("                 default when stdin and stdout are not terminals; see below)\n");
+    printf("  --machine-format F\n");
+    printf("                 Protocol records as json (NDJSON, the default) or tsv\n");
+    printf("  --human        Show the menus even when not on a terminal\n");
+    printf("  -d, --dashboard\n");
+    printf("                 Practice on a full-screen live dashboard\n\n");
+    printf("MACHINE PROTOCOL:\n");
+    printf("  One request per line: categories (e.g. ab or all) start a session, then a\n");
+    printf("  number answers the waiting question, 'skip' skips it and 'quit' ends the\n");
+    printf("  session (outside one, the program). Each reply is one record per line, of\n");
+    printf("  type question, result, skip, summary or error; TSV records hold the same\n");
+    printf("  fields as the JSON ones, in order, led by the type. See the README for\n");
+    printf("  every field.\n\n");
     printf("DESCRIPTION:\n");
     printf("  Interactive terminal-based program for practicing metric conversions.\n");
     printf("  Supports distance, weight, temperature, and volume conversions with\n");
@@ -180,7 +321,16 @@ void show_command_help(void) {
     printf("  metric-trainer          # Start interactive mode\n");
     printf("  metric-trainer --help   # Show this help\n");
     printf("  metric-trainer --whole  # Practice with whole numbers only\n");
-    printf("  metric-trainer --easy   # Practice with simple numbers only\n\n");
+    printf("  metric-trainer --easy   # Practice with simple numbers only\n");
+    printf("  metric-trainer --user alice  # Track statistics for alice\n");
+    printf("  metric-trainer --dashboard   # Practice with live charts\n");
+    printf("  printf 'a\\n12\\nquit\\n' | metric-trainer --machine-format tsv\n");
+    printf("  metric-trainer worksheet -n 50 --categories ab --seed 7\n");
+    printf("  metric-trainer history --since 2024-01-01 --by conversion --incorrect\n");
+    printf("  metric-trainer merge lab-machines/ -o fleet_stats\n");
+    printf("  metric-trainer export -o history.mtc\n");
+    printf("  metric-trainer leaderboard --by streak -c temperature -u alice\n");
+    printf("  metric-trainer serve --port 8080\n\n");
     printf("For detailed usage instructions, run the program and type 'help'.\n");
 }
 
@@ -200,6 +350,22 @@ void show_version(void) {
  * @return Exit status (0 for successful completion)
  */
 int main(int argc, char *argv[]) {
+    uint64_t seed = 0;
+    bool seeded = false;
+    int metrics_port = 0;
+    bool dashboard = false;
+    int machine = -1;                   // -1: decide from whether we are on a terminal
+    machine_format_t machine_format = MACHINE_JSON;
+
+    // Dispatch subcommands
+    if (argc > 1) {
+        for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+            if (strcmp(argv[1], commands[i].name) == 0) {
+                return commands[i].run(argc - 1, argv + 1);
+            }
+        }
+    }
+
     // Handle command line arguments
     if (argc > 1) {
         for (int i = 1; i < argc; i++) {
@@ -214,6 +380,43 @@ int main(int argc, char *argv[]) {
             } else if (strcmp(argv[i], "-e") == 0 || strcmp(argv[i], "--easy") == 0) {
                 g_easy_mode = true;
                 g_whole_numbers_mode = true;  // Easy mode implies whole numbers
+            } else if ((strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--seed") == 0) && i + 1 < argc) {
+                if (!parse_seed(argv[++i], &seed)) {
+                    printf("Invalid seed: %s (use a whole number)\n", argv[i]);
+                    return 1;
+                }
+                seeded = true;
+            } else if ((strcmp(argv[i], "-u") == 0 || strcmp(argv[i], "--user") == 0) && i + 1 < argc) {
+                g_user_name = argv[++i];
+                if (!userstore_valid_name(g_user_name)) {
+                    printf("Invalid user name: %s\n", g_user_name);
+                    printf("Use 1-%d letters, digits, '.', '_' or '-'.\n", USER_NAME_MAX);
+                    return 1;
+                }
+            } else if (strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc) {
+                long port;
+                if (!parse_whole_number(argv[++i], 1, 65535, &port)) {
+                    printf("Invalid metrics port: %s (use 1 to 65535)\n", argv[i]);
+                    return 1;
+                }
+                metrics_port = (int)port;
+            } else if (strcmp(argv[i], "--machine") == 0) {
+                machine = 1;
+            } else if (strcmp(argv[i], "--machine-format") == 0 && i + 1 < argc) {
+                const char *value = argv[++i];
+                if (strcmp(value, "json") == 0) {
+                    machine_format = MACHINE_JSON;
+                } else if (strcmp(value, "tsv") == 0) {
+                    machine_format = MACHINE_TSV;
+                } else {
+                    printf("Invalid machine format: %s (use json or tsv)\n", value);
+                    return 1;
+                }
+                machine = 1;
+            } else if (strcmp(argv[i], "--human") == 0) {
+                machine = 0;
+            } else if (strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "--dashboard") == 0) {
+                dashboard = true;
             } else {
                 printf("Unknown option: %s\n", argv[i]);
                 printf("Try 'metric-trainer --help' for more information.\n");
@@ -222,10 +425,36 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    char input_block[INPUT_BLOCK_SIZE];
+    char line[MAX_INPUT_LENGTH];
     char *user_input;
+    input_t in;
+    input_init(&in, STDIN_FILENO, input_block, sizeof(input_block));
+    in.prompt = stdout;
+    setvbuf(stdout, terminal_buffer, _IOFBF, sizeof(terminal_buffer));
 
     // Initialize random number generator
-    init_random_seed();
+    if (seeded) {
+        rng_seed(rng_default(), seed);
+    } else {
+        init_random_seed();
+    }
+
+    if (metrics_port != 0 && metrics_serve(metrics_port) != 0) {
+        fprintf(stderr, "Cannot serve metrics on port %d: %s\n", metrics_port, strerror(errno));
+        return 1;
+    }
+    if (dashboard) {
+        return dashboard_main();
+    }
+
+    // Scripts and pipes get the line protocol, people get the menus
+    if (machine < 0) {
+        machine = !isatty(STDIN_FILENO) && !isatty(STDOUT_FILENO);
+    }
+    if (machine) {
+        return machine_main(&in, machine_format);
+    }
 
     printf("Welcome to Metric Trainer!\n");
     if (g_easy_mode) {
@@ -233,15 +462,21 @@ int main(int argc, char *argv[]) {
     } else if (g_whole_numbers_mode) {
         printf("Whole Numbers Mode: Questions will use only whole numbers\n");
     }
+    if (g_user_name != NULL) {
+        printf("Statistics are kept for user: %s\n", g_user_name);
+    }
+    if (metrics_port != 0) {
+        printf("Metrics at http://127.0.0.1:%d/metrics\n", metrics_port);
+    }
 
     while (1) {
         show_menu();
 
-        user_input = get_user_input();
+        user_input = get_user_input(&in, line, sizeof(line));
         if (user_input == NULL) {
             // get_user_input() already printed error message if needed
             // For EOF, exit gracefully
-            if (feof(stdin)) {
+            if (input_at_end(&in)) {
                 printf("\nGoodbye!\n");
                 break;
             }
@@ -252,8 +487,9 @@ int main(int argc, char *argv[]) {
 
         trim_whitespace(user_input);
 
-        // Convert to lowercase for easier comparison
-        for (int i = 0; user_input[i]; i++) {
+        // Lowercase the command word for easier comparison; arguments such
+        // as 'history --user Alice' keep their case
+        for (int i = 0; user_input[i] && user_input[i] != ' '; i++) {
             if (user_input[i] >= 'A' && user_input[i] <= 'Z') {
                 user_input[i] = user_input[i] + ('a' - 'A');
             }
@@ -264,44 +500,7 @@ int main(int argc, char *argv[]) {
             printf("Goodbye!\n");
             break;
         } else if (strcmp(user_input, "help") == 0 || strcmp(user_input, "h") == 0 || strcmp(user_input, "?") == 0) {
-            printf("\nMetric Trainer - Complete Help Guide\n");
-            printf("═══════════════════════════════════════════════════════════\n");
-
-            printf("\nCATEGORY SELECTION\n");
-            printf("──────────────────\n");
-            printf("Choose conversion categories for practice:\n");
-            printf("  a = Distance     (miles <-> km, feet <-> m, inches <-> cm)\n");
-            printf("  b = Weight       (pounds <-> kg, ounces <-> grams)\n");
-            printf("  c = Temperature  (Celsius <-> Fahrenheit)\n");
-            printf("  d = Volume       (gallons <-> liters, cups <-> ml, fl oz conversions)\n");
-
-            printf("\nINPUT OPTIONS\n");
-            printf("─────────────\n");
-            printf("  • Single category:     'a', 'b', 'c', or 'd'\n");
-            printf("  • Multiple categories: 'ac', 'bd', 'abc'\n");
-            printf("  • All categories:      'all' or 'abcd'\n");
-            printf("  • Get this help:       'help', 'h', or '?'\n");
-            printf("  • View statistics:     'stats'\n");
-            printf("  • View formulas:       'reference'\n");
-            printf("  • Exit program:        'quit' or 'exit'\n");
-
-            printf("\nPRACTICE SESSION\n");
-            printf("────────────────\n");
-            printf("Practice sessions continue until you type 'quit' or 'exit'.");
-
-            printf("\nDuring practice:\n");
-            printf("  • Enter numbers (decimals OK): 5.2, 100, 42\n");
-            printf("  • Skip difficult questions:    'skip'\n");
-            printf("  • End session early:           'quit' or 'exit'\n");
-
-            printf("\nEXAMPLES\n");
-            printf("────────\n");
-            printf("  'a'    → Practice distance conversions only\n");
-            printf("  'cd'   → Practice temperature and volume together\n");
-            printf("  'all'  → Practice all conversion types\n");
-
-            printf("\n═══════════════════════════════════════════════════════════\n");
-            printf("Ready to start? Enter your category choice above!\n\n");
+            fputs(help_text, stdout);
             continue;
         } else if (strcmp(user_input, "stats") == 0) {
             show_persistent_stats();
@@ -309,6 +508,10 @@ int main(int argc, char *argv[]) {
         } else if (strcmp(user_input, "reference") == 0) {
             show_conversion_reference();
             continue;
+        } else if (strncmp(user_input, "history", 7) == 0 &&
+                   (user_input[7] == '\0' || user_input[7] == ' ')) {
+            run_history_command(user_input);
+            continue;
         }
 
         // Try to parse the category selection
@@ -316,34 +519,19 @@ int main(int argc, char *argv[]) {
         if (parse_category_input(user_input, &selection)) {
             printf("Selected categories:\n");
 
-            if (selection.active[CATEGORY_DISTANCE]) {
-                printf("  Distance (miles <-> km, feet <-> m, inches <-> cm)\n");
-            }
-            if (selection.active[CATEGORY_WEIGHT]) {
-                printf("  Weight (pounds <-> kg, ounces <-> grams)\n");
-            }
-            if (selection.active[CATEGORY_TEMPERATURE]) {
-                printf("  Temperature (Celsius <-> Fahrenheit)\n");
-            }
-            if (selection.active[CATEGORY_VOLUME]) {
-                printf("  Volume (gallons <-> liters, cups <-> ml, fl oz conversions)\n");
+            for (int i = 0; i < CATEGORY_COUNT; i++) {
+                if (selection.active[i]) {
+                    printf("  %s %s\n", category_names[i], category_descs[i]);
+                }
             }
 
             printf("\nTotal: %d categories selected\n", selection.num_active);
             printf("Starting practice session...\n\n");
-            run_practice_session(&selection);
+            run_practice_session(&selection, &in);
             // Session ended - continue to show menu again
         } else {
             printf("\nInvalid input: '%s'\n", user_input);
-            printf("━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n");
-            printf("Quick Reference:\n");
-            printf("  Single categories: 'a', 'b', 'c', 'd'\n");
-            printf("  Multiple categories: 'ac', 'bd', 'abc'\n");
-            printf("  All categories: 'all'\n");
-            printf("  Get help: 'help' or '?'\n");
-            printf("  Exit program: 'quit' or 'exit'\n");
-            printf("━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n");
-            printf("Tip: Try 'help' for detailed explanations\n\n");
+            fputs(quick_reference_text, stdout);
         }
     }
 
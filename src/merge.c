@@ -0,0 +1,590 @@
+/*
+ * merge.c - Fleet Statistics Merge
+ *
+ * The inputs are walked and sorted up front, then cut into fixed chunks
+ * of files. Each chunk is one parallel_for task that loads its files into
+ * its own partial sums, and the partials are added up in chunk order
+ * afterwards - no locks while loading, and the same totals (down to the
+ * float error sums) whatever the thread count.
+ *
+ * Each file is recognized by its magic: stats files (including the legacy
+ * raw format), user stores (every user is counted) and answer logs. An
+ * answer log repeats answers already counted in its machine's stats, so
+ * it contributes only activity figures, read from its index.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "answerlog.h"
+#include "merge.h"
+#include "parallel.h"
+#include "persist.h"
+#include "questions.h"
+#include "tables.h"
+#include "userstore.h"
+
+#define CHUNK_FILES 64
+#define MAX_DEPTH 16
+#define MAX_LISTED_FAILURES 10
+#define ACTIVE_DAYS 7
+
+typedef enum {
+    FILE_SKIPPED,               // Another trainer file, e.g. progress rollups
+    FILE_STATS,
+    FILE_USER_STORE,
+    FILE_ANSWER_LOG,
+    FILE_UNREADABLE
+} merge_file_kind_t;
+
+typedef struct {
+    const char *output;
+    int threads;
+    bool worker_stats;          // Print each worker's utilization
+    int worst;
+    int min_answers;
+} merge_options_t;
+
+typedef struct {
+    char **paths;
+    size_t count;
+    size_t capacity;
+} path_list_t;
+
+/* Sums over some files; 64-bit so a fleet cannot overflow them */
+typedef struct {
+    uint64_t answers[CATEGORY_COUNT];
+    uint64_t correct[CATEGORY_COUNT];
+    double error_sum[CATEGORY_COUNT];
+    uint64_t conversion_answers[CONVERSION_COUNT];
+    uint64_t conversion_correct[CONVERSION_COUNT];
+    sketch_t error_sketch[CONVERSION_COUNT];
+    sketch_t seconds_sketch[CONVERSION_COUNT];
+
+    int files[FILE_UNREADABLE + 1];
+    uint64_t users;
+    uint64_t logged_answers;
+    uint32_t first_answer;
+    uint32_t last_answer;
+    uint64_t active_logs;
+} merge_partial_t;
+
+typedef struct {
+    const path_list_t *inputs;
+    merge_partial_t *partials;  // One per chunk
+    unsigned char *kinds;       // merge_file_kind_t per input
+    uint32_t active_since;
+} merge_job_t;
+
+static void show_merge_help(void) {
+    printf("USAGE:\n");
+    printf("  metric-trainer merge [OPTIONS] DIR|FILE...\n\n");
+    printf("Directories are searched recursively for statistics files, user stores\n");
+    printf("and answer logs. Answer logs add activity figures only, since their\n");
+    printf("answers are already in the statistics of the machine they came from.\n\n");
+    printf("OPTIONS:\n");
+    printf("  -o, --output FILE      Also write the merged statistics as a stats file\n");
+    printf("  -j, --threads N        Worker threads (default: all CPUs)\n");
+    printf("  --cpus LIST            Pin worker threads to these CPUs, e.g. 0-3,8\n");
+    printf("  --worker-stats         Report each worker's utilization\n");
+    printf("  -n, --worst N          Number of weakest conversions to list (default: 5)\n");
+    printf("  --min-answers N        Answers a conversion needs to be ranked (default: 20)\n");
+}
+
+/* ========== Inputs ========== */
+
+static int add_path(path_list_t *list, const char *path) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity > 0 ? list->capacity * 2 : 256;
+        char **paths = realloc(list->paths, capacity * sizeof(*paths));
+        if (paths == NULL) {
+            return -1;
+        }
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+    if ((list->paths[list->count] = strdup(path)) == NULL) {
+        return -1;
+    }
+    list->count++;
+    return 0;
+}
+
+static bool has_suffix(const char *name, const char *suffix) {
+    size_t len = strlen(name);
+    size_t suffix_len = strlen(suffix);
+    return len >= suffix_len && strcmp(name + len - suffix_len, suffix) == 0;
+}
+
+/* Adds a file, or every file under a directory; -1 on a path that cannot be read */
+static int collect_inputs(const char *path, path_list_t *list, int depth) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "merge: cannot read %s\n", path);
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return S_ISREG(st.st_mode) ? add_path(list, path) : 0;
+    }
+    if (depth >= MAX_DEPTH) {
+        return 0;
+    }
+
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        fprintf(stderr, "merge: cannot read %s\n", path);
+        return -1;
+    }
+    int result = 0;
+    struct dirent *entry;
+    while (result == 0 && (entry = readdir(dir)) != NULL) {
+        const char *name = entry->d_name;
+        char child[PATH_MAX];
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 ||
+            has_suffix(name, ANSWERLOG_INDEX_SUFFIX) || has_suffix(name, ".tmp")) {
+            continue;  // Indexes are read with their log; temp files are half-written saves
+        }
+        if (snprintf(child, sizeof(child), "%s/%s", path, name) >= (int)sizeof(child)) {
+            continue;
+        }
+        result = collect_inputs(child, list, depth + 1);
+    }
+    closedir(dir);
+    return result;
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* ========== Loading ========== */
+
+static void add_stats(merge_partial_t *partial, const persistent_stats_t *stats) {
+    for (int c = 0; c < CATEGORY_COUNT; c++) {
+        partial->answers[c] += (uint32_t)stats->total_questions[c];
+        partial->correct[c] += (uint32_t)stats->correct_answers[c];
+        partial->error_sum[c] += stats->total_error[c];
+    }
+    for (int id = 0; id < CONVERSION_COUNT; id++) {
+        const conversion_stats_t *conversion = &stats->conversions[id];
+        partial->conversion_answers[id] += (uint32_t)conversion->total;
+        partial->conversion_correct[id] += (uint32_t)conversion->correct;
+        sketch_merge(&partial->error_sketch[id], &conversion->error_sketch);
+        sketch_merge(&partial->seconds_sketch[id], &conversion->seconds_sketch);
+    }
+}
+
+static void add_log(merge_partial_t *partial, const answerlog_block_t *summary, uint32_t active_since) {
+    if (summary->count == 0) {
+        return;
+    }
+    if (partial->logged_answers == 0 || summary->min_time < partial->first_answer) {
+        partial->first_answer = summary->min_time;
+    }
+    if (summary->max_time > partial->last_answer) {
+        partial->last_answer = summary->max_time;
+    }
+    partial->logged_answers += summary->count;
+    partial->active_logs += summary->max_time >= active_since;
+}
+
+static merge_file_kind_t load_file(const char *path, merge_partial_t *partial, uint32_t active_since) {
+    char magic[4] = {0};
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return FILE_UNREADABLE;
+    }
+    ssize_t got = read(fd, magic, sizeof(magic));
+    close(fd);
+
+    if (got == 4 && memcmp(magic, "MTHL", 4) == 0) {
+        answerlog_block_t summary;
+        if (answerlog_summary(path, &summary) != 0) {
+            return FILE_UNREADABLE;
+        }
+        add_log(partial, &summary, active_since);
+        return FILE_ANSWER_LOG;
+    }
+    if (got == 4 && memcmp(magic, "MTUS", 4) == 0) {
+        persistent_stats_t total;
+        int users;
+        if (userstore_sum(path, &total, &users) != 0) {
+            return FILE_UNREADABLE;
+        }
+        add_stats(partial, &total);
+        partial->users += (uint64_t)users;
+        return FILE_USER_STORE;
+    }
+    if (got == 4 && (memcmp(magic, "MTPR", 4) == 0 || memcmp(magic, "MTHI", 4) == 0)) {
+        return FILE_SKIPPED;
+    }
+
+    persistent_stats_t stats;
+    if (persist_load_stats(path, &stats) != 1) {
+        return FILE_UNREADABLE;
+    }
+    add_stats(partial, &stats);
+    return FILE_STATS;
+}
+
+static void merge_chunk(void *context, int task, int worker) {
+    (void)worker;
+    merge_job_t *job = context;
+    merge_partial_t *partial = &job->partials[task];
+    size_t first = (size_t)task * CHUNK_FILES;
+    size_t end = first + CHUNK_FILES < job->inputs->count ? first + CHUNK_FILES : job->inputs->count;
+
+    for (size_t i = first; i < end; i++) {
+        merge_file_kind_t kind = load_file(job->inputs->paths[i], partial, job->active_since);
+        job->kinds[i] = (unsigned char)kind;
+        partial->files[kind]++;
+    }
+}
+
+static void add_partial(merge_partial_t *dst, const merge_partial_t *src) {
+    for (int c = 0; c < CATEGORY_COUNT; c++) {
+        dst->answers[c] += src->answers[c];
+        dst->correct[c] += src->correct[c];
+        dst->error_sum[c] += src->error_sum[c];
+    }
+    for (int id = 0; id < CONVERSION_COUNT; id++) {
+        dst->conversion_answers[id] += src->conversion_answers[id];
+        dst->conversion_correct[id] += src->conversion_correct[id];
+        sketch_merge(&dst->error_sketch[id], &src->error_sketch[id]);
+        sketch_merge(&dst->seconds_sketch[id], &src->seconds_sketch[id]);
+    }
+    for (int k = 0; k <= FILE_UNREADABLE; k++) {
+        dst->files[k] += src->files[k];
+    }
+    dst->users += src->users;
+    if (src->logged_answers > 0) {
+        if (dst->logged_answers == 0 || src->first_answer < dst->first_answer) {
+            dst->first_answer = src->first_answer;
+        }
+        if (src->last_answer > dst->last_answer) {
+            dst->last_answer = src->last_answer;
+        }
+    }
+    dst->logged_answers += src->logged_answers;
+    dst->active_logs += src->active_logs;
+}
+
+/* ========== Output ========== */
+
+/* The merged totals as a stats file; -1 if a count no longer fits */
+static int write_merged(const char *path, const merge_partial_t *total) {
+    persistent_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+
+    for (int c = 0; c < CATEGORY_COUNT; c++) {
+        if (total->answers[c] > INT_MAX) {
+            fprintf(stderr, "merge: too many answers to store in one stats file\n");
+            return -1;
+        }
+        stats.total_questions[c] = (int)total->answers[c];
+        stats.correct_answers[c] = (int)total->correct[c];
+        stats.total_error[c] = (float)total->error_sum[c];
+    }
+    for (int id = 0; id < CONVERSION_COUNT; id++) {
+        stats.conversions[id].total = (int)total->conversion_answers[id];
+        stats.conversions[id].correct = (int)total->conversion_correct[id];
+        stats.conversions[id].error_sketch = total->error_sketch[id];
+        stats.conversions[id].seconds_sketch = total->seconds_sketch[id];
+    }
+
+    if (persist_save_stats(path, &stats) != 0) {
+        fprintf(stderr, "merge: cannot write %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static void print_category_row(const char *label, uint64_t answers, uint64_t correct, double error_sum,
+                                const sketch_t *errors, const sketch_t *seconds) {
+    if (answers == 0) {
+        printf("  %-12s  %10d  %8s  %8s  %8s  %8s  %8s\n", label, 0, "-", "-", "-", "-", "-");
+        return;
+    }
+    printf("  %-12s  %10llu  %7.1f%%  %7.1f%%", label, (unsigned long long)answers,
+           100.0 * (double)correct / (double)answers, error_sum / (double)answers);
+    if (sketch_count(errors) > 0) {
+        printf("  %7.1f%%  %7.1f%%", sketch_quantile(errors, &sketch_percent_scale, 0.5f),
+               sketch_quantile(errors, &sketch_percent_scale, 0.9f));
+    } else {
+        printf("  %8s  %8s", "-", "-");
+    }
+    if (sketch_count(seconds) > 0) {
+        printf("  %7.1fs\n", sketch_quantile(seconds, &sketch_seconds_scale, 0.5f));
+    } else {
+        printf("  %8s\n", "-");
+    }
+}
+
+static void print_categories(const merge_partial_t *total) {
+    sketch_t all_errors = {{0}};
+    sketch_t all_seconds = {{0}};
+    uint64_t answers = 0, correct = 0;
+    double error_sum = 0.0;
+
+    printf("  %-12s  %10s  %8s  %8s  %8s  %8s  %8s\n",
+           "Category", "Answers", "Accuracy", "Avg Err", "Median", "p90", "Med Time");
+    printf("  ───────────────────────────────────────────────────────────────────────\n");
+    for (int c = 0; c < CATEGORY_COUNT; c++) {
+        int count;
+        const unsigned char *ids = get_conversions_for_category((category_t)c, &count);
+        sketch_t errors = {{0}};
+        sketch_t seconds = {{0}};
+        for (int i = 0; i < count; i++) {
+            int id = ids[i];
+            sketch_merge(&errors, &total->error_sketch[id]);
+            sketch_merge(&seconds, &total->seconds_sketch[id]);
+        }
+        print_category_row(category_names[c], total->answers[c], total->correct[c], total->error_sum[c],
+                           &errors, &seconds);
+        sketch_merge(&all_errors, &errors);
+        sketch_merge(&all_seconds, &seconds);
+        answers += total->answers[c];
+        correct += total->correct[c];
+        error_sum += total->error_sum[c];
+    }
+    printf("  ───────────────────────────────────────────────────────────────────────\n");
+    print_category_row("All", answers, correct, error_sum, &all_errors, &all_seconds);
+}
+
+static const merge_partial_t *ranking;  // For compare_accuracy
+
+/* Lowest accuracy first, then more answers first */
+static int compare_accuracy(const void *a, const void *b) {
+    int ia = *(const int *)a;
+    int ib = *(const int *)b;
+    double ra = (double)ranking->conversion_correct[ia] / (double)ranking->conversion_answers[ia];
+    double rb = (double)ranking->conversion_correct[ib] / (double)ranking->conversion_answers[ib];
+    if (ra != rb) {
+        return ra < rb ? -1 : 1;
+    }
+    uint64_t na = ranking->conversion_answers[ia];
+    uint64_t nb = ranking->conversion_answers[ib];
+    return na != nb ? (na > nb ? -1 : 1) : ia - ib;
+}
+
+static void print_worst(const merge_partial_t *total, const merge_options_t *opts) {
+    int ids[CONVERSION_COUNT];
+    int count = 0;
+    for (int id = 0; id < CONVERSION_COUNT; id++) {
+        if (total->conversion_answers[id] >= (uint64_t)opts->min_answers && total->conversion_answers[id] > 0) {
+            ids[count++] = id;
+        }
+    }
+    if (count == 0 || opts->worst == 0) {
+        return;
+    }
+
+    ranking = total;
+    qsort(ids, (size_t)count, sizeof(int), compare_accuracy);
+    printf("\nWeakest conversions (at least %d answers):\n", opts->min_answers);
+    for (int i = 0; i < count && i < opts->worst; i++) {
+        int id = ids[i];
+        const sketch_t *errors = &total->error_sketch[id];
+        printf("  %d. %s → %s: %.1f%% correct over %llu answers", i + 1,
+               unit_string(conversion_names[id].from_unit), unit_string(conversion_names[id].to_unit),
+               100.0 * (double)total->conversion_correct[id] / (double)total->conversion_answers[id],
+               (unsigned long long)total->conversion_answers[id]);
+        if (sketch_count(errors) > 0) {
+            printf(", median error %.1f%%, p90 %.1f%%", sketch_quantile(errors, &sketch_percent_scale, 0.5f),
+                   sketch_quantile(errors, &sketch_percent_scale, 0.9f));
+        }
+        printf("\n");
+    }
+}
+
+static void format_date(uint32_t when, char *buf, size_t size) {
+    time_t t = (time_t)when;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    strftime(buf, size, "%Y-%m-%d", &tm);
+}
+
+/* ========== Entry Point ========== */
+
+static int parse_merge_options(int argc, char *argv[], merge_options_t *opts, path_list_t *inputs) {
+    memset(opts, 0, sizeof(*opts));
+    opts->threads = parallel_default_threads();
+    opts->worst = 5;
+    opts->min_answers = 20;
+    int named = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            show_merge_help();
+            return 0;
+        } else if (arg[0] != '-') {
+            named++;
+            if (collect_inputs(arg, inputs, 0) != 0) {
+                return -1;
+            }
+            continue;
+        } else if (strcmp(arg, "--worker-stats") == 0) {
+            opts->worker_stats = true;
+            continue;
+        }
+
+        if (value == NULL) {
+            fprintf(stderr, "merge: unknown option or missing value: %s\n", arg);
+            return -1;
+        }
+        i++;
+
+        if (strcmp(arg, "-o") == 0 || strcmp(arg, "--output") == 0) {
+            opts->output = value;
+        } else if (strcmp(arg, "-j") == 0 || strcmp(arg, "--threads") == 0) {
+            long threads;
+            if (!parse_whole_number(value, 1, PARALLEL_MAX_WORKERS, &threads)) {
+                fprintf(stderr, "merge: invalid thread count '%s' (use 1 to %d)\n", value, PARALLEL_MAX_WORKERS);
+                return -1;
+            }
+            opts->threads = (int)threads;
+        } else if (strcmp(arg, "--cpus") == 0) {
+            if (parallel_set_cpus(value) != 0) {
+                fprintf(stderr, "merge: invalid CPU list '%s'\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "-n") == 0 || strcmp(arg, "--worst") == 0) {
+            long worst;
+            if (!parse_whole_number(value, 0, INT_MAX, &worst)) {
+                fprintf(stderr, "merge: invalid --worst '%s' (use 0 or more)\n", value);
+                return -1;
+            }
+            opts->worst = (int)worst;
+        } else if (strcmp(arg, "--min-answers") == 0) {
+            long min_answers;
+            if (!parse_whole_number(value, 0, INT_MAX, &min_answers)) {
+                fprintf(stderr, "merge: invalid --min-answers '%s' (use 0 or more)\n", value);
+                return -1;
+            }
+            opts->min_answers = (int)min_answers;
+        } else {
+            fprintf(stderr, "merge: unknown option: %s\n", arg);
+            return -1;
+        }
+    }
+
+    if (named == 0) {
+        fprintf(stderr, "merge: no input files or directories (see 'merge --help')\n");
+        return -1;
+    }
+    return 1;
+}
+
+static void free_inputs(path_list_t *inputs) {
+    for (size_t i = 0; i < inputs->count; i++) {
+        free(inputs->paths[i]);
+    }
+    free(inputs->paths);
+}
+
+int merge_main(int argc, char *argv[]) {
+    merge_options_t opts;
+    path_list_t inputs = { NULL, 0, 0 };
+    int parsed = parse_merge_options(argc, argv, &opts, &inputs);
+    if (parsed <= 0) {
+        free_inputs(&inputs);
+        return parsed == 0 ? 0 : 1;
+    }
+    if (inputs.count == 0) {
+        fprintf(stderr, "merge: no files found\n");
+        free_inputs(&inputs);
+        return 1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Sorted, so the chunks - and the report - do not depend on readdir order
+    qsort(inputs.paths, inputs.count, sizeof(char *), compare_paths);
+
+    size_t chunks = (inputs.count + CHUNK_FILES - 1) / CHUNK_FILES;
+    merge_job_t job;
+    job.inputs = &inputs;
+    job.partials = calloc(chunks, sizeof(merge_partial_t));
+    job.kinds = calloc(inputs.count, 1);
+    job.active_since = (uint32_t)(time(NULL) - ACTIVE_DAYS * 24 * 3600);
+    merge_partial_t *total = calloc(1, sizeof(merge_partial_t));
+    if (job.partials == NULL || job.kinds == NULL || total == NULL || chunks > INT_MAX) {
+        fprintf(stderr, "merge: out of memory\n");
+        free(job.partials);
+        free(job.kinds);
+        free(total);
+        free_inputs(&inputs);
+        return 1;
+    }
+
+    parallel_for((int)chunks, opts.threads, merge_chunk, &job);
+    for (size_t c = 0; c < chunks; c++) {
+        add_partial(total, &job.partials[c]);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    int listed = 0;
+    for (size_t i = 0; i < inputs.count; i++) {
+        if (job.kinds[i] == FILE_UNREADABLE && listed++ < MAX_LISTED_FAILURES) {
+            fprintf(stderr, "merge: skipped %s (not a readable trainer file)\n", inputs.paths[i]);
+        }
+    }
+
+    printf("\nFleet Statistics\n");
+    printf("══════════════════════════════════════════\n\n");
+    printf("  Merged %d stats file%s, %d user store%s (%llu users) and %d answer log%s\n",
+           total->files[FILE_STATS], total->files[FILE_STATS] == 1 ? "" : "s",
+           total->files[FILE_USER_STORE], total->files[FILE_USER_STORE] == 1 ? "" : "s",
+           (unsigned long long)total->users,
+           total->files[FILE_ANSWER_LOG], total->files[FILE_ANSWER_LOG] == 1 ? "" : "s");
+    if (total->files[FILE_UNREADABLE] > 0) {
+        printf("  Skipped %d unreadable or unrecognized file%s\n", total->files[FILE_UNREADABLE],
+               total->files[FILE_UNREADABLE] == 1 ? "" : "s");
+    }
+    printf("\n");
+
+    print_categories(total);
+    print_worst(total, &opts);
+
+    if (total->logged_answers > 0) {
+        char first[16], last[16];
+        format_date(total->first_answer, first, sizeof(first));
+        format_date(total->last_answer, last, sizeof(last));
+        printf("\nAnswer logs: %llu answers from %s to %s; %llu of %d logs active in the last %d days\n",
+               (unsigned long long)total->logged_answers, first, last,
+               (unsigned long long)total->active_logs, total->files[FILE_ANSWER_LOG], ACTIVE_DAYS);
+    }
+
+    double ms = (double)(end.tv_sec - start.tv_sec) * 1000.0 + (double)(end.tv_nsec - start.tv_nsec) / 1e6;
+    int threads = opts.threads < (int)chunks ? opts.threads : (int)chunks;
+    printf("\n  Read %zu files on %d thread%s in %.1f ms\n", inputs.count, threads, threads == 1 ? "" : "s", ms);
+    if (opts.worker_stats) {
+        parallel_print_stats(stdout);
+    }
+    printf("\n");
+
+    int status = 0;
+    if (opts.output != NULL) {
+        if (write_merged(opts.output, total) == 0) {
+            printf("Merged statistics written to %s\n", opts.output);
+        } else {
+            status = 1;
+        }
+    }
+
+    free(job.partials);
+    free(job.kinds);
+    free(total);
+    free_inputs(&inputs);
+    return status;
+}
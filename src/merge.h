@@ -0,0 +1,21 @@
+/*
+ * merge.h - Fleet Statistics Merge
+ *
+ * Combines the statistics files, user stores and answer logs collected
+ * from many machines into one report - totals, per-category accuracy and
+ * error distributions, the weakest conversions - and optionally one
+ * merged stats file. Files are loaded and reduced in parallel.
+ */
+
+#ifndef MERGE_H
+#define MERGE_H
+
+/**
+ * Entry point for `metric-trainer merge ...`
+ * @param argc Argument count, argv[0] being "merge"
+ * @param argv Argument vector
+ * @return Process exit status
+ */
+int merge_main(int argc, char *argv[]);
+
+#endif
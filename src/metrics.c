@@ -0,0 +1,468 @@
+/*
+ * metrics.c - Operational Metrics
+ *
+ * A shard is one thread's counters. Only its owner writes it, using a
+ * plain load and a relaxed atomic store, so an increment costs no locked
+ * instruction. A scrape reads every shard with relaxed atomic loads. The
+ * shard list is guarded by a mutex that only thread start, thread exit
+ * and scrapes take.
+ *
+ * The HTTP endpoint is deliberately minimal: one connection at a time,
+ * one request per connection, answered and closed. That is all a
+ * Prometheus scraper needs. A client that stalls is dropped after
+ * IO_TIMEOUT_SECONDS, so it cannot hold up the next scrape, and one that
+ * goes away early costs a failed send rather than a SIGPIPE.
+ */
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "metrics.h"
+#include "statswriter.h"
+#include "tables.h"
+
+#define HISTOGRAM_BOUNDS 12
+#define IO_TIMEOUT_SECONDS 2
+#define MAX_REQUEST 4096
+#define METRIC_PREFIX "metric_trainer_"
+
+/* Bucket upper bounds, in nanoseconds and as printed */
+static const uint64_t bound_ns[HISTOGRAM_BOUNDS] = {
+    10000, 25000, 50000, 100000, 250000, 500000,
+    1000000, 2500000, 10000000, 50000000, 250000000, 1000000000
+};
+static const char *const bound_text[HISTOGRAM_BOUNDS] = {
+    "0.00001", "0.000025", "0.00005", "0.0001", "0.00025", "0.0005",
+    "0.001", "0.0025", "0.01", "0.05", "0.25", "1"
+};
+
+typedef struct {
+    uint64_t buckets[HISTOGRAM_BOUNDS + 1];     // Last one is +Inf; not cumulative
+    uint64_t sum_ns;
+} histogram_t;
+
+typedef struct metrics_shard {
+    uint64_t questions[CATEGORY_COUNT];
+    uint64_t answers[CATEGORY_COUNT][2];        // [category][correct]
+    uint64_t sessions_started;
+    uint64_t sessions_ended;
+    uint64_t server_requests;
+    uint64_t server_syscalls;
+    uint64_t server_allocations;
+    histogram_t grading;
+    histogram_t flush;
+    struct metrics_shard *next;
+    bool in_use;                                // Owned by a live thread
+} __attribute__((aligned(64))) metrics_shard_t;
+
+static metrics_shard_t *shards;
+static pthread_mutex_t shards_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t shard_key;
+static pthread_once_t shard_key_once = PTHREAD_ONCE_INIT;
+static __thread metrics_shard_t *thread_shard;
+static metrics_shard_t fallback_shard;          // If a shard cannot be allocated
+static int listen_fd = -1;
+static const char *server_backend;             // Set by `serve`
+static uint64_t server_session_bytes;           // Gauges, set by `serve`
+static uint64_t server_connection_bytes;
+
+/* ========== Shards ========== */
+
+static void release_shard(void *shard) {
+    pthread_mutex_lock(&shards_lock);
+    ((metrics_shard_t *)shard)->in_use = false;
+    pthread_mutex_unlock(&shards_lock);
+}
+
+static void create_shard_key(void) {
+    pthread_key_create(&shard_key, release_shard);
+}
+
+static metrics_shard_t *acquire_shard(void) {
+    metrics_shard_t *shard;
+    void *memory = NULL;
+    pthread_once(&shard_key_once, create_shard_key);
+
+    pthread_mutex_lock(&shards_lock);
+    for (shard = shards; shard != NULL && shard->in_use; shard = shard->next) {
+    }
+    if (shard == NULL && posix_memalign(&memory, 64, sizeof(metrics_shard_t)) == 0) {
+        shard = memset(memory, 0, sizeof(metrics_shard_t));
+        shard->next = shards;
+        shards = shard;
+    }
+    if (shard == NULL) {
+        // Racy, but counting somewhere beats dropping counts
+        pthread_mutex_unlock(&shards_lock);
+        return &fallback_shard;
+    }
+    shard->in_use = true;
+    pthread_mutex_unlock(&shards_lock);
+
+    pthread_setspecific(shard_key, shard);
+    return shard;
+}
+
+static metrics_shard_t *my_shard(void) {
+    if (thread_shard == NULL) {
+        thread_shard = acquire_shard();
+    }
+    return thread_shard;
+}
+
+/* Add to a counter this thread owns */
+static void bump(uint64_t *counter, uint64_t n) {
+    __atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
+
+static uint64_t seconds_to_ns(double seconds) {
+    return seconds > 0.0 ? (uint64_t)(seconds * 1e9) : 0;
+}
+
+static void observe(histogram_t *histogram, double seconds) {
+    uint64_t ns = seconds_to_ns(seconds);
+    int i = 0;
+    while (i < HISTOGRAM_BOUNDS && ns > bound_ns[i]) {
+        i++;
+    }
+    bump(&histogram->buckets[i], 1);
+    bump(&histogram->sum_ns, ns);
+}
+
+/* ========== Recording ========== */
+
+void metrics_question(category_t category) {
+    bump(&my_shard()->questions[category], 1);
+}
+
+void metrics_answer(category_t category, bool correct, double seconds) {
+    metrics_shard_t *shard = my_shard();
+    bump(&shard->answers[category][correct ? 1 : 0], 1);
+    observe(&shard->grading, seconds);
+}
+
+void metrics_session_started(void) {
+    bump(&my_shard()->sessions_started, 1);
+}
+
+void metrics_session_ended(void) {
+    bump(&my_shard()->sessions_ended, 1);
+}
+
+void metrics_flush(double seconds) {
+    observe(&my_shard()->flush, seconds);
+}
+
+void metrics_server_backend(const char *backend) {
+    server_backend = backend;
+}
+
+void metrics_server_io(uint64_t requests, uint64_t syscalls) {
+    metrics_shard_t *shard = my_shard();
+    bump(&shard->server_requests, requests);
+    bump(&shard->server_syscalls, syscalls);
+}
+
+void metrics_server_memory(uint64_t allocations, uint64_t session_bytes, uint64_t connection_bytes) {
+    bump(&my_shard()->server_allocations, allocations);
+    __atomic_store_n(&server_session_bytes, session_bytes, __ATOMIC_RELAXED);
+    __atomic_store_n(&server_connection_bytes, connection_bytes, __ATOMIC_RELAXED);
+}
+
+/* ========== Rendering ========== */
+
+static uint64_t load(const uint64_t *counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static void add_histogram(histogram_t *total, const histogram_t *shard) {
+    for (int i = 0; i <= HISTOGRAM_BOUNDS; i++) {
+        total->buckets[i] += load(&shard->buckets[i]);
+    }
+    total->sum_ns += load(&shard->sum_ns);
+}
+
+static void add_shard(metrics_shard_t *total, const metrics_shard_t *shard) {
+    for (int c = 0; c < CATEGORY_COUNT; c++) {
+        total->questions[c] += load(&shard->questions[c]);
+        total->answers[c][0] += load(&shard->answers[c][0]);
+        total->answers[c][1] += load(&shard->answers[c][1]);
+    }
+    total->sessions_started += load(&shard->sessions_started);
+    total->sessions_ended += load(&shard->sessions_ended);
+    total->server_requests += load(&shard->server_requests);
+    total->server_syscalls += load(&shard->server_syscalls);
+    total->server_allocations += load(&shard->server_allocations);
+    add_histogram(&total->grading, &shard->grading);
+    add_histogram(&total->flush, &shard->flush);
+}
+
+static void sum_shards(metrics_shard_t *total) {
+    memset(total, 0, sizeof(*total));
+    pthread_mutex_lock(&shards_lock);
+    for (const metrics_shard_t *shard = shards; shard != NULL; shard = shard->next) {
+        add_shard(total, shard);
+    }
+    add_shard(total, &fallback_shard);
+    pthread_mutex_unlock(&shards_lock);
+}
+
+static void put_header(outbuf_t *out, const char *name, const char *type, const char *help) {
+    outbuf_puts(out, "# HELP " METRIC_PREFIX);
+    outbuf_puts(out, name);
+    outbuf_putc(out, ' ');
+    outbuf_puts(out, help);
+    outbuf_puts(out, "\n# TYPE " METRIC_PREFIX);
+    outbuf_puts(out, name);
+    outbuf_putc(out, ' ');
+    outbuf_puts(out, type);
+    outbuf_putc(out, '\n');
+}
+
+static void put_category_label(outbuf_t *out, int category) {
+    outbuf_puts(out, "{category=\"");
+    for (const char *p = category_names[category]; *p; p++) {
+        outbuf_putc(out, (*p >= 'A' && *p <= 'Z') ? (char)(*p + ('a' - 'A')) : *p);
+    }
+    outbuf_putc(out, '"');
+}
+
+static void put_count(outbuf_t *out, uint64_t value) {
+    outbuf_long(out, (long)value);
+    outbuf_putc(out, '\n');
+}
+
+/* A value given in billionths (nanoseconds as seconds), all nine decimals */
+static void put_billionths(outbuf_t *out, uint64_t ns) {
+    char fraction[10];
+    outbuf_long(out, (long)(ns / 1000000000));
+    outbuf_putc(out, '.');
+    uint64_t rest = ns % 1000000000;
+    for (int i = 8; i >= 0; i--) {
+        fraction[i] = (char)('0' + rest % 10);
+        rest /= 10;
+    }
+    fraction[9] = '\n';
+    outbuf_write(out, fraction, sizeof(fraction));
+}
+
+static void put_histogram(outbuf_t *out, const char *name, const char *help, const histogram_t *histogram) {
+    uint64_t cumulative = 0;
+    put_header(out, name, "histogram", help);
+    for (int i = 0; i <= HISTOGRAM_BOUNDS; i++) {
+        cumulative += histogram->buckets[i];
+        outbuf_puts(out, METRIC_PREFIX);
+        outbuf_puts(out, name);
+        outbuf_puts(out, "_bucket{le=\"");
+        outbuf_puts(out, i < HISTOGRAM_BOUNDS ? bound_text[i] : "+Inf");
+        outbuf_puts(out, "\"} ");
+        put_count(out, cumulative);
+    }
+    outbuf_puts(out, METRIC_PREFIX);
+    outbuf_puts(out, name);
+    outbuf_puts(out, "_sum ");
+    put_billionths(out, histogram->sum_ns);
+    outbuf_puts(out, METRIC_PREFIX);
+    outbuf_puts(out, name);
+    outbuf_puts(out, "_count ");
+    put_count(out, cumulative);
+}
+
+void metrics_render(outbuf_t *out) {
+    metrics_shard_t total;
+    sum_shards(&total);
+
+    put_header(out, "questions_generated_total", "counter", "Questions put to users.");
+    for (int c = 0; c < CATEGORY_COUNT; c++) {
+        outbuf_puts(out, METRIC_PREFIX "questions_generated_total");
+        put_category_label(out, c);
+        outbuf_puts(out, "} ");
+        put_count(out, total.questions[c]);
+    }
+
+    put_header(out, "answers_graded_total", "counter", "Answers graded, by result.");
+    for (int c = 0; c < CATEGORY_COUNT; c++) {
+        for (int correct = 1; correct >= 0; correct--) {
+            outbuf_puts(out, METRIC_PREFIX "answers_graded_total");
+            put_category_label(out, c);
+            outbuf_puts(out, correct ? ",result=\"correct\"} " : ",result=\"incorrect\"} ");
+            put_count(out, total.answers[c][correct]);
+        }
+    }
+
+    put_header(out, "correct_ratio", "gauge", "Share of graded answers that were correct.");
+    for (int c = 0; c < CATEGORY_COUNT; c++) {
+        uint64_t graded = total.answers[c][0] + total.answers[c][1];
+        if (graded > 0) {
+            outbuf_puts(out, METRIC_PREFIX "correct_ratio");
+            put_category_label(out, c);
+            outbuf_puts(out, "} ");
+            put_billionths(out, total.answers[c][1] * 1000000000 / graded);
+        }
+    }
+
+    put_histogram(out, "grading_seconds", "Time to grade an answer and respond.", &total.grading);
+
+    put_header(out, "sessions_total", "counter", "Practice sessions started.");
+    outbuf_puts(out, METRIC_PREFIX "sessions_total ");
+    put_count(out, total.sessions_started);
+    put_header(out, "sessions_active", "gauge", "Practice sessions in progress.");
+    outbuf_puts(out, METRIC_PREFIX "sessions_active ");
+    // Shards are read one by one, so a session can be seen ending but not starting
+    put_count(out, total.sessions_started > total.sessions_ended ? total.sessions_started - total.sessions_ended : 0);
+
+    put_histogram(out, "flush_seconds", "Time to save statistics, rollups and the answer log.", &total.flush);
+    put_header(out, "flush_queue_depth", "gauge", "Answers waiting to be saved.");
+    outbuf_puts(out, METRIC_PREFIX "flush_queue_depth ");
+    put_count(out, statswriter_queue_depth());
+
+    if (server_backend != NULL) {
+        put_header(out, "server_requests_total", "counter", "HTTP requests answered.");
+        outbuf_puts(out, METRIC_PREFIX "server_requests_total{backend=\"");
+        outbuf_puts(out, server_backend);
+        outbuf_puts(out, "\"} ");
+        put_count(out, total.server_requests);
+        put_header(out, "server_syscalls_total", "counter", "System calls made by the server's event loop.");
+        outbuf_puts(out, METRIC_PREFIX "server_syscalls_total{backend=\"");
+        outbuf_puts(out, server_backend);
+        outbuf_puts(out, "\"} ");
+        put_count(out, total.server_syscalls);
+        put_header(out, "server_allocations_total", "counter", "Heap allocations made for sessions and connections.");
+        outbuf_puts(out, METRIC_PREFIX "server_allocations_total{backend=\"");
+        outbuf_puts(out, server_backend);
+        outbuf_puts(out, "\"} ");
+        put_count(out, total.server_allocations);
+        put_header(out, "server_session_bytes", "gauge", "Memory held for sessions.");
+        outbuf_puts(out, METRIC_PREFIX "server_session_bytes ");
+        put_count(out, load(&server_session_bytes));
+        put_header(out, "server_connection_bytes", "gauge", "Memory held for connections and their buffers.");
+        outbuf_puts(out, METRIC_PREFIX "server_connection_bytes ");
+        put_count(out, load(&server_connection_bytes));
+    }
+}
+
+/* ========== HTTP Endpoint ========== */
+
+static bool send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static void respond(int fd) {
+    char request[MAX_REQUEST];
+    size_t len = 0;
+
+    // Only the request line matters, but read the whole head so the client
+    // is not reset by a close with unread data
+    while (len < sizeof(request) - 1) {
+        ssize_t n = read(fd, request + len, sizeof(request) - 1 - len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return;                     // Reset, or silent past the timeout
+        }
+        if (n == 0) {
+            break;
+        }
+        len += (size_t)n;
+        request[len] = '\0';
+        if (strstr(request, "\r\n\r\n") != NULL || strstr(request, "\n\n") != NULL) {
+            break;
+        }
+    }
+    request[len] = '\0';
+
+    outbuf_t body, head;
+    if (outbuf_init(&body, -1, 8192) != 0 || outbuf_init(&head, -1, 256) != 0) {
+        outbuf_free(&body);
+        return;
+    }
+    bool found = strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET /metrics?", 13) == 0;
+    if (found) {
+        metrics_render(&body);
+        outbuf_puts(&head, "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n");
+    } else {
+        outbuf_puts(&body, "Not found; try /metrics\n");
+        outbuf_puts(&head, "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\n");
+    }
+    outbuf_puts(&head, "Connection: close\r\nContent-Length: ");
+    outbuf_long(&head, (long)body.len);
+    outbuf_puts(&head, "\r\n\r\n");
+    if (send_all(fd, head.data, head.len)) {
+        send_all(fd, body.data, body.len);
+    }
+    outbuf_free(&head);
+    outbuf_free(&body);
+}
+
+static void *serve_main(void *arg) {
+    struct timeval timeout = { IO_TIMEOUT_SECONDS, 0 };
+    (void)arg;
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return NULL;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        respond(fd);
+        close(fd);
+    }
+}
+int metrics_serve(int port) {
+    struct sockaddr_in addr;
+    int one = 1;
+    pthread_t thread;
+
+    if (port <= 0 || port > 65535) {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        return -1;
+    }
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, 16) != 0) {
+        int saved = errno;
+        close(listen_fd);
+        listen_fd = -1;
+        errno = saved;
+        return -1;
+    }
+
+    if ((errno = pthread_create(&thread, NULL, serve_main, NULL)) != 0) {
+        int saved = errno;
+        close(listen_fd);
+        listen_fd = -1;
+        errno = saved;
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * metrics.h - Operational Metrics
+ *
+ * Counters and histograms for running the trainer as a long-lived
+ * service, rendered in the Prometheus text exposition format:
+ *
+ *   metric_trainer_questions_generated_total{category}
+ *   metric_trainer_answers_graded_total{category,result}
+ *   metric_trainer_correct_ratio{category}
+ *   metric_trainer_grading_seconds             histogram
+ *   metric_trainer_sessions_total
+ *   metric_trainer_sessions_active
+ *   metric_trainer_flush_seconds               histogram
+ *   metric_trainer_flush_queue_depth
+ *   metric_trainer_server_requests_total{backend}   (under `serve`)
+ *   metric_trainer_server_syscalls_total{backend}
+ *   metric_trainer_server_allocations_total{backend}
+ *   metric_trainer_server_session_bytes
+ *   metric_trainer_server_connection_bytes
+ *
+ * Every thread counts into its own cache-line-aligned shard, so the
+ * recording calls take no locks and share no cache lines. A scrape
+ * adds the shards up. A shard left by a thread that exits is reused
+ * by the next new thread, and its counts carry over.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "outbuf.h"
+#include "questions.h"
+
+/**
+ * Count a question put to a user
+ */
+void metrics_question(category_t category);
+
+/**
+ * Count a graded answer
+ * @param category Category of the question
+ * @param correct Whether the answer was correct
+ * @param seconds Time taken to grade and respond to it
+ */
+void metrics_answer(category_t category, bool correct, double seconds);
+
+/**
+ * Count a practice session starting or ending
+ */
+void metrics_session_started(void);
+void metrics_session_ended(void);
+
+/**
+ * Record how long one statistics save took
+ */
+void metrics_flush(double seconds);
+
+/**
+ * Name the event loop of `serve`; the server metrics are rendered, with
+ * this as their backend label, once it is set
+ */
+void metrics_server_backend(const char *backend);
+
+/**
+ * Count HTTP requests answered and the system calls made to serve them
+ */
+void metrics_server_io(uint64_t requests, uint64_t syscalls);
+
+/**
+ * Report the server's memory
+ * @param allocations Heap allocations made since the last report
+ * @param session_bytes Bytes now held for sessions
+ * @param connection_bytes Bytes now held for connections and their buffers
+ */
+void metrics_server_memory(uint64_t allocations, uint64_t session_bytes, uint64_t connection_bytes);
+
+/**
+ * Append every metric, in Prometheus text format
+ */
+void metrics_render(outbuf_t *out);
+
+/**
+ * Serve GET /metrics over HTTP on 127.0.0.1 from a background thread
+ * @param port TCP port (1-65535)
+ * @return 0 if listening, -1 on error (errno set)
+ */
+int metrics_serve(int port);
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * outbuf.c - Buffered Output Writer
+ */
+
+#include "outbuf.h"
+#include "format.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+int outbuf_init(outbuf_t *ob, int fd, size_t capacity) {
+    ob->fd = fd;
+    ob->len = 0;
+    ob->error = 0;
+    ob->cap = capacity > FMT_MAX_CHARS ? capacity : FMT_MAX_CHARS;
+    ob->data = malloc(ob->cap);
+    ob->borrowed = NULL;
+    return ob->data != NULL ? 0 : -1;
+}
+
+void outbuf_init_borrowed(outbuf_t *ob, char *data, size_t capacity) {
+    ob->fd = -1;
+    ob->len = 0;
+    ob->error = 0;
+    ob->cap = capacity;
+    ob->data = data;
+    ob->borrowed = data;
+}
+
+void outbuf_free(outbuf_t *ob) {
+    if (ob->data != ob->borrowed) {
+        free(ob->data);
+    }
+    ob->borrowed = NULL;
+    ob->data = NULL;
+    ob->len = 0;
+    ob->cap = 0;
+}
+
+// Write bytes to the descriptor, retrying short writes and interrupts
+static void write_all(outbuf_t *ob, const char *data, size_t len) {
+    size_t done = 0;
+
+    while (done < len && ob->error == 0) {
+        ssize_t n = write(ob->fd, data + done, len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ob->error = errno;
+        } else {
+            done += (size_t)n;
+        }
+    }
+}
+
+static void drain(outbuf_t *ob) {
+    write_all(ob, ob->data, ob->len);
+    ob->len = 0;
+}
+
+char *outbuf_reserve(outbuf_t *ob, size_t n) {
+    if (ob->cap - ob->len >= n) {
+        return ob->data + ob->len;
+    }
+
+    // Descriptor mode: flushing usually makes enough room
+    if (ob->fd >= 0) {
+        drain(ob);
+        if (ob->cap >= n) {
+            return ob->data;
+        }
+    }
+
+    size_t cap = ob->cap * 2;
+    while (cap - ob->len < n) {
+        cap *= 2;
+    }
+    // Borrowed memory is copied out, never reallocated
+    char *data = ob->data == ob->borrowed ? malloc(cap) : realloc(ob->data, cap);
+    if (data == NULL) {
+        ob->error = ENOMEM;
+        return NULL;
+    }
+    if (ob->data == ob->borrowed) {
+        memcpy(data, ob->data, ob->len);
+    }
+    ob->data = data;
+    ob->cap = cap;
+    return ob->data + ob->len;
+}
+
+void outbuf_commit(outbuf_t *ob, char *end) {
+    ob->len = (size_t)(end - ob->data);
+}
+
+void outbuf_write(outbuf_t *ob, const void *data, size_t n) {
+    // Blocks larger than the buffer go straight to the descriptor
+    if (ob->fd >= 0 && n >= ob->cap) {
+        drain(ob);
+        write_all(ob, data, n);
+        return;
+    }
+
+    char *p = outbuf_reserve(ob, n);
+    if (p != NULL) {
+        memcpy(p, data, n);
+        ob->len += n;
+    }
+}
+
+void outbuf_puts(outbuf_t *ob, const char *s) {
+    outbuf_write(ob, s, strlen(s));
+}
+
+void outbuf_putc(outbuf_t *ob, char c) {
+    char *p = outbuf_reserve(ob, 1);
+    if (p != NULL) {
+        *p = c;
+        ob->len++;
+    }
+}
+
+void outbuf_fixed(outbuf_t *ob, double value, int decimals) {
+    char *p = outbuf_reserve(ob, FMT_MAX_CHARS);
+    if (p != NULL) {
+        outbuf_commit(ob, fmt_fixed(p, value, decimals));
+    }
+}
+
+void outbuf_centi(outbuf_t *ob, long centi) {
+    char *p = outbuf_reserve(ob, FMT_MAX_CHARS);
+    if (p != NULL) {
+        outbuf_commit(ob, fmt_centi(p, centi));
+    }
+}
+
+void outbuf_long(outbuf_t *ob, long value) {
+    char *p = outbuf_reserve(ob, FMT_MAX_CHARS);
+    if (p != NULL) {
+        outbuf_commit(ob, fmt_long(p, value));
+    }
+}
+
+int outbuf_flush(outbuf_t *ob) {
+    if (ob->fd >= 0 && ob->len > 0) {
+        drain(ob);
+    }
+    return ob->error == 0 ? 0 : -1;
+}
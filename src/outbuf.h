@@ -0,0 +1,96 @@
+/*
+ * outbuf.h - Buffered Output Writer
+ *
+ * A growable byte buffer that is either bound to a file descriptor
+ * (flushed with write(2) whenever it fills up) or kept in memory for the
+ * caller to hand off later (fd = -1). Bulk writers format straight into
+ * the buffer through outbuf_reserve()/outbuf_commit() and the fmt_*
+ * functions instead of going through stdio.
+ */
+
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+#include <stddef.h>
+
+typedef struct {
+    int fd;                 // Destination descriptor, or -1 for memory only
+    char *data;
+    size_t len;             // Bytes currently buffered
+    size_t cap;             // Allocated size of data
+    int error;              // errno of the first failed write, 0 if none
+    char *borrowed;         // Caller's memory data started in, or NULL
+} outbuf_t;
+
+/**
+ * Initialize a buffer
+ * @param ob Buffer to initialize
+ * @param fd Descriptor to flush to, or -1 to keep everything in memory
+ * @param capacity Initial allocation in bytes
+ * @return 0 on success, -1 if the allocation failed
+ */
+int outbuf_init(outbuf_t *ob, int fd, size_t capacity);
+
+/**
+ * Initialize a memory-mode buffer over memory the caller owns. If it has
+ * to grow, its contents move to the heap; the caller's memory is never
+ * reallocated or freed.
+ * @param ob Buffer to initialize
+ * @param data Caller's memory
+ * @param capacity Its size (at least FMT_MAX_CHARS)
+ */
+void outbuf_init_borrowed(outbuf_t *ob, char *data, size_t capacity);
+
+/**
+ * Release the buffer's memory (does not flush or close the descriptor)
+ */
+void outbuf_free(outbuf_t *ob);
+
+/**
+ * Make room for at least n more bytes and return the write position
+ * @return Pointer to n writable bytes, or NULL if memory ran out
+ */
+char *outbuf_reserve(outbuf_t *ob, size_t n);
+
+/**
+ * Mark bytes up to end (from the last outbuf_reserve) as written
+ */
+void outbuf_commit(outbuf_t *ob, char *end);
+
+/**
+ * Append raw bytes (blocks bigger than the buffer are written through)
+ */
+void outbuf_write(outbuf_t *ob, const void *data, size_t n);
+
+/**
+ * Append a NUL-terminated string
+ */
+void outbuf_puts(outbuf_t *ob, const char *s);
+
+/**
+ * Append a single character
+ */
+void outbuf_putc(outbuf_t *ob, char c);
+
+/**
+ * Append a value with fixed decimals (see fmt_fixed)
+ */
+void outbuf_fixed(outbuf_t *ob, double value, int decimals);
+
+/**
+ * Append an exact amount in hundredths (see fmt_centi)
+ */
+void outbuf_centi(outbuf_t *ob, long centi);
+
+/**
+ * Append a signed integer
+ */
+void outbuf_long(outbuf_t *ob, long value);
+
+/**
+ * Write everything buffered to the descriptor (no-op in memory mode)
+ * @return 0 on success, -1 if any write has failed
+ */
+int outbuf_flush(outbuf_t *ob);
+
+#endif
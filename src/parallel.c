@@ -0,0 +1,318 @@
+/*
+ * parallel.c - Parallel Task Execution
+ *
+ * Each worker's remaining tasks are one range of task numbers, packed
+ * into a 64-bit word (begin in the low half, end in the high half) that
+ * changes only by compare-and-swap. The owner takes tasks from the
+ * front; a thief moves the back half of a victim's range into its own,
+ * which only it and other thieves touch once it has run dry. Tasks are
+ * never added during a job, so a worker that finds every range empty is
+ * done, and the job is over when every worker is.
+ *
+ * Pool threads wait on a condition variable between jobs, and notice a
+ * new one by its generation number.
+ */
+
+#define _GNU_SOURCE                       // pthread_setaffinity_np(3)
+
+#include "parallel.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    parallel_task_fn fn;
+    void *context;
+    int workers;                        // Taking part, including the caller
+} parallel_job_t;
+
+typedef struct {
+    uint64_t range;                     // Tasks left; see pack_range
+    unsigned long long generation;      // Last job this thread noticed
+    unsigned long long tasks;
+    unsigned long long steals;
+    uint64_t busy_ns;
+    uint64_t job_ns;
+    int cpu;
+    bool pinned;
+} __attribute__((aligned(64))) parallel_worker_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t start;               // A job was published
+    pthread_cond_t done;                // The last pool thread finished its part
+    unsigned long long generation;      // Jobs published
+    const parallel_job_t *job;
+    int job_workers;
+    int running;                        // Pool threads still working on the job
+    int started;                        // Pool threads, workers 1..started
+    int used;                           // Most workers any job has had
+    bool caller_pinned;
+    int cpus[PARALLEL_MAX_WORKERS];     // From parallel_set_cpus
+    int cpu_count;
+    parallel_worker_t workers[PARALLEL_MAX_WORKERS];
+} pool = { .lock = PTHREAD_MUTEX_INITIALIZER, .start = PTHREAD_COND_INITIALIZER, .done = PTHREAD_COND_INITIALIZER };
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+/* ========== Task Ranges ========== */
+
+static uint64_t pack_range(uint32_t begin, uint32_t end) {
+    return (uint64_t)end << 32 | begin;
+}
+
+/* Take the next task of the worker's own range */
+static bool take_task(parallel_worker_t *w, int *task) {
+    uint64_t range = __atomic_load_n(&w->range, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint32_t begin = (uint32_t)range;
+        uint32_t end = (uint32_t)(range >> 32);
+        if (begin >= end) {
+            return false;
+        }
+        if (__atomic_compare_exchange_n(&w->range, &range, pack_range(begin + 1, end), false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *task = (int)begin;
+            return true;
+        }
+    }
+}
+
+/* Move the back half of some other worker's range into self's */
+static bool steal_tasks(int self, int workers) {
+    for (int k = 1; k < workers; k++) {
+        parallel_worker_t *victim = &pool.workers[(self + k) % workers];
+        uint64_t range = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+        for (;;) {
+            uint32_t begin = (uint32_t)range;
+            uint32_t end = (uint32_t)(range >> 32);
+            if (begin >= end) {
+                break;
+            }
+            uint32_t mid = begin + (end - begin) / 2;
+            if (__atomic_compare_exchange_n(&victim->range, &range, pack_range(begin, mid), false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                __atomic_store_n(&pool.workers[self].range, pack_range(mid, end), __ATOMIC_RELEASE);
+                pool.workers[self].steals++;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void run_worker(const parallel_job_t *job, int self) {
+    parallel_worker_t *w = &pool.workers[self];
+    int task;
+
+    for (;;) {
+        if (!take_task(w, &task)) {
+            if (!steal_tasks(self, job->workers)) {
+                return;
+            }
+            continue;
+        }
+        uint64_t start = now_ns();
+        job->fn(job->context, task, self);
+        w->busy_ns += now_ns() - start;
+        w->tasks++;
+    }
+}
+
+/* ========== Pool Threads ========== */
+
+static void pin_worker(int self) {
+    if (pool.cpu_count == 0) {
+        return;
+    }
+    parallel_worker_t *w = &pool.workers[self];
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(pool.cpus[self % pool.cpu_count], &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+        w->cpu = pool.cpus[self % pool.cpu_count];
+        w->pinned = true;
+    }
+}
+
+static void *worker_main(void *arg) {
+    int self = (int)(intptr_t)arg;
+    parallel_worker_t *w = &pool.workers[self];
+
+    pin_worker(self);
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (pool.generation == w->generation) {
+            pthread_cond_wait(&pool.start, &pool.lock);
+        }
+        w->generation = pool.generation;
+        if (self >= pool.job_workers) {
+            continue;                   // Not needed for this one
+        }
+        const parallel_job_t *job = pool.job;
+        pthread_mutex_unlock(&pool.lock);
+
+        run_worker(job, self);
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.running == 0) {
+            pthread_cond_signal(&pool.done);
+        }
+    }
+    return NULL;
+}
+
+/* Start pool threads until there are workers threads in all; returns how many there are */
+static int grow_pool(int workers) {
+    while (pool.started + 1 < workers) {
+        int self = pool.started + 1;
+        pthread_t thread;
+        pool.workers[self].generation = pool.generation;
+        if (pthread_create(&thread, NULL, worker_main, (void *)(intptr_t)self) != 0) {
+            break;                      // Run with however many workers we got
+        }
+        pthread_detach(thread);
+        pool.started++;
+    }
+    return pool.started + 1;
+}
+
+/* ========== Public API ========== */
+
+int parallel_default_threads(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+int parallel_set_cpus(const char *list) {
+    int cpus[PARALLEL_MAX_WORKERS];
+    int count = 0;
+    const char *p = list;
+
+    while (*p != '\0') {
+        char *end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if (end == p || first < 0) {
+            return -1;
+        }
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first) {
+                return -1;
+            }
+            p = end;
+        }
+        if (last >= CPU_SETSIZE) {
+            return -1;
+        }
+        for (long cpu = first; cpu <= last && count < PARALLEL_MAX_WORKERS; cpu++) {
+            cpus[count++] = (int)cpu;
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            return -1;
+        }
+    }
+    if (count == 0) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        pool.cpus[i] = cpus[i];
+    }
+    pool.cpu_count = count;
+    pool.caller_pinned = false;
+    return 0;
+}
+
+void parallel_for(int task_count, int threads, parallel_task_fn fn, void *context) {
+    if (task_count <= 0) {
+        return;
+    }
+    if (threads > task_count) threads = task_count;
+    if (threads > PARALLEL_MAX_WORKERS) threads = PARALLEL_MAX_WORKERS;
+    if (threads < 1) threads = 1;
+
+    if (pool.cpu_count > 0 && !pool.caller_pinned) {
+        pin_worker(0);
+        pool.caller_pinned = true;
+    }
+    threads = grow_pool(threads);
+
+    // Worker i starts with the i-th contiguous share of the tasks
+    parallel_job_t job = { fn, context, threads };
+    for (int i = 0; i < threads; i++) {
+        uint32_t begin = (uint32_t)((long long)task_count * i / threads);
+        uint32_t end = (uint32_t)((long long)task_count * (i + 1) / threads);
+        __atomic_store_n(&pool.workers[i].range, pack_range(begin, end), __ATOMIC_RELAXED);
+    }
+
+    uint64_t start = now_ns();
+    if (threads > 1) {
+        pthread_mutex_lock(&pool.lock);
+        pool.job = &job;
+        pool.job_workers = threads;
+        pool.running = threads - 1;
+        pool.generation++;
+        pthread_cond_broadcast(&pool.start);
+        pthread_mutex_unlock(&pool.lock);
+    }
+
+    run_worker(&job, 0);
+
+    if (threads > 1) {
+        pthread_mutex_lock(&pool.lock);
+        while (pool.running > 0) {
+            pthread_cond_wait(&pool.done, &pool.lock);
+        }
+        pthread_mutex_unlock(&pool.lock);
+    }
+    uint64_t elapsed = now_ns() - start;
+    for (int i = 0; i < threads; i++) {
+        pool.workers[i].job_ns += elapsed;
+    }
+    if (threads > pool.used) {
+        pool.used = threads;
+    }
+}
+
+int parallel_worker_stats(parallel_worker_stats_t *stats, int max) {
+    int count = pool.used < max ? pool.used : max;
+    for (int i = 0; i < count; i++) {
+        const parallel_worker_t *w = &pool.workers[i];
+        stats[i].tasks = w->tasks;
+        stats[i].steals = w->steals;
+        stats[i].busy_seconds = (double)w->busy_ns / 1e9;
+        stats[i].job_seconds = (double)w->job_ns / 1e9;
+        stats[i].cpu = w->pinned ? w->cpu : -1;
+    }
+    return pool.used;
+}
+
+void parallel_print_stats(FILE *out) {
+    parallel_worker_stats_t stats[PARALLEL_MAX_WORKERS];
+    int count = parallel_worker_stats(stats, PARALLEL_MAX_WORKERS);
+
+    fprintf(out, "\n  Worker   CPU      Tasks   Steals     Busy  Utilization\n");
+    for (int i = 0; i < count; i++) {
+        const parallel_worker_stats_t *s = &stats[i];
+        fprintf(out, "  %6d  ", i);
+        if (s->cpu >= 0) {
+            fprintf(out, "%4d", s->cpu);
+        } else {
+            fprintf(out, "%4s", "-");
+        }
+        fprintf(out, "  %9llu  %7llu  %6.2fs  %10.1f%%\n", s->tasks, s->steals, s->busy_seconds,
+                s->job_seconds > 0 ? 100.0 * s->busy_seconds / s->job_seconds : 0.0);
+    }
+}
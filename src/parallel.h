@@ -0,0 +1,81 @@
+/*
+ * parallel.h - Parallel Task Execution
+ *
+ * Runs a numbered set of independent tasks across a pool of worker
+ * threads, with the calling thread working as worker 0. Each worker
+ * starts with its own contiguous range of task numbers and takes them
+ * from the front; a worker that runs out steals the back half of
+ * another worker's range, so uneven task costs still balance while
+ * neighbouring tasks mostly stay on one worker. Results must not depend
+ * on which worker ran a task; anything random is seeded per task, not
+ * per worker.
+ *
+ * The pool's threads are started by the first parallel_for that needs
+ * them and then wait between jobs, so commands that run many short
+ * jobs do not pay for thread creation each time. Jobs are run one at a
+ * time and must be submitted from one thread.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdio.h>
+
+#define PARALLEL_MAX_WORKERS 256
+
+/**
+ * Task callback
+ * @param context Caller data passed to parallel_for
+ * @param task Task number in [0, task_count)
+ * @param worker Worker number in [0, threads), stable for the call
+ */
+typedef void (*parallel_task_fn)(void *context, int task, int worker);
+
+/* What one worker has done since the program started */
+typedef struct {
+    unsigned long long tasks;           // Tasks run
+    unsigned long long steals;          // Ranges taken from other workers
+    double busy_seconds;                // Time spent running tasks
+    double job_seconds;                 // Duration of the jobs it took part in
+    int cpu;                            // CPU it is pinned to, or -1
+} parallel_worker_stats_t;
+
+/**
+ * Number of online CPUs (at least 1)
+ */
+int parallel_default_threads(void);
+
+/**
+ * Pin workers to CPUs, worker i to the (i mod n)th CPU of the list;
+ * takes effect for workers not yet started and for the calling thread
+ * at its next parallel_for
+ * @param list CPU numbers and ranges, e.g. "0-3,8"
+ * @return 0 on success, -1 if the list is malformed
+ */
+int parallel_set_cpus(const char *list);
+
+/**
+ * Run fn for every task number and wait for all of them to finish
+ * @param task_count Number of tasks
+ * @param threads Number of workers to use (<= 1 runs everything inline)
+ * @param fn Task callback
+ * @param context Passed through to fn
+ */
+void parallel_for(int task_count, int threads, parallel_task_fn fn, void *context);
+
+/**
+ * Read each worker's figures
+ * @param stats Receives up to max workers' figures
+ * @param max Capacity of stats
+ * @return Number of workers that have taken part in a job
+ */
+int parallel_worker_stats(parallel_worker_stats_t *stats, int max);
+
+/**
+ * Print a table of each worker's tasks, steals and utilization (the
+ * share of its jobs' time spent running tasks)
+ * @param out Where to print
+ */
+void parallel_print_stats(FILE *out);
+
+#endif
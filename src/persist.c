@@ -0,0 +1,213 @@
+/*
+ * persist.c - Versioned Statistics File Format
+ *
+ * Encoding, checksumming and crash-safe saving of persistent_stats_t.
+ * See persist.h for the file layout.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "persist.h"
+
+#define STATS_MAGIC "MTST"
+#define STATS_VERSION 2
+#define STATS_MAX_FILE_SIZE (1 << 20)
+
+/* sizeof(persistent_stats_t) when the file was a bare struct (version 1) */
+#define STATS_LEGACY_SIZE 48
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t byte_order;
+    uint32_t payload_size;
+    uint32_t crc;
+} stats_header_t;
+
+/* The payload is byte-swapped word by word; keep every field 32 bits wide */
+typedef char persistent_stats_word_check[(sizeof(persistent_stats_t) % 4 == 0) ? 1 : -1];
+
+/* ========== Checksums and Byte Order ========== */
+
+/* Four bits at a time: a 64-byte table instead of 1 KB, ample for a few hundred bytes */
+static const uint32_t crc_nibble_table[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+uint32_t persist_crc32(const void *data, size_t len) {
+    const unsigned char *p = data;
+    uint32_t crc = 0xffffffffu;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= p[i];
+        crc = (crc >> 4) ^ crc_nibble_table[crc & 15];
+        crc = (crc >> 4) ^ crc_nibble_table[crc & 15];
+    }
+    return ~crc;
+}
+
+static uint16_t swap16(uint16_t v) {
+    return (uint16_t)((v >> 8) | (v << 8));
+}
+
+static uint32_t swap32(uint32_t v) {
+    return (v >> 24) | ((v >> 8) & 0xff00u) | ((v << 8) & 0xff0000u) | (v << 24);
+}
+
+void persist_decode_stats(const void *payload, size_t size, bool swap, persistent_stats_t *stats) {
+    unsigned char *out = (unsigned char *)stats;
+    size_t keep = size < sizeof(*stats) ? size & ~(size_t)3 : sizeof(*stats);
+
+    memset(stats, 0, sizeof(*stats));
+    memcpy(out, payload, keep);
+
+    if (swap) {
+        for (size_t i = 0; i < keep; i += 4) {
+            uint32_t word;
+            memcpy(&word, out + i, 4);
+            word = swap32(word);
+            memcpy(out + i, &word, 4);
+        }
+    }
+}
+
+/* ========== Stats Files ========== */
+
+int persist_load_stats(const char *path, persistent_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    struct stat st;
+    unsigned char *data = NULL;
+    int result = -1;
+
+    if (fstat(fd, &st) != 0 || st.st_size > STATS_MAX_FILE_SIZE) {
+        goto done;
+    }
+    size_t size = (size_t)st.st_size;
+    data = malloc(size > 0 ? size : 1);
+    if (data == NULL || persist_read_at(fd, data, size, 0) != 0) {
+        goto done;
+    }
+
+    stats_header_t header;
+    if (size >= sizeof(header) && memcmp(data, STATS_MAGIC, 4) == 0) {
+        memcpy(&header, data, sizeof(header));
+        bool swap = header.byte_order == PERSIST_BYTE_ORDER_SWAPPED;
+        if (!swap && header.byte_order != PERSIST_BYTE_ORDER) {
+            goto done;
+        }
+        if (swap) {
+            header.version = swap16(header.version);
+            header.payload_size = swap32(header.payload_size);
+            header.crc = swap32(header.crc);
+        }
+        // Later versions only append fields, so their prefix is readable too
+        if (header.version < STATS_VERSION ||
+            header.payload_size != size - sizeof(header) ||
+            persist_crc32(data + sizeof(header), header.payload_size) != header.crc) {
+            goto done;
+        }
+        persist_decode_stats(data + sizeof(header), header.payload_size, swap, stats);
+        result = 1;
+    } else if (size == STATS_LEGACY_SIZE) {
+        // Version 1: a bare struct in native byte order
+        persist_decode_stats(data, size, false, stats);
+        result = 1;
+    }
+
+done:
+    free(data);
+    close(fd);
+    return result;
+}
+
+int persist_save_stats(const char *path, const persistent_stats_t *stats) {
+    struct {
+        stats_header_t header;
+        persistent_stats_t payload;
+    } file;
+
+    memcpy(file.header.magic, STATS_MAGIC, 4);
+    file.header.version = STATS_VERSION;
+    file.header.byte_order = PERSIST_BYTE_ORDER;
+    file.header.payload_size = sizeof(*stats);
+    file.header.crc = persist_crc32(stats, sizeof(*stats));
+    file.payload = *stats;
+
+    size_t tmp_len = strlen(path) + 5;
+    char *tmp_path = malloc(tmp_len);
+    if (tmp_path == NULL) {
+        return -1;
+    }
+    snprintf(tmp_path, tmp_len, "%s.tmp", path);
+
+    int result = -1;
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        // The rename needs no directory fsync: after a crash the name
+        // refers to either the old file or the new one, both complete
+        if (persist_write_at(fd, &file, sizeof(file), 0) == 0 && fsync(fd) == 0) {
+            result = 0;
+        }
+        if (close(fd) != 0) {
+            result = -1;
+        }
+        if (result == 0 && rename(tmp_path, path) != 0) {
+            result = -1;
+        }
+        if (result != 0) {
+            unlink(tmp_path);
+        }
+    }
+
+    free(tmp_path);
+    return result;
+}
+
+/* ========== Positioned I/O ========== */
+
+int persist_read_at(int fd, void *buf, size_t len, off_t offset) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
+
+int persist_write_at(int fd, const void *buf, size_t len, off_t offset) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
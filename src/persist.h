@@ -0,0 +1,78 @@
+/*
+ * persist.h - Versioned Statistics File Format
+ *
+ * persistent_stats_t on disk. A stats file is a 16-byte header followed
+ * by the statistics payload:
+ *
+ *   magic "MTST" | u16 version | u16 byte order | u32 payload size | u32 CRC-32
+ *
+ * The byte-order field is written as 0x0102 in the writer's native order,
+ * so a file moved between machines is recognized and byte-swapped on load.
+ * The payload is persistent_stats_t as a sequence of 32-bit words. New
+ * fields are only ever appended; a shorter payload from an older version
+ * loads with the missing fields zeroed.
+ *
+ * Files written before the header existed (a bare persistent_stats_t) are
+ * still read, and are rewritten in the current format on the next save.
+ */
+
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "questions.h"
+
+#define PERSIST_BYTE_ORDER 0x0102
+#define PERSIST_BYTE_ORDER_SWAPPED 0x0201
+
+/**
+ * CRC-32 (IEEE 802.3, as used by zlib and PNG)
+ * @param data Bytes to checksum
+ * @param len Number of bytes
+ * @return Checksum
+ */
+uint32_t persist_crc32(const void *data, size_t len);
+
+/**
+ * Decode a stored statistics payload
+ * @param payload Payload bytes as stored
+ * @param size Payload size, may be smaller than persistent_stats_t
+ * @param swap True if the payload was written with the other byte order
+ * @param stats Receives the statistics, zero-extended
+ */
+void persist_decode_stats(const void *payload, size_t size, bool swap, persistent_stats_t *stats);
+
+/**
+ * Load a stats file
+ * @param path File path
+ * @param stats Receives the statistics (zeros unless 1 is returned)
+ * @return 1 if loaded, 0 if the file does not exist, -1 if it is damaged
+ */
+int persist_load_stats(const char *path, persistent_stats_t *stats);
+
+/**
+ * Save a stats file atomically: the new contents are written to a
+ * temporary file, synced once and renamed over the old file, so a crash
+ * leaves either the old or the new statistics, never a mixture
+ * @param path File path
+ * @param stats Statistics to save
+ * @return 0 on success, -1 on error (the old file is left in place)
+ */
+int persist_save_stats(const char *path, const persistent_stats_t *stats);
+
+/**
+ * pread() exactly len bytes, retrying short reads and EINTR
+ * @return 0 on success, -1 on error or end of file
+ */
+int persist_read_at(int fd, void *buf, size_t len, off_t offset);
+
+/**
+ * pwrite() exactly len bytes, retrying short writes and EINTR
+ * @return 0 on success, -1 on error
+ */
+int persist_write_at(int fd, const void *buf, size_t len, off_t offset);
+
+#endif
@@ -0,0 +1,217 @@
+/*
+ * progress.c - Progress Report
+ *
+ * Sums the rollup records of the selected categories into one row per
+ * period, then prints the rows with an accuracy bar and a per-category
+ * comparison of the latest period with the one before it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "progress.h"
+#include "questions.h"
+#include "rollup.h"
+#include "tables.h"
+#include "userstore.h"
+
+#define MAX_PERIODS 520
+#define BAR_WIDTH 20
+
+typedef struct {
+    rollup_kind_t kind;
+    int periods;
+    category_selection_t selection;
+    const char *user;               // Whose progress: --user, else the practicing user
+} progress_options_t;
+
+typedef struct {
+    unsigned long answers;
+    unsigned long correct;
+    double error_sum;
+    double seconds_sum;
+    unsigned long timed;
+} progress_row_t;
+
+static void show_progress_help(void) {
+    printf("USAGE:\n");
+    printf("  metric-trainer progress [OPTIONS]\n\n");
+    printf("OPTIONS:\n");
+    printf("  --weekly               One row per week, Monday to Sunday (default)\n");
+    printf("  --daily                One row per day\n");
+    printf("  -n, --periods N        Number of weeks or days to show (default: 8 or 14)\n");
+    printf("  -c, --categories SET   Categories to include, e.g. \"ab\" (default: all)\n");
+    printf("  -u, --user NAME        Show progress for NAME (see --user in practice)\n");
+}
+
+static int parse_progress_options(int argc, char *argv[], progress_options_t *opts) {
+    const char *categories = "all";
+
+    memset(opts, 0, sizeof(*opts));
+    opts->kind = ROLLUP_WEEK;
+    opts->user = g_user_name;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            show_progress_help();
+            return 0;
+        } else if (strcmp(arg, "--weekly") == 0) {
+            opts->kind = ROLLUP_WEEK;
+            continue;
+        } else if (strcmp(arg, "--daily") == 0) {
+            opts->kind = ROLLUP_DAY;
+            continue;
+        }
+
+        if (value == NULL) {
+            fprintf(stderr, "progress: unknown option or missing value: %s\n", arg);
+            return -1;
+        }
+        i++;
+
+        if (strcmp(arg, "-n") == 0 || strcmp(arg, "--periods") == 0) {
+            long periods;
+            if (!parse_whole_number(value, 1, MAX_PERIODS, &periods)) {
+                fprintf(stderr, "progress: invalid number of periods '%s' (use 1 to %d)\n", value, MAX_PERIODS);
+                return -1;
+            }
+            opts->periods = (int)periods;
+        } else if (strcmp(arg, "-c") == 0 || strcmp(arg, "--categories") == 0) {
+            categories = value;
+        } else if (strcmp(arg, "-u") == 0 || strcmp(arg, "--user") == 0) {
+            if (!userstore_valid_name(value)) {
+                fprintf(stderr, "progress: invalid user name '%s'\n", value);
+                return -1;
+            }
+            opts->user = value;
+        } else {
+            fprintf(stderr, "progress: unknown option: %s\n", arg);
+            return -1;
+        }
+    }
+
+    if (!parse_category_input(categories, &opts->selection)) {
+        fprintf(stderr, "progress: invalid categories '%s'\n", categories);
+        return -1;
+    }
+    if (opts->periods == 0) {
+        opts->periods = opts->kind == ROLLUP_WEEK ? 8 : 14;
+    }
+    return 1;
+}
+
+static void add_record(progress_row_t *row, const rollup_record_t *record) {
+    row->answers += record->answers;
+    row->correct += record->correct;
+    row->error_sum += record->error_sum;
+    row->seconds_sum += record->seconds_sum;
+    row->timed += record->timed;
+}
+
+static void print_row(const char *label, const progress_row_t *row) {
+    if (row->answers == 0) {
+        printf("  %-10s  %7d  %8s  %9s  %8s\n", label, 0, "-", "-", "-");
+        return;
+    }
+
+    double accuracy = 100.0 * row->correct / row->answers;
+    printf("  %-10s  %7lu  %7.1f%%  %8.1f%%  ", label, row->answers, accuracy,
+           row->error_sum / row->answers);
+    if (row->timed > 0) {
+        printf("%7.1fs", row->seconds_sum / row->timed);
+    } else {
+        printf("%8s", "-");
+    }
+
+    printf("  ");
+    int filled = (int)(accuracy / 100.0 * BAR_WIDTH + 0.5);
+    for (int i = 0; i < filled; i++) {
+        fputs("█", stdout);
+    }
+    printf("\n");
+}
+
+int progress_main(int argc, char *argv[]) {
+    progress_options_t opts;
+    int parsed = parse_progress_options(argc, argv, &opts);
+    if (parsed <= 0) {
+        return parsed == 0 ? 0 : 1;
+    }
+
+    char path[MAX_DATA_PATH];
+    rollup_t rollup;
+    user_file_path(opts.user, PROGRESS_FILE, path, sizeof(path));
+    if (rollup_load(path, &rollup) != 0) {
+        fprintf(stderr, "progress: cannot read %s\n", path);
+        return 1;
+    }
+
+    uint32_t today = rollup_day(time(NULL));
+    uint32_t last = opts.kind == ROLLUP_WEEK ? rollup_week(today) : today;
+    uint32_t first = last + 1 >= (uint32_t)opts.periods ? last + 1 - (uint32_t)opts.periods : 0;
+
+    // One row per period, and the latest two periods per category
+    progress_row_t rows[MAX_PERIODS];
+    progress_row_t latest[CATEGORY_COUNT][2];
+    memset(rows, 0, sizeof(rows));
+    memset(latest, 0, sizeof(latest));
+
+    for (size_t i = 0; i < rollup.count; i++) {
+        const rollup_record_t *record = &rollup.records[i];
+        int conversion_id = (int)(record->tag & 0xff);
+        if ((rollup_kind_t)(record->tag >> 8) != opts.kind || conversion_id >= CONVERSION_COUNT ||
+            record->period > last) {
+            continue;
+        }
+        category_t category = (category_t)conversion_table[conversion_id].category;
+        if (!opts.selection.active[category]) {
+            continue;
+        }
+        if (record->period >= first) {
+            add_record(&rows[record->period - first], record);
+        }
+        if (record->period + 1 >= last) {
+            add_record(&latest[category][last - record->period], record);
+        }
+    }
+    rollup_free(&rollup);
+
+    if (opts.user != NULL) {
+        printf("\nProgress for %s\n", opts.user);
+    } else {
+        printf("\nProgress\n");
+    }
+    printf("══════════════════════════════════════════\n\n");
+
+    printf("  %-10s  %7s  %8s  %9s  %8s\n",
+           opts.kind == ROLLUP_WEEK ? "Week of" : "Day", "Answers", "Accuracy", "Avg Error", "Avg Time");
+    printf("  ─────────────────────────────────────────────────────\n");
+
+    for (uint32_t period = first; period <= last; period++) {
+        char label[16];
+        rollup_format_day(opts.kind == ROLLUP_WEEK ? rollup_week_start(period) : period, label);
+        print_row(label, &rows[period - first]);
+    }
+
+    const char *unit = opts.kind == ROLLUP_WEEK ? "week" : "day";
+    printf("\nThis %s vs the previous %s:\n", unit, unit);
+    for (int c = 0; c < CATEGORY_COUNT; c++) {
+        if (!opts.selection.active[c]) {
+            continue;
+        }
+        const progress_row_t *now = &latest[c][0];
+        const progress_row_t *before = &latest[c][1];
+        printf("  %-12s ", category_names[c]);
+        if (now->answers == 0 || before->answers == 0) {
+            printf("%s\n", now->answers == 0 ? "no answers yet" : "no earlier answers to compare");
+            continue;
+        }
+        double accuracy_change = 100.0 * now->correct / now->answers - 100.0 * before->correct / before->answers;
+        double error_change = now->error_sum / now->answers - before->error_sum / before->answers;
+        printf("accuracy %+.1f points, avg error %+.1f points\n", accuracy_change, error_change);
+    }
+    printf("\n");
+    return 0;
+}
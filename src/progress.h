@@ -0,0 +1,20 @@
+/*
+ * progress.h - Progress Report
+ *
+ * Week-over-week (or day-over-day) trends of answers, accuracy, error
+ * and answer time, read from the rollups the stats writer maintains
+ * (see rollup.h).
+ */
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+/**
+ * Entry point for `metric-trainer progress ...`
+ * @param argc Argument count, argv[0] being "progress"
+ * @param argv Argument vector
+ * @return Process exit status
+ */
+int progress_main(int argc, char *argv[]);
+
+#endif
@@ -10,15 +10,45 @@
  *
  * The system is data-driven using conversion_info_t structures that define
  * conversion parameters, ranges, and tolerance levels for each unit pair.
+ * Those structures are generated from conversions.def at build time, with
+ * unit names kept apart in conversion_names so the hot path stays compact.
  */
 
 #include "questions.h"
+#include "tables.h"
+#include "format.h"
+#include "persist.h"
+#include "userstore.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
 #include <ctype.h>
+#include <errno.h>
+
+/* One hot entry per cache line; grow the padding, not the entry */
+typedef char conversion_info_size_check[(sizeof(conversion_info_t) == CACHE_LINE_SIZE) ? 1 : -1];
+
+/* Divide rounding half away from zero, matching roundf() on the float path */
+static long div_round(long long numerator, long long denominator) {
+    long long magnitude = numerator < 0 ? -numerator : numerator;
+    long long quotient = (2 * magnitude + denominator) / (2 * denominator);
+    return (long)(numerator < 0 ? -quotient : quotient);
+}
+
+/* Copy a string without its terminator, returning the end of the copy */
+static char *append_text(char *dst, const char *src) {
+    size_t len = strlen(src);
+    memcpy(dst, src, len);
+    return dst + len;
+}
+
+/* Format a value for a %s conversion: fixed decimals, NUL-terminated */
+static const char *fixed_text(char *buf, double value, int decimals) {
+    *fmt_fixed(buf, value, decimals) = '\0';
+    return buf;
+}
 
 /* ========== Category Management Functions ========== */
 
@@ -85,6 +115,10 @@ bool parse_category_input(const char *input, category_selection_t *selection) {
 }
 
 question_t generate_question(const category_selection_t *selection) {
+    return generate_question_r(selection, rng_default());
+}
+
+question_t generate_question_r(const category_selection_t *selection, rng_t *rng) {
     question_t q = {0};
 
     // Ensure we have at least one active category
@@ -94,11 +128,11 @@ question_t generate_question(const category_selection_t *selection) {
     }
 
     // Pick a random active category
-    category_t chosen_category = pick_random_category(selection);
+    category_t chosen_category = pick_random_category_r(selection, rng);
 
     // Get available conversions for this category
     int conversion_count = 0;
-    const conversion_info_t *conversions = get_conversions_for_category(chosen_category, &conversion_count);
+    const unsigned char *category_ids = get_conversions_for_category(chosen_category, &conversion_count);
 
     if (conversion_count == 0) {
         strcpy(q.question_text, "Error: No conversions available");
@@ -106,82 +140,162 @@ question_t generate_question(const category_selection_t *selection) {
     }
 
     // Pick a random conversion from this category
-    int conversion_index = rand() % conversion_count;
-    const conversion_info_t *conv = &conversions[conversion_index];
+    int conversion_id = category_ids[rng_below(rng, (uint32_t)conversion_count)];
+    return generate_question_for(conversion_id, rng);
+}
 
-    // Generate a random value within the conversion's range
-    float value = generate_random_value(conv->min_value, conv->max_value);
-    value = round_to_precision(value, 1); // Round to 1 decimal place for cleaner questions
+question_t generate_question_for(int conversion_id, rng_t *rng) {
+    question_t q = {0};
+    const conversion_info_t *conv = &conversion_table[conversion_id];
 
-    // Calculate the correct answer
-    float answer = conv->convert_func(value);
-    answer = round_to_precision(answer, 2); // Allow more precision in answers
+    // Pick a value: whole and easy modes draw from the precomputed grids,
+    // normal mode generates a random value within the conversion's range
+    float value;
+    if (g_easy_mode) {
+        value = (float)grid_values[conv->easy_first + rng_below(rng, conv->easy_count)];
+    } else if (g_whole_numbers_mode) {
+        value = (float)grid_values[conv->whole_first + rng_below(rng, conv->whole_count)];
+    } else {
+        value = generate_random_value_r(conv->min_value, conv->max_value, rng);
+        value = round_to_precision(value, 1); // Round to 1 decimal place for cleaner questions
+    }
+
+    float answer;
+    float tolerance;
+    if (g_easy_mode || g_whole_numbers_mode) {
+        // Integer value: compute the answer key exactly in hundredths
+        long value_int = (long)value;
+        unsigned tolerance_permille = g_easy_mode ? 50 : conv->tolerance_permille;
+        q.exact = true;
+        q.answer_centi = div_round((long long)(value_int + conv->pre_offset) * conv->num * 100, conv->den)
+                         + conv->post_offset * 100L;
+        q.tolerance_centi = div_round((long long)q.answer_centi * tolerance_permille, 1000);
+        if (q.tolerance_centi < 10) q.tolerance_centi = 10; // Minimum tolerance
+        answer = (float)q.answer_centi / 100.0f;
+        tolerance = (float)q.tolerance_centi / 100.0f;
+    } else {
+        // Calculate the correct answer
+        answer = value * conv->scale + conv->offset;
+        answer = round_to_precision(answer, 2); // Allow more precision in answers
 
-    // Calculate tolerance for this question
-    float tolerance_percent = g_easy_mode ? 5.0f : conv->tolerance_percent;
-    float tolerance = answer * (tolerance_percent / 100.0f);
-    if (tolerance < 0.1f) tolerance = 0.1f; // Minimum tolerance
+        // Calculate tolerance for this question
+        float tolerance_percent = conv->tolerance_percent;
+        tolerance = answer * (tolerance_percent / 100.0f);
+        if (tolerance < 0.1f) tolerance = 0.1f; // Minimum tolerance
+    }
 
     // Fill in the question structure
-    q.category = chosen_category;
+    q.category = (category_t)conv->category;
+    q.conversion_id = conversion_id;
     q.value = value;
     q.correct_answer = answer;
     q.tolerance = tolerance;
-    strcpy(q.from_unit, conv->from_unit);
-    strcpy(q.to_unit, conv->to_unit);
-
-    // Format the question text with improved formatting
-    snprintf(q.question_text, MAX_QUESTION_TEXT,
-             "Convert %.1f %s to %s",
-             value, conv->from_unit, conv->to_unit);
+    q.from_unit = unit_string(conversion_names[conversion_id].from_unit);
+    q.to_unit = unit_string(conversion_names[conversion_id].to_unit);
+
+    // Format the question text ("Convert 5.0 miles to kilometers")
+    char *p = append_text(q.question_text, "Convert ");
+    p = fmt_fixed(p, value, 1);
+    p = append_text(p, " ");
+    p = append_text(p, q.from_unit);
+    p = append_text(p, " to ");
+    p = append_text(p, q.to_unit);
+    *p = '\0';
 
     return q;
 }
 
-answer_result_t check_answer(const question_t *question, float user_answer) {
+/* Percent error of a difference from the correct answer, capped at MAX_PERCENT_ERROR */
+static float percent_error_of(double difference, double correct, double tolerance) {
+    double scale = correct != 0.0 ? fabs(correct) : tolerance;
+    double percent = difference / scale * 100.0;
+    return percent < MAX_PERCENT_ERROR ? (float)percent : MAX_PERCENT_ERROR;
+}
+
+answer_result_t grade_answer(const question_t *question, float user_answer) {
+    answer_result_t result;
+
+    if (!isfinite(user_answer) || fabsf(user_answer) > MAX_ANSWER_MAGNITUDE) {
+        result.is_correct = false;
+        result.percent_error = MAX_PERCENT_ERROR;
+        return result;
+    }
+
+    if (question->exact) {
+        // Fixed-point path: the user's answer is taken to the nearest hundredth
+        long long user_centi = llround((double)user_answer * 100.0);
+        long long difference = llabs(user_centi - question->answer_centi);
+        result.is_correct = difference <= question->tolerance_centi;
+        result.percent_error = percent_error_of((double)difference, (double)question->answer_centi,
+                                                (double)question->tolerance_centi);
+        return result;
+    }
+
     float difference = fabsf(user_answer - question->correct_answer);
-    bool is_correct = difference <= question->tolerance;
-    float percent_error = (difference / question->correct_answer) * 100.0f;
+    result.is_correct = difference <= question->tolerance;
+    result.percent_error = percent_error_of(difference, question->correct_answer, question->tolerance);
+    return result;
+}
 
-    printf("Correct answer: %.2f (±%.2f %s)\n", question->correct_answer, question->tolerance, question->to_unit);
+answer_result_t check_answer(const question_t *question, float user_answer) {
+    answer_result_t result = grade_answer(question, user_answer);
+    char answer[FMT_MAX_CHARS], tolerance[FMT_MAX_CHARS], error[FMT_MAX_CHARS];
 
-    if (is_correct) {
+    printf("Correct answer: %s (±%s %s)\n", fixed_text(answer, question->correct_answer, 2),
+           fixed_text(tolerance, question->tolerance, 2), question->to_unit);
+
+    if (result.is_correct) {
         printf("Correct!\n");
     } else {
-        printf("Error: %.1f%% off target\n", percent_error);
+        printf("Error: %s%% off target\n", fixed_text(error, result.percent_error, 1));
     }
 
-    answer_result_t result = {is_correct, percent_error};
     return result;
 }
 
 /* ========== Statistics and Reporting Functions ========== */
 
-void update_stats(session_stats_t *stats, const question_t *question, bool correct) {
+void update_stats(session_stats_t *stats, const stats_delta_t *delta) {
     // Update total question count
     stats->total_questions++;
 
     // Update correct answer count
-    if (correct) {
+    if (delta->correct) {
         stats->correct_answers++;
     }
 
     // Update category-specific stats
-    stats->category_totals[question->category]++;
-    if (correct) {
-        stats->category_correct[question->category]++;
+    stats->category_totals[delta->category]++;
+    if (delta->correct) {
+        stats->category_correct[delta->category]++;
+    }
+
+    // Update error and timing distributions
+    sketch_add(&stats->error_sketch, &sketch_percent_scale, delta->percent_error);
+    if (delta->response_seconds > 0.0f) {
+        sketch_add(&stats->seconds_sketch, &sketch_seconds_scale, delta->response_seconds);
     }
 }
 
 void print_session_summary(const session_stats_t *stats) {
+    char a[FMT_MAX_CHARS], b[FMT_MAX_CHARS];
+
     printf("\nSession Summary\n");
     printf("══════════════════════════════════════════\n");
 
     // Overall statistics
     if (stats->total_questions > 0) {
         float overall_percentage = (float)stats->correct_answers / stats->total_questions * 100.0f;
-        printf("Overall Performance: %d/%d correct (%.1f%%)\n",
-               stats->correct_answers, stats->total_questions, overall_percentage);
+        printf("Overall Performance: %d/%d correct (%s%%)\n",
+               stats->correct_answers, stats->total_questions, fixed_text(a, overall_percentage, 1));
+        printf("Error: median %s%%, p90 %s%%\n",
+               fixed_text(a, sketch_quantile(&stats->error_sketch, &sketch_percent_scale, 0.5f), 1),
+               fixed_text(b, sketch_quantile(&stats->error_sketch, &sketch_percent_scale, 0.9f), 1));
+        if (sketch_count(&stats->seconds_sketch) > 0) {
+            printf("Answer time: median %ss, p90 %ss\n",
+                   fixed_text(a, sketch_quantile(&stats->seconds_sketch, &sketch_seconds_scale, 0.5f), 1),
+                   fixed_text(b, sketch_quantile(&stats->seconds_sketch, &sketch_seconds_scale, 0.9f), 1));
+        }
     } else {
         printf("No questions answered this session.\n");
         return;
@@ -191,23 +305,16 @@ void print_session_summary(const session_stats_t *stats) {
     printf("\nCategory Breakdown:\n");
     printf("-------------------\n");
 
-    const char* category_names[] = {
-        "Distance",
-        "Weight",
-        "Temperature",
-        "Volume"
-    };
-
     bool any_categories = false;
     for (int i = 0; i < CATEGORY_COUNT; i++) {
         if (stats->category_totals[i] > 0) {
             any_categories = true;
             float category_percentage = (float)stats->category_correct[i] / stats->category_totals[i] * 100.0f;
-            printf("  %s: %d/%d correct (%.1f%%)\n",
+            printf("  %s: %d/%d correct (%s%%)\n",
                    category_names[i],
                    stats->category_correct[i],
                    stats->category_totals[i],
-                   category_percentage);
+                   fixed_text(a, category_percentage, 1));
         }
     }
 
@@ -221,64 +328,16 @@ void print_session_summary(const session_stats_t *stats) {
 void init_random_seed(void) {
     static bool initialized = false;
     if (!initialized) {
-        srand((unsigned int)time(NULL));
+        rng_seed(rng_default(), (uint64_t)time(NULL));
         initialized = true;
     }
 }
 
-float generate_random_value(float min, float max) {
+float generate_random_value_r(float min, float max, rng_t *rng) {
     if (min >= max) {
         return min;
     }
-
-    // Generate a random float between min and max
-    float range = max - min;
-    float random_fraction = (float)rand() / (float)RAND_MAX;
-    float result = min + (random_fraction * range);
-
-    // If whole numbers mode is enabled, round to nearest integer
-    if (g_whole_numbers_mode) {
-        result = roundf(result);
-        // Ensure we stay within bounds after rounding
-        if (result < min) result = roundf(min);
-        if (result > max) result = roundf(max);
-    }
-
-    // If easy mode is enabled, constrain to 1 or multiples of 5
-    if (g_easy_mode) {
-        int int_result = (int)result;
-
-        // Special case: if result is close to 1 and 1 is within bounds, use 1
-        if (int_result <= 2 && min <= 1.0f) {
-            result = 1.0f;
-        } else {
-            // Round to nearest multiple of 5
-            int multiple_of_5 = ((int_result + 2) / 5) * 5;  // Round to nearest 5
-            if (multiple_of_5 < 5) multiple_of_5 = 5;  // Minimum is 5
-            result = (float)multiple_of_5;
-        }
-
-        // Ensure we stay within bounds
-        if (result < min) {
-            // Find the smallest valid value (1 or next multiple of 5)
-            if (min <= 1.0f) {
-                result = 1.0f;
-            } else {
-                result = ((int)(min + 4) / 5) * 5;  // Round up to next multiple of 5
-            }
-        }
-        if (result > max) {
-            // Find the largest valid value within max
-            if (max >= 1.0f && ((int)max / 5) * 5 < 1.0f) {
-                result = 1.0f;  // Only 1 fits
-            } else {
-                result = ((int)max / 5) * 5;  // Round down to multiple of 5
-                if (result < 1.0f && max >= 1.0f) result = 1.0f;
-            }
-        }
-    }
-
-    return result;
+    return min + rng_unit(rng) * (max - min);
 }
 
 float round_to_precision(float value, int decimal_places) {
@@ -286,93 +345,10 @@ float round_to_precision(float value, int decimal_places) {
     return roundf(value * multiplier) / multiplier;
 }
 
-/* ========== Unit Conversion Functions ========== */
-/* Mathematical conversion functions organized by category */
-
-// Distance conversion functions
-float miles_to_km(float miles) {
-    return miles * 1.609344f;
-}
-
-float km_to_miles(float km) {
-    return km / 1.609344f;
-}
-
-float inches_to_cm(float inches) {
-    return inches * 2.54f;
-}
-
-float cm_to_inches(float cm) {
-    return cm / 2.54f;
-}
-
-float feet_to_meters(float feet) {
-    return feet * 0.3048f;
-}
-
-float meters_to_feet(float meters) {
-    return meters / 0.3048f;
-}
-
-float pounds_to_kg(float pounds) {
-    return pounds * 0.453592f;
-}
-
-float kg_to_pounds(float kg) {
-    return kg / 0.453592f;
-}
-
-float ounces_to_grams(float ounces) {
-    return ounces * 28.3495f;
-}
-
-float grams_to_ounces(float grams) {
-    return grams / 28.3495f;
-}
-
-float fahrenheit_to_celsius(float fahrenheit) {
-    return (fahrenheit - 32.0f) * 5.0f / 9.0f;
-}
-
-float celsius_to_fahrenheit(float celsius) {
-    return celsius * 9.0f / 5.0f + 32.0f;
-}
-
-
-float gallons_to_liters(float gallons) {
-    return gallons * 3.78541f;
-}
-
-float liters_to_gallons(float liters) {
-    return liters / 3.78541f;
-}
-
-float cups_to_ml(float cups) {
-    return cups * 236.588f;  // US cup to milliliters
-}
-
-float ml_to_cups(float ml) {
-    return ml / 236.588f;
-}
-
-float liters_to_fl_oz(float liters) {
-    return liters * 33.814f;  // Liters to fluid ounces
-}
-
-float fl_oz_to_liters(float fl_oz) {
-    return fl_oz / 33.814f;
-}
-
-float ml_to_fl_oz(float ml) {
-    return ml / 29.5735f;  // Milliliters to fluid ounces
-}
-
-float fl_oz_to_ml(float fl_oz) {
-    return fl_oz * 29.5735f;
-}
+/* ========== Category Helpers ========== */
 
 // Helper function to pick a random active category
-category_t pick_random_category(const category_selection_t *selection) {
+category_t pick_random_category_r(const category_selection_t *selection, rng_t *rng) {
     if (selection->num_active == 0) {
         return CATEGORY_DISTANCE; // Fallback
     }
@@ -388,125 +364,18 @@ category_t pick_random_category(const category_selection_t *selection) {
     }
 
     // Pick a random one
-    int random_index = rand() % count;
+    int random_index = (int)rng_below(rng, (uint32_t)count);
     return active_categories[random_index];
 }
 
-// Complete distance conversion data with realistic ranges
-static const conversion_info_t distance_conversions[] = {
-    {
-        "miles", "mi", "kilometers", "km",
-        miles_to_km, 1.0f, 100.0f, 2.0f
-    },
-    {
-        "kilometers", "km", "miles", "mi",
-        km_to_miles, 1.0f, 160.0f, 2.0f
-    },
-    {
-        "inches", "in", "centimeters", "cm",
-        inches_to_cm, 1.0f, 36.0f, 1.5f
-    },
-    {
-        "centimeters", "cm", "inches", "in",
-        cm_to_inches, 1.0f, 90.0f, 1.5f
-    },
-    {
-        "feet", "ft", "meters", "m",
-        feet_to_meters, 1.0f, 50.0f, 2.0f
-    },
-    {
-        "meters", "m", "feet", "ft",
-        meters_to_feet, 1.0f, 15.0f, 2.0f
-    }
-};
-
-static const conversion_info_t weight_conversions[] = {
-    {
-        "pounds", "lb", "kilograms", "kg",
-        pounds_to_kg, 1.0f, 200.0f, 2.0f
-    },
-    {
-        "kilograms", "kg", "pounds", "lb",
-        kg_to_pounds, 1.0f, 90.0f, 2.0f
-    },
-    {
-        "ounces", "oz", "grams", "g",
-        ounces_to_grams, 1.0f, 32.0f, 1.5f
-    },
-    {
-        "grams", "g", "ounces", "oz",
-        grams_to_ounces, 1.0f, 900.0f, 1.5f
-    }
-};
-
-static const conversion_info_t temperature_conversions[] = {
-    {
-        "degrees Fahrenheit", "F", "degrees Celsius", "C",
-        fahrenheit_to_celsius, -40.0f, 300.0f, 1.5f
-    },
-    {
-        "degrees Celsius", "C", "degrees Fahrenheit", "F",
-        celsius_to_fahrenheit, -40.0f, 150.0f, 1.5f
-    },
-};
-
-static const conversion_info_t volume_conversions[] = {
-    {
-        "gallons", "gal", "liters", "L",
-        gallons_to_liters, 1.0f, 20.0f, 2.0f
-    },
-    {
-        "liters", "L", "gallons", "gal",
-        liters_to_gallons, 1.0f, 75.0f, 2.0f
-    },
-    {
-        "cups", "cup", "milliliters", "ml",
-        cups_to_ml, 0.5f, 8.0f, 1.5f
-    },
-    {
-        "milliliters", "ml", "cups", "cup",
-        ml_to_cups, 100.0f, 2000.0f, 1.5f
-    },
-    {
-        "liters", "L", "fluid ounces", "fl oz",
-        liters_to_fl_oz, 1.0f, 3.0f, 2.0f
-    },
-    {
-        "fluid ounces", "fl oz", "liters", "L",
-        fl_oz_to_liters, 8.0f, 50.0f, 2.0f
-    },
-    {
-        "milliliters", "ml", "fluid ounces", "fl oz",
-        ml_to_fl_oz, 200.0f, 1000.0f, 2.0f
-    },
-    {
-        "fluid ounces", "fl oz", "milliliters", "ml",
-        fl_oz_to_ml, 4.0f, 16.0f, 2.0f
-    }
-};
-
-const conversion_info_t* get_conversions_for_category(category_t category, int *count) {
-    switch (category) {
-        case CATEGORY_DISTANCE:
-            *count = sizeof(distance_conversions) / sizeof(distance_conversions[0]);
-            return distance_conversions;
-
-        case CATEGORY_WEIGHT:
-            *count = sizeof(weight_conversions) / sizeof(weight_conversions[0]);
-            return weight_conversions;
-
-        case CATEGORY_TEMPERATURE:
-            *count = sizeof(temperature_conversions) / sizeof(temperature_conversions[0]);
-            return temperature_conversions;
-
-        case CATEGORY_VOLUME:
-            *count = sizeof(volume_conversions) / sizeof(volume_conversions[0]);
-            return volume_conversions;
-
-        default:
-            *count = 0;
-            return NULL;
+const unsigned char *get_conversions_for_category(category_t category, int *count) {
+    if (category < 0 || category >= CATEGORY_COUNT) {
+        *count = 0;
+        return category_conversions[0];
     }
+
+    *count = category_conversion_count[category];
+    return category_conversions[category];
 }
 
 /* ========== Input Validation and Handling Functions ========== */
@@ -541,29 +410,45 @@ bool is_valid_number(const char *input) {
     return true;
 }
 
-int get_numeric_answer(float *answer) {
-    static char input[64];
+bool parse_whole_number(const char *text, long min, long max, long *result) {
+    char *end;
+    errno = 0;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno != 0 || value < min || value > max) {
+        return false;
+    }
+    *result = value;
+    return true;
+}
 
-    printf("Your answer: ");
-    fflush(stdout);
+bool parse_seed(const char *text, uint64_t *seed) {
+    char *end;
 
-    if (fgets(input, sizeof(input), stdin) != NULL) {
-        // Remove newline if present
-        size_t len = strlen(input);
-        if (len > 0 && input[len - 1] == '\n') {
-            input[len - 1] = '\0';
-        }
+    // strtoull would take "-1" as 2^64-1 and skip leading spaces
+    if (!isdigit((unsigned char)*text)) {
+        return false;
+    }
+    errno = 0;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (*end != '\0' || errno != 0) {
+        return false;
+    }
+    *seed = (uint64_t)value;
+    return true;
+}
 
-        // Handle too-long input
-        if (len == sizeof(input) - 1 && input[len - 1] != '\0') {
-            // Clear remaining input
-            int c;
-            while ((c = getchar()) != '\n' && c != EOF);
-            printf("Input too long (max 31 characters).\n");
-            printf("Try a shorter number or use scientific notation (e.g., 1.2e6)\n");
-            return 0;
-        }
+int get_numeric_answer(input_t *in, float *answer) {
+    char input[64];
+
+    fputs("Your answer: ", stdout);
 
+    long len = input_line(in, input, sizeof(input));
+    if (len == INPUT_TOO_LONG) {
+        printf("Input too long (max %d characters).\n", (int)sizeof(input) - 1);
+        printf("Try a shorter number or use scientific notation (e.g., 1.2e6)\n");
+        return 0;
+    }
+    if (len >= 0) {
         // Trim whitespace
         char *start = input;
         while (*start && isspace(*start)) {
@@ -594,8 +479,8 @@ int get_numeric_answer(float *answer) {
             return 0;
         }
 
-        // Validate and parse number
-        if (!is_valid_number(start)) {
+        // Validate and parse number; "inf" and "nan" parse but are not answers
+        if (!is_valid_number(start) || !isfinite(strtof(start, NULL))) {
             printf("Invalid input: '%s'\n", start);
             printf("Please enter a valid number:\n");
             printf("  ✓ Whole numbers: 5, 42, 100\n");
@@ -609,7 +494,7 @@ int get_numeric_answer(float *answer) {
     }
 
     // EOF or read error
-    if (feof(stdin)) {
+    if (in->error == 0) {
         printf("\nExiting...\n");
     } else {
         printf("Error reading input.\n");
@@ -622,73 +507,146 @@ int get_numeric_answer(float *answer) {
 
 #define STATS_FILE ".metric_trainer_stats"
 
-void load_persistent_stats(persistent_stats_t *stats) {
-    FILE *file = fopen(STATS_FILE, "rb");
-    if (file == NULL) {
-        // No stats file exists yet, initialize with zeros
-        memset(stats, 0, sizeof(persistent_stats_t));
-        return;
+void user_data_path(const char *base, char *path, size_t size) {
+    user_file_path(g_user_name, base, path, size);
+}
+
+void user_file_path(const char *user, const char *base, char *path, size_t size) {
+    if (user != NULL) {
+        snprintf(path, size, "%s.%s", base, user);
+    } else {
+        snprintf(path, size, "%s", base);
     }
+}
 
-    size_t read = fread(stats, sizeof(persistent_stats_t), 1, file);
-    if (read != 1) {
-        // File corrupt or incomplete, reset stats
-        memset(stats, 0, sizeof(persistent_stats_t));
+void load_persistent_stats(persistent_stats_t *stats) {
+    int loaded;
+    if (g_user_name != NULL) {
+        loaded = userstore_load(USER_STORE_FILE, g_user_name, stats);
+    } else {
+        loaded = persist_load_stats(STATS_FILE, stats);
     }
 
-    fclose(file);
+    // Missing files start from zeros; damaged ones are worth a warning,
+    // since the next save replaces them
+    if (loaded < 0) {
+        fprintf(stderr, "Warning: could not read saved statistics from %s; starting fresh\n",
+                g_user_name != NULL ? USER_STORE_FILE : STATS_FILE);
+    }
 }
 
 void save_persistent_stats(const persistent_stats_t *stats) {
-    FILE *file = fopen(STATS_FILE, "wb");
-    if (file == NULL) {
-        return;  // Fail silently if can't save
+    // Fail silently if can't save
+    if (g_user_name != NULL) {
+        userstore_save(USER_STORE_FILE, g_user_name, stats);
+    } else {
+        persist_save_stats(STATS_FILE, stats);
     }
-
-    fwrite(stats, sizeof(persistent_stats_t), 1, file);
-    fclose(file);
 }
 
-void update_persistent_stats(persistent_stats_t *persistent, const question_t *question, float percent_error, bool correct) {
-    // Determine category from the question
-    category_t category = CATEGORY_DISTANCE;  // Default
+stats_delta_t make_stats_delta(const question_t *question, float answer, float percent_error, bool correct,
+                               float response_seconds) {
+    stats_delta_t delta;
+    delta.category = question->category;
+    delta.conversion_id = question->conversion_id;
+    delta.correct = correct;
+    delta.percent_error = percent_error;
+    delta.response_seconds = response_seconds;
+    delta.answered_at = time(NULL);
+    delta.value = question->value;
+    delta.answer = answer;
+    return delta;
+}
 
-    // Match by checking conversion units to determine category
-    if (strstr(question->from_unit, "mile") || strstr(question->from_unit, "feet") ||
-        strstr(question->from_unit, "inch") || strstr(question->from_unit, "meter") ||
-        strstr(question->from_unit, "centimeter") || strstr(question->from_unit, "kilometer")) {
-        category = CATEGORY_DISTANCE;
-    } else if (strstr(question->from_unit, "pound") || strstr(question->from_unit, "kilogram") ||
-               strstr(question->from_unit, "ounce") || strstr(question->from_unit, "gram")) {
-        category = CATEGORY_WEIGHT;
-    } else if (strstr(question->from_unit, "Celsius") || strstr(question->from_unit, "Fahrenheit")) {
-        category = CATEGORY_TEMPERATURE;
-    } else {
-        category = CATEGORY_VOLUME;  // gallons, liters, cups, ml, fl oz
-    }
+void apply_stats_delta(persistent_stats_t *persistent, const stats_delta_t *delta) {
+    category_t category = delta->category;
+    conversion_stats_t *conversion = &persistent->conversions[delta->conversion_id];
 
     persistent->total_questions[category]++;
-    if (correct) {
+    conversion->total++;
+    if (delta->correct) {
         persistent->correct_answers[category]++;
+        conversion->correct++;
+    }
+    persistent->total_error[category] += delta->percent_error;
+
+    sketch_add(&conversion->error_sketch, &sketch_percent_scale, delta->percent_error);
+    if (delta->response_seconds > 0.0f) {
+        sketch_add(&conversion->seconds_sketch, &sketch_seconds_scale, delta->response_seconds);
+    }
+}
+
+void merge_persistent_stats(persistent_stats_t *dst, const persistent_stats_t *src) {
+    for (int i = 0; i < CATEGORY_COUNT; i++) {
+        dst->total_questions[i] += src->total_questions[i];
+        dst->correct_answers[i] += src->correct_answers[i];
+        dst->total_error[i] += src->total_error[i];
+    }
+    for (int i = 0; i < CONVERSION_COUNT; i++) {
+        dst->conversions[i].total += src->conversions[i].total;
+        dst->conversions[i].correct += src->conversions[i].correct;
+        sketch_merge(&dst->conversions[i].error_sketch, &src->conversions[i].error_sketch);
+        sketch_merge(&dst->conversions[i].seconds_sketch, &src->conversions[i].seconds_sketch);
+    }
+}
+
+/*
+ * Distribution lines for one category: error and answer time quantiles
+ * from the merged per-conversion sketches, then one line per conversion.
+ * Statistics saved before per-conversion sketches existed print nothing.
+ */
+static void show_conversion_stats(const persistent_stats_t *stats, int category) {
+    int count;
+    const unsigned char *ids = get_conversions_for_category((category_t)category, &count);
+    sketch_t errors = {{0}};
+    sketch_t seconds = {{0}};
+    char a[FMT_MAX_CHARS], b[FMT_MAX_CHARS];
+
+    for (int i = 0; i < count; i++) {
+        int id = ids[i];
+        sketch_merge(&errors, &stats->conversions[id].error_sketch);
+        sketch_merge(&seconds, &stats->conversions[id].seconds_sketch);
+    }
+    if (sketch_count(&errors) == 0) {
+        return;
+    }
+
+    printf("  Median Error: %s%%    p90 Error: %s%%\n",
+           fixed_text(a, sketch_quantile(&errors, &sketch_percent_scale, 0.5f), 1),
+           fixed_text(b, sketch_quantile(&errors, &sketch_percent_scale, 0.9f), 1));
+    if (sketch_count(&seconds) > 0) {
+        printf("  Answer Time: median %ss, p90 %ss\n",
+               fixed_text(a, sketch_quantile(&seconds, &sketch_seconds_scale, 0.5f), 1),
+               fixed_text(b, sketch_quantile(&seconds, &sketch_seconds_scale, 0.9f), 1));
+    }
+
+    for (int i = 0; i < count; i++) {
+        int id = ids[i];
+        const conversion_stats_t *c = &stats->conversions[id];
+        if (c->total == 0) {
+            continue;
+        }
+        printf("    %s → %s: %d/%d correct, median error %s%%, p90 %s%%\n",
+               unit_string(conversion_names[id].from_unit),
+               unit_string(conversion_names[id].to_unit),
+               c->correct, c->total,
+               fixed_text(a, sketch_quantile(&c->error_sketch, &sketch_percent_scale, 0.5f), 1),
+               fixed_text(b, sketch_quantile(&c->error_sketch, &sketch_percent_scale, 0.9f), 1));
     }
-    persistent->total_error[category] += percent_error;
 }
 
 void show_persistent_stats(void) {
     persistent_stats_t stats;
+    char a[FMT_MAX_CHARS], b[FMT_MAX_CHARS];
     load_persistent_stats(&stats);
 
-    printf("\nLifetime Statistics\n");
+    if (g_user_name != NULL) {
+        printf("\nLifetime Statistics for %s\n", g_user_name);
+    } else {
+        printf("\nLifetime Statistics\n");
+    }
     printf("══════════════════════════════════════════\n\n");
 
-    const char* category_names[] = {"Distance", "Weight", "Temperature", "Volume"};
-    const char* category_descs[] = {
-        "(miles <-> km, feet <-> m, inches <-> cm)",
-        "(pounds <-> kg, ounces <-> grams)",
-        "(Celsius <-> Fahrenheit)",
-        "(gallons <-> liters, cups <-> ml, fl oz conversions)"
-    };
-
     bool has_data = false;
     for (int i = 0; i < CATEGORY_COUNT; i++) {
         if (stats.total_questions[i] > 0) {
@@ -711,49 +669,14 @@ void show_persistent_stats(void) {
         } else {
             float percent_correct = (float)stats.correct_answers[i] / stats.total_questions[i] * 100.0f;
             float avg_error = stats.total_error[i] / stats.total_questions[i];
-            printf("  Correct: %.1f%% (%d/%d)    Avg Error: %.1f%%\n",
-                   percent_correct, stats.correct_answers[i], stats.total_questions[i], avg_error);
+            printf("  Correct: %s%% (%d/%d)    Avg Error: %s%%\n", fixed_text(a, percent_correct, 1),
+                   stats.correct_answers[i], stats.total_questions[i], fixed_text(b, avg_error, 1));
+            show_conversion_stats(&stats, i);
         }
         printf("\n");
     }
 }
 
 void show_conversion_reference(void) {
-    printf("\nConversion Reference - All Formulas\n");
-    printf("═══════════════════════════════════\n\n");
-
-    // Distance conversions
-    printf("DISTANCE CONVERSIONS\n");
-    printf("────────────────────\n");
-    printf("Miles to kilometers:     miles × 8/5 = kilometers  (or × 1.609344)\n");
-    printf("Kilometers to miles:     kilometers × 5/8 = miles  (or ÷ 1.609344)\n");
-    printf("Inches to centimeters:   inches × 2.54 = centimeters\n");
-    printf("Centimeters to inches:   centimeters ÷ 2.54 = inches\n");
-    printf("Feet to meters:          feet × 0.3048 = meters\n");
-    printf("Meters to feet:          meters ÷ 0.3048 = feet\n");
-
-    printf("\nWEIGHT CONVERSIONS\n");
-    printf("──────────────────\n");
-    printf("Pounds to kilograms:     pounds × 0.453592 = kilograms\n");
-    printf("Kilograms to pounds:     kilograms ÷ 0.453592 = pounds\n");
-    printf("Ounces to grams:         ounces × 28.3495 = grams\n");
-    printf("Grams to ounces:         grams ÷ 28.3495 = ounces\n");
-
-    printf("\nTEMPERATURE CONVERSIONS\n");
-    printf("───────────────────────\n");
-    printf("Fahrenheit to Celsius:   (°F - 32) × 5/9 = °C\n");
-    printf("Celsius to Fahrenheit:   (°C × 9/5) + 32 = °F\n");
-
-    printf("\nVOLUME CONVERSIONS\n");
-    printf("──────────────────\n");
-    printf("Gallons to liters:       gallons × 3.78541 = liters\n");
-    printf("Liters to gallons:       liters ÷ 3.78541 = gallons\n");
-    printf("Cups to milliliters:     cups × 236.588 = milliliters\n");
-    printf("Milliliters to cups:     milliliters ÷ 236.588 = cups\n");
-    printf("Fluid ounces to ml:      fl oz × 29.5735 = milliliters\n");
-    printf("Milliliters to fl oz:    milliliters ÷ 29.5735 = fl oz\n");
-
-    printf("\n═══════════════════════════════════\n");
-    printf("Note: These formulas show the exact mathematical relationships.\n");
-    printf("During practice, answers within the tolerance range are accepted.\n\n");
+    fputs(reference_text, stdout);
 }
@@ -3,38 +3,70 @@
  * 
  * Data Structure Design:
  * 
- * 1. conversion_info_t: Defines a single conversion type with:
- *    - Unit names and abbreviations (e.g., "miles"/"mi" -> "kilometers"/"km")
- *    - Conversion function pointer for the mathematical transformation
+ * 1. conversion_info_t: Hot data for a single conversion type, with:
+ *    - Linear coefficients for the mathematical transformation
  *    - Practical value ranges for generating realistic questions
  *    - Tolerance percentage for accepting "close enough" answers
+ *    - The exact rational form of the conversion for fixed-point grading
+ *    - Value grids for the whole and easy modes
+ *    Each entry is padded to one cache line and the table is aligned, so
+ *    generating or grading a question reads exactly one cache line.
+ *
+ *    conversion_names_t: Cold data for the same conversion - offsets of
+ *    the unit names and abbreviations (e.g., "miles"/"mi" -> "kilometers"/"km")
+ *    in a shared, interned string table. Only display code touches it.
  * 
  * 2. question_t: Represents a single generated question with:
- *    - Category and direction information  
+ *    - Category, conversion id and direction information
  *    - Specific value to convert and correct answer
  *    - Human-readable question text
  *    - Calculated tolerance for this specific question
  * 
+ *    In --whole and --easy modes the question value is an integer, so the
+ *    answer key and tolerance are computed exactly in hundredths of a unit
+ *    from the rational form and answers are graded with integer compares.
+ *
  * 3. session_stats_t: Tracks user performance across categories
  *    - Overall and per-category statistics
  *    - Used for identifying weak areas and progress tracking
  * 
  * The system supports bidirectional conversions (metric ↔ imperial) with
- * realistic value ranges and flexible answer tolerance.
+ * realistic value ranges and flexible answer tolerance. The conversion
+ * catalog itself lives in conversions.def and is compiled into static
+ * tables at build time (see tables.h).
  */
 
 #ifndef QUESTIONS_H
 #define QUESTIONS_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include "input.h"
+#include "rng.h"
+#include "sketch.h"
 
 /* ========== Global Variables ========== */
 extern bool g_whole_numbers_mode;  // Flag for whole numbers only mode
 extern bool g_easy_mode;           // Flag for easy mode (increments of 5)
+extern const char *g_user_name;    // Selected --user, or NULL for the shared stats file
 
-#define MAX_UNIT_NAME 32
 #define MAX_QUESTION_TEXT 128
+#define MAX_DATA_PATH 80                  // USER_NAME_MAX plus the longest base name
 #define MAX_CONVERSIONS_PER_CATEGORY 8
+#define MAX_PERCENT_ERROR 1000.0f         // Errors are capped here (ten times off)
+#define MAX_ANSWER_MAGNITUDE 1e12f        // Answers beyond this are graded unread
+
+/* Number of conversions in the catalog, counted from conversions.def */
+enum {
+    CONVERSION_COUNT = 0
+#define CONVERSION(...) + 1
+#include "conversions.def"
+};
+
+/* Ids are one byte in saved records and one bit in the answer log's block bitmaps */
+#define CONVERSION_ID_LIMIT 64
+typedef char conversion_id_limit_check[(CONVERSION_COUNT <= CONVERSION_ID_LIMIT) ? 1 : -1];
 
 typedef enum {
     CATEGORY_DISTANCE = 0,
@@ -56,25 +88,44 @@ typedef struct {
 } category_selection_t;
 
 typedef struct {
-    char from_unit[MAX_UNIT_NAME];      // e.g., "miles", "F"
-    char from_abbrev[8];                // e.g., "mi", "F" 
-    char to_unit[MAX_UNIT_NAME];        // e.g., "kilometers", "C"
-    char to_abbrev[8];                  // e.g., "km", "C"
-    float (*convert_func)(float);       // Function pointer for conversion
+    float scale;                        // Conversion is value * scale + offset
+    float offset;                       // Additive term (non-zero for temperatures)
     float min_value;                    // Minimum practical value to generate
     float max_value;                    // Maximum practical value to generate
     float tolerance_percent;            // Acceptable error percentage (e.g., 1.0 for 1%)
+    int num;                            // Exact form of the conversion:
+    int den;                            //   (value + pre_offset) * num / den
+    short pre_offset;                   //   + post_offset
+    short post_offset;
+    unsigned short tolerance_permille;  // tolerance_percent in tenths of a percent
+    unsigned short whole_first;         // Whole numbers value grid (slice of grid_values)
+    unsigned short whole_count;
+    unsigned short easy_first;          // Easy mode value grid (slice of grid_values)
+    unsigned short easy_count;
+    unsigned char category;             // category_t this conversion belongs to
+    unsigned char reserved[21];         // Pads the entry to 64 bytes
 } conversion_info_t;
 
+typedef struct {
+    unsigned short from_unit;           // e.g., "miles", "F"
+    unsigned short from_abbrev;         // e.g., "mi", "F"
+    unsigned short to_unit;             // e.g., "kilometers", "C"
+    unsigned short to_abbrev;           // e.g., "km", "C"
+} conversion_names_t;                   // Offsets into unit_strings
+
 typedef struct {
     category_t category;
+    int conversion_id;                  // Stable id (conversions.def), also the table index
     conversion_direction_t direction;   // Which direction this conversion goes
-    char from_unit[MAX_UNIT_NAME];
-    char to_unit[MAX_UNIT_NAME];
+    const char *from_unit;              // Points into unit_strings
+    const char *to_unit;
     float value;                        // The value to convert
     float correct_answer;               // The correct converted value
     char question_text[MAX_QUESTION_TEXT];
     float tolerance;                    // Acceptable tolerance for this specific question
+    bool exact;                         // Graded in fixed point (whole/easy modes)
+    long answer_centi;                  // Exact answer in hundredths (when exact)
+    long tolerance_centi;               // Exact tolerance in hundredths (when exact)
 } question_t;
 
 typedef struct {
@@ -82,45 +133,47 @@ typedef struct {
     int correct_answers;
     int category_totals[CATEGORY_COUNT];
     int category_correct[CATEGORY_COUNT];
+    sketch_t error_sketch;              // Percent error (sketch_percent_scale)
+    sketch_t seconds_sketch;            // Response time (sketch_seconds_scale)
 } session_stats_t;
 
+/* Lifetime results for one conversion, indexed by its stable id */
+typedef struct {
+    int total;
+    int correct;
+    sketch_t error_sketch;              // Percent error (sketch_percent_scale)
+    sketch_t seconds_sketch;            // Response time (sketch_seconds_scale)
+} conversion_stats_t;
+
+/*
+ * Stored as 32-bit words; new fields go at the end (see persist.h).
+ * conversions[] is keyed by id and must stay last: a conversion added to
+ * the catalog extends it, and older files load with the new one zeroed
+ */
 typedef struct {
     int total_questions[CATEGORY_COUNT];
     int correct_answers[CATEGORY_COUNT];
     float total_error[CATEGORY_COUNT];  // Sum of all percent errors for average calculation
+    conversion_stats_t conversions[CONVERSION_COUNT];
 } persistent_stats_t;
 
+/* One graded answer's contribution to the statistics */
+typedef struct {
+    category_t category;
+    int conversion_id;
+    bool correct;
+    float percent_error;
+    float response_seconds;             // Time from question shown to answer entered
+    time_t answered_at;                 // Wall-clock time of the answer
+    float value;                        // Value the question asked about
+    float answer;                       // Answer given
+} stats_delta_t;
+
 typedef struct {
     bool is_correct;
     float percent_error;
 } answer_result_t;
 
-/* ========== Conversion Functions ========== */
-/* Mathematical conversion functions for unit transformations */
-
-float miles_to_km(float miles);               /* Convert miles to kilometers */
-float km_to_miles(float km);                  /* Convert kilometers to miles */
-float inches_to_cm(float inches);             /* Convert inches to centimeters */
-float cm_to_inches(float cm);                 /* Convert centimeters to inches */
-float feet_to_m(float feet);                  /* Convert feet to meters */
-float m_to_feet(float m);                     /* Convert meters to feet */
-float pounds_to_kg(float pounds);             /* Convert pounds to kilograms */
-float kg_to_pounds(float kg);                 /* Convert kilograms to pounds */
-float ounces_to_grams(float ounces);          /* Convert ounces to grams */
-float grams_to_ounces(float grams);           /* Convert grams to ounces */
-float fahrenheit_to_celsius(float fahrenheit); /* Convert Fahrenheit to Celsius */
-float celsius_to_fahrenheit(float celsius);   /* Convert Celsius to Fahrenheit */
-float celsius_to_kelvin(float celsius);       /* Convert Celsius to Kelvin */
-float kelvin_to_celsius(float kelvin);        /* Convert Kelvin to Celsius */
-float gallons_to_liters(float gallons);       /* Convert gallons to liters */
-float liters_to_gallons(float liters);        /* Convert liters to gallons */
-float cups_to_ml(float cups);                 /* Convert cups to milliliters */
-float ml_to_cups(float ml);                   /* Convert milliliters to cups */
-float liters_to_fl_oz(float liters);          /* Convert liters to fluid ounces */
-float fl_oz_to_liters(float fl_oz);           /* Convert fluid ounces to liters */
-float ml_to_fl_oz(float ml);                  /* Convert milliliters to fluid ounces */
-float fl_oz_to_ml(float fl_oz);               /* Convert fluid ounces to milliliters */
-
 /* ========== Core Functions ========== */
 /* Primary system functionality for question generation and management */
 
@@ -146,20 +199,48 @@ bool parse_category_input(const char *input, category_selection_t *selection);
 question_t generate_question(const category_selection_t *selection);
 
 /**
- * Check if user's answer is within acceptable tolerance
+ * Generate a question drawing randomness from a caller-owned generator
+ * @param selection Pointer to active category selection
+ * @param rng Generator to draw from (safe to use one per thread)
+ * @return Generated question_t structure with all fields populated
+ */
+question_t generate_question_r(const category_selection_t *selection, rng_t *rng);
+
+/**
+ * Generate a question for one specific conversion
+ * @param conversion_id Conversion id (the index into conversion_table)
+ * @param rng Generator to draw the question value from
+ * @return Generated question_t structure with all fields populated
+ */
+question_t generate_question_for(int conversion_id, rng_t *rng);
+
+/**
+ * Check if user's answer is within acceptable tolerance and print feedback
  * @param question Pointer to the question being answered
  * @param user_answer The user's numeric answer
  * @return answer_result_t containing correctness and error percentage
  */
 answer_result_t check_answer(const question_t *question, float user_answer);
 
+/**
+ * Grade an answer without printing anything (shared by check_answer).
+ * The error is relative to the size of the correct answer, or to the
+ * tolerance when the correct answer is 0, and is capped at
+ * MAX_PERCENT_ERROR; answers that are not finite or exceed
+ * MAX_ANSWER_MAGNITUDE are incorrect with the capped error
+ * @param question Pointer to the question being answered
+ * @param user_answer The user's numeric answer
+ * @return answer_result_t containing correctness and error percentage
+ *         (always finite, 0 to MAX_PERCENT_ERROR)
+ */
+answer_result_t grade_answer(const question_t *question, float user_answer);
+
 /**
  * Update session statistics with question result
  * @param stats Pointer to session_stats_t to update
- * @param question Pointer to the question that was answered
- * @param correct Whether the answer was correct
+ * @param delta The graded answer (see make_stats_delta)
  */
-void update_stats(session_stats_t *stats, const question_t *question, bool correct);
+void update_stats(session_stats_t *stats, const stats_delta_t *delta);
 
 /**
  * Print comprehensive session summary with statistics
@@ -172,10 +253,11 @@ void print_session_summary(const session_stats_t *stats);
 
 /**
  * Get and validate numeric answer from user input
+ * @param in Input to read the answer line from
  * @param answer Pointer to float to store the parsed answer
  * @return 1 if valid number entered, -1 for quit/exit, 0 for skip/error
  */
-int get_numeric_answer(float *answer);
+int get_numeric_answer(input_t *in, float *answer);
 
 /**
  * Validate that a string represents a valid number
@@ -184,31 +266,50 @@ int get_numeric_answer(float *answer);
  */
 bool is_valid_number(const char *input);
 
+/**
+ * Parse a whole-number option value
+ * @param text Option value
+ * @param min Smallest value accepted
+ * @param max Largest value accepted
+ * @param result Receives the value
+ * @return true if text is a whole number from min to max with nothing after it
+ */
+bool parse_whole_number(const char *text, long min, long max, long *result);
+
+/**
+ * Parse a --seed value: digits only, 0 to 2^64-1
+ * @return true if text is a valid seed
+ */
+bool parse_seed(const char *text, uint64_t *seed);
+
 /* ========== Utility Functions ========== */
 /* Helper functions for internal system operations */
 
 /**
- * Get array of conversion info for a specific category
+ * Get the conversions belonging to a specific category
  * @param category The category to retrieve conversions for
  * @param count Pointer to int to store the number of conversions
- * @return Pointer to array of conversion_info_t structures
+ * @return The category's conversion ids, in id order
  */
-const conversion_info_t* get_conversions_for_category(category_t category, int *count);
+const unsigned char *get_conversions_for_category(category_t category, int *count);
 
 /**
  * Randomly select an active category from user selection
  * @param selection Pointer to category selection with active flags
+ * @param rng Generator to draw from
  * @return Randomly chosen active category
  */
-category_t pick_random_category(const category_selection_t *selection);
+category_t pick_random_category_r(const category_selection_t *selection, rng_t *rng);
 
 /**
  * Generate random floating point value within specified range
  * @param min Minimum value (inclusive)
  * @param max Maximum value (inclusive)
- * @return Random float between min and max
+ * @param rng Generator to draw from
+ * @return Random float between min and max (whole and easy modes draw
+ *         from the precomputed grids instead)
  */
-float generate_random_value(float min, float max);
+float generate_random_value_r(float min, float max, rng_t *rng);
 
 /**
  * Round value to specified number of decimal places
@@ -219,30 +320,65 @@ float generate_random_value(float min, float max);
 float round_to_precision(float value, int decimal_places);
 
 /**
- * Initialize random number generator with current time seed
+ * Seed the default generator (rng_default) with the current time
  */
 void init_random_seed(void);
 
 /**
- * Load persistent statistics from file
+ * Name of a per-user data file: the base name, suffixed with ".<user>"
+ * when --user is set
+ * @param base Base file name, e.g. ".metric_trainer_progress"
+ * @param path Receives the file name
+ * @param size Size of path (MAX_DATA_PATH is always enough)
+ */
+void user_data_path(const char *base, char *path, size_t size);
+
+/**
+ * Name of another user's data file, as user_data_path names it
+ * @param user User name, or NULL for the shared file
+ * @param base Base file name
+ * @param path Receives the file name
+ * @param size Size of path (MAX_DATA_PATH is always enough)
+ */
+void user_file_path(const char *user, const char *base, char *path, size_t size);
+
+/**
+ * Load persistent statistics from file (the user store when --user is set)
  * @param stats Pointer to persistent_stats_t to populate
  */
 void load_persistent_stats(persistent_stats_t *stats);
 
 /**
- * Save persistent statistics to file
+ * Save persistent statistics to file (the user store when --user is set)
  * @param stats Pointer to persistent_stats_t to save
  */
 void save_persistent_stats(const persistent_stats_t *stats);
 
 /**
- * Update persistent statistics with session data
+ * Add one answer to persistent statistics
  * @param persistent Pointer to persistent statistics
- * @param session Pointer to session statistics
- * @param question Pointer to current question for category info
+ * @param delta The answer (see make_stats_delta)
+ */
+void apply_stats_delta(persistent_stats_t *persistent, const stats_delta_t *delta);
+
+/**
+ * Describe a graded answer as a stats delta
+ * @param question The question answered
+ * @param answer The answer given
  * @param percent_error The error percentage for this answer
+ * @param correct Whether the answer was within tolerance
+ * @param response_seconds Time taken to answer
+ * @return The delta to apply or queue, stamped with the current time
+ */
+stats_delta_t make_stats_delta(const question_t *question, float answer, float percent_error, bool correct,
+                               float response_seconds);
+
+/**
+ * Add one set of persistent statistics to another
+ * @param dst Statistics to add to
+ * @param src Statistics to add
  */
-void update_persistent_stats(persistent_stats_t *persistent, const question_t *question, float percent_error, bool correct);
+void merge_persistent_stats(persistent_stats_t *dst, const persistent_stats_t *src);
 
 /**
  * Display persistent statistics by category
@@ -0,0 +1,114 @@
+/*
+ * rng.c - Explicit-State Random Number Generation
+ *
+ * xoshiro256** 1.0 by David Blackman and Sebastiano Vigna, including
+ * their jump and long-jump polynomials. Seeds are expanded to the 256-bit
+ * state with SplitMix64, as the authors recommend, so every 64-bit seed
+ * (including zero) gives a valid non-zero state.
+ */
+
+#include "rng.h"
+
+static uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(rng_t *rng, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        rng->s[i] = splitmix64(&seed);
+    }
+}
+
+uint64_t rng_next(rng_t *rng) {
+    uint64_t *s = rng->s;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return result;
+}
+
+// Apply a jump polynomial: equivalent to calling rng_next 2^128 (or 2^192) times
+static void jump_with(rng_t *rng, const uint64_t polynomial[4]) {
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (polynomial[i] & ((uint64_t)1 << b)) {
+                s0 ^= rng->s[0];
+                s1 ^= rng->s[1];
+                s2 ^= rng->s[2];
+                s3 ^= rng->s[3];
+            }
+            rng_next(rng);
+        }
+    }
+
+    rng->s[0] = s0;
+    rng->s[1] = s1;
+    rng->s[2] = s2;
+    rng->s[3] = s3;
+}
+
+void rng_jump(rng_t *rng) {
+    static const uint64_t jump[4] = {
+        0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+        0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+    };
+    jump_with(rng, jump);
+}
+
+void rng_long_jump(rng_t *rng) {
+    static const uint64_t long_jump[4] = {
+        0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL,
+        0x77710069854ee241ULL, 0x39109bb02acbe635ULL
+    };
+    jump_with(rng, long_jump);
+}
+
+void rng_seed_stream(rng_t *rng, uint64_t seed, uint64_t stream) {
+    rng_seed(rng, seed);
+    for (uint64_t i = 0; i < stream; i++) {
+        rng_jump(rng);
+    }
+}
+
+void rng_derive_streams(uint64_t seed, int count, rng_t *streams) {
+    rng_t current;
+    rng_seed(&current, seed);
+
+    for (int i = 0; i < count; i++) {
+        streams[i] = current;
+        rng_jump(&current);
+    }
+}
+
+uint32_t rng_below(rng_t *rng, uint32_t bound) {
+    // Multiply-shift maps 32 random bits onto [0, bound) without division
+    return (uint32_t)(((rng_next(rng) >> 32) * (uint64_t)bound) >> 32);
+}
+
+float rng_unit(rng_t *rng) {
+    return (float)(rng_next(rng) >> 40) / (float)((1 << 24) - 1);
+}
+
+rng_t *rng_default(void) {
+    static rng_t default_rng = {{
+        0x9e3779b97f4a7c15ULL, 0xbf58476d1ce4e5b9ULL,
+        0x94d049bb133111ebULL, 0x2545f4914f6cdd1dULL
+    }};
+    return &default_rng;
+}
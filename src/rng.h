@@ -0,0 +1,77 @@
+/*
+ * rng.h - Explicit-State Random Number Generation
+ *
+ * The question engine draws all randomness through an rng_t that the
+ * caller owns, so independent generators can run side by side (one per
+ * worker thread, one per worksheet chunk) without sharing state.
+ *
+ * The generator is xoshiro256**, which supports jumping ahead by 2^128
+ * draws. Stream k of a seed is the seeded state jumped k times, so
+ * streams never overlap in practice, and a run split into shards gives
+ * the same numbers whether the shards run serially or in parallel.
+ */
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint64_t s[4];
+} rng_t;
+
+/**
+ * Seed a generator
+ * @param rng Generator to initialize
+ * @param seed Any 64-bit value (including 0)
+ */
+void rng_seed(rng_t *rng, uint64_t seed);
+
+/**
+ * Seed a generator with stream number `stream` derived from `seed`
+ * Costs one jump per stream number; use rng_derive_streams for many.
+ * @param rng Generator to initialize
+ * @param seed Base seed shared by all streams
+ * @param stream Stream index (e.g., worksheet chunk number)
+ */
+void rng_seed_stream(rng_t *rng, uint64_t seed, uint64_t stream);
+
+/**
+ * Derive consecutive streams 0..count-1 of a seed in one pass
+ * @param seed Base seed
+ * @param count Number of streams to derive
+ * @param streams Output array of count generators
+ */
+void rng_derive_streams(uint64_t seed, int count, rng_t *streams);
+
+/**
+ * Advance a generator by 2^128 draws (moves it to the next stream)
+ */
+void rng_jump(rng_t *rng);
+
+/**
+ * Advance a generator by 2^192 draws (for splitting streams further)
+ */
+void rng_long_jump(rng_t *rng);
+
+/**
+ * Draw the next 64 random bits
+ */
+uint64_t rng_next(rng_t *rng);
+
+/**
+ * Draw a uniform integer in [0, bound) - bound must be positive
+ */
+uint32_t rng_below(rng_t *rng, uint32_t bound);
+
+/**
+ * Draw a uniform float in [0, 1]
+ */
+float rng_unit(rng_t *rng);
+
+/**
+ * The process-wide generator used by the interactive trainer
+ */
+rng_t *rng_default(void);
+
+#endif
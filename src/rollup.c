@@ -0,0 +1,298 @@
+/*
+ * rollup.c - Daily and Weekly Progress Rollups
+ *
+ * Records are kept in memory in file order. The records an answer
+ * updates belong to the current day and week, so they are found by
+ * scanning back from the end and stopping at the first day record older
+ * than the current week.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "persist.h"
+#include "rollup.h"
+
+#define ROLLUP_MAGIC "MTPR"
+#define ROLLUP_VERSION 1
+#define ROLLUP_HEADER_SIZE 16
+#define ROLLUP_WORDS (sizeof(rollup_record_t) / 4)
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t byte_order;
+    uint32_t record_size;
+    uint32_t reserved;
+} rollup_header_t;
+
+typedef char rollup_record_size_check[(sizeof(rollup_record_t) == 32) ? 1 : -1];
+
+/* ========== Calendar ========== */
+
+/* Days from 1970-01-01 to a proleptic Gregorian date (H. Hinnant's algorithm) */
+static long days_from_civil(long y, int m, int d) {
+    y -= m <= 2;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+uint32_t rollup_day(time_t when) {
+    struct tm tm;
+    localtime_r(&when, &tm);
+    long day = days_from_civil(tm.tm_year + 1900L, tm.tm_mon + 1, tm.tm_mday);
+    return day > 0 ? (uint32_t)day : 0;
+}
+
+uint32_t rollup_week(uint32_t day) {
+    return (day + 3) / 7;  // 1970-01-01 was a Thursday
+}
+
+uint32_t rollup_week_start(uint32_t week) {
+    return week > 0 ? week * 7 - 3 : 0;
+}
+
+void rollup_format_day(uint32_t day, char *buf) {
+    long z = (long)day + 719468;
+    long era = z / 146097;
+    long doe = z - era * 146097;
+    long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long mp = (5 * doy + 2) / 153;
+    int d = (int)(doy - (153 * mp + 2) / 5 + 1);
+    int m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    long y = yoe + era * 400 + (m <= 2);
+    snprintf(buf, 16, "%04ld-%02d-%02d", y % 10000, m % 100, d % 100);
+}
+
+/* ========== Records ========== */
+
+static uint32_t swap32(uint32_t v) {
+    return (v >> 24) | ((v >> 8) & 0xff00u) | ((v << 8) & 0xff0000u) | (v << 24);
+}
+
+static uint32_t record_crc(const rollup_record_t *record) {
+    return persist_crc32(record, offsetof(rollup_record_t, crc));
+}
+
+/*
+ * Find the record for a period, appending an empty one if there is none.
+ * Appending can move every record, so the record is returned by index
+ */
+static int find_or_add(rollup_t *rollup, rollup_kind_t kind, uint32_t period,
+                       int conversion_id, uint32_t week_start, size_t *index) {
+    uint32_t tag = (uint32_t)kind << 8 | (uint32_t)conversion_id;
+
+    for (size_t i = rollup->count; i-- > 0;) {
+        rollup_record_t *record = &rollup->records[i];
+        if (record->period == period && record->tag == tag) {
+            if (i < rollup->first_dirty) {
+                rollup->first_dirty = i;
+            }
+            *index = i;
+            return 0;
+        }
+        if ((record->tag >> 8) == ROLLUP_DAY && record->period < week_start) {
+            break;  // Everything earlier belongs to past weeks
+        }
+    }
+
+    if (rollup->count == rollup->capacity) {
+        size_t capacity = rollup->capacity > 0 ? rollup->capacity * 2 : 256;
+        rollup_record_t *records = realloc(rollup->records, capacity * sizeof(*records));
+        if (records == NULL) {
+            return -1;
+        }
+        rollup->records = records;
+        rollup->capacity = capacity;
+    }
+
+    rollup_record_t *record = &rollup->records[rollup->count];
+    memset(record, 0, sizeof(*record));
+    record->period = period;
+    record->tag = tag;
+    if (rollup->count < rollup->first_dirty) {
+        rollup->first_dirty = rollup->count;
+    }
+    *index = rollup->count++;
+    return 0;
+}
+
+void rollup_add(rollup_t *rollup, const stats_delta_t *delta) {
+    uint32_t day = rollup_day(delta->answered_at);
+    uint32_t week = rollup_week(day);
+    size_t indexes[2];
+    bool found[2] = {
+        find_or_add(rollup, ROLLUP_DAY, day, delta->conversion_id,
+                    rollup_week_start(week), &indexes[0]) == 0,
+        find_or_add(rollup, ROLLUP_WEEK, week, delta->conversion_id,
+                    rollup_week_start(week), &indexes[1]) == 0,
+    };
+
+    // Both lookups are done before either record is touched: the second
+    // may have reallocated the array
+    for (int i = 0; i < 2; i++) {
+        if (!found[i]) {
+            continue;
+        }
+        rollup_record_t *record = &rollup->records[indexes[i]];
+        record->answers++;
+        if (delta->correct) {
+            record->correct++;
+        }
+        record->error_sum += delta->percent_error;
+        if (delta->response_seconds > 0.0f) {
+            record->seconds_sum += delta->response_seconds;
+            record->timed++;
+        }
+        record->crc = record_crc(record);
+    }
+}
+
+/* ========== Files ========== */
+
+int rollup_load(const char *path, rollup_t *rollup) {
+    memset(rollup, 0, sizeof(*rollup));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        rollup->rewrite = true;
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    struct stat st;
+    rollup_header_t header;
+    int result = -1;
+
+    if (fstat(fd, &st) != 0 || st.st_size < ROLLUP_HEADER_SIZE ||
+        persist_read_at(fd, &header, sizeof(header), 0) != 0 ||
+        memcmp(header.magic, ROLLUP_MAGIC, 4) != 0) {
+        goto done;
+    }
+    bool swap = header.byte_order == PERSIST_BYTE_ORDER_SWAPPED;
+    if (!swap && header.byte_order != PERSIST_BYTE_ORDER) {
+        goto done;
+    }
+    // The record size is checked unswapped as well: 32 either way round
+    if (header.record_size != sizeof(rollup_record_t) &&
+        header.record_size != (uint32_t)sizeof(rollup_record_t) << 24) {
+        goto done;
+    }
+
+    size_t count = (size_t)(st.st_size - ROLLUP_HEADER_SIZE) / sizeof(rollup_record_t);
+    rollup->records = malloc((count > 0 ? count : 1) * sizeof(rollup_record_t));
+    if (rollup->records == NULL ||
+        persist_read_at(fd, rollup->records, count * sizeof(rollup_record_t), ROLLUP_HEADER_SIZE) != 0) {
+        free(rollup->records);
+        rollup->records = NULL;
+        goto done;
+    }
+    rollup->capacity = count;
+
+    // Keep the records whose CRC holds. The CRC covers the words in the
+    // writer's byte order, so it is checked before converting
+    for (size_t i = 0; i < count; i++) {
+        rollup_record_t record = rollup->records[i];
+        uint32_t crc = swap ? swap32(record.crc) : record.crc;
+        if (record_crc(&record) != crc) {
+            continue;
+        }
+        if (swap) {
+            uint32_t words[ROLLUP_WORDS];
+            memcpy(words, &record, sizeof(words));
+            for (size_t w = 0; w < ROLLUP_WORDS; w++) {
+                words[w] = swap32(words[w]);
+            }
+            memcpy(&record, words, sizeof(words));
+            record.crc = record_crc(&record);
+        }
+        rollup->records[rollup->count++] = record;
+    }
+    rollup->first_dirty = rollup->count;
+    rollup->rewrite = swap || rollup->count != count ||
+                      (st.st_size - ROLLUP_HEADER_SIZE) % sizeof(rollup_record_t) != 0;
+    result = 0;
+
+done:
+    if (result != 0) {
+        rollup->rewrite = true;  // Start over rather than patch a file we cannot read
+    }
+    close(fd);
+    return result;
+}
+
+int rollup_flush(const char *path, rollup_t *rollup) {
+    if (rollup->rewrite) {
+        rollup_header_t header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, ROLLUP_MAGIC, 4);
+        header.version = ROLLUP_VERSION;
+        header.byte_order = PERSIST_BYTE_ORDER;
+        header.record_size = sizeof(rollup_record_t);
+
+        size_t tmp_len = strlen(path) + 5;
+        char *tmp_path = malloc(tmp_len);
+        if (tmp_path == NULL) {
+            return -1;
+        }
+        snprintf(tmp_path, tmp_len, "%s.tmp", path);
+
+        int result = -1;
+        int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            if (persist_write_at(fd, &header, sizeof(header), 0) == 0 &&
+                persist_write_at(fd, rollup->records, rollup->count * sizeof(rollup_record_t),
+                                 ROLLUP_HEADER_SIZE) == 0 &&
+                fsync(fd) == 0) {
+                result = 0;
+            }
+            if (close(fd) != 0 || (result == 0 && rename(tmp_path, path) != 0)) {
+                result = -1;
+            }
+            if (result != 0) {
+                unlink(tmp_path);
+            }
+        }
+        free(tmp_path);
+
+        if (result == 0) {
+            rollup->rewrite = false;
+            rollup->first_dirty = rollup->count;
+        }
+        return result;
+    }
+
+    if (rollup->first_dirty >= rollup->count) {
+        return 0;
+    }
+
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    size_t first = rollup->first_dirty;
+    int result = persist_write_at(fd, &rollup->records[first],
+                                  (rollup->count - first) * sizeof(rollup_record_t),
+                                  ROLLUP_HEADER_SIZE + (off_t)(first * sizeof(rollup_record_t)));
+    if (result == 0) {
+        result = fdatasync(fd);
+    }
+    close(fd);
+
+    if (result == 0) {
+        rollup->first_dirty = rollup->count;
+    }
+    return result;
+}
+
+void rollup_free(rollup_t *rollup) {
+    free(rollup->records);
+    memset(rollup, 0, sizeof(*rollup));
+}
@@ -0,0 +1,98 @@
+/*
+ * rollup.h - Daily and Weekly Progress Rollups
+ *
+ * Running totals of answers, correct answers, error and answer time for
+ * each conversion per calendar day and per week (Monday to Sunday, local
+ * time). Rollups are updated as answers come in, so trends over any
+ * span are read straight from them without replaying history; category
+ * figures are sums over the category's conversions.
+ *
+ * File layout (.metric_trainer_progress, suffixed with ".<user>" for
+ * --user): a 16-byte header - magic "MTPR", u16 version, u16 byte order,
+ * u32 record size, u32 reserved - then 32-byte records in the order
+ * their period began. Since only the current day's and week's records
+ * change, a flush rewrites just the records touched since the last one.
+ * Each record carries its own CRC; a record torn by a crash is dropped
+ * on load, losing that conversion's figures for one day or week.
+ */
+
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "questions.h"
+
+#define PROGRESS_FILE ".metric_trainer_progress"
+
+typedef enum {
+    ROLLUP_DAY = 1,
+    ROLLUP_WEEK = 2
+} rollup_kind_t;
+
+/* Stored as eight 32-bit words */
+typedef struct {
+    uint32_t period;        // Days since 1970-01-01, or weeks since the Monday before it
+    uint32_t tag;           // kind << 8 | conversion id
+    uint32_t answers;
+    uint32_t correct;
+    float error_sum;        // Sum of percent errors
+    float seconds_sum;      // Sum of answer times, over `timed` answers
+    uint32_t timed;
+    uint32_t crc;           // CRC-32 of the words above
+} rollup_record_t;
+
+typedef struct {
+    rollup_record_t *records;
+    size_t count;
+    size_t capacity;
+    size_t first_dirty;     // Records from here on are unsaved
+    bool rewrite;           // The whole file needs writing (new or foreign byte order)
+} rollup_t;
+
+/**
+ * Local calendar day of a time, counted from 1970-01-01
+ */
+uint32_t rollup_day(time_t when);
+
+/**
+ * Week containing a day, counted in Monday-to-Sunday weeks
+ */
+uint32_t rollup_week(uint32_t day);
+
+/**
+ * First day (a Monday) of a week
+ */
+uint32_t rollup_week_start(uint32_t week);
+
+/**
+ * Format a day as YYYY-MM-DD
+ * @param day Day number from rollup_day
+ * @param buf Buffer of at least 16 bytes
+ */
+void rollup_format_day(uint32_t day, char *buf);
+
+/**
+ * Load rollups; a missing file gives an empty set
+ * @return 0 on success, -1 if the file could not be read
+ */
+int rollup_load(const char *path, rollup_t *rollup);
+
+/**
+ * Count one answer in its day's and week's rollups
+ */
+void rollup_add(rollup_t *rollup, const stats_delta_t *delta);
+
+/**
+ * Save the records changed since the last flush, with one fdatasync
+ * @return 0 on success, -1 on error
+ */
+int rollup_flush(const char *path, rollup_t *rollup);
+
+/**
+ * Release a rollup set
+ */
+void rollup_free(rollup_t *rollup);
+
+#endif
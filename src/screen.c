@@ -0,0 +1,280 @@
+/*
+ * screen.c - Full-Screen Terminal Frame Buffer
+ */
+
+#include "screen.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#define SCREEN_OUTBUF_SIZE (1 << 16)
+#define MAX_REWRITE 4           // Unchanged cells worth rewriting instead of moving the cursor
+
+static const screen_style_t plain = { SCREEN_DEFAULT, SCREEN_DEFAULT, 0 };
+
+static bool same_style(screen_style_t a, screen_style_t b) {
+    return a.fg == b.fg && a.bg == b.bg && a.flags == b.flags;
+}
+
+static bool same_cell(const screen_cell_t *a, const screen_cell_t *b) {
+    return a->ch == b->ch && same_style(a->style, b->style);
+}
+
+static void blank_cells(screen_cell_t *cells, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        cells[i].ch = ' ';
+        cells[i].style = plain;
+    }
+}
+
+/* ========== Terminal ========== */
+
+/* Write out everything buffered, however big, with as few writes as the terminal allows */
+static int send_buffer(screen_t *screen) {
+    size_t done = 0;
+
+    while (done < screen->out.len) {
+        ssize_t n = write(screen->fd, screen->out.data + done, screen->out.len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            screen->out.len = 0;
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    screen->out.len = 0;
+    return 0;
+}
+
+int screen_open(screen_t *screen, int fd) {
+    memset(screen, 0, sizeof(*screen));
+    screen->fd = fd;
+    if (!isatty(fd) || tcgetattr(fd, &screen->saved_mode) != 0) {
+        return -1;
+    }
+    if (outbuf_init(&screen->out, -1, SCREEN_OUTBUF_SIZE) != 0) {
+        return -1;
+    }
+    if (screen_resize(screen) != 0) {
+        outbuf_free(&screen->out);
+        return -1;
+    }
+
+    // Keys one at a time, unechoed; Ctrl-C and Ctrl-Z arrive as keys
+    struct termios raw = screen->saved_mode;
+    raw.c_lflag &= ~(tcflag_t)(ICANON | ECHO | ISIG | IEXTEN);
+    raw.c_iflag &= ~(tcflag_t)(IXON | ICRNL);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &raw);
+    screen->mode_saved = true;
+
+    outbuf_puts(&screen->out, "\x1b[?1049h\x1b[?25l");
+    return 0;
+}
+
+void screen_restore(const screen_t *screen) {
+    static const char restore[] = "\x1b[0m\x1b[?25h\x1b[?1049l";
+    size_t done = 0;
+
+    // Only write() and tcsetattr(), so a signal handler may call this
+    while (done < sizeof(restore) - 1) {
+        ssize_t n = write(screen->fd, restore + done, sizeof(restore) - 1 - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    if (screen->mode_saved) {
+        tcsetattr(screen->fd, TCSANOW, &screen->saved_mode);
+    }
+}
+
+void screen_close(screen_t *screen) {
+    send_buffer(screen);
+    screen_restore(screen);
+    screen->mode_saved = false;
+    outbuf_free(&screen->out);
+    free(screen->cells);
+    free(screen->shown);
+    screen->cells = NULL;
+    screen->shown = NULL;
+}
+
+int screen_resize(screen_t *screen) {
+    struct winsize size;
+    int rows = 24, cols = 80;
+    if (ioctl(screen->fd, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0) {
+        rows = size.ws_row;
+        cols = size.ws_col;
+    }
+
+    size_t count = (size_t)rows * (size_t)cols;
+    screen_cell_t *cells = realloc(screen->cells, count * sizeof(screen_cell_t));
+    if (cells == NULL) {
+        return -1;
+    }
+    screen->cells = cells;
+    screen_cell_t *shown = realloc(screen->shown, count * sizeof(screen_cell_t));
+    if (shown == NULL) {
+        return -1;
+    }
+    screen->shown = shown;
+    screen->rows = rows;
+    screen->cols = cols;
+    blank_cells(screen->cells, count);
+    screen->redraw = true;
+    return 0;
+}
+
+void screen_invalidate(screen_t *screen) {
+    screen->redraw = true;
+}
+
+/* ========== Drawing ========== */
+
+void screen_clear(screen_t *screen) {
+    blank_cells(screen->cells, (size_t)screen->rows * (size_t)screen->cols);
+}
+
+void screen_put(screen_t *screen, int row, int col, uint32_t ch, screen_style_t style) {
+    if (row < 0 || row >= screen->rows || col < 0 || col >= screen->cols) {
+        return;
+    }
+    screen_cell_t *cell = &screen->cells[(size_t)row * (size_t)screen->cols + (size_t)col];
+    cell->ch = ch;
+    cell->style = style;
+}
+
+int screen_text(screen_t *screen, int row, int col, const char *text, screen_style_t style) {
+    const unsigned char *p = (const unsigned char *)text;
+
+    while (*p != '\0' && col < screen->cols) {
+        uint32_t ch = *p++;
+        int extra = ch >= 0xf0 ? 3 : ch >= 0xe0 ? 2 : ch >= 0xc0 ? 1 : 0;
+        if (extra > 0) {
+            ch &= 0x3fu >> extra;
+            for (; extra > 0 && (*p & 0xc0) == 0x80; extra--) {
+                ch = ch << 6 | (*p++ & 0x3fu);
+            }
+        }
+        screen_put(screen, row, col++, ch, style);
+    }
+    return col;
+}
+
+void screen_fill(screen_t *screen, int row, int col, int count, uint32_t ch, screen_style_t style) {
+    for (int i = 0; i < count; i++) {
+        screen_put(screen, row, col + i, ch, style);
+    }
+}
+
+/* ========== Output ========== */
+
+static void send_style(screen_t *screen, screen_style_t style) {
+    outbuf_t *out = &screen->out;
+
+    if (screen->style_known && same_style(screen->style, style)) {
+        return;
+    }
+    outbuf_puts(out, "\x1b[0");
+    if (style.flags & SCREEN_BOLD) outbuf_puts(out, ";1");
+    if (style.flags & SCREEN_DIM) outbuf_puts(out, ";2");
+    if (style.flags & SCREEN_REVERSE) outbuf_puts(out, ";7");
+    if (style.fg != SCREEN_DEFAULT) {
+        outbuf_puts(out, style.fg > SCREEN_WHITE ? ";9" : ";3");
+        outbuf_putc(out, (char)('0' + (style.fg - 1) % 8));
+    }
+    if (style.bg != SCREEN_DEFAULT) {
+        outbuf_puts(out, style.bg > SCREEN_WHITE ? ";10" : ";4");
+        outbuf_putc(out, (char)('0' + (style.bg - 1) % 8));
+    }
+    outbuf_putc(out, 'm');
+    screen->style = style;
+    screen->style_known = true;
+}
+
+static void send_char(outbuf_t *out, uint32_t ch) {
+    char utf8[4];
+    size_t n;
+
+    if (ch < 0x80) {
+        utf8[0] = (char)ch;
+        n = 1;
+    } else if (ch < 0x800) {
+        utf8[0] = (char)(0xc0 | ch >> 6);
+        utf8[1] = (char)(0x80 | (ch & 0x3f));
+        n = 2;
+    } else if (ch < 0x10000) {
+        utf8[0] = (char)(0xe0 | ch >> 12);
+        utf8[1] = (char)(0x80 | (ch >> 6 & 0x3f));
+        utf8[2] = (char)(0x80 | (ch & 0x3f));
+        n = 3;
+    } else {
+        utf8[0] = (char)(0xf0 | ch >> 18);
+        utf8[1] = (char)(0x80 | (ch >> 12 & 0x3f));
+        utf8[2] = (char)(0x80 | (ch >> 6 & 0x3f));
+        utf8[3] = (char)(0x80 | (ch & 0x3f));
+        n = 4;
+    }
+    outbuf_write(out, utf8, n);
+}
+
+static void send_cell(screen_t *screen, size_t index) {
+    send_style(screen, screen->cells[index].style);
+    send_char(&screen->out, screen->cells[index].ch);
+    screen->shown[index] = screen->cells[index];
+
+    // After the last column the cursor's position depends on the terminal
+    if (++screen->cursor_col == screen->cols) {
+        screen->cursor_row = -1;
+    }
+}
+
+static void move_cursor(screen_t *screen, int row, int col) {
+    outbuf_puts(&screen->out, "\x1b[");
+    outbuf_long(&screen->out, row + 1);
+    outbuf_putc(&screen->out, ';');
+    outbuf_long(&screen->out, col + 1);
+    outbuf_putc(&screen->out, 'H');
+    screen->cursor_row = row;
+    screen->cursor_col = col;
+}
+
+int screen_present(screen_t *screen) {
+    size_t count = (size_t)screen->rows * (size_t)screen->cols;
+
+    if (screen->redraw) {
+        // A cleared terminal shows blanks, so only the rest need sending
+        screen->style_known = false;
+        send_style(screen, plain);
+        outbuf_puts(&screen->out, "\x1b[2J");
+        blank_cells(screen->shown, count);
+        screen->cursor_row = -1;
+        screen->redraw = false;
+    }
+
+    for (int row = 0; row < screen->rows; row++) {
+        size_t base = (size_t)row * (size_t)screen->cols;
+        for (int col = 0; col < screen->cols; col++) {
+            if (same_cell(&screen->cells[base + (size_t)col], &screen->shown[base + (size_t)col])) {
+                continue;
+            }
+            if (screen->cursor_row == row && screen->cursor_col <= col &&
+                col - screen->cursor_col <= MAX_REWRITE) {
+                while (screen->cursor_col < col) {
+                    send_cell(screen, base + (size_t)screen->cursor_col);
+                }
+            } else {
+                move_cursor(screen, row, col);
+            }
+            send_cell(screen, base + (size_t)col);
+        }
+    }
+
+    screen->last_bytes = screen->out.len;
+    screen->total_bytes += screen->last_bytes;
+    screen->frames++;
+    return send_buffer(screen);
+}
@@ -0,0 +1,134 @@
+/*
+ * screen.h - Full-Screen Terminal Frame Buffer
+ *
+ * Callers draw each frame into a grid of cells (one character and its
+ * colours per cell) and then present it. The screen keeps a copy of what
+ * the terminal already shows and sends only the cells that differ, as
+ * ANSI cursor-movement and colour sequences in a single write(2); a
+ * frame in which one counter ticks costs a few dozen bytes, however big
+ * the terminal. Colour sequences are sent only when the colours change,
+ * and a short run of unchanged cells is rewritten rather than jumped
+ * over when that is shorter than the cursor movement.
+ *
+ * Every character must be one column wide (ASCII, box drawing, block
+ * elements, arrows); text is given in UTF-8.
+ *
+ * screen_open() also puts the terminal into the mode a full-screen
+ * program needs: the alternate screen, no cursor, and keys delivered one
+ * at a time without echo or signals (Ctrl-C arrives as a key).
+ * screen_close() puts everything back; screen_restore() does the same
+ * from a signal handler.
+ */
+
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <termios.h>
+#include "outbuf.h"
+
+/* Colours: the terminal's default, then the eight ANSI colours and their bright forms */
+enum {
+    SCREEN_DEFAULT = 0,
+    SCREEN_BLACK, SCREEN_RED, SCREEN_GREEN, SCREEN_YELLOW,
+    SCREEN_BLUE, SCREEN_MAGENTA, SCREEN_CYAN, SCREEN_WHITE,
+    SCREEN_BRIGHT_BLACK, SCREEN_BRIGHT_RED, SCREEN_BRIGHT_GREEN, SCREEN_BRIGHT_YELLOW,
+    SCREEN_BRIGHT_BLUE, SCREEN_BRIGHT_MAGENTA, SCREEN_BRIGHT_CYAN, SCREEN_BRIGHT_WHITE
+};
+
+/* Attribute flags */
+#define SCREEN_BOLD 1
+#define SCREEN_DIM 2
+#define SCREEN_REVERSE 4
+
+typedef struct {
+    uint8_t fg;
+    uint8_t bg;
+    uint8_t flags;
+} screen_style_t;
+
+typedef struct {
+    uint32_t ch;                    // Unicode code point
+    screen_style_t style;
+} screen_cell_t;
+
+typedef struct {
+    int fd;
+    int rows;
+    int cols;
+    screen_cell_t *cells;           // The frame being drawn
+    screen_cell_t *shown;           // What the terminal shows
+    bool redraw;                    // Clear and send every cell next time
+    int cursor_row;                 // Where the terminal's cursor is, or -1
+    int cursor_col;
+    screen_style_t style;           // Colours the terminal is set to
+    bool style_known;
+    outbuf_t out;                   // Bytes for the terminal, sent once per present
+    struct termios saved_mode;
+    bool mode_saved;
+    size_t last_bytes;              // Sent by the last screen_present
+    unsigned long long frames;
+    unsigned long long total_bytes;
+} screen_t;
+
+/**
+ * Take over a terminal: alternate screen, hidden cursor, unbuffered keys
+ * @param screen Screen to initialize (sized with screen_resize)
+ * @param fd Terminal descriptor, used for output and its mode
+ * @return 0 on success, -1 if fd is not a terminal or memory ran out
+ */
+int screen_open(screen_t *screen, int fd);
+
+/**
+ * Give the terminal back as it was and free the screen
+ */
+void screen_close(screen_t *screen);
+
+/**
+ * Give the terminal back as it was without touching the screen's memory;
+ * async-signal-safe, for a program about to die of a signal
+ */
+void screen_restore(const screen_t *screen);
+
+/**
+ * Read the terminal's size and resize the frame to match (the next
+ * present repaints everything)
+ * @return 0 on success, -1 if memory ran out
+ */
+int screen_resize(screen_t *screen);
+
+/**
+ * Repaint everything at the next present (e.g. after Ctrl-L)
+ */
+void screen_invalidate(screen_t *screen);
+
+/**
+ * Blank the frame being drawn
+ */
+void screen_clear(screen_t *screen);
+
+/**
+ * Draw one character; cells outside the screen are ignored
+ */
+void screen_put(screen_t *screen, int row, int col, uint32_t ch, screen_style_t style);
+
+/**
+ * Draw UTF-8 text, clipped to the screen's width
+ * @return The column just past the text
+ */
+int screen_text(screen_t *screen, int row, int col, const char *text, screen_style_t style);
+
+/**
+ * Draw the same character in count cells of a row
+ */
+void screen_fill(screen_t *screen, int row, int col, int count, uint32_t ch, screen_style_t style);
+
+/**
+ * Send the cells that changed since the last present, in one write
+ * @return 0 on success, -1 if writing failed
+ */
+int screen_present(screen_t *screen);
+
+#endif
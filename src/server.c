@@ -0,0 +1,914 @@
+/*
+ * server.c - The Web API Server
+ *
+ * One thread serves every connection, with one of two event loops:
+ *
+ *   epoll     Level-triggered readiness. The server reads until the
+ *             socket is drained, answers, and sends.
+ *   io_uring  Completions. Each connection has one multishot receive,
+ *             which fills buffers from a shared ring that the kernel
+ *             picks from. Accepts are multishot too. Sends are queued
+ *             while a batch of completions is processed, and the queue
+ *             goes to the kernel in the single io_uring_enter that
+ *             also waits for the next batch.
+ *
+ * Both loops share the connection logic. Each connection has an input
+ * buffer, which requests are parsed from in place, and an in-memory
+ * outbuf that responses are framed into. Every pipelined request that
+ * has fully arrived is answered before anything is sent, so a batch of
+ * requests costs one send. A connection whose client stops reading is
+ * not read from either once it has too much output pending.
+ *
+ * Connections come from a slab, and their buffers are 4 KB blocks lent
+ * from a second slab only while there is input or output to hold, so an
+ * idle connection costs just its conn_t. A buffer that outgrows its
+ * block moves to the heap until it is empty again. Once the server has
+ * seen its peak load, serving requests makes no heap calls.
+ *
+ * The API state is owned by this thread alone and takes no locks.
+ */
+
+#define _GNU_SOURCE                       // accept4(2)
+
+#include <errno.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "api.h"
+#include "http.h"
+#include "metrics.h"
+#include "outbuf.h"
+#include "questions.h"
+#include "server.h"
+#include "slab.h"
+#include "uring.h"
+#include "userstore.h"
+
+#define MAX_EVENTS 256
+#define IO_BLOCK_SIZE 4096                // I/O buffers lent to connections
+#define IO_BLOCKS_PER_CHUNK 64
+#define CONNS_PER_CHUNK 256
+#define INPUT_MAX (HTTP_MAX_HEAD + HTTP_MAX_BODY)
+#define OUTPUT_BACKLOG (1 << 20)          // Pending output that stops reading
+#define EXPIRE_INTERVAL_MS 1000
+
+#define URING_ENTRIES 4096
+#define URING_CQ_ENTRIES 16384
+#define RECV_GROUP 0
+#define RECV_BUFFERS 2048
+#define RECV_BUFFER_SIZE 4096
+
+/* What an io_uring completion is for, in the low bits of its user_data */
+enum { OP_ACCEPT, OP_RECV, OP_SEND, OP_CANCEL };
+#define OP_MASK 3
+
+typedef enum {
+    BACKEND_EPOLL,
+    BACKEND_URING
+} backend_t;
+
+static const char *const backend_names[] = { "epoll", "io_uring" };
+
+typedef struct {
+    int fd;
+    char *in;                             // NULL while there is no input
+    size_t in_len;
+    size_t in_cap;
+    bool in_heap;                         // in outgrew its block
+    outbuf_t out;                         // Responses not yet sent; no data while empty
+    size_t out_sent;                      // epoll: bytes of out already sent
+    bool closing;                         // Close once the output is sent
+    // epoll
+    uint32_t events;                      // Events registered
+    // io_uring
+    outbuf_t in_flight;                   // Output a send is working through
+    size_t in_flight_sent;
+    bool receiving;                       // The multishot receive is armed
+    bool cancelling;                      // Its cancellation is in flight
+    bool closed;                          // Shut down; freed when idle
+} conn_t;
+
+typedef struct {
+    api_t *api;
+    backend_t backend;
+    int listen_fd;
+    int epoll_fd;
+    uring_t ring;
+    conn_t **conns;                       // Indexed by descriptor
+    size_t conns_cap;
+    slab_t conn_slab;
+    slab_t blocks;                        // IO_BLOCK_SIZE buffers
+    unsigned long long allocations;       // Heap allocations outside the slabs
+    unsigned long long requests;
+    unsigned long long connections;
+    unsigned long long syscalls;          // Made by the event loop
+    unsigned long long requests_reported; // Already passed to metrics
+    unsigned long long syscalls_reported;
+    unsigned long long allocations_reported;
+    long long next_expiry;                // Monotonic ms
+} server_t;
+
+typedef struct {
+    int port;
+    backend_t backend;
+    api_options_t api;
+} server_options_t;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int signum) {
+    (void)signum;
+    stop_requested = 1;
+}
+
+/* ========== Connections ========== */
+
+static conn_t *new_conn(server_t *server, int fd) {
+    if ((size_t)fd >= server->conns_cap) {
+        size_t cap = server->conns_cap * 2;
+        while (cap <= (size_t)fd) {
+            cap *= 2;
+        }
+        conn_t **conns = realloc(server->conns, cap * sizeof(conn_t *));
+        if (conns == NULL) {
+            return NULL;
+        }
+        memset(conns + server->conns_cap, 0, (cap - server->conns_cap) * sizeof(conn_t *));
+        server->conns = conns;
+        server->conns_cap = cap;
+        server->allocations++;
+    }
+
+    conn_t *conn = slab_alloc(&server->conn_slab);
+    if (conn == NULL) {
+        return NULL;
+    }
+    memset(conn, 0, sizeof(*conn));
+    conn->fd = fd;
+    server->conns[fd] = conn;
+    server->connections++;
+    return conn;
+}
+
+/* Lend an output buffer a block, if it has none; -1 if memory ran out */
+static int take_output(server_t *server, outbuf_t *out) {
+    if (out->data != NULL) {
+        return 0;
+    }
+    char *block = slab_alloc(&server->blocks);
+    if (block == NULL) {
+        return -1;
+    }
+    outbuf_init_borrowed(out, block, IO_BLOCK_SIZE);
+    return 0;
+}
+
+/* Take back an output buffer's block once it is empty */
+static void return_output(server_t *server, outbuf_t *out) {
+    if (out->data == NULL || out->len > 0) {
+        return;
+    }
+    if (out->data != out->borrowed) {
+        server->allocations++;            // It outgrew the block
+    }
+    slab_free(&server->blocks, out->borrowed);
+    outbuf_free(out);
+}
+
+/* Lend the input a block, if it has none; -1 if memory ran out */
+static int take_input(server_t *server, conn_t *conn) {
+    if (conn->in != NULL) {
+        return 0;
+    }
+    if ((conn->in = slab_alloc(&server->blocks)) == NULL) {
+        return -1;
+    }
+    conn->in_cap = IO_BLOCK_SIZE;
+    conn->in_heap = false;
+    return 0;
+}
+
+/* Make room for at least need bytes of input; -1 past the largest request */
+static int grow_input(server_t *server, conn_t *conn, size_t need) {
+    if (need > INPUT_MAX) {
+        return -1;
+    }
+    size_t cap = conn->in_cap;
+    while (cap < need) {
+        cap *= 2;
+    }
+    if (cap > INPUT_MAX) {
+        cap = INPUT_MAX;
+    }
+    char *in;
+    if (conn->in_heap) {
+        in = realloc(conn->in, cap);
+    } else if ((in = malloc(cap)) != NULL) {
+        memcpy(in, conn->in, conn->in_len);
+        slab_free(&server->blocks, conn->in);
+        conn->in_heap = true;
+    }
+    if (in == NULL) {
+        return -1;
+    }
+    server->allocations++;
+    conn->in = in;
+    conn->in_cap = cap;
+    return 0;
+}
+
+/* Take back the input's block once it is empty */
+static void return_input(server_t *server, conn_t *conn) {
+    if (conn->in == NULL || conn->in_len > 0) {
+        return;
+    }
+    if (conn->in_heap) {
+        free(conn->in);
+    } else {
+        slab_free(&server->blocks, conn->in);
+    }
+    conn->in = NULL;
+    conn->in_cap = 0;
+}
+
+/* Return whatever buffers a connection no longer needs */
+static void return_buffers(server_t *server, conn_t *conn) {
+    return_input(server, conn);
+    return_output(server, &conn->out);
+    return_output(server, &conn->in_flight);
+}
+
+static void free_conn(server_t *server, conn_t *conn) {
+    server->syscalls++;
+    close(conn->fd);
+    server->conns[conn->fd] = NULL;
+    conn->in_len = 0;
+    conn->out.len = 0;
+    conn->in_flight.len = 0;
+    return_buffers(server, conn);
+    slab_free(&server->conn_slab, conn);
+}
+
+static size_t pending_output(const conn_t *conn) {
+    return conn->out.len - conn->out_sent + conn->in_flight.len - conn->in_flight_sent;
+}
+
+/* Answer complete requests from data, up to the output backlog; returns bytes used */
+static size_t answer_requests(server_t *server, conn_t *conn, const char *data, size_t len) {
+    size_t offset = 0;
+
+    while (!conn->closing && offset < len && pending_output(conn) < OUTPUT_BACKLOG) {
+        http_request_t request;
+        long used = http_parse(data + offset, len - offset, &request);
+        if (used == 0) {
+            break;
+        }
+        if (take_output(server, &conn->out) != 0) {
+            conn->out.error = ENOMEM;
+            break;
+        }
+        server->requests++;
+        if (used < 0) {
+            api_error(&conn->out, (int)-used, "malformed request", false);
+            conn->closing = true;
+            break;
+        }
+        api_handle(server->api, &request, &conn->out);
+        offset += (size_t)used;
+        if (!request.keep_alive) {
+            conn->closing = true;
+        }
+    }
+    return offset;
+}
+
+/* Answer what is buffered in the connection's input */
+static void answer_buffered(server_t *server, conn_t *conn) {
+    size_t used = answer_requests(server, conn, conn->in, conn->in_len);
+    if (used > 0) {
+        memmove(conn->in, conn->in + used, conn->in_len - used);
+        conn->in_len -= used;
+    }
+}
+
+/* Append to the input buffer; -1 if it would outgrow the largest request */
+static int buffer_input(server_t *server, conn_t *conn, const char *data, size_t len) {
+    if (take_input(server, conn) != 0 ||
+        (conn->in_len + len > conn->in_cap && grow_input(server, conn, conn->in_len + len) != 0)) {
+        return -1;
+    }
+    memcpy(conn->in + conn->in_len, data, len);
+    conn->in_len += len;
+    return 0;
+}
+
+static long long monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* Heap allocations for sessions and connections so far */
+static unsigned long long server_allocations(const server_t *server, const api_memory_t *sessions) {
+    return sessions->allocations + server->conn_slab.chunk_count + server->blocks.chunk_count +
+           server->allocations;
+}
+
+/* Bytes held for connections: the slabs, the descriptor table and receive buffers */
+static size_t connection_bytes(const server_t *server) {
+    return slab_bytes(&server->conn_slab) + slab_bytes(&server->blocks) +
+           server->conns_cap * sizeof(conn_t *) + (size_t)server->ring.buf_count * server->ring.buf_size;
+}
+
+/* Once per loop iteration: expire idle sessions, pass counts to metrics */
+static void server_tick(server_t *server) {
+    long long now = monotonic_ms();
+    if (now >= server->next_expiry) {
+        api_expire(server->api);
+        server->next_expiry = now + EXPIRE_INTERVAL_MS;
+    }
+
+    unsigned long long syscalls = server->syscalls + server->ring.syscalls;
+    metrics_server_io(server->requests - server->requests_reported, syscalls - server->syscalls_reported);
+    server->requests_reported = server->requests;
+    server->syscalls_reported = syscalls;
+
+    api_memory_t sessions;
+    api_memory(server->api, &sessions);
+    unsigned long long allocations = server_allocations(server, &sessions);
+    metrics_server_memory(allocations - server->allocations_reported, sessions.bytes, connection_bytes(server));
+    server->allocations_reported = allocations;
+}
+
+/* ========== epoll Backend ========== */
+
+static void close_conn(server_t *server, conn_t *conn) {
+    server->syscalls++;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    free_conn(server, conn);
+}
+
+/* Register interest in input unless the client is behind on output */
+static int watch_conn(server_t *server, conn_t *conn) {
+    uint32_t events = 0;
+    if (!conn->closing && pending_output(conn) < OUTPUT_BACKLOG) {
+        events |= EPOLLIN;
+    }
+    if (pending_output(conn) > 0) {
+        events |= EPOLLOUT;
+    }
+    if (events == conn->events) {
+        return 0;
+    }
+    struct epoll_event ev = { .events = events, .data.ptr = conn };
+    conn->events = events;
+    server->syscalls++;
+    return epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+static void accept_conns(server_t *server) {
+    for (;;) {
+        server->syscalls++;
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK);
+        if (fd < 0) {
+            return;                       // EAGAIN, or a connection that gave up
+        }
+        conn_t *conn = new_conn(server, fd);
+        if (conn == NULL) {
+            close(fd);
+            continue;
+        }
+        conn->events = EPOLLIN;
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = conn };
+        server->syscalls++;
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            free_conn(server, conn);
+        }
+    }
+}
+
+/* Read what has arrived; returns -1 once the connection should be closed */
+static int read_input(server_t *server, conn_t *conn) {
+    if (take_input(server, conn) != 0) {
+        return -1;
+    }
+    for (;;) {
+        if (conn->in_len == conn->in_cap) {
+            if (conn->in_cap >= INPUT_MAX) {
+                return 0;                 // Full; parsing will make room or fail
+            }
+            if (grow_input(server, conn, conn->in_cap + 1) != 0) {
+                return -1;
+            }
+        }
+        server->syscalls++;
+        ssize_t n = recv(conn->fd, conn->in + conn->in_len, conn->in_cap - conn->in_len, 0);
+        if (n > 0) {
+            conn->in_len += (size_t)n;
+        } else if (n == 0) {
+            return -1;                    // Client closed
+        } else {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+        }
+    }
+}
+
+/* Send pending output; returns -1 once the connection should be closed */
+static int send_output(server_t *server, conn_t *conn) {
+    if (conn->out.error) {
+        return -1;                        // A response was lost to a failed allocation
+    }
+    while (pending_output(conn) > 0) {
+        server->syscalls++;
+        ssize_t n = send(conn->fd, conn->out.data + conn->out_sent, pending_output(conn), MSG_NOSIGNAL);
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+        }
+        conn->out_sent += (size_t)n;
+    }
+    conn->out.len = 0;
+    conn->out_sent = 0;
+    return conn->closing ? -1 : 0;
+}
+
+static void serve_conn(server_t *server, conn_t *conn, uint32_t events) {
+    if ((events & (EPOLLIN | EPOLLERR | EPOLLHUP)) && read_input(server, conn) != 0) {
+        close_conn(server, conn);
+        return;
+    }
+    // Output that drains completely lets input held back by the backlog
+    // through; no new input may come to prompt it
+    size_t before;
+    do {
+        before = conn->in_len;
+        answer_buffered(server, conn);
+        if (send_output(server, conn) != 0) {
+            close_conn(server, conn);
+            return;
+        }
+    } while (conn->in_len > 0 && conn->in_len < before && pending_output(conn) == 0);
+    return_buffers(server, conn);
+    if (watch_conn(server, conn) != 0) {
+        close_conn(server, conn);
+    }
+}
+
+static int run_epoll(server_t *server) {
+    struct epoll_event events[MAX_EVENTS];
+    struct epoll_event listen_event = { .events = EPOLLIN, .data.ptr = NULL };
+
+    if ((server->epoll_fd = epoll_create1(0)) < 0 ||
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &listen_event) != 0) {
+        return -1;
+    }
+    server->syscalls += 2;
+    while (!stop_requested) {
+        server->syscalls++;
+        int n = epoll_wait(server->epoll_fd, events, MAX_EVENTS, EXPIRE_INTERVAL_MS);
+        if (n < 0 && errno != EINTR) {
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) {
+                accept_conns(server);
+            } else {
+                serve_conn(server, events[i].data.ptr, events[i].events);
+            }
+        }
+        server_tick(server);
+    }
+    return 0;
+}
+
+/* ========== io_uring Backend ========== */
+
+static int arm_accept(server_t *server) {
+    struct io_uring_sqe *sqe = uring_sqe(&server->ring);
+    if (sqe == NULL) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = server->listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = OP_ACCEPT;
+    return 0;
+}
+
+static void arm_recv(server_t *server, conn_t *conn) {
+    struct io_uring_sqe *sqe = uring_sqe(&server->ring);
+    if (sqe == NULL) {
+        return;                           // Retried after the next send completes
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_GROUP;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | OP_RECV;
+    conn->receiving = true;
+}
+
+/* Stop receiving while the client is behind on output */
+static void pause_recv(server_t *server, conn_t *conn) {
+    struct io_uring_sqe *sqe = uring_sqe(&server->ring);
+    if (sqe == NULL) {
+        return;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = (uint64_t)(uintptr_t)conn | OP_RECV;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | OP_CANCEL;
+    conn->cancelling = true;
+}
+
+static void submit_send(server_t *server, conn_t *conn) {
+    struct io_uring_sqe *sqe = uring_sqe(&server->ring);
+    if (sqe == NULL) {
+        conn->closed = true;              // Cannot make progress; give up on it
+        return;
+    }
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = conn->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(conn->in_flight.data + conn->in_flight_sent);
+    sqe->len = (uint32_t)(conn->in_flight.len - conn->in_flight_sent);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | OP_SEND;
+}
+
+/* Start sending the output gathered so far, unless a send is in flight */
+static void start_send(server_t *server, conn_t *conn) {
+    if (conn->in_flight.len > 0 || conn->out.len == 0) {
+        return;
+    }
+    outbuf_t swap = conn->in_flight;
+    conn->in_flight = conn->out;
+    conn->out = swap;
+    conn->in_flight_sent = 0;
+    submit_send(server, conn);
+}
+
+/* Shut a connection down; it is freed once no operation refers to it */
+static void shut_conn(server_t *server, conn_t *conn) {
+    if (!conn->closed) {
+        conn->closed = true;
+        if (conn->receiving) {
+            server->syscalls++;
+            shutdown(conn->fd, SHUT_RDWR);   // Ends the multishot receive
+        }
+    }
+    if (!conn->receiving && !conn->cancelling && conn->in_flight.len == 0) {
+        free_conn(server, conn);
+    }
+}
+
+/* After any completion: send, resume receiving, or finish closing */
+static void settle_conn(server_t *server, conn_t *conn) {
+    if (conn->out.error || conn->in_flight.error) {
+        conn->closed = true;
+    }
+    if (conn->closed) {
+        shut_conn(server, conn);
+        return;
+    }
+    start_send(server, conn);
+    if (conn->closing && pending_output(conn) == 0) {
+        shut_conn(server, conn);
+        return;
+    }
+    bool backlogged = pending_output(conn) >= OUTPUT_BACKLOG;
+    if (conn->receiving && backlogged && !conn->cancelling) {
+        pause_recv(server, conn);
+    } else if (!conn->receiving && !backlogged && !conn->cancelling && !conn->closing) {
+        arm_recv(server, conn);
+    }
+    return_buffers(server, conn);
+}
+
+static void on_accept(server_t *server, const struct io_uring_cqe *cqe) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        arm_accept(server);               // The multishot accept ended (e.g. EMFILE)
+    }
+    if (cqe->res < 0) {
+        return;
+    }
+    conn_t *conn = new_conn(server, cqe->res);
+    if (conn == NULL) {
+        server->syscalls++;
+        close(cqe->res);
+        return;
+    }
+    arm_recv(server, conn);
+}
+
+static void on_recv(server_t *server, conn_t *conn, const struct io_uring_cqe *cqe) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        conn->receiving = false;
+    }
+    if (cqe->res > 0 && !conn->closed) {
+        unsigned id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        const char *data = uring_buffer(&server->ring, id);
+        size_t len = (size_t)cqe->res;
+
+        // Parse straight from the kernel's buffer; only a partial request
+        // (or input held back by the backlog) is copied
+        size_t used = conn->in_len == 0 ? answer_requests(server, conn, data, len) : 0;
+        if (!conn->closing && used < len && buffer_input(server, conn, data + used, len - used) != 0) {
+            conn->closed = true;
+        }
+        uring_recycle(&server->ring, id);
+        if (conn->in_len > 0 && used == 0) {
+            answer_buffered(server, conn);
+        }
+    } else if (cqe->res > 0) {
+        uring_recycle(&server->ring, cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    } else if (cqe->res == 0 || (cqe->res != -ENOBUFS && cqe->res != -ECANCELED)) {
+        conn->closed = true;              // Client closed, or the socket failed
+    }
+    settle_conn(server, conn);
+}
+
+static void on_send(server_t *server, conn_t *conn, const struct io_uring_cqe *cqe) {
+    if (cqe->res < 0) {
+        conn->in_flight.len = 0;
+        conn->closed = true;
+    } else {
+        conn->in_flight_sent += (size_t)cqe->res;
+        if (conn->in_flight_sent < conn->in_flight.len && !conn->closed) {
+            submit_send(server, conn);
+            return;
+        }
+        conn->in_flight.len = 0;
+        conn->in_flight_sent = 0;
+    }
+    // Input held back by the backlog can be answered now
+    if (!conn->closed && conn->in_len > 0 && pending_output(conn) < OUTPUT_BACKLOG) {
+        answer_buffered(server, conn);
+    }
+    settle_conn(server, conn);
+}
+
+static void on_completion(server_t *server, const struct io_uring_cqe *cqe) {
+    conn_t *conn = (conn_t *)(uintptr_t)(cqe->user_data & ~(uint64_t)OP_MASK);
+    switch (cqe->user_data & OP_MASK) {
+        case OP_ACCEPT:
+            on_accept(server, cqe);
+            break;
+        case OP_RECV:
+            on_recv(server, conn, cqe);
+            break;
+        case OP_SEND:
+            on_send(server, conn, cqe);
+            break;
+        case OP_CANCEL:
+            conn->cancelling = false;
+            settle_conn(server, conn);
+            break;
+    }
+}
+
+/* Set up the rings; -1 (errno set) if this kernel cannot run the backend */
+static int open_uring(server_t *server) {
+    if (uring_init(&server->ring, URING_ENTRIES, URING_CQ_ENTRIES) != 0) {
+        return -1;
+    }
+    if (uring_provide_buffers(&server->ring, RECV_GROUP, RECV_BUFFERS, RECV_BUFFER_SIZE) != 0) {
+        int saved = errno;
+        uring_free(&server->ring);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+static int run_uring(server_t *server) {
+    if (arm_accept(server) != 0) {
+        return -1;
+    }
+    while (!stop_requested) {
+        int result = uring_enter(&server->ring, EXPIRE_INTERVAL_MS);
+        if (result < 0 && result != -ETIME && result != -EINTR) {
+            errno = -result;
+            return -1;
+        }
+        struct io_uring_cqe *cqe;
+        while ((cqe = uring_cqe(&server->ring)) != NULL) {
+            struct io_uring_cqe done = *cqe;
+            uring_cqe_seen(&server->ring);
+            on_completion(server, &done);
+        }
+        server_tick(server);
+    }
+    return 0;
+}
+
+/* ========== Event Loop ========== */
+
+static int open_listener(int port) {
+    struct sockaddr_in addr;
+    int one = 1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    // Accepted connections inherit this, which saves a call per connection
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+
+/* ========== Command ========== */
+
+static void show_serve_help(void) {
+    printf("Usage: metric-trainer serve [OPTIONS]\n\n");
+    printf("Serve practice sessions as a JSON API on http://127.0.0.1:PORT.\n\n");
+    printf("OPTIONS:\n");
+    printf("  -p, --port P          Port to listen on (default: %d)\n", SERVER_DEFAULT_PORT);
+    printf("  --backend B           Event loop: epoll or io_uring (default: epoll;\n");
+    printf("                        io_uring falls back to epoll where unavailable)\n");
+    printf("  --store PATH          User store to seed the leaderboard from\n");
+    printf("                        (default: %s)\n", USER_STORE_FILE);
+    printf("  --max-sessions N      Open sessions allowed at once (default: %d)\n", API_DEFAULT_MAX_SESSIONS);
+    printf("  --idle-timeout S      End sessions idle for S seconds (default: %d)\n", API_DEFAULT_IDLE_SECONDS);
+    printf("  -w, --whole           Ask with whole numbers only\n");
+    printf("  -e, --easy            Ask with simple numbers only\n");
+    printf("  -h, --help            Show this help\n\n");
+    printf("ENDPOINTS:\n");
+    printf("  POST   /session?categories=ab&user=NAME\n");
+    printf("  GET    /session/ID/question\n");
+    printf("  POST   /session/ID/answer?value=X\n");
+    printf("  GET    /session/ID/stats\n");
+    printf("  DELETE /session/ID\n");
+    printf("  GET    /leaderboard?by=accuracy&category=all&top=10&user=NAME\n");
+    printf("  GET    /metrics\n\n");
+    printf("Sessions live in memory and end when the server stops.\n");
+}
+
+static int parse_serve_options(int argc, char *argv[], server_options_t *opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->port = SERVER_DEFAULT_PORT;
+    opts->backend = BACKEND_EPOLL;
+    opts->api.store = USER_STORE_FILE;
+    opts->api.max_sessions = API_DEFAULT_MAX_SESSIONS;
+    opts->api.idle_seconds = API_DEFAULT_IDLE_SECONDS;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            show_serve_help();
+            return 0;
+        } else if (strcmp(arg, "-w") == 0 || strcmp(arg, "--whole") == 0) {
+            g_whole_numbers_mode = true;
+            continue;
+        } else if (strcmp(arg, "-e") == 0 || strcmp(arg, "--easy") == 0) {
+            g_easy_mode = true;
+            continue;
+        }
+        if (value == NULL) {
+            fprintf(stderr, "serve: unknown option or missing value: %s\n", arg);
+            return -1;
+        }
+        i++;
+
+        if (strcmp(arg, "-p") == 0 || strcmp(arg, "--port") == 0) {
+            long port;
+            if (!parse_whole_number(value, 1, 65535, &port)) {
+                fprintf(stderr, "serve: invalid port '%s' (use 1 to 65535)\n", value);
+                return -1;
+            }
+            opts->port = (int)port;
+        } else if (strcmp(arg, "--backend") == 0) {
+            if (strcmp(value, "epoll") == 0) {
+                opts->backend = BACKEND_EPOLL;
+            } else if (strcmp(value, "io_uring") == 0 || strcmp(value, "uring") == 0) {
+                opts->backend = BACKEND_URING;
+            } else {
+                fprintf(stderr, "serve: unknown backend '%s' (use epoll or io_uring)\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "--store") == 0) {
+            opts->api.store = value;
+        } else if (strcmp(arg, "--max-sessions") == 0) {
+            long max;
+            if (!parse_whole_number(value, 1, LONG_MAX, &max)) {
+                fprintf(stderr, "serve: invalid --max-sessions '%s' (use 1 or more)\n", value);
+                return -1;
+            }
+            opts->api.max_sessions = (size_t)max;
+        } else if (strcmp(arg, "--idle-timeout") == 0) {
+            long idle_seconds;
+            if (!parse_whole_number(value, 1, INT_MAX, &idle_seconds)) {
+                fprintf(stderr, "serve: invalid --idle-timeout '%s' (use 1 or more seconds)\n", value);
+                return -1;
+            }
+            opts->api.idle_seconds = (int)idle_seconds;
+        } else {
+            fprintf(stderr, "serve: unknown option: %s\n", arg);
+            return -1;
+        }
+    }
+    return 1;
+}
+
+int server_main(int argc, char *argv[]) {
+    server_options_t opts;
+    int parsed = parse_serve_options(argc, argv, &opts);
+    if (parsed <= 0) {
+        return parsed == 0 ? 0 : 1;
+    }
+
+    server_t server;
+    memset(&server, 0, sizeof(server));
+    server.epoll_fd = -1;
+    server.ring.fd = -1;
+    server.backend = opts.backend;
+    if ((server.api = api_create(&opts.api)) == NULL) {
+        fprintf(stderr, "serve: cannot load the leaderboard from %s\n", opts.api.store);
+        return 1;
+    }
+    slab_init(&server.conn_slab, sizeof(conn_t), CONNS_PER_CHUNK);
+    slab_init(&server.blocks, IO_BLOCK_SIZE, IO_BLOCKS_PER_CHUNK);
+    server.conns_cap = 1024;
+    server.conns = calloc(server.conns_cap, sizeof(conn_t *));
+    server.allocations = 1;
+    server.listen_fd = open_listener(opts.port);
+    if (server.conns == NULL || server.listen_fd < 0) {
+        fprintf(stderr, "serve: cannot listen on port %d: %s\n", opts.port, strerror(errno));
+        free(server.conns);
+        api_free(server.api);
+        return 1;
+    }
+    if (server.backend == BACKEND_URING && open_uring(&server) != 0) {
+        fprintf(stderr, "serve: io_uring is unavailable (%s); using epoll\n", strerror(errno));
+        server.backend = BACKEND_EPOLL;
+    }
+    metrics_server_backend(backend_names[server.backend]);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = request_stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    printf("Serving on http://127.0.0.1:%d with %s (Ctrl-C to stop)\n", opts.port, backend_names[server.backend]);
+    fflush(stdout);
+    int status = server.backend == BACKEND_URING ? run_uring(&server) : run_epoll(&server);
+    if (status != 0) {
+        fprintf(stderr, "serve: %s\n", strerror(errno));
+    }
+
+    unsigned long long syscalls = server.syscalls + server.ring.syscalls;
+    printf("\nServed %llu requests on %llu connections with %llu system calls (%.2f per request);\n",
+           server.requests, server.connections, syscalls,
+           server.requests > 0 ? (double)syscalls / (double)server.requests : 0.0);
+    api_memory_t sessions;
+    api_memory(server.api, &sessions);
+    printf("%llu heap allocations for sessions and connections; %zu sessions were open",
+           server_allocations(&server, &sessions), sessions.sessions);
+    if (sessions.sessions > 0) {
+        printf(" (%zu bytes each)", sessions.bytes / sessions.sessions);
+    }
+    printf(".\n");
+
+    // Tearing the ring down first cancels its operations, so no
+    // completion can refer to a connection freed below
+    if (server.backend == BACKEND_URING) {
+        uring_free(&server.ring);
+    }
+    for (size_t fd = 0; fd < server.conns_cap; fd++) {
+        if (server.conns[fd] != NULL) {
+            free_conn(&server, server.conns[fd]);
+        }
+    }
+    close(server.listen_fd);
+    if (server.epoll_fd >= 0) {
+        close(server.epoll_fd);
+    }
+    free(server.conns);
+    slab_destroy(&server.conn_slab);
+    slab_destroy(&server.blocks);
+    api_free(server.api);
+    return status == 0 ? 0 : 1;
+}
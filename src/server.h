@@ -0,0 +1,23 @@
+/*
+ * server.h - The Web API Server
+ *
+ * `metric-trainer serve` answers the JSON API (see api.h) on the
+ * loopback interface. One thread multiplexes every connection with
+ * epoll; connections are kept alive and may pipeline requests, so a web
+ * front-end pays for one connection, not one per question.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#define SERVER_DEFAULT_PORT 8080
+
+/**
+ * Entry point for `metric-trainer serve ...`
+ * @param argc Argument count, argv[0] being "serve"
+ * @param argv Argument vector
+ * @return Process exit status
+ */
+int server_main(int argc, char *argv[]);
+
+#endif
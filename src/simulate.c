@@ -0,0 +1,463 @@
+/*
+ * simulate.c - Simulated Learners
+ *
+ * Learner model, per conversion:
+ *   - skill: probability of knowing the conversion factor. A learner who
+ *     knows it answers within a fraction of a percent; one who doesn't
+ *     guesses with a configurable relative error.
+ *   - learning: after every graded answer the learner sees the correct
+ *     value, and skill moves toward 1 by learn_rate (half as much when
+ *     the answer was already right).
+ *   - forgetting: skill decays exponentially with the number of questions
+ *     since the conversion was last practiced; every repetition slows the
+ *     decay (a simple spacing effect).
+ * A learner has mastered the selection when the decayed skill of every
+ * conversion in it is at or above the mastery threshold.
+ *
+ * Strategies only see what a real trainer could see - which questions
+ * were answered correctly - never the learner's hidden skill:
+ *   uniform  generate_question_r over the selection, as in practice mode
+ *   weak     conversions weighted by their observed error rate
+ *   spaced   Leitner boxes: correct answers double a conversion's interval,
+ *            wrong answers reset it, and the most overdue one is asked
+ *
+ * Learners are simulated in batches of SIM_BATCH; batch k uses random
+ * stream k of the seed for every strategy, so all strategies face the
+ * same population and results do not depend on the thread count.
+ */
+
+#include "simulate.h"
+#include "questions.h"
+#include "tables.h"
+#include "parallel.h"
+#include "rng.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define SIM_BATCH 64                    // Learners per task / random stream
+#define SIM_MAX_BOX 8                   // Highest Leitner box (interval 2^8)
+#define MAX_GUESS_ERROR 10.0f           // Largest --guess-error (1000%)
+
+typedef enum {
+    STRATEGY_UNIFORM = 0,
+    STRATEGY_WEAK,
+    STRATEGY_SPACED,
+    STRATEGY_COUNT
+} strategy_t;
+
+static const char *strategy_names[STRATEGY_COUNT] = { "uniform", "weak", "spaced" };
+
+typedef struct {
+    long learners;
+    int max_questions;                  // Give up on a learner after this many
+    float mastery;                      // Skill every conversion must reach
+    float learn_rate;
+    float forget_rate;                  // Decay per question since last practiced
+    float guess_error;                  // Relative error of an unknowing guess
+    float initial_skill;                // Mean starting skill
+    uint64_t seed;
+    category_selection_t selection;
+    bool strategies[STRATEGY_COUNT];
+    int threads;
+    bool worker_stats;                  // Print each worker's utilization
+} sim_options_t;
+
+typedef struct {
+    float skill[CONVERSION_COUNT];
+    int last_seen[CONVERSION_COUNT];
+    int reps[CONVERSION_COUNT];
+    // What the strategy is allowed to observe
+    int attempts[CONVERSION_COUNT];
+    int correct[CONVERSION_COUNT];
+    int box[CONVERSION_COUNT];
+    int due[CONVERSION_COUNT];
+} learner_t;
+
+typedef struct {
+    const sim_options_t *opts;
+    strategy_t strategy;
+    const rng_t *streams;               // One per batch
+    int active[CONVERSION_COUNT];       // Conversion ids in the selection
+    int active_count;
+    int *results;                       // Questions to mastery per learner (-1: never)
+} sim_run_t;
+
+/* ========== Learner Model ========== */
+
+// Approximately normal deviate (Irwin-Hall with four uniforms, unit variance)
+static float gaussian(rng_t *rng) {
+    float sum = rng_unit(rng) + rng_unit(rng) + rng_unit(rng) + rng_unit(rng);
+    return (sum - 2.0f) * 1.7320508f;
+}
+
+static float retained_skill(const sim_options_t *opts, const learner_t *l, int c, int now) {
+    int elapsed = now - l->last_seen[c];
+    return l->skill[c] * expf(-opts->forget_rate * (float)elapsed / (float)(1 + l->reps[c]));
+}
+
+static void init_learner(const sim_options_t *opts, learner_t *l, rng_t *rng) {
+    memset(l, 0, sizeof(*l));
+    for (int c = 0; c < CONVERSION_COUNT; c++) {
+        float skill = opts->initial_skill + 0.15f * gaussian(rng);
+        l->skill[c] = skill < 0.0f ? 0.0f : (skill > 1.0f ? 1.0f : skill);
+    }
+}
+
+static float learner_answer(const sim_options_t *opts, learner_t *l, const question_t *q,
+                            int now, rng_t *rng) {
+    int c = q->conversion_id;
+
+    l->skill[c] = retained_skill(opts, l, c, now);
+    l->last_seen[c] = now;
+
+    float relative_error = rng_unit(rng) < l->skill[c]
+        ? 0.002f * gaussian(rng)
+        : opts->guess_error * gaussian(rng);
+    return q->correct_answer * (1.0f + relative_error);
+}
+
+static void learner_feedback(const sim_options_t *opts, learner_t *l, int c, bool correct) {
+    float gain = opts->learn_rate * (1.0f - l->skill[c]);
+    l->skill[c] += correct ? gain * 0.5f : gain;
+    l->reps[c]++;
+}
+
+static bool has_mastered(const sim_run_t *run, const learner_t *l, int now) {
+    for (int i = 0; i < run->active_count; i++) {
+        if (retained_skill(run->opts, l, run->active[i], now) < run->opts->mastery) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ========== Selection Strategies ========== */
+
+static question_t next_question(const sim_run_t *run, const learner_t *l, rng_t *rng) {
+    switch (run->strategy) {
+        case STRATEGY_WEAK: {
+            // Weight = estimated error rate, (misses + 1) / (attempts + 2)
+            float weights[CONVERSION_COUNT];
+            float total = 0.0f;
+            for (int i = 0; i < run->active_count; i++) {
+                int c = run->active[i];
+                weights[i] = (float)(l->attempts[c] - l->correct[c] + 1) / (float)(l->attempts[c] + 2);
+                total += weights[i];
+            }
+            float pick = rng_unit(rng) * total;
+            int i = 0;
+            while (i < run->active_count - 1 && pick > weights[i]) {
+                pick -= weights[i++];
+            }
+            return generate_question_for(run->active[i], rng);
+        }
+
+        case STRATEGY_SPACED: {
+            // Most overdue conversion; start the scan at a random offset to break ties
+            int start = (int)rng_below(rng, (uint32_t)run->active_count);
+            int best = run->active[start];
+            for (int k = 1; k < run->active_count; k++) {
+                int c = run->active[(start + k) % run->active_count];
+                if (l->due[c] < l->due[best]) best = c;
+            }
+            return generate_question_for(best, rng);
+        }
+
+        case STRATEGY_UNIFORM:
+        default:
+            return generate_question_r(&run->opts->selection, rng);
+    }
+}
+
+static void record_result(const sim_run_t *run, learner_t *l, int c, bool correct, int now) {
+    l->attempts[c]++;
+    if (correct) {
+        l->correct[c]++;
+    }
+    if (run->strategy == STRATEGY_SPACED) {
+        l->box[c] = correct ? (l->box[c] < SIM_MAX_BOX ? l->box[c] + 1 : SIM_MAX_BOX) : 0;
+        l->due[c] = now + (1 << l->box[c]);
+    }
+}
+
+/* ========== Simulation ========== */
+
+static int simulate_learner(const sim_run_t *run, rng_t *rng) {
+    const sim_options_t *opts = run->opts;
+    learner_t learner;
+    init_learner(opts, &learner, rng);
+
+    for (int now = 0; now < opts->max_questions; now++) {
+        question_t q = next_question(run, &learner, rng);
+        float answer = learner_answer(opts, &learner, &q, now, rng);
+        answer_result_t result = grade_answer(&q, answer);
+
+        learner_feedback(opts, &learner, q.conversion_id, result.is_correct);
+        record_result(run, &learner, q.conversion_id, result.is_correct, now);
+
+        if (has_mastered(run, &learner, now + 1)) {
+            return now + 1;
+        }
+    }
+    return -1;
+}
+
+static void simulate_batch(void *context, int task, int worker) {
+    (void)worker;
+    sim_run_t *run = context;
+    rng_t rng = run->streams[task];
+    long first = (long)task * SIM_BATCH;
+    long last = first + SIM_BATCH;
+    if (last > run->opts->learners) last = run->opts->learners;
+
+    for (long i = first; i < last; i++) {
+        run->results[i] = simulate_learner(run, &rng);
+    }
+}
+
+static int compare_ints(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+static void report_strategy(const sim_options_t *opts, strategy_t strategy, int *results, double seconds) {
+    long mastered = 0;
+    double total = 0.0;
+
+    // Learners who never got there sort last
+    for (long i = 0; i < opts->learners; i++) {
+        if (results[i] < 0) {
+            results[i] = opts->max_questions + 1;
+        } else {
+            mastered++;
+            total += results[i];
+        }
+    }
+    qsort(results, (size_t)opts->learners, sizeof(int), compare_ints);
+
+    printf("  %-8s  %7.1f%%", strategy_names[strategy], 100.0 * mastered / opts->learners);
+    if (mastered == 0) {
+        printf("  %8s  %8s  %8s", "-", "-", "-");
+    } else {
+        long median = results[(opts->learners - 1) / 2];
+        long p90 = results[(opts->learners * 9 - 1) / 10];
+        printf("  %8.1f", total / mastered);
+        if (median > opts->max_questions) printf("  %8s", "never"); else printf("  %8ld", median);
+        if (p90 > opts->max_questions) printf("  %8s", "never"); else printf("  %8ld", p90);
+    }
+    printf("  %7.2fs\n", seconds);
+}
+
+/* ========== Command Line ========== */
+
+static void show_simulate_help(void) {
+    printf("USAGE:\n");
+    printf("  metric-trainer simulate [OPTIONS]\n\n");
+    printf("OPTIONS:\n");
+    printf("  -n, --learners N       Virtual learners per strategy (default: 10000)\n");
+    printf("  -S, --strategy NAME    uniform, weak, spaced or all (default: all)\n");
+    printf("  -c, --categories SET   Categories to practice, e.g. \"ab\" (default: all)\n");
+    printf("  -s, --seed S           Random seed (default: current time)\n");
+    printf("  -t, --threads N        Worker threads (default: all CPUs)\n");
+    printf("  --cpus LIST            Pin worker threads to these CPUs, e.g. 0-3,8\n");
+    printf("  --worker-stats         Report each worker's utilization\n");
+    printf("  --max-questions N      Give up on a learner after N questions (default: 2000)\n");
+    printf("  --mastery P            Skill needed on every conversion, 0-1 (default: 0.9)\n");
+    printf("  --learn-rate R         Skill gained per corrected answer, 0-1 (default: 0.15)\n");
+    printf("  --forget-rate R        Skill decay per question elapsed, 0-1 (default: 0.01)\n");
+    printf("  --guess-error E        Relative error of a guess, 0-10 (default: 0.25)\n");
+    printf("  --initial-skill P      Mean starting skill, 0-1 (default: 0.3)\n");
+    printf("  -w, --whole / -e, --easy  Question modes, as in practice\n");
+}
+
+/* A model parameter from 0 to max; reports a bad value itself */
+static bool parse_rate(const char *option, const char *text, float max, float *result) {
+    char *end;
+    errno = 0;
+    float value = strtof(text, &end);
+    if (end == text || *end != '\0' || errno != 0 || !(value >= 0.0f && value <= max)) {
+        fprintf(stderr, "simulate: invalid %s '%s' (use 0 to %g)\n", option, text, (double)max);
+        return false;
+    }
+    *result = value;
+    return true;
+}
+
+static int parse_simulate_options(int argc, char *argv[], sim_options_t *opts) {
+    const char *categories = "all";
+    const char *strategy = "all";
+    bool seeded = false;
+
+    memset(opts, 0, sizeof(*opts));
+    opts->learners = 10000;
+    opts->max_questions = 2000;
+    opts->mastery = 0.9f;
+    opts->learn_rate = 0.15f;
+    opts->forget_rate = 0.01f;
+    opts->guess_error = 0.25f;
+    opts->initial_skill = 0.3f;
+    opts->threads = parallel_default_threads();
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            show_simulate_help();
+            return 0;
+        } else if (strcmp(arg, "-w") == 0 || strcmp(arg, "--whole") == 0) {
+            g_whole_numbers_mode = true;
+            continue;
+        } else if (strcmp(arg, "-e") == 0 || strcmp(arg, "--easy") == 0) {
+            g_easy_mode = true;
+            g_whole_numbers_mode = true;
+            continue;
+        } else if (strcmp(arg, "--worker-stats") == 0) {
+            opts->worker_stats = true;
+            continue;
+        }
+
+        if (value == NULL) {
+            fprintf(stderr, "simulate: unknown option or missing value: %s\n", arg);
+            return -1;
+        }
+        i++;
+
+        if (strcmp(arg, "-n") == 0 || strcmp(arg, "--learners") == 0) {
+            if (!parse_whole_number(value, 1, LONG_MAX, &opts->learners)) {
+                fprintf(stderr, "simulate: invalid learner count '%s' (use a positive number)\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "-S") == 0 || strcmp(arg, "--strategy") == 0) {
+            strategy = value;
+        } else if (strcmp(arg, "-c") == 0 || strcmp(arg, "--categories") == 0) {
+            categories = value;
+        } else if (strcmp(arg, "-s") == 0 || strcmp(arg, "--seed") == 0) {
+            if (!parse_seed(value, &opts->seed)) {
+                fprintf(stderr, "simulate: invalid seed '%s' (use a whole number)\n", value);
+                return -1;
+            }
+            seeded = true;
+        } else if (strcmp(arg, "-t") == 0 || strcmp(arg, "--threads") == 0) {
+            long threads;
+            if (!parse_whole_number(value, 1, PARALLEL_MAX_WORKERS, &threads)) {
+                fprintf(stderr, "simulate: invalid thread count '%s' (use 1 to %d)\n",
+                        value, PARALLEL_MAX_WORKERS);
+                return -1;
+            }
+            opts->threads = (int)threads;
+        } else if (strcmp(arg, "--cpus") == 0) {
+            if (parallel_set_cpus(value) != 0) {
+                fprintf(stderr, "simulate: invalid CPU list '%s'\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "--max-questions") == 0) {
+            long max_questions;
+            if (!parse_whole_number(value, 1, INT_MAX, &max_questions)) {
+                fprintf(stderr, "simulate: invalid question limit '%s' (use a positive number)\n", value);
+                return -1;
+            }
+            opts->max_questions = (int)max_questions;
+        } else if (strcmp(arg, "--mastery") == 0) {
+            if (!parse_rate(arg, value, 1.0f, &opts->mastery)) return -1;
+        } else if (strcmp(arg, "--learn-rate") == 0) {
+            if (!parse_rate(arg, value, 1.0f, &opts->learn_rate)) return -1;
+        } else if (strcmp(arg, "--forget-rate") == 0) {
+            if (!parse_rate(arg, value, 1.0f, &opts->forget_rate)) return -1;
+        } else if (strcmp(arg, "--guess-error") == 0) {
+            if (!parse_rate(arg, value, MAX_GUESS_ERROR, &opts->guess_error)) return -1;
+        } else if (strcmp(arg, "--initial-skill") == 0) {
+            if (!parse_rate(arg, value, 1.0f, &opts->initial_skill)) return -1;
+        } else {
+            fprintf(stderr, "simulate: unknown option: %s\n", arg);
+            return -1;
+        }
+    }
+
+    bool any_strategy = false;
+    for (int s = 0; s < STRATEGY_COUNT; s++) {
+        opts->strategies[s] = strcmp(strategy, "all") == 0 || strcmp(strategy, strategy_names[s]) == 0;
+        any_strategy = any_strategy || opts->strategies[s];
+    }
+    if (!any_strategy) {
+        fprintf(stderr, "simulate: unknown strategy '%s'\n", strategy);
+        return -1;
+    }
+    if (!parse_category_input(categories, &opts->selection)) {
+        fprintf(stderr, "simulate: invalid categories '%s'\n", categories);
+        return -1;
+    }
+    if (!seeded) {
+        opts->seed = (uint64_t)time(NULL);
+    }
+    return 1;
+}
+
+static double elapsed_seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int simulate_main(int argc, char *argv[]) {
+    sim_options_t opts;
+    int parsed = parse_simulate_options(argc, argv, &opts);
+    if (parsed <= 0) {
+        return parsed == 0 ? 0 : 1;
+    }
+
+    int batches = (int)((opts.learners + SIM_BATCH - 1) / SIM_BATCH);
+    rng_t *streams = malloc(sizeof(rng_t) * (size_t)batches);
+    int *results = malloc(sizeof(int) * (size_t)opts.learners);
+    if (streams == NULL || results == NULL) {
+        fprintf(stderr, "simulate: out of memory\n");
+        free(streams);
+        free(results);
+        return 1;
+    }
+    rng_derive_streams(opts.seed, batches, streams);
+
+    sim_run_t run;
+    memset(&run, 0, sizeof(run));
+    run.opts = &opts;
+    run.streams = streams;
+    run.results = results;
+    for (int cat = 0; cat < CATEGORY_COUNT; cat++) {
+        if (!opts.selection.active[cat]) continue;
+        int count = 0;
+        const unsigned char *ids = get_conversions_for_category((category_t)cat, &count);
+        for (int i = 0; i < count; i++) {
+            run.active[run.active_count++] = ids[i];
+        }
+    }
+
+    printf("Simulating %ld learners per strategy on %d conversions (seed %llu, %d thread%s)\n\n",
+           opts.learners, run.active_count, (unsigned long long)opts.seed, opts.threads, opts.threads == 1 ? "" : "s");
+    printf("  Strategy  Mastered  Mean Qs   Median       p90     Time\n");
+    printf("  ────────────────────────────────────────────────────────\n");
+
+    for (int s = 0; s < STRATEGY_COUNT; s++) {
+        if (!opts.strategies[s]) continue;
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        run.strategy = (strategy_t)s;
+        parallel_for(batches, opts.threads, simulate_batch, &run);
+        report_strategy(&opts, run.strategy, results, elapsed_seconds(&start));
+    }
+    printf("\nQuestions to mastery: fewer is better. Learners who never reach mastery\n");
+    printf("within --max-questions count as 'never' in the percentiles.\n");
+    if (opts.worker_stats) {
+        parallel_print_stats(stdout);
+    }
+
+    free(streams);
+    free(results);
+    return 0;
+}
@@ -0,0 +1,22 @@
+/*
+ * simulate.h - Simulated Learners
+ *
+ * Offline evaluation of question-selection strategies. Synthetic
+ * learners answer questions produced by generate_question_for and are
+ * graded by grade_answer - the same engine the interactive trainer uses,
+ * minus the terminal - and the simulator reports how many questions each
+ * strategy needs to bring a learner to mastery.
+ */
+
+#ifndef SIMULATE_H
+#define SIMULATE_H
+
+/**
+ * Entry point for `metric-trainer simulate ...`
+ * @param argc Argument count, argv[0] being "simulate"
+ * @param argv Argument vector
+ * @return Process exit status
+ */
+int simulate_main(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * sketch.c - Mergeable Quantile Sketches
+ */
+
+#include <math.h>
+#include "sketch.h"
+
+#define LOG_BUCKETS (SKETCH_BUCKETS - 2)
+
+/* log_gamma = ln(max / min) / LOG_BUCKETS */
+const sketch_scale_t sketch_percent_scale = { 0.1f, 0.30701135f };    // gamma ~1.359
+const sketch_scale_t sketch_seconds_scale = { 0.25f, 0.25944080f };   // gamma ~1.296
+
+int sketch_add(sketch_t *sketch, const sketch_scale_t *scale, float value) {
+    if (!(value >= 0.0f)) {
+        return -1;  // Negative or NaN: no bucket means anything for it
+    }
+    int bucket = 0;
+    if (value >= scale->min) {
+        float position = logf(value / scale->min) / scale->log_gamma;
+        bucket = position >= LOG_BUCKETS ? SKETCH_BUCKETS - 1 : 1 + (int)position;
+    }
+    sketch->counts[bucket]++;
+    return 0;
+}
+
+void sketch_merge(sketch_t *dst, const sketch_t *src) {
+    for (int i = 0; i < SKETCH_BUCKETS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+}
+
+uint32_t sketch_count(const sketch_t *sketch) {
+    uint32_t total = 0;
+    for (int i = 0; i < SKETCH_BUCKETS; i++) {
+        total += sketch->counts[i];
+    }
+    return total;
+}
+
+float sketch_quantile(const sketch_t *sketch, const sketch_scale_t *scale, float q) {
+    uint32_t total = sketch_count(sketch);
+    if (total == 0) {
+        return 0.0f;
+    }
+
+    // Nearest rank: the bucket holding the ceil(q * n)-th smallest value
+    double rank = ceil((double)q * total);
+    if (rank < 1.0) {
+        rank = 1.0;
+    }
+    uint64_t seen = 0;
+    int bucket = 0;
+    for (; bucket < SKETCH_BUCKETS - 1; bucket++) {
+        seen += sketch->counts[bucket];
+        if (seen >= rank) {
+            break;
+        }
+    }
+
+    if (bucket == 0) {
+        return 0.0f;
+    }
+    if (bucket == SKETCH_BUCKETS - 1) {
+        return scale->min * expf(LOG_BUCKETS * scale->log_gamma);
+    }
+    return scale->min * expf((bucket - 0.5f) * scale->log_gamma);
+}
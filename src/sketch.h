@@ -0,0 +1,69 @@
+/*
+ * sketch.h - Mergeable Quantile Sketches
+ *
+ * A fixed-size histogram with logarithmically spaced buckets, in the
+ * style of DDSketch: bucket 0 counts values below the scale's minimum,
+ * buckets 1..SKETCH_BUCKETS-2 each span a factor of gamma, and the last
+ * bucket counts everything at or above the maximum. Any quantile is then
+ * known to within a factor of sqrt(gamma) (about 15% for the scales
+ * below), an update is one logf() and an increment, and two sketches of
+ * the same scale merge by adding their counts - across sessions, users
+ * or machines, in any order, with the same result.
+ *
+ * Counts are 32-bit so a sketch can be stored inside persistent_stats_t
+ * (see persist.h); the scale is not stored and must match on merge.
+ */
+
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <stdint.h>
+
+#define SKETCH_BUCKETS 32
+
+typedef struct {
+    uint32_t counts[SKETCH_BUCKETS];
+} sketch_t;
+
+typedef struct {
+    float min;          // Lower edge of bucket 1
+    float log_gamma;    // Natural log of the ratio between bucket edges
+} sketch_scale_t;
+
+/* Percent error from 0.1% to 1000% */
+extern const sketch_scale_t sketch_percent_scale;
+
+/* Response time from 0.25 s to 10 minutes */
+extern const sketch_scale_t sketch_seconds_scale;
+
+/**
+ * Count one value
+ * @param sketch Sketch to update
+ * @param scale Scale the sketch uses
+ * @param value Value to count; 0 up to the minimum counts as below it
+ * @return 0, or -1 (and nothing counted) if value is negative or NaN
+ */
+int sketch_add(sketch_t *sketch, const sketch_scale_t *scale, float value);
+
+/**
+ * Add the counts of one sketch to another of the same scale
+ */
+void sketch_merge(sketch_t *dst, const sketch_t *src);
+
+/**
+ * Total number of values counted
+ */
+uint32_t sketch_count(const sketch_t *sketch);
+
+/**
+ * Estimate a quantile
+ * @param sketch Sketch to query (must not be empty)
+ * @param scale Scale the sketch uses
+ * @param q Quantile, 0.0 to 1.0 (0.5 = median), taken as the nearest
+ *          rank: the ceil(q * n)-th smallest of the n values counted
+ * @return Geometric midpoint of the bucket holding the quantile; 0 for
+ *         values below the minimum, the maximum for values above it
+ */
+float sketch_quantile(const sketch_t *sketch, const sketch_scale_t *scale, float q);
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * slab.c - Fixed-Size Object Slabs
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "slab.h"
+
+struct slab_chunk {
+    slab_chunk_t *next;
+    uint64_t pad;                       // Keeps objects SLAB_ALIGN-aligned
+    unsigned char objects[];
+};
+
+void slab_init(slab_t *slab, size_t object_size, size_t per_chunk) {
+    if (object_size < sizeof(void *)) {
+        object_size = sizeof(void *);
+    }
+    slab->object_size = (object_size + SLAB_ALIGN - 1) / SLAB_ALIGN * SLAB_ALIGN;
+    slab->per_chunk = per_chunk > 0 ? per_chunk : 1;
+    slab->free_list = NULL;
+    slab->chunks = NULL;
+    slab->carved = 0;
+    slab->in_use = 0;
+    slab->chunk_count = 0;
+}
+
+void *slab_alloc(slab_t *slab) {
+    void *object = slab->free_list;
+    if (object != NULL) {
+        slab->free_list = *(void **)object;
+    } else {
+        if (slab->chunks == NULL || slab->carved == slab->per_chunk) {
+            slab_chunk_t *chunk = malloc(sizeof(slab_chunk_t) + slab->per_chunk * slab->object_size);
+            if (chunk == NULL) {
+                return NULL;
+            }
+            chunk->next = slab->chunks;
+            slab->chunks = chunk;
+            slab->carved = 0;
+            slab->chunk_count++;
+        }
+        object = slab->chunks->objects + slab->carved++ * slab->object_size;
+    }
+    slab->in_use++;
+    return object;
+}
+
+void slab_free(slab_t *slab, void *object) {
+    if (object == NULL) {
+        return;
+    }
+    *(void **)object = slab->free_list;
+    slab->free_list = object;
+    slab->in_use--;
+}
+
+void slab_destroy(slab_t *slab) {
+    slab_chunk_t *chunk = slab->chunks;
+    while (chunk != NULL) {
+        slab_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    slab_init(slab, slab->object_size, slab->per_chunk);
+}
+
+size_t slab_bytes(const slab_t *slab) {
+    return slab->chunk_count * (sizeof(slab_chunk_t) + slab->per_chunk * slab->object_size);
+}
@@ -0,0 +1,66 @@
+/*
+ * slab.h - Fixed-Size Object Slabs
+ *
+ * A slab hands out objects of one size, carved from chunks allocated
+ * many objects at a time. Freed objects go onto a free list and are
+ * handed out again, most recently freed first (so they are likely still
+ * in cache). Once a workload has reached its peak number of live
+ * objects, allocating and freeing them costs no heap calls at all.
+ * Objects are carved from a chunk only when first needed, so the pages
+ * of a fresh chunk are not touched until then.
+ *
+ * Chunks are only returned to the heap by slab_destroy. Not thread
+ * safe; each slab belongs to one thread.
+ */
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+#define SLAB_ALIGN 16
+
+typedef struct slab_chunk slab_chunk_t;
+
+typedef struct {
+    size_t object_size;         // Rounded up to SLAB_ALIGN
+    size_t per_chunk;           // Objects per chunk
+    void *free_list;            // Freed objects, linked through their first word
+    slab_chunk_t *chunks;       // Newest first; only the newest has uncarved objects
+    size_t carved;              // Objects carved from the newest chunk
+    size_t in_use;              // Objects handed out and not freed
+    size_t chunk_count;         // Chunks allocated (each one heap allocation)
+} slab_t;
+
+/**
+ * Initialize an empty slab (allocates nothing yet)
+ * @param slab Slab to initialize
+ * @param object_size Size of each object
+ * @param per_chunk Objects to allocate at a time
+ */
+void slab_init(slab_t *slab, size_t object_size, size_t per_chunk);
+
+/**
+ * Take an object (contents undefined)
+ * @return The object, SLAB_ALIGN-aligned, or NULL if memory ran out
+ */
+void *slab_alloc(slab_t *slab);
+
+/**
+ * Give an object back
+ * @param slab The slab it came from
+ * @param object The object (NULL is ignored)
+ */
+void slab_free(slab_t *slab, void *object);
+
+/**
+ * Free every chunk; objects still in use become invalid
+ */
+void slab_destroy(slab_t *slab);
+
+/**
+ * Bytes the slab holds from the heap
+ */
+size_t slab_bytes(const slab_t *slab);
+
+#endif
@@ -0,0 +1,303 @@
+/*
+ * statswriter.c - Write-Behind Statistics Persistence
+ *
+ * The ring is a fixed power-of-two array indexed by free-running head and
+ * tail counters: the session thread is the only writer of `head`, the
+ * writer thread the only writer of `tail`, and each publishes with a
+ * release store that the other side reads with an acquire load.
+ *
+ * If the ring fills (the disk has stalled), answers go to an overflow
+ * array under a mutex until the writer takes it. While the overflow holds
+ * anything, nothing new goes on the ring, so draining the ring and then
+ * taking the overflow - both under the mutex - applies answers in the
+ * order they were given.
+ *
+ * The writer thread sleeps in poll() on a pipe with the save interval as
+ * timeout. Signal handlers wake it by writing the signal's number to the
+ * pipe - write() being async-signal-safe - and statswriter_stop() by
+ * setting a flag and writing a byte. A wakeup reads the pipe until it is
+ * empty, so a signal that arrives together with a stop is still seen.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "answerlog.h"
+#include "metrics.h"
+#include "rollup.h"
+#include "statswriter.h"
+
+#define RING_SIZE 1024            // Power of two
+
+static const int handled_signals[] = { SIGINT, SIGTERM, SIGHUP };
+#define HANDLED_SIGNAL_COUNT (int)(sizeof(handled_signals) / sizeof(handled_signals[0]))
+
+typedef struct {
+    stats_delta_t ring[RING_SIZE];
+    size_t head __attribute__((aligned(64)));   // Next slot to fill (session thread)
+    size_t tail __attribute__((aligned(64)));   // Next slot to drain (writer thread)
+
+    /* Under overflow_lock */
+    pthread_mutex_t overflow_lock;
+    stats_delta_t *overflow;        // Answers given since the ring was found full
+    size_t overflow_count;
+    size_t overflow_capacity;
+    bool overflowing;               // overflow_count > 0; also read without the lock
+
+    /* Writer thread only, after start */
+    persistent_stats_t totals;
+    rollup_t rollup;
+    char rollup_path[MAX_DATA_PATH];
+    answerlog_t log;
+    int interval_ms;
+
+    pthread_t thread;
+    bool threaded;                  // False if the thread could not start: save on stop
+    int wake_pipe[2];
+    bool stopping;                  // Set by statswriter_stop() before it wakes the thread
+    struct sigaction saved_actions[HANDLED_SIGNAL_COUNT];
+} statswriter_t;
+
+static statswriter_t writer;
+
+/* ========== Ring ========== */
+
+/* Counts one answer everywhere it is kept */
+static void apply_answer(const stats_delta_t *delta) {
+    apply_stats_delta(&writer.totals, delta);
+    rollup_add(&writer.rollup, delta);
+    answerlog_append(&writer.log, delta);
+}
+
+static void save_all(void) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    save_persistent_stats(&writer.totals);
+    rollup_flush(writer.rollup_path, &writer.rollup);
+    answerlog_flush(&writer.log);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    metrics_flush((double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+static bool ring_push(const stats_delta_t *delta) {
+    size_t head = writer.head;
+    size_t tail = __atomic_load_n(&writer.tail, __ATOMIC_ACQUIRE);
+    if (head - tail == RING_SIZE) {
+        return false;
+    }
+    writer.ring[head & (RING_SIZE - 1)] = *delta;
+    __atomic_store_n(&writer.head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* Applies every queued delta; returns how many there were */
+static size_t ring_drain(void) {
+    size_t tail = writer.tail;
+    size_t head = __atomic_load_n(&writer.head, __ATOMIC_ACQUIRE);
+    for (size_t i = tail; i != head; i++) {
+        apply_answer(&writer.ring[i & (RING_SIZE - 1)]);
+    }
+    __atomic_store_n(&writer.tail, head, __ATOMIC_RELEASE);
+    return head - tail;
+}
+
+/* Applies the ring and then the overflow, oldest answer first; returns how many */
+static size_t drain_all(void) {
+    if (!__atomic_load_n(&writer.overflowing, __ATOMIC_ACQUIRE)) {
+        return ring_drain();
+    }
+
+    pthread_mutex_lock(&writer.overflow_lock);
+    size_t count = ring_drain();
+    stats_delta_t *overflow = writer.overflow;
+    size_t overflow_count = writer.overflow_count;
+    writer.overflow = NULL;
+    writer.overflow_count = 0;
+    writer.overflow_capacity = 0;
+    __atomic_store_n(&writer.overflowing, false, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&writer.overflow_lock);
+
+    for (size_t i = 0; i < overflow_count; i++) {
+        apply_answer(&overflow[i]);
+    }
+    free(overflow);
+    return count + overflow_count;
+}
+
+/* ========== Writer Thread ========== */
+
+static void on_signal(int sig) {
+    int saved_errno = errno;
+    unsigned char byte = (unsigned char)sig;
+    ssize_t ignored = write(writer.wake_pipe[1], &byte, 1);
+    (void)ignored;
+    errno = saved_errno;
+}
+
+static void restore_signals(void) {
+    for (int i = 0; i < HANDLED_SIGNAL_COUNT; i++) {
+        sigaction(handled_signals[i], &writer.saved_actions[i], NULL);
+    }
+}
+
+/* Empty the wake pipe; returns the first signal in it, or 0 */
+static int read_wakeups(void) {
+    unsigned char bytes[64];
+    int sig = 0;
+    ssize_t n;
+
+    while ((n = read(writer.wake_pipe[0], bytes, sizeof(bytes))) > 0 || (n < 0 && errno == EINTR)) {
+        for (ssize_t i = 0; i < n && sig == 0; i++) {
+            sig = bytes[i];
+        }
+    }
+    return sig;
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    struct pollfd pfd = { writer.wake_pipe[0], POLLIN, 0 };
+    bool dirty = false;
+
+    for (;;) {
+        int ready = poll(&pfd, 1, writer.interval_ms);
+        int sig = ready > 0 ? read_wakeups() : 0;
+
+        if (sig == 0 && __atomic_load_n(&writer.stopping, __ATOMIC_ACQUIRE)) {
+            return NULL;  // statswriter_stop() drains and saves
+        }
+
+        // Coalesce everything queued since the last pass into one save
+        if (drain_all() > 0) {
+            dirty = true;
+        }
+        if (dirty) {
+            save_all();
+            dirty = false;
+        }
+
+        if (sig != 0) {
+            // The answers are safe; now let the signal do what it would have done
+            restore_signals();
+            raise(sig);
+        }
+        if (__atomic_load_n(&writer.stopping, __ATOMIC_ACQUIRE)) {
+            return NULL;
+        }
+    }
+}
+
+/* ========== Public API ========== */
+
+void statswriter_start(const persistent_stats_t *base, int interval_ms) {
+    memset(&writer, 0, sizeof(writer));
+    pthread_mutex_init(&writer.overflow_lock, NULL);
+    writer.totals = *base;
+    writer.interval_ms = interval_ms;
+    user_data_path(PROGRESS_FILE, writer.rollup_path, sizeof(writer.rollup_path));
+    rollup_load(writer.rollup_path, &writer.rollup);
+
+    char log_path[MAX_DATA_PATH];
+    user_data_path(ANSWERLOG_FILE, log_path, sizeof(log_path));
+    if (answerlog_open(log_path, &writer.log) != 0) {
+        fprintf(stderr, "Warning: cannot open %s; this session will not be in the history\n", log_path);
+    }
+
+    if (pipe(writer.wake_pipe) != 0) {
+        return;
+    }
+    fcntl(writer.wake_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(writer.wake_pipe[1], F_SETFL, O_NONBLOCK);
+
+    // Handlers go in before the thread exists, so a signal can never find
+    // a pipe nobody reads; SA_RESTART keeps the session's read() going
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_signal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    for (int i = 0; i < HANDLED_SIGNAL_COUNT; i++) {
+        sigaction(handled_signals[i], &action, &writer.saved_actions[i]);
+        if (writer.saved_actions[i].sa_handler == SIG_IGN) {
+            sigaction(handled_signals[i], &writer.saved_actions[i], NULL);  // e.g. under nohup
+        }
+    }
+
+    if (pthread_create(&writer.thread, NULL, writer_main, NULL) == 0) {
+        writer.threaded = true;
+    } else {
+        restore_signals();
+        close(writer.wake_pipe[0]);
+        close(writer.wake_pipe[1]);
+    }
+}
+
+void statswriter_record(const stats_delta_t *delta) {
+    if (!writer.threaded) {
+        apply_answer(delta);
+        return;
+    }
+
+    if (!__atomic_load_n(&writer.overflowing, __ATOMIC_ACQUIRE) && ring_push(delta)) {
+        return;
+    }
+
+    // A full ring means the disk has stalled for a long time; keep the
+    // answer in memory rather than wait, for the writer's next pass. The
+    // ring is tried again first in case the writer has just emptied both
+    pthread_mutex_lock(&writer.overflow_lock);
+    if (writer.overflow_count > 0 || !ring_push(delta)) {
+        if (writer.overflow_count == writer.overflow_capacity) {
+            size_t capacity = writer.overflow_capacity > 0 ? writer.overflow_capacity * 2 : RING_SIZE;
+            stats_delta_t *grown = realloc(writer.overflow, capacity * sizeof(*grown));
+            if (grown != NULL) {
+                writer.overflow = grown;
+                writer.overflow_capacity = capacity;
+            }
+        }
+        if (writer.overflow_count < writer.overflow_capacity) {
+            writer.overflow[writer.overflow_count++] = *delta;
+            __atomic_store_n(&writer.overflowing, true, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&writer.overflow_lock);
+}
+
+size_t statswriter_queue_depth(void) {
+    size_t tail = __atomic_load_n(&writer.tail, __ATOMIC_ACQUIRE);
+    return __atomic_load_n(&writer.head, __ATOMIC_ACQUIRE) - tail;
+}
+
+void statswriter_stop(persistent_stats_t *totals) {
+    if (writer.threaded) {
+        unsigned char byte = 0;
+        __atomic_store_n(&writer.stopping, true, __ATOMIC_RELEASE);
+        while (write(writer.wake_pipe[1], &byte, 1) < 0 && errno == EINTR) {
+        }
+        pthread_join(writer.thread, NULL);
+        restore_signals();
+        close(writer.wake_pipe[0]);
+        close(writer.wake_pipe[1]);
+        writer.threaded = false;
+
+        // The thread has exited, so its totals are ours now
+        drain_all();
+    }
+
+    save_all();
+    rollup_free(&writer.rollup);
+    answerlog_close(&writer.log);
+
+    pthread_mutex_destroy(&writer.overflow_lock);
+
+    if (totals != NULL) {
+        *totals = writer.totals;
+    }
+}
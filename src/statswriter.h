@@ -0,0 +1,48 @@
+/*
+ * statswriter.h - Write-Behind Statistics Persistence
+ *
+ * During a practice session, answers are not saved by the answer loop
+ * itself. Each graded answer becomes a stats_delta_t pushed onto a
+ * single-producer, single-consumer ring. A background thread drains the
+ * ring into the lifetime totals, progress rollups (rollup.h) and answer
+ * log (answerlog.h), and saves them every interval, when the session
+ * ends, and on SIGINT, SIGTERM or SIGHUP (after which the signal is
+ * raised again with the handling it had before the session). Pushing is
+ * a couple of atomic operations and does not wait for the disk; if the
+ * ring fills, answers are kept in memory, in order, until the writer's
+ * next pass. A crash loses at most one interval of answers.
+ */
+
+#ifndef STATSWRITER_H
+#define STATSWRITER_H
+
+#include <stddef.h>
+#include "questions.h"
+
+#define STATSWRITER_DEFAULT_INTERVAL_MS 2000
+
+/**
+ * Start the writer for a session
+ * @param base Lifetime statistics loaded at the start of the session
+ * @param interval_ms Longest time an answer may wait before being saved
+ */
+void statswriter_start(const persistent_stats_t *base, int interval_ms);
+
+/**
+ * Queue one answer for saving; never waits for the disk
+ * @param delta The answer's contribution to the lifetime statistics
+ */
+void statswriter_record(const stats_delta_t *delta);
+
+/**
+ * Answers queued but not yet applied; safe to call from any thread
+ */
+size_t statswriter_queue_depth(void);
+
+/**
+ * Stop the writer: saves everything queued so far and joins the thread
+ * @param totals Receives the final lifetime statistics (may be NULL)
+ */
+void statswriter_stop(persistent_stats_t *totals);
+
+#endif
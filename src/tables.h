@@ -0,0 +1,44 @@
+/*
+ * tables.h - Build-time Generated Conversion Tables
+ *
+ * Everything declared here is produced by tools/gentables from
+ * conversions.def and linked in as static const data (tables_gen.c),
+ * so the program does no parsing or table building at startup.
+ *
+ * Conversions are stored in one flat table indexed by their stable ids
+ * (see conversions.def); category_conversions lists each category's ids.
+ * The table is split hot/cold: conversion_table holds only what
+ * generation and grading read, while unit names live in
+ * conversion_names as offsets into the interned unit_strings table.
+ * The value grids list every value the --whole and --easy modes may
+ * ask about, as (first, count) slices of grid_values.
+ */
+
+#ifndef TABLES_H
+#define TABLES_H
+
+#include "questions.h"
+
+#define CACHE_LINE_SIZE 64
+
+extern const conversion_info_t conversion_table[CONVERSION_COUNT];
+extern const conversion_names_t conversion_names[CONVERSION_COUNT];
+extern const char unit_strings[];
+extern const unsigned char category_conversions[CATEGORY_COUNT][MAX_CONVERSIONS_PER_CATEGORY];
+extern const unsigned char category_conversion_count[CATEGORY_COUNT];
+
+extern const char category_letters[CATEGORY_COUNT];
+extern const char *const category_names[CATEGORY_COUNT];
+extern const char *const category_descs[CATEGORY_COUNT];
+
+extern const short grid_values[];
+
+extern const char menu_text[];          // Category menu shown by show_menu()
+extern const char reference_text[];     // Formula sheet shown by show_conversion_reference()
+
+/* Resolve an offset from conversion_names into a unit string */
+static inline const char *unit_string(unsigned short offset) {
+    return unit_strings + offset;
+}
+
+#endif
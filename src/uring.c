@@ -0,0 +1,200 @@
+/*
+ * uring.c - Minimal io_uring Rings
+ *
+ * The kernel and this process share the rings through one mapping (the
+ * submission and completion rings) plus one for the submission entries.
+ * The process owns the submission tail and the completion head; the
+ * kernel owns the other ends. Each side publishes its index with a
+ * release store and reads the other's with an acquire load, which is
+ * the whole of the synchronization.
+ *
+ * The ring is set up for a single issuing thread with deferred task
+ * work where the kernel has it (6.1 and later), so completions are only
+ * processed when the server asks for them, between batches.
+ */
+
+#define _DEFAULT_SOURCE                   // syscall(2)
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "uring.h"
+
+static int sys_setup(unsigned entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_enter(int fd, unsigned submit, unsigned wait, unsigned flags, void *arg, size_t arg_size) {
+    return (int)syscall(__NR_io_uring_enter, fd, submit, wait, flags, arg, arg_size);
+}
+
+static int sys_register(int fd, unsigned opcode, void *arg, unsigned count) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+/* ========== Setup ========== */
+
+int uring_init(uring_t *ring, unsigned entries, unsigned cq_entries) {
+    struct io_uring_params params;
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL |
+                   IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    params.cq_entries = cq_entries;
+    int fd = sys_setup(entries, &params);
+    if (fd < 0 && errno == EINVAL) {
+        // Before 6.1: no deferred task work
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = cq_entries;
+        fd = sys_setup(entries, &params);
+    }
+    if (fd < 0) {
+        return -1;
+    }
+    ring->fd = fd;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        uring_free(ring);
+        errno = ENOSYS;                   // Older than 5.11
+        return -1;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ring_map_size = sq_size > cq_size ? sq_size : cq_size;
+    ring->ring_map = mmap(NULL, ring->ring_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQ_RING);
+    ring->sqe_map_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqe_map = mmap(NULL, ring->sqe_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQES);
+    if (ring->ring_map == MAP_FAILED || ring->sqe_map == MAP_FAILED) {
+        int saved = errno;
+        uring_free(ring);
+        errno = saved;
+        return -1;
+    }
+
+    char *base = ring->ring_map;
+    ring->sq_head = (unsigned *)(base + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(base + params.sq_off.tail);
+    ring->sq_array = (unsigned *)(base + params.sq_off.array);
+    ring->sq_mask = *(unsigned *)(base + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    ring->sqes = ring->sqe_map;
+    ring->cq_head = (unsigned *)(base + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(base + params.cq_off.tail);
+    ring->cq_mask = *(unsigned *)(base + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(base + params.cq_off.cqes);
+
+    // Slot i of the ring always names entry i; entries are used in order
+    for (unsigned i = 0; i < ring->sq_entries; i++) {
+        ring->sq_array[i] = i;
+    }
+    return 0;
+}
+
+void uring_free(uring_t *ring) {
+    if (ring->buf_ring != NULL) {
+        munmap(ring->buf_ring, ring->buf_count * sizeof(struct io_uring_buf));
+    }
+    free(ring->buf_base);
+    if (ring->sqe_map != NULL && ring->sqe_map != MAP_FAILED) {
+        munmap(ring->sqe_map, ring->sqe_map_size);
+    }
+    if (ring->ring_map != NULL && ring->ring_map != MAP_FAILED) {
+        munmap(ring->ring_map, ring->ring_map_size);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+/* ========== Provided Buffers ========== */
+
+int uring_provide_buffers(uring_t *ring, uint16_t group, unsigned count, unsigned size) {
+    // The buffer ring must be page aligned, which an anonymous mapping is
+    void *map = mmap(NULL, count * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    ring->buf_ring = map;
+    ring->buf_count = count;
+    ring->buf_size = size;
+    ring->buf_base = malloc((size_t)count * size);
+    if (ring->buf_base == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)map;
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (sys_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        return -1;                        // Before 5.19
+    }
+    for (unsigned id = 0; id < count; id++) {
+        uring_recycle(ring, id);
+    }
+    return 0;
+}
+
+void uring_recycle(uring_t *ring, unsigned id) {
+    struct io_uring_buf *buf = &ring->buf_ring->bufs[ring->buf_tail & (ring->buf_count - 1)];
+    buf->addr = (uint64_t)(uintptr_t)uring_buffer(ring, id);
+    buf->len = ring->buf_size;
+    buf->bid = (uint16_t)id;
+    ring->buf_tail++;
+    __atomic_store_n(&ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
+
+/* ========== Submission and Completion ========== */
+
+struct io_uring_sqe *uring_sqe(uring_t *ring) {
+    if (ring->sq_pending == ring->sq_entries) {
+        __atomic_store_n(ring->sq_tail, *ring->sq_tail + ring->sq_pending, __ATOMIC_RELEASE);
+        ring->syscalls++;
+        if (sys_enter(ring->fd, ring->sq_pending, 0, 0, NULL, 0) < 0) {
+            ring->sq_pending = *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+            *ring->sq_tail -= ring->sq_pending;
+            return NULL;
+        }
+        ring->sq_pending = 0;
+    }
+    struct io_uring_sqe *sqe = &ring->sqes[(*ring->sq_tail + ring->sq_pending) & ring->sq_mask];
+    ring->sq_pending++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int uring_enter(uring_t *ring, int timeout_ms) {
+    struct __kernel_timespec timeout = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_nsec = (long long)(timeout_ms % 1000) * 1000000
+    };
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uint64_t)(uintptr_t)&timeout;
+
+    unsigned submit = ring->sq_pending;
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + submit, __ATOMIC_RELEASE);
+    ring->sq_pending = 0;
+    ring->syscalls++;
+    int result = sys_enter(ring->fd, submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    // With IORING_SETUP_SUBMIT_ALL everything queued is consumed unless
+    // the call failed before submitting; the kernel's head says which
+    unsigned unsubmitted = *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (unsubmitted > 0) {
+        *ring->sq_tail -= unsubmitted;
+        ring->sq_pending = unsubmitted;
+    }
+    return result < 0 ? -errno : 0;
+}
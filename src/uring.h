@@ -0,0 +1,118 @@
+/*
+ * uring.h - Minimal io_uring Rings
+ *
+ * Just enough io_uring for the server's event loop, on raw system calls
+ * with no library: a submission and completion ring pair, and one ring
+ * of provided receive buffers that multishot receives draw from. Entries
+ * are queued in user memory and reach the kernel together at the next
+ * uring_enter, so a whole batch of accepts, receives and sends costs one
+ * system call.
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <linux/io_uring.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    int fd;
+    // Submission ring (mapped)
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sq_pending;                  // Queued but not yet submitted
+    struct io_uring_sqe *sqes;
+    // Completion ring (mapped)
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    // Provided buffers
+    struct io_uring_buf_ring *buf_ring;
+    char *buf_base;
+    unsigned buf_count;                   // Power of two
+    unsigned buf_size;
+    uint16_t buf_tail;
+    // Mappings to undo
+    void *ring_map;
+    size_t ring_map_size;
+    void *sqe_map;
+    size_t sqe_map_size;
+    unsigned long long syscalls;          // io_uring_enter calls made
+} uring_t;
+
+/**
+ * Set up a ring pair
+ * @param ring Ring to initialize
+ * @param entries Submission ring size (power of two)
+ * @param cq_entries Completion ring size (power of two, >= entries)
+ * @return 0 on success, -1 with errno set (ENOSYS or EPERM where
+ *         io_uring is unavailable)
+ */
+int uring_init(uring_t *ring, unsigned entries, unsigned cq_entries);
+
+/**
+ * Tear down a ring; pending operations are cancelled by the kernel
+ */
+void uring_free(uring_t *ring);
+
+/**
+ * Register a ring of receive buffers for IOSQE_BUFFER_SELECT
+ * @param ring The ring
+ * @param group Buffer group id that receives will name
+ * @param count Number of buffers (power of two, at most 32768)
+ * @param size Bytes per buffer
+ * @return 0 on success, -1 with errno set
+ */
+int uring_provide_buffers(uring_t *ring, uint16_t group, unsigned count, unsigned size);
+
+/**
+ * Buffer a completion selected, by its id
+ */
+static inline char *uring_buffer(const uring_t *ring, unsigned id) {
+    return ring->buf_base + (size_t)id * ring->buf_size;
+}
+
+/**
+ * Hand a selected buffer back to the kernel for reuse
+ */
+void uring_recycle(uring_t *ring, unsigned id);
+
+/**
+ * Next free submission entry, zeroed; submits queued entries first if
+ * the ring is full
+ * @return The entry, or NULL if the ring stays full
+ */
+struct io_uring_sqe *uring_sqe(uring_t *ring);
+
+/**
+ * Submit queued entries and wait for at least one completion
+ * @param ring The ring
+ * @param timeout_ms Longest wait
+ * @return 0, or -errno (-ETIME on timeout, -EINTR on a signal)
+ */
+int uring_enter(uring_t *ring, int timeout_ms);
+
+/**
+ * Oldest unconsumed completion, or NULL if there is none
+ */
+static inline struct io_uring_cqe *uring_cqe(uring_t *ring) {
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return &ring->cqes[head & ring->cq_mask];
+}
+
+/**
+ * Consume the completion uring_cqe returned
+ */
+static inline void uring_cqe_seen(uring_t *ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -0,0 +1,575 @@
+/*
+ * userstore.c - Multi-User Statistics Store
+ *
+ * On-disk open-addressing hash table of per-user statistics. Slots are
+ * addressed directly from the FNV-1a hash of the user name with linear
+ * probing, capped at STORE_MAX_PROBES, so a lookup costs one pread() of
+ * the header plus at most STORE_MAX_PROBES slot reads. An insert whose
+ * probe sequence would run past the cap doubles the table instead.
+ *
+ * Crash safety: each slot holds two copies of the statistics, each with
+ * a sequence number and CRC. A save overwrites the older copy and leaves
+ * the newer one alone, so a torn write can only damage the copy that was
+ * about to be replaced; loads take the valid copy with the higher
+ * sequence number. Everything else - creating, growing, or upgrading the
+ * store from an older format - builds a complete new table in a
+ * temporary file and renames it into place. Every save ends with exactly
+ * one fsync, whichever path it takes.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "persist.h"
+#include "userstore.h"
+
+#define STORE_MAGIC "MTUS"
+#define STORE_VERSION 2
+#define STORE_HEADER_SIZE 64
+#define STORE_INITIAL_CAPACITY 64
+#define STORE_MAX_PROBES 16
+
+#define SLOT_EMPTY 0
+#define SLOT_USED 1
+
+/*
+ * Slot layout (version 2):
+ *   0   u32  state
+ *   4   name, NUL-padded to USER_NAME_MAX + 1 bytes
+ *   36  copy 0: u32 sequence, u32 CRC-32 of payload, payload
+ *   ..  copy 1: same, directly after copy 0
+ * A sequence number of 0 marks a copy that was never written.
+ *
+ * Version 1 had no header CRC or byte-order mark and kept a single bare
+ * persistent_stats_t at offset 36; it is read and upgraded on first save.
+ */
+#define SLOT_NAME 4
+#define SLOT_COPIES 36
+#define COPY_HEADER 8
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t byte_order;
+    uint32_t slot_size;      // Bytes between consecutive slots
+    uint32_t capacity;       // Number of slots, a power of two
+    uint32_t stats_size;     // Payload bytes per copy
+    uint32_t crc;            // CRC-32 of the fields above
+} store_header_t;
+
+/* A header as found on disk, whichever version and byte order */
+typedef struct {
+    int version;
+    bool swap;
+    uint32_t slot_size;
+    uint32_t capacity;
+    uint32_t stats_size;
+} store_format_t;
+
+/* Current slot size, padded to whole cache lines so a slot never straddles two */
+#define COPY_SIZE (COPY_HEADER + sizeof(persistent_stats_t))
+#define SLOT_SIZE ((SLOT_COPIES + 2 * COPY_SIZE + 63) / 64 * 64)
+
+/* ========== Helpers ========== */
+
+static uint32_t hash_name(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t get32(const unsigned char *p, bool swap) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    if (swap) {
+        v = (v >> 24) | ((v >> 8) & 0xff00u) | ((v << 8) & 0xff0000u) | (v << 24);
+    }
+    return v;
+}
+
+static void put32(unsigned char *p, uint32_t v) {
+    memcpy(p, &v, 4);
+}
+
+static off_t slot_offset(const store_format_t *format, uint32_t index) {
+    return (off_t)STORE_HEADER_SIZE + (off_t)index * format->slot_size;
+}
+
+static int lock_file(int fd, short type) {
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    while (fcntl(fd, F_SETLKW, &lock) != 0) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static bool is_current(const store_format_t *format) {
+    return format->version == STORE_VERSION && !format->swap &&
+           format->slot_size == SLOT_SIZE &&
+           format->stats_size == sizeof(persistent_stats_t);
+}
+
+static int read_format(int fd, store_format_t *format) {
+    unsigned char raw[STORE_HEADER_SIZE];
+    if (persist_read_at(fd, raw, sizeof(raw), 0) != 0 || memcmp(raw, STORE_MAGIC, 4) != 0) {
+        return -1;
+    }
+
+    memset(format, 0, sizeof(*format));
+    if (get32(raw + 4, false) == 1) {
+        // Version 1: magic, version, slot size, capacity, count, stats size
+        format->version = 1;
+        format->slot_size = get32(raw + 8, false);
+        format->capacity = get32(raw + 12, false);
+        format->stats_size = get32(raw + 20, false);
+        if (format->slot_size < SLOT_COPIES + format->stats_size) {
+            return -1;
+        }
+    } else {
+        store_header_t header;
+        memcpy(&header, raw, sizeof(header));
+        if (header.byte_order == PERSIST_BYTE_ORDER_SWAPPED) {
+            format->swap = true;
+        } else if (header.byte_order != PERSIST_BYTE_ORDER) {
+            return -1;
+        }
+        if (persist_crc32(raw, offsetof(store_header_t, crc)) !=
+            get32(raw + offsetof(store_header_t, crc), format->swap)) {
+            return -1;
+        }
+        format->version = format->swap ? (header.version >> 8) | ((header.version & 0xff) << 8)
+                                       : header.version;
+        format->slot_size = get32(raw + offsetof(store_header_t, slot_size), format->swap);
+        format->capacity = get32(raw + offsetof(store_header_t, capacity), format->swap);
+        format->stats_size = get32(raw + offsetof(store_header_t, stats_size), format->swap);
+        if (format->version < STORE_VERSION ||
+            format->slot_size < SLOT_COPIES + 2 * (COPY_HEADER + format->stats_size)) {
+            return -1;
+        }
+    }
+
+    if (format->capacity == 0 || (format->capacity & (format->capacity - 1)) != 0 ||
+        format->stats_size % 4 != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Extracts the newest valid statistics from a slot.
+ * Returns the index of the copy used, or -1 if neither copy is valid
+ * (stats are then zero); *seq receives its sequence number.
+ */
+static int slot_stats(const store_format_t *format, const unsigned char *slot,
+                      persistent_stats_t *stats, uint32_t *seq) {
+    memset(stats, 0, sizeof(*stats));
+    *seq = 0;
+
+    if (format->version == 1) {
+        persist_decode_stats(slot + SLOT_COPIES, format->stats_size, false, stats);
+        return 0;
+    }
+
+    int best = -1;
+    for (int i = 0; i < 2; i++) {
+        const unsigned char *copy = slot + SLOT_COPIES + i * (COPY_HEADER + format->stats_size);
+        uint32_t copy_seq = get32(copy, format->swap);
+        uint32_t crc = get32(copy + 4, format->swap);
+        if (copy_seq != 0 && copy_seq > *seq &&
+            persist_crc32(copy + COPY_HEADER, format->stats_size) == crc) {
+            best = i;
+            *seq = copy_seq;
+        }
+    }
+    if (best >= 0) {
+        const unsigned char *copy = slot + SLOT_COPIES + best * (COPY_HEADER + format->stats_size);
+        persist_decode_stats(copy + COPY_HEADER, format->stats_size, format->swap, stats);
+    }
+    return best;
+}
+
+/* Fills a copy in the current format */
+static void encode_copy(unsigned char *copy, uint32_t seq, const persistent_stats_t *stats) {
+    put32(copy, seq);
+    put32(copy + 4, persist_crc32(stats, sizeof(*stats)));
+    memcpy(copy + COPY_HEADER, stats, sizeof(*stats));
+}
+
+/*
+ * Probes for `user`, reading only each slot's state and name, then the
+ * whole of the matching slot into `slot` (slot_size bytes).
+ * Returns 1 with *index at the user's slot, 0 with *index at the empty
+ * slot where the user would go, 2 if the probe limit was reached, or -1.
+ */
+static int find_slot(int fd, const store_format_t *format, const char *user,
+                     unsigned char *slot, uint32_t *index) {
+    uint32_t mask = format->capacity - 1;
+    uint32_t i = hash_name(user) & mask;
+    uint32_t limit = format->capacity < STORE_MAX_PROBES ? format->capacity : STORE_MAX_PROBES;
+    if (format->version == 1) {
+        limit = format->capacity;  // Version 1 bounded load, not probe length
+    }
+
+    for (uint32_t probes = 0; probes < limit; probes++) {
+        if (persist_read_at(fd, slot, SLOT_COPIES, slot_offset(format, i)) != 0) {
+            return -1;
+        }
+        uint32_t state = get32(slot, format->swap);
+        if (state == SLOT_EMPTY) {
+            *index = i;
+            return 0;
+        }
+        if (state == SLOT_USED && strncmp((const char *)slot + SLOT_NAME, user, USER_NAME_MAX + 1) == 0) {
+            *index = i;
+            return persist_read_at(fd, slot, format->slot_size, slot_offset(format, i)) == 0 ? 1 : -1;
+        }
+        i = (i + 1) & mask;
+    }
+    return 2;
+}
+
+/* Places a slot in an in-memory table; false if the probe limit is hit */
+static bool table_insert(unsigned char *table, uint32_t capacity, const unsigned char *slot) {
+    uint32_t mask = capacity - 1;
+    uint32_t i = hash_name((const char *)slot + SLOT_NAME) & mask;
+    uint32_t limit = capacity < STORE_MAX_PROBES ? capacity : STORE_MAX_PROBES;
+
+    for (uint32_t probes = 0; probes < limit; probes++) {
+        unsigned char *dst = table + (size_t)i * SLOT_SIZE;
+        if (get32(dst, false) == SLOT_EMPTY) {
+            memcpy(dst, slot, SLOT_SIZE);
+            return true;
+        }
+        i = (i + 1) & mask;
+    }
+    return false;
+}
+
+/*
+ * Writes a complete table in the current format to a temporary file and
+ * renames it over the store: every user from the old table (`old` may be
+ * NULL for a new store), with `user` set to `stats`, added if missing.
+ * The capacity doubles until every user fits within the probe limit.
+ */
+static int rebuild(const char *path, int fd, const store_format_t *old, uint32_t capacity,
+                   const char *user, const persistent_stats_t *stats) {
+    size_t tmp_len = strlen(path) + 5;
+    char *tmp_path = malloc(tmp_len);
+    size_t old_len = old != NULL ? (size_t)old->capacity * old->slot_size : 0;
+    unsigned char *old_table = malloc(old_len > 0 ? old_len : 1);
+    unsigned char *table = NULL;
+    unsigned char slot[SLOT_SIZE];
+    int result = -1;
+    int out = -1;
+
+    if (tmp_path == NULL || old_table == NULL ||
+        (old_len > 0 && persist_read_at(fd, old_table, old_len, STORE_HEADER_SIZE) != 0)) {
+        goto done;
+    }
+    snprintf(tmp_path, tmp_len, "%s.tmp", path);
+
+    for (;;) {
+        table = calloc(capacity, SLOT_SIZE);
+        if (table == NULL) {
+            goto done;
+        }
+        bool fits = true;
+
+        for (uint32_t i = 0; fits && old != NULL && i < old->capacity; i++) {
+            const unsigned char *src = old_table + (size_t)i * old->slot_size;
+            const char *name = (const char *)src + SLOT_NAME;
+            if (get32(src, old->swap) != SLOT_USED || strncmp(name, user, USER_NAME_MAX + 1) == 0) {
+                continue;
+            }
+            persistent_stats_t user_stats;
+            uint32_t seq;
+            slot_stats(old, src, &user_stats, &seq);
+
+            memset(slot, 0, sizeof(slot));
+            put32(slot, SLOT_USED);
+            memcpy(slot + SLOT_NAME, name, USER_NAME_MAX);
+            encode_copy(slot + SLOT_COPIES, seq > 0 ? seq : 1, &user_stats);
+            fits = table_insert(table, capacity, slot);
+        }
+
+        if (fits) {
+            // The saved user, skipped above, continues its sequence numbers
+            uint32_t seq = 1;
+            if (old != NULL) {
+                for (uint32_t i = 0; i < old->capacity; i++) {
+                    const unsigned char *src = old_table + (size_t)i * old->slot_size;
+                    persistent_stats_t ignored;
+                    if (get32(src, old->swap) == SLOT_USED &&
+                        strncmp((const char *)src + SLOT_NAME, user, USER_NAME_MAX + 1) == 0) {
+                        slot_stats(old, src, &ignored, &seq);
+                        seq++;
+                        break;
+                    }
+                }
+            }
+            memset(slot, 0, sizeof(slot));
+            put32(slot, SLOT_USED);
+            strncpy((char *)slot + SLOT_NAME, user, USER_NAME_MAX);
+            encode_copy(slot + SLOT_COPIES, seq, stats);
+            fits = table_insert(table, capacity, slot);
+        }
+
+        if (fits) {
+            break;
+        }
+        free(table);
+        table = NULL;
+        capacity *= 2;
+    }
+
+    store_header_t header;
+    unsigned char raw[STORE_HEADER_SIZE];
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, STORE_MAGIC, 4);
+    header.version = STORE_VERSION;
+    header.byte_order = PERSIST_BYTE_ORDER;
+    header.slot_size = SLOT_SIZE;
+    header.capacity = capacity;
+    header.stats_size = sizeof(persistent_stats_t);
+    header.crc = persist_crc32(&header, offsetof(store_header_t, crc));
+    memset(raw, 0, sizeof(raw));
+    memcpy(raw, &header, sizeof(header));
+
+    // Lock the new file before it becomes visible under the store's name.
+    // Only used slots are written; empty ones stay holes in a sparse file
+    out = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (out < 0 || lock_file(out, F_WRLCK) != 0 ||
+        ftruncate(out, STORE_HEADER_SIZE + (off_t)capacity * SLOT_SIZE) != 0 ||
+        persist_write_at(out, raw, sizeof(raw), 0) != 0) {
+        goto done;
+    }
+    for (uint32_t i = 0; i < capacity; i++) {
+        const unsigned char *src = table + (size_t)i * SLOT_SIZE;
+        if (get32(src, false) == SLOT_USED &&
+            persist_write_at(out, src, SLOT_SIZE, STORE_HEADER_SIZE + (off_t)i * SLOT_SIZE) != 0) {
+            goto done;
+        }
+    }
+    if (fsync(out) != 0 || rename(tmp_path, path) != 0) {
+        goto done;
+    }
+    result = 0;
+
+done:
+    if (out >= 0) {
+        if (result != 0) {
+            unlink(tmp_path);
+        }
+        close(out);
+    }
+    free(tmp_path);
+    free(old_table);
+    free(table);
+    return result;
+}
+
+/*
+ * Opens and locks the store. If the file was replaced by a concurrent
+ * rebuild while waiting for the lock, the stale descriptor is dropped and
+ * the new file is opened instead.
+ */
+static int open_locked(const char *path, int flags, short lock_type) {
+    for (;;) {
+        int fd = open(path, flags, 0644);
+        if (fd < 0) {
+            return -1;
+        }
+        if (lock_file(fd, lock_type) != 0) {
+            close(fd);
+            return -1;
+        }
+
+        struct stat held, current;
+        if (fstat(fd, &held) == 0 && stat(path, &current) == 0 &&
+            held.st_ino == current.st_ino && held.st_dev == current.st_dev) {
+            return fd;
+        }
+        close(fd);
+    }
+}
+
+/* ========== Public API ========== */
+
+bool userstore_valid_name(const char *name) {
+    size_t len = 0;
+    for (const char *p = name; *p; p++, len++) {
+        char c = *p;
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                  (c >= '0' && c <= '9') || c == '.' || c == '_' || c == '-';
+        if (!ok || len >= USER_NAME_MAX) {
+            return false;
+        }
+    }
+    return len > 0;
+}
+
+int userstore_load(const char *path, const char *user, persistent_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    int fd = open_locked(path, O_RDONLY, F_RDLCK);
+    if (fd < 0) {
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    store_format_t format;
+    unsigned char *slot = NULL;
+    uint32_t index, seq;
+    int result = -1;
+
+    if (read_format(fd, &format) == 0 && (slot = malloc(format.slot_size)) != NULL) {
+        int found = find_slot(fd, &format, user, slot, &index);
+        if (found == 1) {
+            slot_stats(&format, slot, stats, &seq);
+            result = 1;
+        } else if (found >= 0) {
+            result = 0;
+        }
+    }
+
+    free(slot);
+    close(fd);
+    return result;
+}
+
+int userstore_save(const char *path, const char *user, const persistent_stats_t *stats) {
+    int fd = open_locked(path, O_RDWR | O_CREAT, F_WRLCK);
+    if (fd < 0) {
+        return -1;
+    }
+
+    store_format_t format;
+    unsigned char *slot = NULL;
+    struct stat st;
+    uint32_t index, seq;
+    int result = -1;
+
+    if (fstat(fd, &st) != 0) {
+        goto done;
+    }
+    if (st.st_size == 0) {
+        // New store (or one whose creation was interrupted before the rename)
+        result = rebuild(path, fd, NULL, STORE_INITIAL_CAPACITY, user, stats);
+        goto done;
+    }
+    if (read_format(fd, &format) != 0) {
+        goto done;  // Not a store we understand; leave it untouched
+    }
+    if (!is_current(&format)) {
+        result = rebuild(path, fd, &format, format.capacity, user, stats);
+        goto done;
+    }
+
+    slot = malloc(format.slot_size);
+    if (slot == NULL) {
+        goto done;
+    }
+    int found = find_slot(fd, &format, user, slot, &index);
+    if (found == 1) {
+        // Existing user: overwrite the older copy, keeping the newer one intact
+        persistent_stats_t current;
+        int newest = slot_stats(&format, slot, &current, &seq);
+        int target = newest == 0 ? 1 : 0;
+        unsigned char copy[COPY_SIZE];
+        encode_copy(copy, seq + 1, stats);
+        if (persist_write_at(fd, copy, sizeof(copy),
+                             slot_offset(&format, index) + SLOT_COPIES + target * COPY_SIZE) == 0 &&
+            fdatasync(fd) == 0) {
+            result = 0;
+        }
+    } else if (found == 0) {
+        // New user: a torn write here can only leave an orphaned or empty
+        // record, and the user had no statistics to lose
+        memset(slot, 0, format.slot_size);
+        put32(slot, SLOT_USED);
+        strncpy((char *)slot + SLOT_NAME, user, USER_NAME_MAX);
+        encode_copy(slot + SLOT_COPIES, 1, stats);
+        if (persist_write_at(fd, slot, format.slot_size, slot_offset(&format, index)) == 0 &&
+            fdatasync(fd) == 0) {
+            result = 0;
+        }
+    } else if (found == 2) {
+        result = rebuild(path, fd, &format, format.capacity * 2, user, stats);
+    }
+
+done:
+    free(slot);
+    close(fd);
+    return result;
+}
+
+int userstore_foreach(const char *path, userstore_visit_fn visit, void *context) {
+    int fd = open_locked(path, O_RDONLY, F_RDLCK);
+    if (fd < 0) {
+        return -1;
+    }
+
+    store_format_t format;
+    unsigned char *slots = NULL;
+    int result = -1;
+    const uint32_t batch = 64;
+
+    // Whole runs of slots per read: a sparse store reads back as empty slots
+    if (read_format(fd, &format) == 0 && (slots = malloc((size_t)batch * format.slot_size)) != NULL) {
+        result = 0;
+        for (uint32_t first = 0; first < format.capacity && result == 0; first += batch) {
+            uint32_t count = format.capacity - first < batch ? format.capacity - first : batch;
+            if (persist_read_at(fd, slots, (size_t)count * format.slot_size, slot_offset(&format, first)) != 0) {
+                result = -1;
+                break;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                const unsigned char *slot = slots + (size_t)i * format.slot_size;
+                persistent_stats_t stats;
+                char name[USER_NAME_MAX + 1];
+                uint32_t seq;
+                if (get32(slot, format.swap) != SLOT_USED) {
+                    continue;
+                }
+                memcpy(name, slot + SLOT_NAME, USER_NAME_MAX);
+                name[USER_NAME_MAX] = '\0';
+                slot_stats(&format, slot, &stats, &seq);
+                visit(context, name, &stats);
+            }
+        }
+    }
+
+    free(slots);
+    close(fd);
+    return result;
+}
+
+typedef struct {
+    persistent_stats_t *total;
+    int *users;
+} sum_context_t;
+
+static void sum_user(void *context, const char *user, const persistent_stats_t *stats) {
+    sum_context_t *sum = context;
+    (void)user;
+    merge_persistent_stats(sum->total, stats);
+    (*sum->users)++;
+}
+
+int userstore_sum(const char *path, persistent_stats_t *total, int *users) {
+    sum_context_t sum = { total, users };
+    memset(total, 0, sizeof(*total));
+    *users = 0;
+    return userstore_foreach(path, sum_user, &sum);
+}
@@ -0,0 +1,73 @@
+/*
+ * userstore.h - Multi-User Statistics Store
+ *
+ * Keeps the persistent_stats_t of many users in one file, so a shared lab
+ * machine can hold everyone's lifetime results side by side. The file is
+ * an on-disk open-addressing hash table of fixed-size slots keyed by user
+ * name: loading a user reads the header and (usually) one slot, and saving
+ * rewrites only that user's slot in place.
+ *
+ * File layout:
+ *   [header, 64 bytes]  magic, version, byte order, slot size, capacity, CRC
+ *   [slot 0] [slot 1] ... [slot capacity-1]
+ *   slot = { state, name[USER_NAME_MAX + 1], two checksummed copies of
+ *            persistent_stats_t with sequence numbers, padding }
+ *
+ * Lookups probe at most 16 slots; the table doubles (rebuilt in a
+ * temporary file and renamed into place) when an insert would need more.
+ * Writers take an fcntl() lock on the file.
+ */
+
+#ifndef USERSTORE_H
+#define USERSTORE_H
+
+#include <stdbool.h>
+#include "questions.h"
+
+#define USER_STORE_FILE ".metric_trainer_users"
+#define USER_NAME_MAX 31
+
+/**
+ * Check that a user name is 1-31 characters of [A-Za-z0-9._-]
+ */
+bool userstore_valid_name(const char *name);
+
+/**
+ * Load one user's statistics
+ * @param path Store file path
+ * @param user User name
+ * @param stats Receives the statistics (zeros for a new user)
+ * @return 1 if the user was found, 0 if not, -1 on I/O error
+ */
+int userstore_load(const char *path, const char *user, persistent_stats_t *stats);
+
+/**
+ * Save one user's statistics, creating the store or the user as needed
+ * @param path Store file path
+ * @param user User name
+ * @param stats Statistics to store
+ * @return 0 on success, -1 on error
+ */
+int userstore_save(const char *path, const char *user, const persistent_stats_t *stats);
+
+typedef void (*userstore_visit_fn)(void *context, const char *user, const persistent_stats_t *stats);
+
+/**
+ * Visit every user in a store, in slot order
+ * @param path Store file path
+ * @param visit Called once per user
+ * @param context Passed to visit
+ * @return 0 on success, -1 if the store cannot be read
+ */
+int userstore_foreach(const char *path, userstore_visit_fn visit, void *context);
+
+/**
+ * Add up the statistics of every user in a store
+ * @param path Store file path
+ * @param total Receives the sum
+ * @param users Receives the number of users
+ * @return 0 on success, -1 if the store cannot be read
+ */
+int userstore_sum(const char *path, persistent_stats_t *total, int *users);
+
+#endif
@@ -0,0 +1,387 @@
+/*
+ * worksheet.c - Printable Worksheet Generator
+ *
+ * Generation runs in rounds: each round hands a batch of chunks to the
+ * worker threads, every chunk formats its questions and answers into its
+ * own memory buffers, and the main thread then writes the buffers out in
+ * chunk order. Formatting goes through outbuf/fmt_* rather than stdio,
+ * so writing millions of questions is limited by the output device.
+ */
+
+#include "worksheet.h"
+#include "questions.h"
+#include "outbuf.h"
+#include "parallel.h"
+#include "rng.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define WORKSHEET_CHUNK 16384           // Questions per chunk (and RNG stream)
+#define WORKSHEET_OUTBUF_SIZE (1 << 16) // Buffer size for the output files
+
+typedef enum {
+    FORMAT_TEXT = 0,
+    FORMAT_CSV,
+    FORMAT_JSON
+} worksheet_format_t;
+
+typedef struct {
+    long count;                         // Number of questions to generate
+    uint64_t seed;
+    category_selection_t selection;
+    worksheet_format_t format;
+    const char *output_path;            // NULL for stdout
+    const char *key_path;
+    int threads;
+    bool worker_stats;                  // Print each worker's utilization
+} worksheet_options_t;
+
+typedef struct {
+    rng_t rng;                          // Random stream of the chunk in this slot
+    outbuf_t questions;
+    outbuf_t answers;
+} worksheet_slot_t;
+
+typedef struct {
+    const worksheet_options_t *opts;
+    worksheet_slot_t *slots;
+    long first_chunk;                   // Chunk number of slot 0 this round
+    rng_t next_stream;                  // Stream of the first chunk next round
+} worksheet_round_t;
+
+static const char *format_extensions[] = { "txt", "csv", "json" };
+
+/* ========== Record Formatting ========== */
+
+static void write_answer_value(outbuf_t *ob, const question_t *q) {
+    if (q->exact) {
+        outbuf_centi(ob, q->answer_centi);
+    } else {
+        outbuf_fixed(ob, q->correct_answer, 2);
+    }
+}
+
+static void write_tolerance_value(outbuf_t *ob, const question_t *q) {
+    if (q->exact) {
+        outbuf_centi(ob, q->tolerance_centi);
+    } else {
+        outbuf_fixed(ob, q->tolerance, 2);
+    }
+}
+
+static void write_records(const worksheet_options_t *opts, long number,
+                          const question_t *q, outbuf_t *qs, outbuf_t *as) {
+    switch (opts->format) {
+        case FORMAT_TEXT:
+            outbuf_long(qs, number);
+            outbuf_puts(qs, ". ");
+            outbuf_puts(qs, q->question_text);
+            outbuf_putc(qs, '\n');
+
+            outbuf_long(as, number);
+            outbuf_puts(as, ". ");
+            write_answer_value(as, q);
+            outbuf_putc(as, ' ');
+            outbuf_puts(as, q->to_unit);
+            outbuf_puts(as, " (±");
+            write_tolerance_value(as, q);
+            outbuf_puts(as, ")\n");
+            break;
+
+        case FORMAT_CSV:
+            outbuf_long(qs, number);
+            outbuf_putc(qs, ',');
+            outbuf_fixed(qs, q->value, 1);
+            outbuf_putc(qs, ',');
+            outbuf_puts(qs, q->from_unit);
+            outbuf_putc(qs, ',');
+            outbuf_puts(qs, q->to_unit);
+            outbuf_putc(qs, '\n');
+
+            outbuf_long(as, number);
+            outbuf_putc(as, ',');
+            write_answer_value(as, q);
+            outbuf_putc(as, ',');
+            write_tolerance_value(as, q);
+            outbuf_putc(as, ',');
+            outbuf_puts(as, q->to_unit);
+            outbuf_putc(as, '\n');
+            break;
+
+        case FORMAT_JSON:
+            // Unit names come from the catalog and never need escaping
+            if (number > 1) {
+                outbuf_puts(qs, ",\n");
+                outbuf_puts(as, ",\n");
+            }
+            outbuf_puts(qs, "{\"n\":");
+            outbuf_long(qs, number);
+            outbuf_puts(qs, ",\"value\":");
+            outbuf_fixed(qs, q->value, 1);
+            outbuf_puts(qs, ",\"from\":\"");
+            outbuf_puts(qs, q->from_unit);
+            outbuf_puts(qs, "\",\"to\":\"");
+            outbuf_puts(qs, q->to_unit);
+            outbuf_puts(qs, "\"}");
+
+            outbuf_puts(as, "{\"n\":");
+            outbuf_long(as, number);
+            outbuf_puts(as, ",\"answer\":");
+            write_answer_value(as, q);
+            outbuf_puts(as, ",\"tolerance\":");
+            write_tolerance_value(as, q);
+            outbuf_puts(as, ",\"unit\":\"");
+            outbuf_puts(as, q->to_unit);
+            outbuf_puts(as, "\"}");
+            break;
+    }
+}
+
+/* ========== Chunk Generation ========== */
+
+static void generate_chunk(void *context, int task, int worker) {
+    (void)worker;
+    worksheet_round_t *round = context;
+    const worksheet_options_t *opts = round->opts;
+    worksheet_slot_t *slot = &round->slots[task];
+    long chunk = round->first_chunk + task;
+    long first = chunk * WORKSHEET_CHUNK;
+    long last = first + WORKSHEET_CHUNK;
+    if (last > opts->count) last = opts->count;
+
+    rng_t *rng = &slot->rng;
+
+    slot->questions.len = 0;
+    slot->answers.len = 0;
+    for (long i = first; i < last; i++) {
+        question_t q = generate_question_r(&opts->selection, rng);
+        write_records(opts, i + 1, &q, &slot->questions, &slot->answers);
+    }
+}
+
+/* ========== Command Line ========== */
+
+static void show_worksheet_help(void) {
+    printf("USAGE:\n");
+    printf("  metric-trainer worksheet -n COUNT [OPTIONS]\n\n");
+    printf("OPTIONS:\n");
+    printf("  -n, --count N          Number of questions (required)\n");
+    printf("  -c, --categories SET   Categories to draw from, e.g. \"ab\" (default: all)\n");
+    printf("  -s, --seed S           Random seed; the same seed gives the same worksheet\n");
+    printf("  -f, --format FMT       text, csv or json (default: text)\n");
+    printf("  -o, --output FILE      Question file (default: standard output)\n");
+    printf("  -k, --key FILE         Answer key file (default: answer_key.<ext>)\n");
+    printf("  -t, --threads N        Generator threads (default: all CPUs)\n");
+    printf("  --cpus LIST            Pin generator threads to these CPUs, e.g. 0-3,8\n");
+    printf("  --worker-stats         Report each thread's utilization on stderr\n");
+    printf("  -w, --whole            Whole numbers only\n");
+    printf("  -e, --easy             Simple numbers only (1, 5, 10, 15...)\n");
+}
+
+static int parse_worksheet_options(int argc, char *argv[], worksheet_options_t *opts) {
+    const char *categories = "all";
+    bool seeded = false;
+
+    memset(opts, 0, sizeof(*opts));
+    opts->count = -1;
+    opts->threads = parallel_default_threads();
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            show_worksheet_help();
+            return 0;
+        } else if (strcmp(arg, "-w") == 0 || strcmp(arg, "--whole") == 0) {
+            g_whole_numbers_mode = true;
+            continue;
+        } else if (strcmp(arg, "-e") == 0 || strcmp(arg, "--easy") == 0) {
+            g_easy_mode = true;
+            g_whole_numbers_mode = true;
+            continue;
+        } else if (strcmp(arg, "--worker-stats") == 0) {
+            opts->worker_stats = true;
+            continue;
+        }
+
+        if (value == NULL) {
+            fprintf(stderr, "worksheet: unknown option or missing value: %s\n", arg);
+            return -1;
+        }
+        i++;
+
+        if (strcmp(arg, "-n") == 0 || strcmp(arg, "--count") == 0) {
+            if (!parse_whole_number(value, 1, LONG_MAX, &opts->count)) {
+                fprintf(stderr, "worksheet: invalid count '%s' (use a positive number)\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "-c") == 0 || strcmp(arg, "--categories") == 0) {
+            categories = value;
+        } else if (strcmp(arg, "-s") == 0 || strcmp(arg, "--seed") == 0) {
+            if (!parse_seed(value, &opts->seed)) {
+                fprintf(stderr, "worksheet: invalid seed '%s' (use a whole number)\n", value);
+                return -1;
+            }
+            seeded = true;
+        } else if (strcmp(arg, "-f") == 0 || strcmp(arg, "--format") == 0) {
+            if (strcmp(value, "text") == 0) {
+                opts->format = FORMAT_TEXT;
+            } else if (strcmp(value, "csv") == 0) {
+                opts->format = FORMAT_CSV;
+            } else if (strcmp(value, "json") == 0) {
+                opts->format = FORMAT_JSON;
+            } else {
+                fprintf(stderr, "worksheet: unknown format '%s' (use text, csv or json)\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "-o") == 0 || strcmp(arg, "--output") == 0) {
+            opts->output_path = value;
+        } else if (strcmp(arg, "-k") == 0 || strcmp(arg, "--key") == 0) {
+            opts->key_path = value;
+        } else if (strcmp(arg, "-t") == 0 || strcmp(arg, "--threads") == 0) {
+            long threads;
+            if (!parse_whole_number(value, 1, PARALLEL_MAX_WORKERS, &threads)) {
+                fprintf(stderr, "worksheet: invalid thread count '%s' (use 1 to %d)\n",
+                        value, PARALLEL_MAX_WORKERS);
+                return -1;
+            }
+            opts->threads = (int)threads;
+        } else if (strcmp(arg, "--cpus") == 0) {
+            if (parallel_set_cpus(value) != 0) {
+                fprintf(stderr, "worksheet: invalid CPU list '%s'\n", value);
+                return -1;
+            }
+        } else {
+            fprintf(stderr, "worksheet: unknown option: %s\n", arg);
+            return -1;
+        }
+    }
+
+    if (opts->count <= 0) {
+        fprintf(stderr, "worksheet: -n COUNT is required and must be positive\n");
+        return -1;
+    }
+    if (!parse_category_input(categories, &opts->selection)) {
+        fprintf(stderr, "worksheet: invalid categories '%s'\n", categories);
+        return -1;
+    }
+    if (!seeded) {
+        opts->seed = (uint64_t)time(NULL);
+    }
+    return 1;
+}
+
+static int open_output(const char *path) {
+    if (path == NULL) {
+        return STDOUT_FILENO;
+    }
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "worksheet: cannot open %s: %s\n", path, strerror(errno));
+    }
+    return fd;
+}
+
+int worksheet_main(int argc, char *argv[]) {
+    worksheet_options_t opts;
+    int parsed = parse_worksheet_options(argc, argv, &opts);
+    if (parsed <= 0) {
+        return parsed == 0 ? 0 : 1;
+    }
+
+    char default_key[32];
+    if (opts.key_path == NULL) {
+        snprintf(default_key, sizeof(default_key), "answer_key.%s", format_extensions[opts.format]);
+        opts.key_path = default_key;
+    }
+
+    int question_fd = open_output(opts.output_path);
+    int key_fd = open_output(opts.key_path);
+    if (question_fd < 0 || key_fd < 0) {
+        return 1;
+    }
+
+    outbuf_t questions;
+    outbuf_t answers;
+    int slot_count = opts.threads * 2;
+    worksheet_slot_t *slots = calloc((size_t)slot_count, sizeof(worksheet_slot_t));
+    bool ok = slots != NULL &&
+              outbuf_init(&questions, question_fd, WORKSHEET_OUTBUF_SIZE) == 0 &&
+              outbuf_init(&answers, key_fd, WORKSHEET_OUTBUF_SIZE) == 0;
+    for (int i = 0; ok && i < slot_count; i++) {
+        ok = outbuf_init(&slots[i].questions, -1, WORKSHEET_CHUNK * 64) == 0 &&
+             outbuf_init(&slots[i].answers, -1, WORKSHEET_CHUNK * 64) == 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "worksheet: out of memory\n");
+        return 1;
+    }
+
+    if (opts.format == FORMAT_CSV) {
+        outbuf_puts(&questions, "n,value,from_unit,to_unit\n");
+        outbuf_puts(&answers, "n,answer,tolerance,unit\n");
+    } else if (opts.format == FORMAT_JSON) {
+        outbuf_puts(&questions, "[\n");
+        outbuf_puts(&answers, "[\n");
+    }
+
+    long chunk_count = (opts.count + WORKSHEET_CHUNK - 1) / WORKSHEET_CHUNK;
+    worksheet_round_t round = { &opts, slots, 0, {{0}} };
+    rng_seed(&round.next_stream, opts.seed);
+
+    while (round.first_chunk < chunk_count) {
+        long remaining = chunk_count - round.first_chunk;
+        int tasks = remaining < slot_count ? (int)remaining : slot_count;
+
+        // Chunk k always gets stream k of the seed, whichever worker runs it
+        for (int i = 0; i < tasks; i++) {
+            slots[i].rng = round.next_stream;
+            rng_jump(&round.next_stream);
+        }
+
+        parallel_for(tasks, opts.threads, generate_chunk, &round);
+
+        for (int i = 0; i < tasks; i++) {
+            outbuf_write(&questions, slots[i].questions.data, slots[i].questions.len);
+            outbuf_write(&answers, slots[i].answers.data, slots[i].answers.len);
+        }
+        round.first_chunk += tasks;
+    }
+
+    if (opts.format == FORMAT_JSON) {
+        outbuf_puts(&questions, "\n]\n");
+        outbuf_puts(&answers, "\n]\n");
+    }
+
+    int status = 0;
+    if (outbuf_flush(&questions) != 0 || outbuf_flush(&answers) != 0) {
+        fprintf(stderr, "worksheet: write failed: %s\n",
+                strerror(questions.error ? questions.error : answers.error));
+        status = 1;
+    } else {
+        fprintf(stderr, "Wrote %ld questions to %s and the answer key to %s (seed %llu)\n",
+                opts.count, opts.output_path ? opts.output_path : "standard output",
+                opts.key_path, (unsigned long long)opts.seed);
+    }
+    if (opts.worker_stats) {
+        parallel_print_stats(stderr);
+    }
+
+    for (int i = 0; i < slot_count; i++) {
+        outbuf_free(&slots[i].questions);
+        outbuf_free(&slots[i].answers);
+    }
+    free(slots);
+    outbuf_free(&questions);
+    outbuf_free(&answers);
+    if (opts.output_path != NULL) close(question_fd);
+    close(key_fd);
+    return status;
+}
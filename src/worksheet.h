@@ -0,0 +1,21 @@
+/*
+ * worksheet.h - Printable Worksheet Generator
+ *
+ * Streams a numbered list of questions and a separate answer key in
+ * text, CSV or JSON. Questions are produced in fixed-size chunks, chunk k
+ * drawing from random stream k of the seed (see rng.h), so the output for
+ * a given seed is identical no matter how many threads generate it.
+ */
+
+#ifndef WORKSHEET_H
+#define WORKSHEET_H
+
+/**
+ * Entry point for `metric-trainer worksheet ...`
+ * @param argc Argument count, argv[0] being "worksheet"
+ * @param argv Argument vector
+ * @return Process exit status
+ */
+int worksheet_main(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ * bench_format.c - Benchmark for the fmt_fixed Formatter
+ *
+ * First checks that fmt_fixed shows exactly what snprintf("%.1f") and
+ * snprintf("%.2f") show, for every float whose bit pattern falls on a
+ * stride through [0, 1e7] (both signs) and for every multiple of 1/1000
+ * up to 10000, which covers the ties that must round to even. Then times
+ * both on a mix of question values, answers and percent errors like
+ * the ones worksheets, exports and reports print, and reports the cost
+ * per number.
+ *
+ * Usage: bench_format [-n NUMBERS] [-s STRIDE]
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "format.h"
+
+#define DEFAULT_NUMBERS 2000000
+#define DEFAULT_STRIDE 401
+#define ROUNDS 5
+
+typedef struct {
+    long numbers;                 // Values formatted per timed round
+    unsigned long stride;         // Bit patterns skipped between checked floats
+} bench_options_t;
+
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static int parse_options(int argc, char *argv[], bench_options_t *opts) {
+    opts->numbers = DEFAULT_NUMBERS;
+    opts->stride = DEFAULT_STRIDE;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "-n") == 0 && value != NULL) {
+            opts->numbers = atol(value);
+            i++;
+        } else if (strcmp(argv[i], "-s") == 0 && value != NULL) {
+            opts->stride = strtoul(value, NULL, 10);
+            i++;
+        } else {
+            return -1;
+        }
+    }
+    return opts->numbers > 0 && opts->stride > 0 ? 0 : -1;
+}
+
+/* ========== Round-Trip Check ========== */
+
+/* Compare one value at both precisions; returns the number of mismatches */
+static int check_value(float value) {
+    int mismatches = 0;
+    for (int decimals = 1; decimals <= 2; decimals++) {
+        char expected[64], actual[FMT_MAX_CHARS + 1];
+        snprintf(expected, sizeof(expected), "%.*f", decimals, value);
+        *fmt_fixed(actual, value, decimals) = '\0';
+        if (strcmp(expected, actual) != 0) {
+            if (mismatches == 0) {
+                fprintf(stderr, "mismatch for %.9g: printf \"%s\", fmt_fixed \"%s\"\n",
+                        value, expected, actual);
+            }
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+static unsigned long check_round_trip(unsigned long stride, unsigned long *checked) {
+    unsigned long mismatches = 0;
+    union { float f; uint32_t bits; } limit = { .f = 1e7f };
+
+    *checked = 0;
+    for (uint32_t bits = 0; bits <= limit.bits; bits += (uint32_t)stride) {
+        union { uint32_t bits; float f; } v = { .bits = bits };
+        mismatches += (unsigned long)check_value(v.f);
+        mismatches += (unsigned long)check_value(-v.f);
+        *checked += 2;
+    }
+    for (long k = 0; k <= 10000000; k++) {
+        mismatches += (unsigned long)check_value((float)k / 1000.0f);
+        (*checked)++;
+    }
+    return mismatches;
+}
+
+/* ========== Timing ========== */
+
+/* Values shaped like the program's output: question values, answers, errors */
+static float *make_values(long count) {
+    float *values = malloc((size_t)count * sizeof(float));
+    if (values == NULL) {
+        return NULL;
+    }
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for (long i = 0; i < count; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        double u = (double)(state >> 11) / 9007199254740992.0;
+        switch (i % 3) {
+        case 0:  values[i] = roundf((float)(u * 5000.0)) / 10.0f; break;       // 0.0 - 500.0
+        case 1:  values[i] = roundf((float)(u * 200000.0)) / 100.0f; break;    // 0.00 - 2000.00
+        default: values[i] = (float)(u * 150.0); break;                        // percent error
+        }
+    }
+    return values;
+}
+
+/* Best of ROUNDS, in nanoseconds per number */
+static double time_formatter(const float *values, long count, bool use_snprintf, unsigned long *checksum) {
+    char buf[64];
+    double best = 0.0;
+
+    for (int round = 0; round < ROUNDS; round++) {
+        double start = now_seconds();
+        for (long i = 0; i < count; i++) {
+            int decimals = 1 + (int)(i & 1);
+            size_t len;
+            if (use_snprintf) {
+                len = (size_t)snprintf(buf, sizeof(buf), "%.*f", decimals, values[i]);
+            } else {
+                len = (size_t)(fmt_fixed(buf, values[i], decimals) - buf);
+            }
+            *checksum += len + (unsigned char)buf[len - 1];
+        }
+        double ns = (now_seconds() - start) * 1e9 / (double)count;
+        if (round == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    bench_options_t opts;
+    if (parse_options(argc, argv, &opts) != 0) {
+        fprintf(stderr, "Usage: bench_format [-n NUMBERS] [-s STRIDE]\n");
+        return 1;
+    }
+
+    unsigned long checked;
+    unsigned long mismatches = check_round_trip(opts.stride, &checked);
+    printf("Round trip: %lu values at 1 and 2 decimals, %lu mismatches\n\n", checked, mismatches);
+
+    float *values = make_values(opts.numbers);
+    if (values == NULL) {
+        fprintf(stderr, "bench_format: out of memory\n");
+        return 1;
+    }
+    unsigned long fixed_sum = 0, snprintf_sum = 0;
+    double fixed_ns = time_formatter(values, opts.numbers, false, &fixed_sum);
+    double snprintf_ns = time_formatter(values, opts.numbers, true, &snprintf_sum);
+    free(values);
+
+    printf("  %-10s  %10s  %14s\n", "Formatter", "ns/number", "Numbers/s");
+    printf("  %-10s  %10.1f  %14.0f\n", "fmt_fixed", fixed_ns, 1e9 / fixed_ns);
+    printf("  %-10s  %10.1f  %14.0f\n", "snprintf", snprintf_ns, 1e9 / snprintf_ns);
+    printf("\n  fmt_fixed is %.1fx faster (%ld numbers, best of %d rounds)\n",
+           snprintf_ns / fixed_ns, opts.numbers, ROUNDS);
+
+    if (fixed_sum != snprintf_sum) {
+        fprintf(stderr, "bench_format: the formatters disagreed on the timed values\n");
+        return 1;
+    }
+    return mismatches == 0 ? 0 : 1;
+}
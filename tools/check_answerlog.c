@@ -0,0 +1,346 @@
+/*
+ * check_answerlog.c - Checks for the Answer Log's Index Repair and Conversion
+ *
+ * Writes a log of a thousand answers, then damages its index in each way
+ * a crash or a bad disk can: a corrupted summary, a truncated or missing
+ * index, an index behind the log, and a torn record at the end of the
+ * log. After each, queries and summaries must still see every answer,
+ * and reopening the log must rebuild the index byte for byte. Version 1
+ * logs, in both byte orders, must read as they are and convert on open.
+ * Prints one line per failure and a summary.
+ *
+ * Usage: check_answerlog
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "answerlog.h"
+#include "persist.h"
+
+#define ANSWERS 1000
+#define BEHIND 300                // Answers the stale index has not seen
+#define FIRST_TIME 1700000000u
+#define V1_RECORD_SIZE 16
+
+static int failures;
+static char log_path[64];
+static char index_path[80];
+
+static void fail(const char *name, const char *what) {
+    printf("check_answerlog: %s: %s\n", name, what);
+    failures++;
+}
+
+/* ========== Answers ========== */
+
+static stats_delta_t make_delta(int i) {
+    stats_delta_t delta;
+    memset(&delta, 0, sizeof(delta));
+    delta.conversion_id = i % CONVERSION_COUNT;
+    delta.correct = i % 3 != 0;
+    delta.percent_error = (float)(i % 50) * 1.5f;
+    delta.response_seconds = (float)(i % 4) * 0.5f;
+    delta.answered_at = (time_t)(FIRST_TIME + (unsigned)i * 60);
+    delta.value = (float)i * 0.5f;
+    delta.answer = (float)i;
+    return delta;
+}
+
+/* The record answer i reads back as; version 1 logs have no value or answer */
+static answer_record_t expected_record(int i, bool answered) {
+    stats_delta_t delta = make_delta(i);
+    answer_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.time = (uint32_t)delta.answered_at;
+    record.conversion_id = (uint8_t)delta.conversion_id;
+    record.flags = (delta.correct ? ANSWERLOG_CORRECT : 0) | (delta.response_seconds > 0.0f ? ANSWERLOG_TIMED : 0);
+    record.percent_error = delta.percent_error;
+    record.response_seconds = delta.response_seconds;
+    if (answered) {
+        record.flags |= ANSWERLOG_ANSWERED;
+        record.value = delta.value;
+        record.answer = delta.answer;
+    }
+    return record;
+}
+
+static void append_answers(int first, int count) {
+    answerlog_t log;
+    if (answerlog_open(log_path, &log) != 0) {
+        fail("append", "cannot open the log");
+        return;
+    }
+    for (int i = first; i < first + count; i++) {
+        stats_delta_t delta = make_delta(i);
+        answerlog_append(&log, &delta);
+        if (i % 97 == 0) {
+            answerlog_flush(&log);
+        }
+    }
+    answerlog_close(&log);
+}
+
+static void remove_log(void) {
+    unlink(log_path);
+    unlink(index_path);
+}
+
+/* ========== Reading Back ========== */
+
+typedef struct {
+    answer_record_t records[ANSWERS + 1];
+    int count;
+} collected_t;
+
+static void collect(void *context, const answer_record_t *record) {
+    collected_t *collected = context;
+    if (collected->count <= ANSWERS) {
+        collected->records[collected->count] = *record;
+    }
+    collected->count++;
+}
+
+static bool same_record(const answer_record_t *a, const answer_record_t *b) {
+    return a->time == b->time && a->conversion_id == b->conversion_id && a->flags == b->flags &&
+           a->percent_error == b->percent_error && a->response_seconds == b->response_seconds &&
+           a->value == b->value && a->answer == b->answer;
+}
+
+/* Answers 0 to count-1, whole and through a filter that skips blocks */
+static void check_contents(const char *name, int count, int answered_from) {
+    static collected_t all, some;
+    answerlog_filter_t filter;
+
+    memset(&filter, 0, sizeof(filter));
+    all.count = 0;
+    if (answerlog_query(log_path, &filter, collect, &all, NULL) != 0 || all.count != count) {
+        fail(name, "a query did not return every answer");
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        answer_record_t expected = expected_record(i, i >= answered_from);
+        if (!same_record(&all.records[i], &expected)) {
+            fail(name, "an answer read back wrong");
+            return;
+        }
+    }
+
+    // Incorrect answers in the second half: a stale summary would hide some
+    filter.since = FIRST_TIME + (unsigned)(count / 2) * 60;
+    filter.incorrect_only = true;
+    some.count = 0;
+    int expected_some = 0;
+    for (int i = count / 2; i < count; i++) {
+        expected_some += i % 3 == 0;
+    }
+    if (answerlog_query(log_path, &filter, collect, &some, NULL) != 0 || some.count != expected_some) {
+        fail(name, "a filtered query missed answers");
+    }
+
+    answerlog_block_t summary;
+    int correct = 0;
+    for (int i = 0; i < count; i++) {
+        correct += i % 3 != 0;
+    }
+    if (answerlog_summary(log_path, &summary) != 0 || summary.count != (uint32_t)count ||
+        summary.correct != (uint32_t)correct || summary.min_time != FIRST_TIME ||
+        summary.max_time != FIRST_TIME + (unsigned)(count - 1) * 60) {
+        fail(name, "the summary is wrong");
+    }
+}
+
+static char *read_file(const char *path, size_t *len) {
+    FILE *file = fopen(path, "rb");
+    struct stat st;
+    char *data = NULL;
+
+    if (file != NULL && fstat(fileno(file), &st) == 0 && (data = malloc((size_t)st.st_size + 1)) != NULL) {
+        *len = fread(data, 1, (size_t)st.st_size, file);
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
+    return data;
+}
+
+static void write_file(const char *path, const char *data, size_t len) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL || fwrite(data, 1, len, file) != len) {
+        fail(path, "cannot write");
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
+}
+
+/* ========== Index Repair ========== */
+
+typedef enum { CORRUPT, TRUNCATE, MISSING, BEHIND_LOG, TORN_RECORD } damage_t;
+
+static const char *const damage_names[] = {
+    "corrupted summary", "truncated index", "missing index", "index behind the log", "torn record"
+};
+
+static void check_repair(damage_t damage, const char *good_index, size_t good_len) {
+    const char *name = damage_names[damage];
+    size_t len;
+    char *index;
+
+    remove_log();
+    if (damage == BEHIND_LOG) {
+        append_answers(0, ANSWERS - BEHIND);
+        index = read_file(index_path, &len);
+        append_answers(ANSWERS - BEHIND, BEHIND);
+        if (index != NULL) {
+            write_file(index_path, index, len);
+            free(index);
+        }
+    } else {
+        append_answers(0, ANSWERS);
+    }
+
+    switch (damage) {
+    case CORRUPT:
+        index = read_file(index_path, &len);
+        if (index != NULL) {
+            // The third summary's max_time, made too early: only its CRC tells
+            answerlog_block_t block;
+            char *stored = index + 16 + 2 * sizeof(block);
+            memcpy(&block, stored, sizeof(block));
+            block.max_time = FIRST_TIME;
+            memcpy(stored, &block, sizeof(block));
+            write_file(index_path, index, len);
+            free(index);
+        }
+        break;
+    case TRUNCATE:
+        if (truncate(index_path, 16 + sizeof(answerlog_block_t) + 5) != 0) {
+            fail(name, "cannot truncate the index");
+        }
+        break;
+    case MISSING:
+        unlink(index_path);
+        break;
+    case TORN_RECORD: {
+        FILE *file = fopen(log_path, "ab");
+        if (file != NULL) {
+            fwrite("torn record", 1, 11, file);
+            fclose(file);
+        }
+        break;
+    }
+    case BEHIND_LOG:
+        break;
+    }
+
+    // Readers work around the damage without writing anything
+    check_contents(name, ANSWERS, 0);
+
+    // A writer repairs it
+    answerlog_t log;
+    if (answerlog_open(log_path, &log) != 0) {
+        fail(name, "cannot open the damaged log");
+        return;
+    }
+    answerlog_close(&log);
+    index = read_file(index_path, &len);
+    if (index == NULL || len != good_len || memcmp(index, good_index, len) != 0) {
+        fail(name, "the rebuilt index differs");
+    }
+    free(index);
+
+    struct stat st;
+    if (stat(log_path, &st) != 0 || (size_t)st.st_size != 16 + ANSWERS * sizeof(answer_record_t)) {
+        fail(name, "the log was not cut back to whole records");
+    }
+    check_contents(name, ANSWERS, 0);
+}
+
+/* ========== Version 1 Logs ========== */
+
+static uint32_t swap32(uint32_t v) {
+    return (v >> 24) | ((v >> 8) & 0xff00u) | ((v << 8) & 0xff0000u) | (v << 24);
+}
+
+/* A version 1 log as older releases wrote it, optionally in the other byte order */
+static void write_v1_log(int count, bool swap) {
+    size_t len = 16 + (size_t)count * V1_RECORD_SIZE;
+    char *data = calloc(1, len);
+    if (data == NULL) {
+        fail("version 1", "out of memory");
+        return;
+    }
+    uint16_t version = swap ? 0x0100 : 1;
+    uint16_t byte_order = swap ? PERSIST_BYTE_ORDER_SWAPPED : PERSIST_BYTE_ORDER;
+    uint32_t record_size = swap ? swap32(V1_RECORD_SIZE) : V1_RECORD_SIZE;
+    memcpy(data, "MTHL", 4);
+    memcpy(data + 4, &version, 2);
+    memcpy(data + 6, &byte_order, 2);
+    memcpy(data + 8, &record_size, 4);
+
+    for (int i = 0; i < count; i++) {
+        answer_record_t record = expected_record(i, false);
+        uint32_t words[4];
+        memcpy(words, &record, sizeof(words));
+        if (swap) {
+            // Word 1 is single bytes, which no byte order moves
+            words[0] = swap32(words[0]);
+            words[2] = swap32(words[2]);
+            words[3] = swap32(words[3]);
+        }
+        memcpy(data + 16 + (size_t)i * V1_RECORD_SIZE, words, V1_RECORD_SIZE);
+    }
+    remove_log();
+    write_file(log_path, data, len);
+    free(data);
+}
+
+static void check_v1(bool swap) {
+    const char *name = swap ? "version 1, other byte order" : "version 1";
+
+    write_v1_log(ANSWERS, swap);
+    check_contents(name, ANSWERS, ANSWERS);
+
+    // The next session converts it and appends in the current format
+    append_answers(ANSWERS, 1);
+    struct stat st;
+    if (stat(log_path, &st) != 0 || (size_t)st.st_size != 16 + (ANSWERS + 1) * sizeof(answer_record_t)) {
+        fail(name, "the log was not converted");
+    }
+    check_contents(name, ANSWERS + 1, ANSWERS);
+}
+
+int main(void) {
+    char dir[] = "/tmp/check_answerlog.XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        perror("check_answerlog: mkdtemp");
+        return 1;
+    }
+    snprintf(log_path, sizeof(log_path), "%s/%s", dir, ANSWERLOG_FILE);
+    snprintf(index_path, sizeof(index_path), "%s%s", log_path, ANSWERLOG_INDEX_SUFFIX);
+
+    append_answers(0, ANSWERS);
+    check_contents("fresh log", ANSWERS, 0);
+    size_t good_len = 0;
+    char *good_index = read_file(index_path, &good_len);
+    if (good_index == NULL) {
+        fail("fresh log", "no index");
+    } else {
+        for (int damage = CORRUPT; damage <= TORN_RECORD; damage++) {
+            check_repair((damage_t)damage, good_index, good_len);
+        }
+        free(good_index);
+    }
+    check_v1(false);
+    check_v1(true);
+
+    remove_log();
+    rmdir(dir);
+    printf("check_answerlog: %d answers through %d kinds of index damage and 2 version 1 logs; %d failures\n",
+           ANSWERS, TORN_RECORD + 1, failures);
+    return failures == 0 ? 0 : 1;
+}
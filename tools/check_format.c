@@ -0,0 +1,171 @@
+/*
+ * check_format.c - Checks for the Number Formatters' Edge Cases
+ *
+ * Compares fmt_fixed with snprintf("%.*f") at 0 to 3 decimals where the
+ * two are most likely to part: negative zero and negatives that round to
+ * zero, exact ties that must round to even, doubles that only look like
+ * ties (0.15, 2.675), magnitudes either side of the 1e15 cut-over,
+ * infinities and NaN, and out-of-range decimals. Then a few hundred
+ * thousand random doubles, which unlike floats do not scale exactly.
+ * Also checks fmt_long and fmt_centi at the ends of their range, and
+ * that no formatter writes past FMT_MAX_CHARS (longer values are cut
+ * short, as format.h says). tools/bench_format covers
+ * the float inputs in bulk. Prints one line per failure and a summary.
+ *
+ * Usage: check_format
+ */
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "format.h"
+#include "rng.h"
+
+#define RANDOM_VALUES 200000
+#define BUFFER 64
+#define SENTINEL 0x5a
+
+static const double edge_values[] = {
+    0.0, -0.0, -0.0004, -0.4, -0.5, -1e-300, 4.9e-324, -4.9e-324,
+    0.5, 1.5, 2.5, 3.5, -2.5, 0.25, 0.75, 0.125, 0.375, 0.0625, 1.0625, 1024.5,
+    0.05, 0.15, 0.25, 0.35, 0.45, 1.005, 1.15, 2.675, 1.0005, 8.345, -0.15, 0.0005, 0.0015,
+    0.49999999999999994, 0.5000000000000001, 999.9995, 9.9995, 99.95, 9.95,
+    999999999999999.9, 999999999999999.5, 999999999999999.0, 1e15, -1e15, 1.5e15,
+    99999999999999.99, 9999999999999.999, 999999999999.9995, 1e12, 1e13, 1e14, 123456789012.3456, 4503599627370495.5, 9007199254740993.0, 1e20, -1e300, DBL_MAX,
+};
+
+static int failures;
+
+static void fail(const char *name, double value, int decimals, const char *got, const char *expected) {
+    if (failures < 20) {
+        printf("check_format: %s: %.17g at %d decimals gave '%s', expected '%s'\n",
+               name, value, decimals, got, expected);
+    }
+    failures++;
+}
+
+/* Runs a formatter into a marked buffer; NULL if it wrote past FMT_MAX_CHARS */
+static const char *finish(char *buffer, char *end) {
+    for (size_t i = FMT_MAX_CHARS; i < BUFFER; i++) {
+        if ((unsigned char)buffer[i] != SENTINEL) {
+            return NULL;
+        }
+    }
+    if (end < buffer || end >= buffer + FMT_MAX_CHARS) {
+        return NULL;
+    }
+    *end = '\0';
+    return buffer;
+}
+
+static void check_fixed(const char *name, double value, int decimals) {
+    char buffer[BUFFER];
+    char expected[BUFFER];
+
+    memset(buffer, SENTINEL, sizeof(buffer));
+    const char *got = finish(buffer, fmt_fixed(buffer, value, decimals));
+    int shown = decimals < 0 ? 0 : decimals > 3 ? 3 : decimals;
+    snprintf(expected, FMT_MAX_CHARS, "%.*f", shown, value);
+    if (got == NULL) {
+        fail(name, value, decimals, "(written past FMT_MAX_CHARS)", expected);
+    } else if (strcmp(got, expected) != 0) {
+        fail(name, value, decimals, got, expected);
+    }
+}
+
+/* ========== fmt_fixed ========== */
+
+static void check_edges(void) {
+    for (size_t i = 0; i < sizeof(edge_values) / sizeof(edge_values[0]); i++) {
+        for (int decimals = 0; decimals <= 3; decimals++) {
+            check_fixed("edge", edge_values[i], decimals);
+            check_fixed("edge", -edge_values[i], decimals);
+        }
+    }
+    static const double non_finite[] = { INFINITY, -INFINITY, NAN };
+    for (size_t i = 0; i < sizeof(non_finite) / sizeof(non_finite[0]); i++) {
+        for (int decimals = 0; decimals <= 3; decimals++) {
+            check_fixed("not finite", non_finite[i], decimals);
+        }
+    }
+    check_fixed("decimals below 0", 2.5, -1);
+    check_fixed("decimals above 3", 2.71828, 4);
+    check_fixed("decimals above 3", 1e15, 9);
+}
+
+static double random_double(rng_t *rng, int decimals) {
+    static const double powers_of_ten[] = { 1.0, 10.0, 100.0, 1000.0 };
+    double tie = ((double)rng_below(rng, 20000000) + 0.5) / powers_of_ten[decimals];
+    uint64_t bits;
+    double value;
+
+    switch (rng_below(rng, 4)) {
+        case 0:
+            // Any bit pattern whose magnitude is below 1e16
+            bits = rng_next(rng) & ~(0x7ffULL << 52);
+            bits |= (uint64_t)(970 + rng_below(rng, 84)) << 52;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        case 1:
+            // A decimal tie at these decimals, which a double holds only approximately
+            return tie;
+        case 2:
+            // Its neighbours
+            return nextafter(tie, rng_below(rng, 2) ? INFINITY : -INFINITY);
+        default:
+            // A difference, as the callers compute elapsed times and errors
+            return (double)rng_unit(rng) * 1000.0 - (double)rng_unit(rng) * 1000.0;
+    }
+}
+
+static void check_random(rng_t *rng) {
+    for (int i = 0; i < RANDOM_VALUES; i++) {
+        int decimals = (int)rng_below(rng, 4);
+        check_fixed("random", random_double(rng, decimals), decimals);
+    }
+}
+
+/* ========== fmt_long and fmt_centi ========== */
+
+static void check_integers(void) {
+    static const long values[] = { 0, 1, -1, 5, -5, 9, 10, 99, 100, -100, 805, -805,
+                                   LONG_MAX, LONG_MIN, LONG_MAX - 1, LONG_MIN + 1 };
+    char buffer[BUFFER];
+    char expected[BUFFER];
+
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        long value = values[i];
+
+        memset(buffer, SENTINEL, sizeof(buffer));
+        const char *got = finish(buffer, fmt_long(buffer, value));
+        snprintf(expected, sizeof(expected), "%ld", value);
+        if (got == NULL || strcmp(got, expected) != 0) {
+            fail("fmt_long", (double)value, 0, got != NULL ? got : "(written past FMT_MAX_CHARS)", expected);
+        }
+
+        memset(buffer, SENTINEL, sizeof(buffer));
+        got = finish(buffer, fmt_centi(buffer, value));
+        unsigned long magnitude = value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+        snprintf(expected, sizeof(expected), "%s%lu.%02lu", value < 0 ? "-" : "", magnitude / 100, magnitude % 100);
+        if (got == NULL || strcmp(got, expected) != 0) {
+            fail("fmt_centi", (double)value, 2, got != NULL ? got : "(written past FMT_MAX_CHARS)", expected);
+        }
+    }
+}
+
+int main(void) {
+    rng_t rng;
+
+    rng_seed(&rng, 20240601);
+    check_edges();
+    check_random(&rng);
+    check_integers();
+
+    printf("check_format: %zu edge values and %d random doubles at 0-3 decimals; %d failures\n",
+           sizeof(edge_values) / sizeof(edge_values[0]) * 2, RANDOM_VALUES, failures);
+    return failures == 0 ? 0 : 1;
+}
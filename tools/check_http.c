@@ -0,0 +1,291 @@
+/*
+ * check_http.c - Checks for the HTTP Request Parser and Framing
+ *
+ * Feeds http_parse the requests the server has to cope with: complete
+ * ones, the same requests arriving a byte at a time, pipelined requests
+ * taken one after another from the same bytes, keep-alive in HTTP/1.0
+ * and 1.1, Content-Length bodies, and malformed or oversized input that
+ * must fail with the right status. Then frames a response with
+ * http_begin/http_end and checks the patched Content-Length. Prints one
+ * line per failure and a summary.
+ *
+ * Usage: check_http
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "http.h"
+
+typedef struct {
+    const char *name;
+    const char *input;
+    long result;                  // Expected http_parse result; > 0 means the whole input
+    const char *method;
+    const char *path;
+    const char *query;            // NULL if there is none
+    const char *body;
+    bool keep_alive;
+} parse_case_t;
+
+static const parse_case_t cases[] = {
+    { "simple GET", "GET /stats HTTP/1.1\r\nHost: x\r\n\r\n", 1,
+      "GET", "/stats", NULL, "", true },
+    { "query string", "GET /question?category=length&easy HTTP/1.1\r\n\r\n", 1,
+      "GET", "/question", "category=length&easy", "", true },
+    { "empty query", "GET /stats? HTTP/1.1\r\n\r\n", 1,
+      "GET", "/stats", "", "", true },
+    { "HTTP/1.0 closes", "GET / HTTP/1.0\r\n\r\n", 1,
+      "GET", "/", NULL, "", false },
+    { "HTTP/1.0 keep-alive", "GET / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n", 1,
+      "GET", "/", NULL, "", true },
+    { "HTTP/1.1 close", "GET / HTTP/1.1\r\nconnection:  close \r\n\r\n", 1,
+      "GET", "/", NULL, "", false },
+    { "body", "POST /answer HTTP/1.1\r\nContent-Length: 13\r\n\r\n{\"answer\":12}", 1,
+      "POST", "/answer", NULL, "{\"answer\":12}", true },
+    { "padded length", "POST /answer HTTP/1.1\r\ncontent-length:\t2 \r\n\r\nab", 1,
+      "POST", "/answer", NULL, "ab", true },
+    { "largest body", NULL, 1, "POST", "/answer", NULL, NULL, true },
+
+    { "nothing yet", "", 0, NULL, NULL, NULL, NULL, false },
+    { "head in progress", "GET /stats HTTP/1.1\r\nHost: x\r\n", 0, NULL, NULL, NULL, NULL, false },
+    { "body in progress", "POST /answer HTTP/1.1\r\nContent-Length: 5\r\n\r\nabc", 0,
+      NULL, NULL, NULL, NULL, false },
+
+    { "no target", "GET HTTP/1.1\r\n\r\n", -400, NULL, NULL, NULL, NULL, false },
+    { "empty method", " / HTTP/1.1\r\n\r\n", -400, NULL, NULL, NULL, NULL, false },
+    { "empty target", "GET  HTTP/1.1\r\n\r\n", -400, NULL, NULL, NULL, NULL, false },
+    { "not HTTP", "GET / FTP/1.1\r\n\r\n", -400, NULL, NULL, NULL, NULL, false },
+    { "long version", "GET / HTTP/1.10\r\n\r\n", -400, NULL, NULL, NULL, NULL, false },
+    { "blank request line", "\r\n\r\n", -400, NULL, NULL, NULL, NULL, false },
+    { "bad length", "POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\nab", -400,
+      NULL, NULL, NULL, NULL, false },
+    { "empty length", "POST / HTTP/1.1\r\nContent-Length:\r\n\r\n", -400,
+      NULL, NULL, NULL, NULL, false },
+    { "body too large", "POST / HTTP/1.1\r\nContent-Length: 65537\r\n\r\n", -413,
+      NULL, NULL, NULL, NULL, false },
+    { "chunked", "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n", -501,
+      NULL, NULL, NULL, NULL, false },
+    { "head too large", NULL, -431, NULL, NULL, NULL, NULL, false },
+};
+
+static int failures;
+
+static void fail(const char *name, const char *what) {
+    printf("check_http: %s: %s\n", name, what);
+    failures++;
+}
+
+static bool field_is(const char *field, size_t len, const char *expected) {
+    return strlen(expected) == len && memcmp(field, expected, len) == 0;
+}
+
+/* The generated inputs: a body of HTTP_MAX_BODY bytes, and a head that never ends */
+static char *make_input(const parse_case_t *c, size_t *len) {
+    char *data;
+
+    if (c->result > 0) {
+        char head[64];
+        int n = snprintf(head, sizeof(head), "POST /answer HTTP/1.1\r\nContent-Length: %d\r\n\r\n",
+                         HTTP_MAX_BODY);
+        *len = (size_t)n + HTTP_MAX_BODY;
+        data = malloc(*len);
+        if (data != NULL) {
+            memcpy(data, head, (size_t)n);
+            memset(data + n, 'x', HTTP_MAX_BODY);
+        }
+    } else {
+        static const char start[] = "GET / HTTP/1.1\r\n";
+        *len = HTTP_MAX_HEAD;
+        data = malloc(*len);
+        if (data != NULL) {
+            memset(data, 'a', *len);
+            memcpy(data, start, sizeof(start) - 1);
+        }
+    }
+    return data;
+}
+
+static void check_request(const parse_case_t *c, const http_request_t *request, const char *data, size_t len) {
+    if (!field_is(request->method, request->method_len, c->method)) {
+        fail(c->name, "wrong method");
+    }
+    if (!field_is(request->path, request->path_len, c->path)) {
+        fail(c->name, "wrong path");
+    }
+    if (c->query == NULL ? request->query != NULL
+                         : request->query == NULL || !field_is(request->query, request->query_len, c->query)) {
+        fail(c->name, "wrong query");
+    }
+    if (c->body != NULL ? !field_is(request->body, request->body_len, c->body)
+                        : request->body_len != HTTP_MAX_BODY) {
+        fail(c->name, "wrong body");
+    }
+    if (request->body + request->body_len != data + len) {
+        fail(c->name, "body does not end the request");
+    }
+    if (request->keep_alive != c->keep_alive) {
+        fail(c->name, "wrong keep-alive");
+    }
+}
+
+/* One case whole, then every proper prefix, which must ask for more */
+static void check_case(const parse_case_t *c) {
+    size_t len;
+    char *data;
+
+    if (c->input != NULL) {
+        len = strlen(c->input);
+        data = malloc(len + 1);
+        if (data != NULL) {
+            memcpy(data, c->input, len);
+        }
+    } else {
+        data = make_input(c, &len);
+    }
+    if (data == NULL) {
+        fail(c->name, "out of memory");
+        return;
+    }
+
+    http_request_t request;
+    long result = http_parse(data, len, &request);
+    long expected = c->result > 0 ? (long)len : c->result;
+    if (result != expected) {
+        char what[64];
+        snprintf(what, sizeof(what), "returned %ld, expected %ld", result, expected);
+        fail(c->name, what);
+    } else if (result > 0) {
+        check_request(c, &request, data, len);
+    }
+
+    // Arriving a byte at a time, a request is incomplete until its last byte
+    if (expected > 0) {
+        for (size_t prefix = 0; prefix < len; prefix++) {
+            if (http_parse(data, prefix, &request) != 0) {
+                fail(c->name, "a partial request did not ask for more");
+                break;
+            }
+        }
+    }
+    free(data);
+}
+
+/* Every case that parses, back to back in one buffer, comes out in order */
+static void check_pipelined(void) {
+    size_t total = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (cases[i].result > 0 && cases[i].input != NULL) {
+            total += strlen(cases[i].input);
+        }
+    }
+    char *data = malloc(total);
+    if (data == NULL) {
+        fail("pipelined", "out of memory");
+        return;
+    }
+    size_t len = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (cases[i].result > 0 && cases[i].input != NULL) {
+            memcpy(data + len, cases[i].input, strlen(cases[i].input));
+            len += strlen(cases[i].input);
+        }
+    }
+
+    size_t offset = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const parse_case_t *c = &cases[i];
+        if (c->result <= 0 || c->input == NULL) {
+            continue;
+        }
+        http_request_t request;
+        size_t size = strlen(c->input);
+        long result = http_parse(data + offset, len - offset, &request);
+        if (result != (long)size) {
+            fail("pipelined", c->name);
+            break;
+        }
+        check_request(c, &request, data + offset, size);
+        offset += size;
+    }
+    free(data);
+}
+
+/* Query parameters: present, bare, empty and missing */
+static void check_query(void) {
+    static const char input[] = "GET /question?category=length&easy&to=&c HTTP/1.1\r\n\r\n";
+    http_request_t request;
+    const char *value;
+    size_t value_len;
+
+    if (http_parse(input, sizeof(input) - 1, &request) <= 0) {
+        fail("query", "did not parse");
+        return;
+    }
+    if (!http_is(&request, "GET", "/question") || http_is(&request, "GET", "/questions") ||
+        http_is(&request, "POST", "/question")) {
+        fail("query", "http_is");
+    }
+    if (!http_query(&request, "category", &value, &value_len) || !field_is(value, value_len, "length")) {
+        fail("query", "category");
+    }
+    if (!http_query(&request, "easy", &value, &value_len) || value_len != 0) {
+        fail("query", "easy");
+    }
+    if (!http_query(&request, "to", &value, &value_len) || value_len != 0) {
+        fail("query", "to");
+    }
+    if (!http_query(&request, "c", &value, &value_len) || value_len != 0) {
+        fail("query", "c");
+    }
+    if (http_query(&request, "cat", &value, &value_len) || http_query(&request, "from", &value, &value_len)) {
+        fail("query", "found a parameter that is not there");
+    }
+}
+
+/* A framed response carries its body's length, whatever the size */
+static void check_response(void) {
+    static const size_t sizes[] = { 0, 9, 10, 12345, 1000000 };
+    outbuf_t out;
+
+    if (outbuf_init(&out, -1, 256) != 0) {
+        fail("response", "out of memory");
+        return;
+    }
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        out.len = 0;
+        size_t start = http_begin(&out, 200, "application/json", true);
+        for (size_t k = 0; k < sizes[i]; k++) {
+            outbuf_putc(&out, 'x');
+        }
+        http_end(&out, start);
+
+        char expected[32];
+        snprintf(expected, sizeof(expected), "Content-Length: %10zu\r\n\r\n", sizes[i]);
+        size_t n = strlen(expected);
+        if (out.len != start + sizes[i] || start < n || memcmp(out.data + start - n, expected, n) != 0) {
+            fail("response", "wrong Content-Length");
+        }
+    }
+
+    out.len = 0;
+    http_json_string(&out, "a\"b\\c\n\x01", 7);
+    if (!field_is(out.data, out.len, "\"a\\\"b\\\\c\\u000a\\u0001\"")) {
+        fail("response", "JSON string escaping");
+    }
+    outbuf_free(&out);
+}
+
+int main(void) {
+    size_t count = sizeof(cases) / sizeof(cases[0]);
+    for (size_t i = 0; i < count; i++) {
+        check_case(&cases[i]);
+    }
+    check_pipelined();
+    check_query();
+    check_response();
+
+    printf("check_http: %zu requests whole, in pieces and pipelined; %d failures\n", count, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,223 @@
+/*
+ * check_leaderboard.c - Checks for the Leaderboard Skip Lists
+ *
+ * Ranks a few thousand users, then re-ranks them tens of thousands of
+ * times: single answers through leaderboard_record, whole new scores
+ * through leaderboard_set, and scores that drop out of a ranking and
+ * come back. Every so often every ranking is read back and compared with
+ * the scores kept here: who is ranked, the order (exactly, with ties
+ * going to the user seen first, for streaks; by the ranking rules for
+ * accuracy and speed), runs read from the middle, and each user's own
+ * rank. Prints one line per failure and a summary.
+ *
+ * Usage: check_leaderboard
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "leaderboard.h"
+#include "rng.h"
+
+#define USERS 3000
+#define UPDATES 60000
+#define CHECK_EVERY 5000
+#define MIN_ANSWERS 5
+
+/* Globals that main.c defines for the program */
+bool g_whole_numbers_mode;
+bool g_easy_mode;
+const char *g_user_name;
+
+static int failures;
+static leaderboard_score_t scores[USERS][LEADERBOARD_SCOPES];
+static char names[USERS][16];
+static leaderboard_entry_t entries[USERS + 1];
+
+static void fail(const char *what, int scope, leaderboard_metric_t metric) {
+    if (failures < 20) {
+        printf("check_leaderboard: %s (scope %d, %s)\n", what, scope, leaderboard_metric_names[metric]);
+    }
+    failures++;
+}
+
+/* ========== Scores ========== */
+
+/* Small ranges, so there are plenty of ties and of users below MIN_ANSWERS */
+static void random_scores(rng_t *rng, leaderboard_score_t user[LEADERBOARD_SCOPES]) {
+    memset(user, 0, sizeof(leaderboard_score_t) * LEADERBOARD_SCOPES);
+    if (rng_below(rng, 8) == 0) {
+        return;                         // Unranked everywhere
+    }
+    int answers = (int)rng_below(rng, 40);
+    for (int i = 0; i < answers; i++) {
+        leaderboard_score_add(user, (category_t)rng_below(rng, CATEGORY_COUNT), rng_below(rng, 3) != 0,
+                              rng_below(rng, 4) == 0 ? 0.0f : 0.5f * (float)(1 + rng_below(rng, 8)));
+    }
+}
+
+static bool ranks(const leaderboard_score_t *score, leaderboard_metric_t metric) {
+    switch (metric) {
+        case LEADERBOARD_ACCURACY: return score->answered > 0 && score->answered >= MIN_ANSWERS;
+        case LEADERBOARD_SPEED:    return score->timed > 0 && score->timed >= MIN_ANSWERS;
+        default:                   return score->best_streak > 0;
+    }
+}
+
+/* Whether a may be ranked directly above b */
+static bool in_order(const leaderboard_score_t *a, const leaderboard_score_t *b, leaderboard_metric_t metric) {
+    switch (metric) {
+        case LEADERBOARD_ACCURACY: {
+            uint64_t ppm_a = (uint64_t)a->correct * 1000000 / a->answered;
+            uint64_t ppm_b = (uint64_t)b->correct * 1000000 / b->answered;
+            return ppm_a > ppm_b || (ppm_a == ppm_b && a->answered >= b->answered);
+        }
+        case LEADERBOARD_SPEED: {
+            uint64_t ms_a = (uint64_t)(a->seconds * 1000.0 / a->timed);
+            uint64_t ms_b = (uint64_t)(b->seconds * 1000.0 / b->timed);
+            return ms_a < ms_b || (ms_a == ms_b && a->timed >= b->timed);
+        }
+        default:
+            return a->best_streak >= b->best_streak;
+    }
+}
+
+static bool same_score(const leaderboard_score_t *a, const leaderboard_score_t *b) {
+    return a->answered == b->answered && a->correct == b->correct && a->timed == b->timed &&
+           a->streak == b->streak && a->best_streak == b->best_streak && a->seconds == b->seconds;
+}
+
+static int user_number(const char *name) {
+    return atoi(name + 4);
+}
+
+/* ========== Checking ========== */
+
+static void check_ranking(const leaderboard_t *board, int scope, leaderboard_metric_t metric) {
+    size_t expected = 0;
+    for (int u = 0; u < USERS; u++) {
+        expected += ranks(&scores[u][scope], metric);
+    }
+    size_t ranked = leaderboard_ranked(board, scope, metric);
+    if (ranked != expected) {
+        fail("wrong number of users ranked", scope, metric);
+        return;
+    }
+    if (leaderboard_top(board, scope, metric, 1, USERS + 1, entries) != ranked) {
+        fail("the top of the ranking is not the whole ranking", scope, metric);
+        return;
+    }
+
+    // Streak ties go to the user seen first, so that order is exact
+    int streak_order[USERS];
+    size_t n = 0;
+    if (metric == LEADERBOARD_STREAK) {
+        uint32_t longest = 0;
+        for (int u = 0; u < USERS; u++) {
+            if (scores[u][scope].best_streak > longest) {
+                longest = scores[u][scope].best_streak;
+            }
+        }
+        for (uint32_t best = longest; best > 0; best--) {
+            for (int u = 0; u < USERS; u++) {
+                if (scores[u][scope].best_streak == best) {
+                    streak_order[n++] = u;
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < ranked; i++) {
+        int u = user_number(entries[i].user);
+        leaderboard_entry_t found;
+        if (entries[i].rank != i + 1 || !same_score(&entries[i].score, &scores[u][scope])) {
+            fail("an entry has the wrong rank or score", scope, metric);
+            return;
+        }
+        if (!ranks(&scores[u][scope], metric) ||
+            (i > 0 && !in_order(&entries[i - 1].score, &entries[i].score, metric)) ||
+            (metric == LEADERBOARD_STREAK && streak_order[i] != u)) {
+            fail("the ranking is out of order", scope, metric);
+            return;
+        }
+        if (!leaderboard_find(board, entries[i].user, scope, metric, &found) || found.rank != i + 1) {
+            fail("a user's own rank disagrees with the ranking", scope, metric);
+            return;
+        }
+    }
+
+    // A run read from the middle is the same slice
+    size_t first = ranked / 3 + 1;
+    leaderboard_entry_t run[10];
+    size_t got = leaderboard_top(board, scope, metric, first, 10, run);
+    if (ranked > 0 && (got != (ranked - first + 1 < 10 ? ranked - first + 1 : 10) ||
+                       (got > 0 && strcmp(run[0].user, entries[first - 1].user) != 0))) {
+        fail("a run from the middle is wrong", scope, metric);
+    }
+
+    for (int u = 0; u < USERS; u++) {
+        leaderboard_entry_t found;
+        if (!ranks(&scores[u][scope], metric) &&
+            (!leaderboard_find(board, names[u], scope, metric, &found) || found.rank != 0)) {
+            fail("an unranked user has a rank", scope, metric);
+            return;
+        }
+    }
+}
+
+static void check_all(const leaderboard_t *board) {
+    if (leaderboard_users(board) != USERS) {
+        fail("wrong number of users", LEADERBOARD_ALL, LEADERBOARD_ACCURACY);
+    }
+    for (int scope = 0; scope < LEADERBOARD_SCOPES; scope++) {
+        for (int m = 0; m < LEADERBOARD_METRICS; m++) {
+            check_ranking(board, scope, (leaderboard_metric_t)m);
+        }
+    }
+}
+
+int main(void) {
+    leaderboard_t *board = leaderboard_create(MIN_ANSWERS);
+    rng_t rng;
+    int checks = 0;
+
+    if (board == NULL) {
+        fprintf(stderr, "check_leaderboard: out of memory\n");
+        return 1;
+    }
+    rng_seed(&rng, 20240101);
+    for (int u = 0; u < USERS; u++) {
+        snprintf(names[u], sizeof(names[u]), "user%d", u);
+        random_scores(&rng, scores[u]);
+        leaderboard_set(board, names[u], scores[u]);
+    }
+    check_all(board);
+    checks++;
+
+    for (int i = 1; i <= UPDATES; i++) {
+        int u = (int)rng_below(&rng, USERS);
+        if (rng_below(&rng, 4) == 0) {
+            random_scores(&rng, scores[u]);
+            leaderboard_set(board, names[u], scores[u]);
+        } else {
+            stats_delta_t delta;
+            memset(&delta, 0, sizeof(delta));
+            delta.category = (category_t)rng_below(&rng, CATEGORY_COUNT);
+            delta.correct = rng_below(&rng, 3) != 0;
+            delta.response_seconds = rng_below(&rng, 4) == 0 ? 0.0f : 0.5f * (float)(1 + rng_below(&rng, 8));
+            leaderboard_score_add(scores[u], delta.category, delta.correct, delta.response_seconds);
+            leaderboard_record(board, names[u], &delta);
+        }
+        if (i % CHECK_EVERY == 0) {
+            check_all(board);
+            checks++;
+        }
+    }
+    leaderboard_free(board);
+
+    printf("check_leaderboard: %d users, %d re-ranks, %d checks of %d rankings; %d failures\n",
+           USERS, UPDATES, checks, LEADERBOARD_SCOPES * LEADERBOARD_METRICS, failures);
+    return failures == 0 ? 0 : 1;
+}
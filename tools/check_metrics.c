@@ -0,0 +1,184 @@
+/*
+ * check_metrics.c - Checks for the Metrics Endpoint
+ *
+ * Serves metrics from this process, with SIGPIPE left at its default,
+ * then treats the endpoint the way real clients do: connections closed
+ * before sending anything, requests reset before the response is read,
+ * and a client that sends half a request and stalls. After each, a
+ * scrape must still be answered promptly and in full - a SIGPIPE would
+ * have killed the check, and a stalled client must not hold the
+ * endpoint. Also checks that the active sessions gauge does not wrap
+ * below zero. Prints one line per failure and a summary.
+ *
+ * Usage: check_metrics
+ */
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include "metrics.h"
+
+#define FIRST_PORT 19090
+#define PORTS_TO_TRY 100
+#define EARLY_CLOSES 200
+#define SCRAPE_EVERY 10             // Keeps the endpoint's backlog of 16 from overflowing
+#define SCRAPE_TIMEOUT_SECONDS 10
+
+/* Globals that main.c defines for the program */
+bool g_whole_numbers_mode;
+bool g_easy_mode;
+const char *g_user_name;
+
+static int failures;
+static int port;
+
+static void fail(const char *name, const char *what) {
+    printf("check_metrics: %s: %s\n", name, what);
+    failures++;
+}
+
+static int connect_endpoint(void) {
+    struct sockaddr_in addr;
+    struct timeval timeout = { SCRAPE_TIMEOUT_SECONDS, 0 };
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Close with a reset rather than a FIN, as a client that gives up does */
+static void reset(int fd) {
+    struct linger linger = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+    close(fd);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* One whole scrape: a 200 whose body is as long as it says */
+static void check_scrape(const char *name) {
+    static const char request[] = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    static char response[65536];
+    size_t len = 0;
+    int fd = connect_endpoint();
+
+    if (fd < 0) {
+        fail(name, "cannot connect");
+        return;
+    }
+    if (send(fd, request, sizeof(request) - 1, MSG_NOSIGNAL) != (ssize_t)(sizeof(request) - 1)) {
+        fail(name, "cannot send the request");
+        close(fd);
+        return;
+    }
+    for (;;) {
+        ssize_t n = recv(fd, response + len, sizeof(response) - 1 - len, 0);
+        if (n <= 0) {
+            if (n < 0) {
+                fail(name, "no response in time");
+            }
+            break;
+        }
+        len += (size_t)n;
+    }
+    close(fd);
+    response[len] = '\0';
+
+    const char *body = strstr(response, "\r\n\r\n");
+    const char *length = strstr(response, "Content-Length: ");
+    if (strncmp(response, "HTTP/1.1 200 OK\r\n", 17) != 0 || body == NULL || length == NULL) {
+        fail(name, "not a 200 response");
+    } else if (strtoul(length + 16, NULL, 10) != len - (size_t)(body + 4 - response)) {
+        fail(name, "the body is cut short");
+    } else if (strstr(body, "\nmetric_trainer_sessions_active 0\n") == NULL) {
+        fail(name, "sessions_active is not 0");
+    }
+}
+
+static void check_early_close(void) {
+    for (int i = 0; i < EARLY_CLOSES; i++) {
+        int fd = connect_endpoint();
+        if (fd < 0) {
+            fail("early close", "cannot connect");
+            return;
+        }
+        if (i % 2 == 0) {
+            // Connected, then gone without a word
+            close(fd);
+        } else {
+            // Asked, then reset before the answer could be sent
+            send(fd, "GET /metrics HTTP/1.1\r\n\r\n", 25, MSG_NOSIGNAL);
+            reset(fd);
+        }
+        if ((i + 1) % SCRAPE_EVERY == 0) {
+            check_scrape("after early closes");
+        }
+    }
+}
+
+static void check_stalled_client(void) {
+    int stalled = connect_endpoint();
+    if (stalled < 0) {
+        fail("stalled client", "cannot connect");
+        return;
+    }
+    send(stalled, "GET /met", 8, MSG_NOSIGNAL);
+
+    double start = now();
+    check_scrape("behind a stalled client");
+    if (now() - start >= SCRAPE_TIMEOUT_SECONDS) {
+        fail("stalled client", "held the endpoint");
+    }
+    close(stalled);
+}
+
+int main(void) {
+    // More sessions ending than starting, as a scrape can see mid-update
+    metrics_session_started();
+    metrics_session_ended();
+    metrics_session_ended();
+
+    for (port = FIRST_PORT; port < FIRST_PORT + PORTS_TO_TRY; port++) {
+        if (metrics_serve(port) == 0) {
+            break;
+        }
+        if (errno != EADDRINUSE) {
+            perror("check_metrics: metrics_serve");
+            return 1;
+        }
+    }
+    if (port == FIRST_PORT + PORTS_TO_TRY) {
+        fprintf(stderr, "check_metrics: no free port from %d\n", FIRST_PORT);
+        return 1;
+    }
+
+    check_scrape("first scrape");
+    check_early_close();
+    check_stalled_client();
+
+    printf("check_metrics: %d early closes and a stalled client on port %d; %d failures\n",
+           EARLY_CLOSES, port, failures);
+    return failures == 0 ? 0 : 1;
+}
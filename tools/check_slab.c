@@ -0,0 +1,159 @@
+/*
+ * check_slab.c - Checks for the Fixed-Size Object Slabs
+ *
+ * Runs random allocate and free sequences through slabs of several
+ * object and chunk sizes. Every live object is filled with its own
+ * pattern and checked before it is freed, so objects that overlap, or a
+ * free list that hands out an object twice, show up as a clobbered
+ * pattern. Also checks alignment, the in-use count, that objects are
+ * reused most recently freed first, and that chunks are allocated only
+ * as the number of live objects reaches a new peak. Prints one line per
+ * failure and a summary.
+ *
+ * Usage: check_slab
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "rng.h"
+#include "slab.h"
+
+#define MAX_LIVE 2000
+#define OPERATIONS 200000
+
+static const size_t object_sizes[] = { 1, 8, 16, 17, 100, 600 };
+static const size_t chunk_sizes[] = { 0, 1, 7, 64 };
+
+static int failures;
+
+static void fail(size_t object_size, size_t per_chunk, const char *what) {
+    printf("check_slab: object size %zu, %zu per chunk: %s\n", object_size, per_chunk, what);
+    failures++;
+}
+
+/* ========== Objects ========== */
+
+typedef struct {
+    unsigned char *object;
+    unsigned char pattern;
+} live_t;
+
+static live_t live[MAX_LIVE];
+
+static void fill(unsigned char *object, size_t size, unsigned char pattern) {
+    memset(object, pattern, size);
+}
+
+static bool intact(const unsigned char *object, size_t size, unsigned char pattern) {
+    for (size_t i = 0; i < size; i++) {
+        if (object[i] != pattern) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t chunks_for(size_t objects, size_t per_chunk) {
+    return (objects + per_chunk - 1) / per_chunk;
+}
+
+/* ========== Checking ========== */
+
+static void check_slab(rng_t *rng, size_t object_size, size_t per_chunk) {
+    slab_t slab;
+    size_t count = 0;
+    size_t peak = 0;
+    unsigned char next_pattern = 1;
+
+    slab_init(&slab, object_size, per_chunk);
+    size_t chunk_objects = per_chunk > 0 ? per_chunk : 1;
+    if (slab.object_size < object_size || slab.object_size % SLAB_ALIGN != 0) {
+        fail(object_size, per_chunk, "object size not rounded up to SLAB_ALIGN");
+    }
+    if (slab_bytes(&slab) != 0) {
+        fail(object_size, per_chunk, "a fresh slab holds memory");
+    }
+
+    for (int op = 0; op < OPERATIONS; op++) {
+        // Drift between growing and shrinking so the peak moves now and then
+        bool grow = count == 0 || (count < MAX_LIVE && rng_below(rng, 100) < ((op / 20000) % 2 ? 45u : 55u));
+        if (grow) {
+            unsigned char *object = slab_alloc(&slab);
+            if (object == NULL) {
+                fail(object_size, per_chunk, "out of memory");
+                break;
+            }
+            if ((uintptr_t)object % SLAB_ALIGN != 0) {
+                fail(object_size, per_chunk, "object not aligned");
+                break;
+            }
+            live[count].object = object;
+            live[count].pattern = next_pattern;
+            fill(object, slab.object_size, next_pattern);
+            next_pattern = next_pattern == 255 ? 1 : (unsigned char)(next_pattern + 1);
+            count++;
+            if (count > peak) {
+                peak = count;
+            }
+        } else {
+            size_t i = rng_below(rng, (uint32_t)count);
+            if (!intact(live[i].object, slab.object_size, live[i].pattern)) {
+                fail(object_size, per_chunk, "an object was overwritten while in use");
+                break;
+            }
+            slab_free(&slab, live[i].object);
+            live[i] = live[--count];
+        }
+
+        if (slab.in_use != count) {
+            fail(object_size, per_chunk, "wrong in-use count");
+            break;
+        }
+        if (slab.chunk_count != chunks_for(peak, chunk_objects)) {
+            fail(object_size, per_chunk, "chunks allocated below the peak");
+            break;
+        }
+    }
+    if (slab_bytes(&slab) < peak * slab.object_size) {
+        fail(object_size, per_chunk, "holds less memory than its objects");
+    }
+
+    // The most recently freed object comes back first
+    if (count >= 2) {
+        unsigned char *a = live[0].object;
+        unsigned char *b = live[1].object;
+        slab_free(&slab, a);
+        slab_free(&slab, b);
+        slab_free(&slab, NULL);
+        if (slab_alloc(&slab) != b || slab_alloc(&slab) != a) {
+            fail(object_size, per_chunk, "objects not reused most recently freed first");
+        }
+    }
+
+    slab_destroy(&slab);
+    if (slab_bytes(&slab) != 0 || slab.in_use != 0 || slab.free_list != NULL) {
+        fail(object_size, per_chunk, "memory left after slab_destroy");
+    }
+    if (slab_alloc(&slab) == NULL || slab.chunk_count != 1) {
+        fail(object_size, per_chunk, "cannot be reused after slab_destroy");
+    }
+    slab_destroy(&slab);
+}
+
+int main(void) {
+    rng_t rng;
+    size_t slabs = 0;
+
+    rng_seed(&rng, 20240301);
+    for (size_t s = 0; s < sizeof(object_sizes) / sizeof(object_sizes[0]); s++) {
+        for (size_t c = 0; c < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); c++) {
+            check_slab(&rng, object_sizes[s], chunk_sizes[c]);
+            slabs++;
+        }
+    }
+
+    printf("check_slab: %zu slabs, %d allocations and frees each; %d failures\n", slabs, OPERATIONS, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,375 @@
+/*
+ * gentables.c - Conversion Table Generator
+ *
+ * Build-time helper that expands conversions.def into tables_gen.c:
+ * the hot conversion table with precomputed coefficients, the interned
+ * unit name table, category name tables, the menu and reference text,
+ * and the value grids used by the --whole and --easy modes. The Makefile runs it before compiling the
+ * trainer, so none of this work happens when the program starts.
+ *
+ * Usage: gentables > src/tables_gen.c
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "questions.h"              // CONVERSION_ID_LIMIT, MAX_CONVERSIONS_PER_CATEGORY
+
+typedef struct {
+    const char *id;
+    char letter;
+    const char *name;
+    const char *description;
+} category_def_t;
+
+typedef struct {
+    int id;
+    const char *category;
+    const char *from_unit;
+    const char *from_abbrev;
+    const char *to_unit;
+    const char *to_abbrev;
+    long long num;
+    long long den;
+    long long pre_offset;
+    long long post_offset;
+    double min_value;
+    double max_value;
+    double tolerance_percent;
+    const char *reference;
+} conversion_def_t;
+
+static const category_def_t categories[] = {
+#define CATEGORY(id, letter, name, description) { #id, letter, name, description },
+#include "conversions.def"
+};
+
+static const conversion_def_t conversions[] = {
+#define CONVERSION(id, category, from_unit, from_abbrev, to_unit, to_abbrev, \
+                   num, den, pre_offset, post_offset,                        \
+                   min_value, max_value, tolerance_percent, reference)       \
+    { id, #category, from_unit, from_abbrev, to_unit, to_abbrev,             \
+      num, den, pre_offset, post_offset,                                     \
+      min_value, max_value, tolerance_percent, reference },
+#include "conversions.def"
+};
+
+#define NUM_CATEGORIES ((int)(sizeof(categories) / sizeof(categories[0])))
+#define NUM_CONVERSIONS ((int)(sizeof(conversions) / sizeof(conversions[0])))
+#define MAX_GRID_VALUES 16384
+
+static short grid_values[MAX_GRID_VALUES];
+static int grid_count = 0;
+
+/* ========== Output Helpers ========== */
+
+// Print a string as the body of a C string literal
+static void print_escaped(const char *s) {
+    for (; *s; s++) {
+        switch (*s) {
+            case '"':  fputs("\\\"", stdout); break;
+            case '\\': fputs("\\\\", stdout); break;
+            case '\n': fputs("\\n", stdout); break;
+            default:   putchar(*s); break;
+        }
+    }
+}
+
+// Print one line of a multi-line string literal
+static void print_line(const char *s) {
+    fputs("    \"", stdout);
+    print_escaped(s);
+    fputs("\"\n", stdout);
+}
+
+// Print one element of a string array initializer
+static void print_item(const char *s) {
+    fputs("    \"", stdout);
+    print_escaped(s);
+    fputs("\",\n", stdout);
+}
+
+// Print a double as a float literal that survives the round trip
+static void print_float(double value) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.9g", value);
+    fputs(buf, stdout);
+    if (strpbrk(buf, ".eEn") == NULL) {
+        fputs(".0", stdout);
+    }
+    putchar('f');
+}
+
+/* ========== Value Grids ========== */
+
+static int add_grid_value(int value) {
+    if (grid_count >= MAX_GRID_VALUES) {
+        fprintf(stderr, "gentables: value grids exceed %d entries\n", MAX_GRID_VALUES);
+        return 0;
+    }
+    grid_values[grid_count++] = (short)value;
+    return 1;
+}
+
+// Whole numbers mode: every integer between the rounded range ends
+static int build_whole_grid(const conversion_def_t *c, int *first, int *count) {
+    int lo = (int)round(c->min_value);
+    int hi = (int)round(c->max_value);
+
+    *first = grid_count;
+    for (int v = lo; v <= hi; v++) {
+        if (!add_grid_value(v)) return 0;
+    }
+    *count = grid_count - *first;
+    return 1;
+}
+
+// Easy mode: 1 (when in range) followed by the multiples of 5 in range
+static int build_easy_grid(const conversion_def_t *c, int *first, int *count) {
+    *first = grid_count;
+    if (c->min_value <= 1.0 && c->max_value >= 1.0) {
+        if (!add_grid_value(1)) return 0;
+    }
+
+    int lo = (int)ceil(c->min_value / 5.0) * 5;
+    if (lo < 5) lo = 5;
+    for (int v = lo; v <= c->max_value; v += 5) {
+        if (!add_grid_value(v)) return 0;
+    }
+
+    // Degenerate range: fall back to the smallest value in range
+    if (grid_count == *first && !add_grid_value((int)ceil(c->min_value))) {
+        return 0;
+    }
+    *count = grid_count - *first;
+    return 1;
+}
+
+/* ========== Table Emitters ========== */
+
+static int category_index(const char *id) {
+    for (int i = 0; i < NUM_CATEGORIES; i++) {
+        if (strcmp(categories[i].id, id) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int whole_first[NUM_CONVERSIONS], whole_count[NUM_CONVERSIONS];
+static int easy_first[NUM_CONVERSIONS], easy_count[NUM_CONVERSIONS];
+
+static int build_value_grids(void) {
+    for (int i = 0; i < NUM_CONVERSIONS; i++) {
+        if (!build_whole_grid(&conversions[i], &whole_first[i], &whole_count[i]) ||
+            !build_easy_grid(&conversions[i], &easy_first[i], &easy_count[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Hot table: coefficients, ranges, tolerance, exact form, grids - one line each
+static void emit_conversion_table(void) {
+    printf("const conversion_info_t conversion_table[CONVERSION_COUNT]\n");
+    printf("    __attribute__((aligned(CACHE_LINE_SIZE))) = {\n");
+    for (int i = 0; i < NUM_CONVERSIONS; i++) {
+        const conversion_def_t *c = &conversions[i];
+        double scale = (double)c->num / (double)c->den;
+        double offset = (double)c->pre_offset * scale + (double)c->post_offset;
+        double values[] = { scale, offset, c->min_value, c->max_value, c->tolerance_percent };
+
+        printf("    { ");
+        for (int v = 0; v < 5; v++) {
+            print_float(values[v]);
+            fputs(", ", stdout);
+        }
+        printf("%lld, %lld, %lld, %lld, %d,\n",
+               c->num, c->den, c->pre_offset, c->post_offset,
+               (int)round(c->tolerance_percent * 10.0));
+        printf("      %d, %d, %d, %d, %d, {0} },  // %s -> %s\n",
+               whole_first[i], whole_count[i], easy_first[i], easy_count[i],
+               category_index(c->category), c->from_abbrev, c->to_abbrev);
+    }
+    printf("};\n\n");
+}
+
+/* ========== Interned Unit Strings ========== */
+
+#define MAX_UNIT_STRINGS (NUM_CONVERSIONS * 4)
+
+static const char *unit_strings[MAX_UNIT_STRINGS];
+static int unit_offsets[MAX_UNIT_STRINGS];
+static int unit_string_count = 0;
+static int unit_strings_size = 0;
+
+// Return the offset of s in the string table, adding it on first use
+static int intern(const char *s) {
+    for (int i = 0; i < unit_string_count; i++) {
+        if (strcmp(unit_strings[i], s) == 0) {
+            return unit_offsets[i];
+        }
+    }
+    unit_strings[unit_string_count] = s;
+    unit_offsets[unit_string_count] = unit_strings_size;
+    unit_string_count++;
+    unit_strings_size += (int)strlen(s) + 1;
+    return unit_offsets[unit_string_count - 1];
+}
+
+// Cold table: unit names and abbreviations, only read for display
+static void emit_conversion_names(void) {
+    printf("const conversion_names_t conversion_names[CONVERSION_COUNT] = {\n");
+    for (int i = 0; i < NUM_CONVERSIONS; i++) {
+        const conversion_def_t *c = &conversions[i];
+        int from_unit = intern(c->from_unit);
+        int from_abbrev = intern(c->from_abbrev);
+        int to_unit = intern(c->to_unit);
+        int to_abbrev = intern(c->to_abbrev);
+        printf("    { %d, %d, %d, %d },\n", from_unit, from_abbrev, to_unit, to_abbrev);
+    }
+    printf("};\n\n");
+
+    printf("const char unit_strings[%d] =\n", unit_strings_size);
+    for (int i = 0; i < unit_string_count; i++) {
+        fputs("    \"", stdout);
+        print_escaped(unit_strings[i]);
+        // The final terminator comes from the string literal itself
+        fputs(i + 1 < unit_string_count ? "\\0\"\n" : "\"\n", stdout);
+    }
+    printf("    ;\n\n");
+}
+
+static int emit_category_tables(void) {
+    int members[NUM_CATEGORIES][MAX_CONVERSIONS_PER_CATEGORY];
+    int count[NUM_CATEGORIES];
+
+    for (int i = 0; i < NUM_CATEGORIES; i++) {
+        count[i] = 0;
+    }
+
+    for (int i = 0; i < NUM_CONVERSIONS; i++) {
+        // Saved statistics are keyed by id, so the ids must stay put
+        if (conversions[i].id != i) {
+            fprintf(stderr, "gentables: conversion %d (%s -> %s) has id %d; ids run 0, 1, 2, ... "
+                    "in order, and new conversions go at the end\n",
+                    i, conversions[i].from_abbrev, conversions[i].to_abbrev, conversions[i].id);
+            return 0;
+        }
+        int cat = category_index(conversions[i].category);
+        if (cat < 0) {
+            fprintf(stderr, "gentables: unknown category %s\n", conversions[i].category);
+            return 0;
+        }
+        if (count[cat] == MAX_CONVERSIONS_PER_CATEGORY) {
+            fprintf(stderr, "gentables: more than %d %s conversions\n",
+                    MAX_CONVERSIONS_PER_CATEGORY, conversions[i].category);
+            return 0;
+        }
+        members[cat][count[cat]++] = i;
+    }
+
+    printf("const unsigned char category_conversions[CATEGORY_COUNT][MAX_CONVERSIONS_PER_CATEGORY] = {\n");
+    for (int i = 0; i < NUM_CATEGORIES; i++) {
+        printf("    {");
+        for (int j = 0; j < count[i]; j++) printf(" %d,", members[i][j]);
+        printf(" },\n");
+    }
+    printf("};\n");
+
+    printf("const unsigned char category_conversion_count[CATEGORY_COUNT] = {");
+    for (int i = 0; i < NUM_CATEGORIES; i++) printf(" %d,", count[i]);
+    printf(" };\n\n");
+
+    printf("const char category_letters[CATEGORY_COUNT] = {");
+    for (int i = 0; i < NUM_CATEGORIES; i++) printf(" '%c',", categories[i].letter);
+    printf(" };\n\n");
+
+    printf("const char *const category_names[CATEGORY_COUNT] = {\n");
+    for (int i = 0; i < NUM_CATEGORIES; i++) print_item(categories[i].name);
+    printf("};\n\n");
+
+    printf("const char *const category_descs[CATEGORY_COUNT] = {\n");
+    for (int i = 0; i < NUM_CATEGORIES; i++) print_item(categories[i].description);
+    printf("};\n\n");
+    return 1;
+}
+
+static void emit_value_grids(void) {
+    printf("const short grid_values[%d] = {", grid_count);
+    for (int i = 0; i < grid_count; i++) {
+        printf("%s%d,", (i % 16 == 0) ? "\n    " : " ", grid_values[i]);
+    }
+    printf("\n};\n\n");
+}
+
+static void emit_menu_text(void) {
+    char line[256];
+
+    printf("const char menu_text[] =\n");
+    print_line("\n");
+    print_line("Metric Trainer - Metric Conversion Practice\n");
+    print_line("==========================================\n\n");
+    print_line("Select categories:\n");
+    for (int i = 0; i < NUM_CATEGORIES; i++) {
+        snprintf(line, sizeof(line), "  %c) %-13s%s\n",
+                 categories[i].letter, categories[i].name, categories[i].description);
+        print_line(line);
+    }
+    print_line("  all) All categories\n\n");
+    print_line("Enter choice (e.g., \"b\", \"all\", \"ac\", or \"help\"): ");
+    printf("    ;\n\n");
+}
+
+static void emit_reference_text(void) {
+    char line[256];
+
+    printf("const char reference_text[] =\n");
+    print_line("\nConversion Reference - All Formulas\n");
+    print_line("═══════════════════════════════════\n\n");
+
+    for (int cat = 0; cat < NUM_CATEGORIES; cat++) {
+        int len = 0;
+        for (const char *p = categories[cat].name; *p && len < 64; p++) {
+            line[len++] = (char)toupper((unsigned char)*p);
+        }
+        line[len] = '\0';
+        strcat(line, " CONVERSIONS\n");
+        if (cat > 0) print_line("\n");
+        print_line(line);
+
+        // Underline with one box-drawing rule per header character
+        line[0] = '\0';
+        for (int i = 0; i < len + 12; i++) strcat(line, "─");
+        strcat(line, "\n");
+        print_line(line);
+
+        for (int i = 0; i < NUM_CONVERSIONS; i++) {
+            if (category_index(conversions[i].category) == cat && conversions[i].reference) {
+                snprintf(line, sizeof(line), "%s\n", conversions[i].reference);
+                print_line(line);
+            }
+        }
+    }
+
+    print_line("\n═══════════════════════════════════\n");
+    print_line("Note: These formulas show the exact mathematical relationships.\n");
+    print_line("During practice, answers within the tolerance range are accepted.\n\n");
+    printf("    ;\n");
+}
+
+int main(void) {
+    printf("/* Generated by tools/gentables from src/conversions.def - do not edit. */\n\n");
+    printf("#include \"tables.h\"\n\n");
+
+    if (!emit_category_tables() || !build_value_grids()) {
+        return 1;
+    }
+    emit_conversion_table();
+    emit_conversion_names();
+    emit_value_grids();
+    emit_menu_text();
+    emit_reference_text();
+    return 0;
+}
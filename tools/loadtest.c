@@ -0,0 +1,460 @@
+/*
+ * loadtest.c - Load Generator for `metric-trainer serve`
+ *
+ * Opens many keep-alive connections, starts a session on each, then
+ * keeps every connection busy with batches of pipelined question and
+ * answer requests for a fixed time. Reports requests per second, any
+ * error responses, the system calls and heap allocations the server made
+ * per request, and the memory it holds per open session, all read from
+ * its /metrics before and after. Given two ports (say, one
+ * server on each event loop backend) it loads each in turn and compares
+ * them. Single-threaded with epoll, like the server, so on a one-core
+ * machine the two split the CPU.
+ *
+ * Usage: loadtest [-p PORT]... [-c CONNECTIONS] [-d SECONDS] [-P PAIRS]
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_EVENTS 256
+#define BUFFER_SIZE 16384
+#define SESSION_ID_DIGITS 16
+#define MAX_SERVERS 2
+#define METRICS_SIZE 65536
+
+typedef struct {
+    int fd;
+    char session[SESSION_ID_DIGITS + 1];  // Empty until the session starts
+    char in[BUFFER_SIZE];
+    size_t in_len;
+    char out[BUFFER_SIZE];
+    size_t out_len;
+    size_t out_sent;
+    int awaiting;                         // Responses still to come
+} client_t;
+
+typedef struct {
+    int ports[MAX_SERVERS];
+    int servers;
+    int connections;
+    double seconds;
+    int pairs;                            // Question/answer pairs per batch
+} loadtest_options_t;
+
+/* What the server's /metrics said */
+typedef struct {
+    char backend[32];
+    unsigned long long syscalls;
+    unsigned long long allocations;
+    unsigned long long sessions;
+    unsigned long long session_bytes;
+} server_counts_t;
+
+typedef struct {
+    int port;
+    char backend[32];
+    double seconds;
+    unsigned long long responses;
+    unsigned long long errors;
+    unsigned long long syscalls;      // Server's, while loaded
+    unsigned long long allocations;
+    unsigned long long sessions;      // Open once loaded, and the memory they hold
+    unsigned long long session_bytes;
+    int lost;
+} run_result_t;
+
+static unsigned long long responses = 0;
+static unsigned long long errors = 0;
+
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static void queue(client_t *client, const char *request) {
+    size_t n = strlen(request);
+    memcpy(client->out + client->out_len, request, n);
+    client->out_len += n;
+    client->awaiting++;
+}
+
+static void queue_batch(client_t *client, int pairs) {
+    char request[256];
+    client->out_len = 0;
+    client->out_sent = 0;
+    if (client->session[0] == '\0') {
+        queue(client, "POST /session HTTP/1.1\r\nHost: localhost\r\nContent-Length: 0\r\n\r\n");
+        return;
+    }
+    for (int i = 0; i < pairs; i++) {
+        snprintf(request, sizeof(request), "GET /session/%s/question HTTP/1.1\r\nHost: localhost\r\n\r\n",
+                 client->session);
+        queue(client, request);
+        snprintf(request, sizeof(request),
+                 "POST /session/%s/answer?value=1 HTTP/1.1\r\nHost: localhost\r\nContent-Length: 0\r\n\r\n",
+                 client->session);
+        queue(client, request);
+    }
+}
+
+/* Send queued requests; returns -1 on a connection error */
+static int flush_client(client_t *client) {
+    while (client->out_sent < client->out_len) {
+        ssize_t n = send(client->fd, client->out + client->out_sent, client->out_len - client->out_sent,
+                         MSG_NOSIGNAL);
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        client->out_sent += (size_t)n;
+    }
+    return 0;
+}
+
+/* Consume complete responses; returns -1 on a malformed one */
+static int take_responses(client_t *client) {
+    size_t offset = 0;
+    for (;;) {
+        char *start = client->in + offset;
+        size_t len = client->in_len - offset;
+        char *head_end = NULL;
+        for (size_t i = 3; i < len; i++) {
+            if (memcmp(start + i - 3, "\r\n\r\n", 4) == 0) {
+                head_end = start + i + 1;
+                break;
+            }
+        }
+        if (head_end == NULL) {
+            break;
+        }
+        char *length = NULL;
+        for (char *p = start; p < head_end - 16; p++) {
+            if (strncasecmp(p, "\nContent-Length:", 16) == 0) {
+                length = p + 16;
+                break;
+            }
+        }
+        if (length == NULL || len < 12) {
+            return -1;
+        }
+        size_t body_len = (size_t)strtoul(length, NULL, 10);
+        if ((size_t)(head_end - start) + body_len > len) {
+            break;
+        }
+        int status = atoi(start + 9);
+        if (status >= 400) {
+            errors++;
+        } else if (client->session[0] == '\0') {
+            static const char prefix[] = "{\"session\":\"";
+            if (body_len < sizeof(prefix) - 1 + SESSION_ID_DIGITS ||
+                memcmp(head_end, prefix, sizeof(prefix) - 1) != 0) {
+                return -1;
+            }
+            memcpy(client->session, head_end + sizeof(prefix) - 1, SESSION_ID_DIGITS);
+            client->session[SESSION_ID_DIGITS] = '\0';
+        }
+        responses++;
+        client->awaiting--;
+        offset += (size_t)(head_end - start) + body_len;
+    }
+    memmove(client->in, client->in + offset, client->in_len - offset);
+    client->in_len -= offset;
+    return 0;
+}
+
+static int connect_client(client_t *client, int port, int epoll_fd) {
+    struct sockaddr_in addr;
+    int one = 1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    client->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (client->fd < 0 || connect(client->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        return -1;
+    }
+    setsockopt(client->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(client->fd, F_SETFL, fcntl(client->fd, F_GETFL, 0) | O_NONBLOCK);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = client };
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client->fd, &ev);
+}
+
+static int parse_options(int argc, char *argv[], loadtest_options_t *opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->connections = 100;
+    opts->seconds = 5.0;
+    opts->pairs = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (value == NULL) {
+            fprintf(stderr, "loadtest: unknown option or missing value: %s\n", arg);
+            return -1;
+        }
+        i++;
+        if (strcmp(arg, "-p") == 0) {
+            if (opts->servers == MAX_SERVERS) {
+                fprintf(stderr, "loadtest: at most %d ports\n", MAX_SERVERS);
+                return -1;
+            }
+            opts->ports[opts->servers++] = atoi(value);
+        } else if (strcmp(arg, "-c") == 0) {
+            opts->connections = atoi(value);
+        } else if (strcmp(arg, "-d") == 0) {
+            opts->seconds = atof(value);
+        } else if (strcmp(arg, "-P") == 0) {
+            opts->pairs = atoi(value);
+        } else {
+            fprintf(stderr, "loadtest: unknown option: %s\n", arg);
+            return -1;
+        }
+    }
+    if (opts->servers == 0) {
+        opts->ports[opts->servers++] = 8080;
+    }
+    for (int i = 0; i < opts->servers; i++) {
+        if (opts->ports[i] <= 0 || opts->ports[i] > 65535) {
+            fprintf(stderr, "loadtest: invalid port\n");
+            return -1;
+        }
+    }
+    // A batch must fit the client's output buffer
+    if (opts->connections <= 0 || opts->seconds <= 0 || opts->pairs <= 0 || opts->pairs > BUFFER_SIZE / 256 / 2) {
+        fprintf(stderr, "loadtest: invalid option value\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* The value of the series starting with name, or 0 if there is none */
+static unsigned long long series_value(const char *text, const char *name) {
+    size_t len = strlen(name);
+    for (const char *line = text; line != NULL && *line != '\0'; line = strchr(line, '\n')) {
+        line += *line == '\n';
+        if (strncmp(line, name, len) == 0 && (line[len] == ' ' || line[len] == '{')) {
+            const char *space = strchr(line, ' ');
+            return space != NULL ? strtoull(space + 1, NULL, 10) : 0;
+        }
+    }
+    return 0;
+}
+
+/* Read the server's own counters from /metrics; -1 if it has none */
+static int read_server_counts(int port, server_counts_t *counts) {
+    static const char request[] = "GET /metrics HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    static const char series[] = "metric_trainer_server_syscalls_total{backend=\"";
+    static char text[METRICS_SIZE];
+    struct sockaddr_in addr;
+    size_t len = 0;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        send(fd, request, sizeof(request) - 1, MSG_NOSIGNAL) < 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    ssize_t n;
+    while (len < sizeof(text) - 1 && (n = recv(fd, text + len, sizeof(text) - 1 - len, 0)) > 0) {
+        len += (size_t)n;
+    }
+    close(fd);
+    text[len] = '\0';
+
+    const char *found = strstr(text, series);
+    if (found == NULL) {
+        return -1;
+    }
+    found += sizeof(series) - 1;
+    const char *quote = strchr(found, '"');
+    if (quote == NULL || (size_t)(quote - found) >= sizeof(counts->backend) || quote[1] != '}') {
+        return -1;
+    }
+    memcpy(counts->backend, found, (size_t)(quote - found));
+    counts->backend[quote - found] = '\0';
+    counts->syscalls = strtoull(quote + 2, NULL, 10);
+    counts->allocations = series_value(text, "metric_trainer_server_allocations_total");
+    counts->sessions = series_value(text, "metric_trainer_sessions_active");
+    counts->session_bytes = series_value(text, "metric_trainer_server_session_bytes");
+    return 0;
+}
+
+/* Load one server; returns -1 if it could not be loaded at all */
+static int run_load(const loadtest_options_t *opts, int port, run_result_t *result) {
+    memset(result, 0, sizeof(*result));
+    result->port = port;
+    responses = 0;
+    errors = 0;
+
+    int epoll_fd = epoll_create1(0);
+    client_t *clients = calloc((size_t)opts->connections, sizeof(client_t));
+    if (epoll_fd < 0 || clients == NULL) {
+        perror("loadtest");
+        return -1;
+    }
+    int connected = 0;
+    int status = -1;
+    for (; connected < opts->connections; connected++) {
+        if (connect_client(&clients[connected], port, epoll_fd) != 0) {
+            fprintf(stderr, "loadtest: port %d, connection %d: %s\n", port, connected + 1, strerror(errno));
+            goto done;
+        }
+        queue_batch(&clients[connected], opts->pairs);
+        flush_client(&clients[connected]);
+    }
+
+    // Sessions are started before the clock starts
+    int started = 0;
+    while (started < opts->connections) {
+        struct epoll_event events[MAX_EVENTS];
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, 5000);
+        if (n <= 0) {
+            fprintf(stderr, "loadtest: port %d stopped answering\n", port);
+            goto done;
+        }
+        for (int i = 0; i < n; i++) {
+            client_t *client = events[i].data.ptr;
+            ssize_t got = recv(client->fd, client->in + client->in_len, BUFFER_SIZE - client->in_len, 0);
+            if (got <= 0 || (client->in_len += (size_t)got, take_responses(client)) != 0) {
+                fprintf(stderr, "loadtest: port %d lost a connection while starting sessions\n", port);
+                goto done;
+            }
+            if (client->awaiting == 0) {
+                started++;
+            }
+        }
+    }
+    if (errors > 0) {
+        fprintf(stderr, "loadtest: port %d could not start %llu sessions\n", port, errors);
+        goto done;
+    }
+    responses = 0;
+
+    server_counts_t before, after;
+    bool counted = read_server_counts(port, &before) == 0;
+    double start = now_seconds();
+    double stop = start + opts->seconds;
+    for (int i = 0; i < opts->connections; i++) {
+        queue_batch(&clients[i], opts->pairs);
+        flush_client(&clients[i]);
+    }
+    while (now_seconds() < stop) {
+        struct epoll_event events[MAX_EVENTS];
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, 100);
+        for (int i = 0; i < n; i++) {
+            client_t *client = events[i].data.ptr;
+            ssize_t got = recv(client->fd, client->in + client->in_len, BUFFER_SIZE - client->in_len, 0);
+            if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                continue;
+            }
+            if (got <= 0 || (client->in_len += (size_t)got, take_responses(client)) != 0) {
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+                result->lost++;
+                continue;
+            }
+            if (client->awaiting == 0) {
+                queue_batch(client, opts->pairs);
+            }
+            if (flush_client(client) != 0) {
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+                result->lost++;
+            }
+        }
+    }
+    result->seconds = now_seconds() - start;
+    result->responses = responses;
+    result->errors = errors;
+    strcpy(result->backend, "?");
+    if (counted && read_server_counts(port, &after) == 0) {
+        strcpy(result->backend, after.backend);
+        result->syscalls = after.syscalls - before.syscalls;
+        result->allocations = after.allocations - before.allocations;
+        result->sessions = after.sessions;
+        result->session_bytes = after.session_bytes;
+    }
+    status = 0;
+
+done:
+    for (int i = 0; i < connected; i++) {
+        close(clients[i].fd);
+    }
+    free(clients);
+    close(epoll_fd);
+    return status;
+}
+
+int main(int argc, char *argv[]) {
+    loadtest_options_t opts;
+    if (parse_options(argc, argv, &opts) != 0) {
+        fprintf(stderr, "Usage: loadtest [-p PORT]... [-c CONNECTIONS] [-d SECONDS] [-P PAIRS]\n");
+        return 1;
+    }
+
+    run_result_t results[MAX_SERVERS];
+    for (int i = 0; i < opts.servers; i++) {
+        if (run_load(&opts, opts.ports[i], &results[i]) != 0) {
+            return 1;
+        }
+    }
+
+    printf("%d connections, %d pipelined requests per batch, %.0f s per server\n\n",
+           opts.connections, 2 * opts.pairs, opts.seconds);
+    printf("  %5s  %-8s  %12s  %12s  %14s  %12s  %13s  %7s  %4s\n", "Port", "Backend", "Responses",
+           "Requests/s", "Syscalls/req", "Allocs/req", "Bytes/session", "Errors", "Lost");
+    int failed = 0;
+    for (int i = 0; i < opts.servers; i++) {
+        const run_result_t *r = &results[i];
+        printf("  %5d  %-8s  %12llu  %12.0f  ", r->port, r->backend, r->responses,
+               (double)r->responses / r->seconds);
+        if (r->syscalls > 0 && r->responses > 0) {
+            printf("%14.3f  %12.4f  ", (double)r->syscalls / (double)r->responses,
+                   (double)r->allocations / (double)r->responses);
+        } else {
+            printf("%14s  %12s  ", "-", "-");
+        }
+        if (r->sessions > 0 && r->session_bytes > 0) {
+            printf("%13llu", r->session_bytes / r->sessions);
+        } else {
+            printf("%13s", "-");
+        }
+        printf("  %7llu  %4d\n", r->errors, r->lost);
+        failed |= r->errors > 0 || r->lost > 0;
+    }
+
+    if (opts.servers == 2 && results[0].responses > 0 && results[1].responses > 0) {
+        const run_result_t *a = &results[0], *b = &results[1];
+        double rate_a = (double)a->responses / a->seconds;
+        double rate_b = (double)b->responses / b->seconds;
+        printf("\n%s vs %s: %+.1f%% requests/s", b->backend, a->backend, 100.0 * (rate_b / rate_a - 1.0));
+        if (a->syscalls > 0 && b->syscalls > 0) {
+            double per_a = (double)a->syscalls / (double)a->responses;
+            double per_b = (double)b->syscalls / (double)b->responses;
+            if (per_a >= per_b) {
+                printf(", %.1fx fewer system calls per request", per_a / per_b);
+            } else {
+                printf(", %.1fx more system calls per request", per_b / per_a);
+            }
+        }
+        printf("\n");
+    }
+    return failed ? 1 : 0;
+}